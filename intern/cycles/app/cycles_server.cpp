@@ -36,10 +36,11 @@ int main(int argc, const char **argv)
 	/* device types */
 	string devicelist = "";
 	string devicename = "cpu";
+	string socket_path = "";
 	bool list = false, debug = false;
 	int threads = 0, verbosity = 1;
 
-	vector<DeviceType>& types = Device::available_types();
+	vector<DeviceType> types = Device::available_types();
 
 	foreach(DeviceType type, types) {
 		if(devicelist != "")
@@ -55,6 +56,7 @@ int main(int argc, const char **argv)
 		"--device %s", &devicename, ("Devices to use: " + devicelist).c_str(),
 		"--list-devices", &list, "List information about all available devices",
 		"--threads %d", &threads, "Number of threads to use for CPU device",
+		"--socket %s", &socket_path, "Listen on a Unix domain socket instead of TCP, for local clients",
 #ifdef WITH_CYCLES_LOGGING
 		"--debug", &debug, "Enable debug logging",
 		"--verbose %d", &verbosity, "Set verbosity of the logger",
@@ -73,7 +75,7 @@ int main(int argc, const char **argv)
 	}
 
 	if(list) {
-		vector<DeviceInfo>& devices = Device::available_devices();
+		vector<DeviceInfo> devices = Device::available_devices();
 
 		printf("Devices:\n");
 
@@ -88,7 +90,7 @@ int main(int argc, const char **argv)
 
 	/* find matching device */
 	DeviceType device_type = Device::type_from_string(devicename.c_str());
-	vector<DeviceInfo>& devices = Device::available_devices();
+	vector<DeviceInfo> devices = Device::available_devices();
 	DeviceInfo device_info;
 
 	foreach(DeviceInfo& device, devices) {
@@ -102,9 +104,10 @@ int main(int argc, const char **argv)
 
 	while(1) {
 		Stats stats;
-		Device *device = Device::create(device_info, stats, true);
+		Profiler profiler;
+		Device *device = Device::create(device_info, stats, profiler, true);
 		printf("Cycles Server with device: %s\n", device->info.description.c_str());
-		device->server_run();
+		device->server_run(socket_path);
 		delete device;
 	}
 
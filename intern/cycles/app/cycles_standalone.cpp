@@ -138,6 +138,29 @@ void end_session()
 	default_thread_pool()->clear_threads();
 }
 
+void write_profiling_report(RenderStats& stats)
+{
+	if(options.profiling_report_path.empty()) {
+		return;
+	}
+
+	string report = stats.json_report();
+	if(!path_write_text(options.profiling_report_path, report)) {
+		fprintf(stderr, "Failed to write profiling report %s\n", options.profiling_report_path.c_str());
+	}
+}
+
+void write_session_profiling_report()
+{
+	if(options.profiling_report_path.empty() || !options.session) {
+		return;
+	}
+
+	RenderStats stats;
+	options.session->collect_statistics(&stats);
+	write_profiling_report(stats);
+}
+
 bool write_render(const uchar *pixels, int w, int h, int channels)
 {
 	string msg = string_printf("Writing image %s", options.output_path.c_str());
@@ -762,7 +785,12 @@ void bake_light_map()
 	float* ret = new float[bake_output_buffer_size];
 	memset(ret, 0, bake_output_buffer_size * sizeof(float));
 	int pass_filter = BAKE_FILTER_INDIRECT;
-	scene->bake_manager->bake(scene->device, &scene->dscene, scene, options.session->progress, shader_value_type, pass_filter, ras->get_bake_data(), ret);
+	scene->bake_manager->use_profiling = options.session_params.use_profiling;
+	if(scene->bake_manager->bake(scene->device, &scene->dscene, scene, options.session->progress, shader_value_type, pass_filter, ras->get_bake_data(), ret) &&
+	   scene->bake_manager->use_profiling)
+	{
+		write_profiling_report(scene->bake_manager->profiling_stats);
+	}
 
 	const int channel = 4;
 	if (shader_value_type == SHADER_EVAL_SH4)
@@ -997,6 +1025,9 @@ static void options_parse(int argc, const char **argv)
 	/* parse options */
 	ArgParse ap;
 	bool help = false, debug = false, version = false;
+	bool numa_replication = false;
+	int tile_memory_mb = 0;
+	string workers = "";
 	int verbosity = 1;
 
 	ap.options ("Usage: cycles [options] file.xml",
@@ -1010,11 +1041,21 @@ static void options_parse(int argc, const char **argv)
 		"--samples %d", &options.session_params.samples, "Number of samples to render",
 		"--output %s", &options.output_path, "File path to write output image",
 		"--threads %d", &options.session_params.threads, "CPU Rendering Threads",
+		"--numa", &options.session_params.numa_affinity, "Bind CPU rendering threads to NUMA nodes",
+		"--numa-replicate", &numa_replication, "Copy BVH and triangle data to every NUMA node",
 		"--width  %d", &options.width, "Window width in pixel",
 		"--height %d", &options.height, "Window height in pixel",
 		"--tile-width %d", &options.session_params.tile_size.x, "Tile width in pixels",
 		"--tile-height %d", &options.session_params.tile_size.y, "Tile height in pixels",
+		"--adaptive-tiles", &options.session_params.adaptive_tiles, "Split tiles at the end of a pass to keep all threads busy",
+		"--out-of-core %s", &options.session_params.out_of_core_path, "Stream finished tiles to this tiled EXR file instead of keeping the full frame in memory",
+		"--tile-memory %d", &tile_memory_mb, "Memory budget for out-of-core tile buffers in MB, spilled to disk above it",
+#ifdef WITH_NETWORK
+		"--workers %s", &workers, "Comma separated Unix socket paths of cycles_server processes to share bakes with",
+#endif
 		"--list-devices", &list, "List information about all available devices",
+		"--profile", &options.session_params.use_profiling, "Collect kernel profiling information (CPU only)",
+		"--profile-report %s", &options.profiling_report_path, "Write kernel, shader and object profiling statistics to this JSON file (CPU only)",
 #ifdef WITH_CYCLES_LOGGING
 		"--debug", &debug, "Enable debug logging",
 		"--verbose %d", &verbosity, "Set verbosity of the logger",
@@ -1065,9 +1106,20 @@ static void options_parse(int argc, const char **argv)
 	options.session_params.background = true;
 #endif
 
+	if(!options.profiling_report_path.empty()) {
+		options.session_params.use_profiling = true;
+	}
+
 	/* Use progressive rendering */
 	options.session_params.progressive = true;
 
+	/* Out-of-core rendering finishes every tile in one go, so it can be written and freed. */
+	if(!options.session_params.out_of_core_path.empty()) {
+		options.session_params.background = true;
+		options.session_params.progressive = false;
+		options.session_params.tile_memory_budget = (size_t)max(tile_memory_mb, 0) * 1024 * 1024;
+	}
+
 	/* find matching device */
 	DeviceType device_type = Device::type_from_string(devicename.c_str());
 	vector<DeviceInfo> devices = Device::available_devices(DEVICE_MASK(device_type));
@@ -1075,9 +1127,28 @@ static void options_parse(int argc, const char **argv)
 	bool device_available = false;
 	if (!devices.empty()) {
 		options.session_params.device = devices.front();
+		options.session_params.device.numa_replication = numa_replication;
 		device_available = true;
 	}
 
+#ifdef WITH_NETWORK
+	/* Texels are distributed between the local device and the workers. */
+	if(device_available && !workers.empty()) {
+		vector<string> paths;
+		string_split(paths, workers, ",");
+
+		vector<DeviceInfo> subdevices;
+		subdevices.push_back(options.session_params.device);
+		foreach(const string& path, paths) {
+			subdevices.push_back(Device::get_network_device("unix:" + path));
+		}
+
+		options.session_params.device = Device::get_multi_device(subdevices,
+		                                                         options.session_params.threads,
+		                                                         options.session_params.background);
+	}
+#endif
+
 	/* handle invalid configurations */
 	if(options.session_params.device.type == DEVICE_NONE || !device_available) {
 		fprintf(stderr, "Unknown device: %s\n", devicename.c_str());
@@ -1121,6 +1192,7 @@ int main(int argc, const char **argv)
 #endif
 		session_init();
 		options.session->wait();
+		write_session_profiling_report();
 		session_exit();
 #ifdef WITH_CYCLES_STANDALONE_GUI
 	}
@@ -7,6 +7,7 @@
 #include <util/util_transform.h>
 #include <render/scene.h>
 #include <render/session.h>
+#include <render/stats.h>
 
 #include <render/mesh.h>
 #include <render/object.h>
@@ -23,6 +24,8 @@ struct Options {
 	bool quiet;
 	bool show_help, interactive, pause;
 	string output_path;
+	/* JSON file the profiling statistics are written to, empty to disable. */
+	string profiling_report_path;
 };
 extern Options options;
 
@@ -32,6 +35,8 @@ bool write_float_map(const float* pixels, int w, int h, int channels);
 void start_render_image();
 void bake_light_map();
 void end_session();
+void write_profiling_report(RenderStats& stats);
+void write_session_profiling_report();
 
 int create_pbr_shader(Scene* scene, const std::string& diff_tex, const std::string& mtl_tex, const std::string& normal_tex);
 void fbx_add_default_shader(Scene* scene);
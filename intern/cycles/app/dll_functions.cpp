@@ -74,6 +74,7 @@ void assign_session_specific(const int w, const int h, const int render_device,
 	options.height = h;
 	options.session_params.tile_size.x = 128;
 	options.session_params.tile_size.y = 128;
+	options.session_params.adaptive_tiles = true;
 	bool debug = true;
 
 	if (debug) {
@@ -380,6 +381,18 @@ DLL_EXPORT int unity_add_light(const char* name, float intensity, float radius,
 	return 0;
 }
 
+DLL_EXPORT int set_profiling_report(const char* filepath)
+{
+	options.profiling_report_path = filepath ? filepath : "";
+	options.session_params.use_profiling = !options.profiling_report_path.empty();
+	if (options.session)
+	{
+		options.session->params.use_profiling = options.session_params.use_profiling;
+	}
+
+	return 0;
+}
+
 DLL_EXPORT int bake_lightmap()
 {
 	bake_light_map();
@@ -413,6 +426,7 @@ DLL_EXPORT int interactive_pt_rendering(UnityRenderOptions u3d_render_options, S
 	start_render_image();
 	options.session->render_icb = icb;
 	options.session->wait();
+	write_session_profiling_report();
 
 	return 0;
 }
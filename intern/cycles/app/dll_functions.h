@@ -63,6 +63,10 @@ extern "C"
 
 	DLL_EXPORT int unity_add_light(const char* name, float intensity, float radius, float* color, float* dir, float* pos, int type);
 
+	/* Collect kernel, shader and object profiling statistics (CPU only) and
+	 * write them as JSON to filepath after every bake or interactive render. */
+	DLL_EXPORT int set_profiling_report(const char* filepath);
+
 	DLL_EXPORT int bake_lightmap();
 
 	//typedef void (*render_image_cb)(const char* data, const int w, const int h, const int data_type);
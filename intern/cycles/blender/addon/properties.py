@@ -85,6 +85,8 @@ enum_curve_primitives = (
     ('TRIANGLES', "Triangles", "Create triangle geometry around strands"),
     ('LINE_SEGMENTS', "Line Segments", "Use line segment primitives"),
     ('CURVE_SEGMENTS', "Curve Segments", "Use segmented cardinal curve primitives"),
+    ('TESSELLATED_RIBBONS', "Tessellated Ribbons",
+     "Use cardinal curves tessellated into ribbons facing the ray, faster for dense hair and foliage", 4),
 )
 
 enum_triangle_curves = (
@@ -115,6 +117,7 @@ enum_use_layer_samples = (
 enum_sampling_pattern = (
     ('SOBOL', "Sobol", "Use Sobol random sampling pattern"),
     ('CORRELATED_MUTI_JITTER', "Correlated Multi-Jitter", "Use Correlated Multi-Jitter random sampling pattern"),
+    ('SOBOL_OWEN', "Owen Scrambled Sobol", "Use Sobol random sampling pattern with Owen scrambling, converges faster than Sobol at the same number of samples"),
 )
 
 enum_integrator = (
@@ -918,6 +921,12 @@ class CyclesLightSettings(bpy.types.PropertyGroup):
         description="Light casts shadows",
         default=True,
     )
+    use_transparent_shadow: BoolProperty(
+        name="Transparent Shadow",
+        description="Evaluate transparent surfaces for shadows of this light, "
+        "when disabled any surface blocks the light which is faster for scenes with many alpha mapped surfaces",
+        default=True,
+    )
     samples: IntProperty(
         name="Samples",
         description="Number of light samples to render for each AA sample",
@@ -356,9 +356,10 @@ class CYCLES_RENDER_PT_hair(CyclesButtonsPanel, Panel):
         col = layout.column()
         col.prop(ccscene, "minimum_width", text="Min Pixels")
         col.prop(ccscene, "maximum_width", text="Max Extension")
-        col.prop(ccscene, "shape", text="Shape")
-        if not (ccscene.primitive in {'CURVE_SEGMENTS', 'LINE_SEGMENTS'} and ccscene.shape == 'RIBBONS'):
-            col.prop(ccscene, "cull_backfacing", text="Cull back-faces")
+        if ccscene.primitive != 'TESSELLATED_RIBBONS':
+            col.prop(ccscene, "shape", text="Shape")
+            if not (ccscene.primitive in {'CURVE_SEGMENTS', 'LINE_SEGMENTS'} and ccscene.shape == 'RIBBONS'):
+                col.prop(ccscene, "cull_backfacing", text="Cull back-faces")
         col.prop(ccscene, "primitive", text="Primitive")
 
         if ccscene.primitive == 'TRIANGLES' and ccscene.shape == 'THICK':
@@ -1360,6 +1361,9 @@ class CYCLES_LIGHT_PT_light(CyclesButtonsPanel, Panel):
         sub = col.column(align=True)
         sub.active = not (light.type == 'AREA' and clamp.is_portal)
         sub.prop(clamp, "cast_shadow")
+        subsub = sub.row()
+        subsub.active = clamp.cast_shadow
+        subsub.prop(clamp, "use_transparent_shadow")
         sub.prop(clamp, "use_multiple_importance_sampling", text="Multiple Importance")
 
         if light.type == 'AREA':
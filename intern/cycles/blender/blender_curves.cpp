@@ -889,6 +889,11 @@ void BlenderSync::sync_curve_settings()
 			curve_system_manager->use_backfacing = false;
 		}
 	}
+	/* Tessellated Ribbons */
+	else if(curve_system_manager->primitive == CURVE_TESSELLATED_RIBBONS) {
+		curve_system_manager->curve_shape = CURVE_RIBBON;
+		curve_system_manager->use_backfacing = false;
+	}
 
 	if(curve_system_manager->modified_mesh(prev_curve_system_manager)) {
 		BL::BlendData::objects_iterator b_ob;
@@ -200,6 +200,7 @@ void BlenderSync::sync_light(BL::Object& b_parent,
 	PointerRNA cscene = RNA_pointer_get(&b_scene.ptr, "cycles");
 	PointerRNA clight = RNA_pointer_get(&b_light.ptr, "cycles");
 	light->cast_shadow = get_boolean(clight, "cast_shadow");
+	light->use_transparent_shadow = get_boolean(clight, "use_transparent_shadow");
 	light->use_mis = get_boolean(clight, "use_multiple_importance_sampling");
 
 	int samples = get_int(clight, "samples");
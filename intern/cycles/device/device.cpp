@@ -380,8 +380,15 @@ Device *Device::create(DeviceInfo& info, Stats &stats, Profiler &profiler, bool
 #endif
 #ifdef WITH_NETWORK
 		case DEVICE_NETWORK:
-			device = device_network_create(info, stats, profiler, "127.0.0.1");
+		{
+			/* Device id may carry the server address, as in "NETWORK:unix:/tmp/cycles.sock". */
+			string address = "127.0.0.1";
+			if(string_startswith(info.id, "NETWORK:")) {
+				address = info.id.substr(strlen("NETWORK:"));
+			}
+			device = device_network_create(info, stats, profiler, address.c_str());
 			break;
+		}
 #endif
 #ifdef WITH_OPENCL
 		case DEVICE_OPENCL:
@@ -558,12 +565,20 @@ DeviceInfo Device::get_multi_device(const vector<DeviceInfo>& subdevices, int th
 	info.has_osl = true;
 	info.has_profiling = true;
 
+	/* Network devices run in other processes and don't need CPU threads here. */
+	int num_local_devices = 0;
+	foreach(const DeviceInfo &device, subdevices) {
+		if(device.type != DEVICE_NETWORK) {
+			num_local_devices++;
+		}
+	}
+
 	foreach(const DeviceInfo &device, subdevices) {
 		/* Ensure CPU device does not slow down GPU. */
-		if(device.type == DEVICE_CPU && subdevices.size() > 1) {
+		if(device.type == DEVICE_CPU && num_local_devices > 1) {
 			if(background) {
 				int orig_cpu_threads = (threads)? threads: system_cpu_thread_count();
-				int cpu_threads = max(orig_cpu_threads - (subdevices.size() - 1), 0);
+				int cpu_threads = max(orig_cpu_threads - (num_local_devices - 1), 0);
 
 				VLOG(1) << "CPU render threads reduced from "
 						<< orig_cpu_threads << " to " << cpu_threads
@@ -597,6 +612,20 @@ DeviceInfo Device::get_multi_device(const vector<DeviceInfo>& subdevices, int th
 	return info;
 }
 
+#ifdef WITH_NETWORK
+DeviceInfo Device::get_network_device(const string& address)
+{
+	vector<DeviceInfo> devices;
+	device_network_info(devices);
+
+	DeviceInfo info = devices.front();
+	info.id = "NETWORK:" + address;
+	info.description = "Network Device " + address;
+
+	return info;
+}
+#endif
+
 void Device::tag_update()
 {
 	free_memory();
@@ -71,6 +71,7 @@ public:
 	bool has_osl;                   /* Support Open Shading Language. */
 	bool use_split_kernel;          /* Use split or mega kernel. */
 	bool has_profiling;             /* Supports runtime collection of profiling info. */
+	bool numa_replication;          /* Copy hot scene data to every NUMA node (CPU only). */
 	int cpu_threads;
 	vector<DeviceInfo> multi_devices;
 
@@ -87,6 +88,7 @@ public:
 		has_osl = false;
 		use_split_kernel = false;
 		has_profiling = false;
+		numa_replication = false;
 	}
 
 	bool operator==(const DeviceInfo &info) {
@@ -347,8 +349,8 @@ public:
 	    bool transparent, const DeviceDrawParams &draw_params);
 
 #ifdef WITH_NETWORK
-	/* networking */
-	void server_run();
+	/* networking, listens on a Unix domain socket if a path is given */
+	void server_run(const string& socket_path = "");
 #endif
 
 	/* multi device */
@@ -368,6 +370,11 @@ public:
 	static DeviceInfo get_multi_device(const vector<DeviceInfo>& subdevices,
 	                                   int threads,
 	                                   bool background);
+#ifdef WITH_NETWORK
+	/* Device connecting to the server at the given address, use "unix:<path>"
+	 * for a server on a local socket. */
+	static DeviceInfo get_network_device(const string& address);
+#endif
 
 	/* Tag devices lists for update. */
 	static void tag_update();
@@ -167,6 +167,16 @@ public:
 	device_vector<TextureInfo> texture_info;
 	bool need_texture_info;
 
+	/* Copies of hot read-only data textures on every NUMA node, indexed by
+	 * node. Worker threads bound to a node use them instead of the original
+	 * array, so BVH traversal doesn't read across the interconnect. */
+	struct NUMAReplica {
+		vector<void*> node_data;
+		size_t memory_size;
+		size_t data_size;
+	};
+	map<string, NUMAReplica> numa_replicas;
+
 #ifdef WITH_OSL
 	OSLGlobals osl_globals;
 #endif
@@ -240,6 +250,9 @@ public:
 #ifdef WITH_OSL
 		kernel_globals.osl = &osl_globals;
 #endif
+		/* Copied by threads that don't go through thread_kernel_globals_init(). */
+		kernel_globals.shadow_transparency_cache.num_entries = 0;
+		kernel_globals.shadow_transparency_cache.next_entry = 0;
 		use_split_kernel = DebugFlags().cpu.split_kernel;
 		if(use_split_kernel) {
 			VLOG(1) << "Will be using split kernel.";
@@ -273,6 +286,10 @@ public:
 	{
 		task_pool.stop();
 		texture_info.free();
+
+		while(!numa_replicas.empty()) {
+			numa_replica_free(numa_replicas.begin()->first);
+		}
 	}
 
 	virtual bool show_samples() const
@@ -402,6 +419,14 @@ public:
 							mem.name,
 							mem.host_pointer,
 							mem.data_size);
+
+			/* Replicas are only read by threads bound to a NUMA node. */
+			if(info.numa_replication &&
+			   TaskScheduler::numa_affinity() &&
+			   numa_replicate_texture(mem.name))
+			{
+				numa_replica_alloc(mem);
+			}
 		}
 		else {
 			/* Image Texture. */
@@ -440,6 +465,7 @@ public:
 	void tex_free(device_memory& mem)
 	{
 		if(mem.device_pointer) {
+			numa_replica_free(mem.name);
 			mem.device_pointer = 0;
 			stats.mem_free(mem.device_size);
 			mem.device_size = 0;
@@ -447,6 +473,78 @@ public:
 		}
 	}
 
+	/* Arrays read by every ray, worth having local to each NUMA node. */
+	static bool numa_replicate_texture(const char *name)
+	{
+		return (strcmp(name, "__bvh_nodes") == 0 ||
+		        strcmp(name, "__bvh_leaf_nodes") == 0 ||
+		        strcmp(name, "__prim_tri_verts") == 0 ||
+		        strcmp(name, "__prim_tri_index") == 0 ||
+		        strcmp(name, "__tri_vindex") == 0);
+	}
+
+	void numa_replica_alloc(device_memory& mem)
+	{
+		const int num_nodes = system_cpu_num_numa_nodes();
+		if(num_nodes < 2) {
+			return;
+		}
+
+		NUMAReplica& replica = numa_replicas[mem.name];
+		replica.memory_size = mem.memory_size();
+		replica.data_size = mem.data_size;
+		replica.node_data.resize(num_nodes, NULL);
+
+		for(int node = 0; node < num_nodes; node++) {
+			if(!system_cpu_is_numa_node_available(node)) {
+				continue;
+			}
+
+			void *data = system_cpu_allocate_on_node(replica.memory_size, node);
+			if(data) {
+				memcpy(data, mem.host_pointer, replica.memory_size);
+				stats.mem_alloc(replica.memory_size);
+			}
+			replica.node_data[node] = data;
+		}
+
+		VLOG(1) << "Replicated " << mem.name << " on " << num_nodes << " NUMA nodes.";
+	}
+
+	void numa_replica_free(const string& name)
+	{
+		map<string, NUMAReplica>::iterator it = numa_replicas.find(name);
+		if(it == numa_replicas.end()) {
+			return;
+		}
+
+		NUMAReplica& replica = it->second;
+		foreach(void *data, replica.node_data) {
+			if(data) {
+				system_cpu_free_on_node(data, replica.memory_size);
+				stats.mem_free(replica.memory_size);
+			}
+		}
+
+		numa_replicas.erase(it);
+	}
+
+	/* Point the thread's kernel globals to the replicas of its NUMA node. */
+	void numa_bind_kernel_globals(KernelGlobals *kg)
+	{
+		const int node = thread::current_node();
+		if(node < 0) {
+			return;
+		}
+
+		foreach(auto& it, numa_replicas) {
+			const NUMAReplica& replica = it.second;
+			if(node < replica.node_data.size() && replica.node_data[node]) {
+				kernel_tex_copy(kg, it.first.c_str(), replica.node_data[node], replica.data_size);
+			}
+		}
+	}
+
 	void *osl_memory()
 	{
 #ifdef WITH_OSL
@@ -895,10 +993,18 @@ public:
 	void thread_shader(DeviceTask& task)
 	{
 		KernelGlobals kg = kernel_globals;
+		numa_bind_kernel_globals(&kg);
 
 #ifdef WITH_OSL
 		OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
 #endif
+		/* Bakes sample shader timings, hit counters are only sized once the
+		 * profiler got reset, so only register while it is running. */
+		const bool use_profiling = profiler.active();
+		if(use_profiling) {
+			profiler.add_state(&kg.profiler);
+		}
+
 		for(int sample = 0; sample < task.num_samples; sample++) {
 			for(int x = task.shader_x; x < task.shader_x + task.shader_w; x++)
 				shader_kernel()(&kg,
@@ -919,6 +1025,10 @@ public:
 
 		}
 
+		if(use_profiling) {
+			profiler.remove_state(&kg.profiler);
+		}
+
 #ifdef WITH_OSL
 		OSLShader::thread_free(&kg);
 #endif
@@ -964,6 +1074,8 @@ protected:
 	{
 		KernelGlobals kg = kernel_globals;
 		kg.transparent_shadow_intersections = NULL;
+		kg.shadow_transparency_cache.num_entries = 0;
+		kg.shadow_transparency_cache.next_entry = 0;
 		const int decoupled_count = sizeof(kg.decoupled_volume_steps) /
 		                            sizeof(*kg.decoupled_volume_steps);
 		for(int i = 0; i < decoupled_count; ++i) {
@@ -971,6 +1083,7 @@ protected:
 		}
 		kg.decoupled_volume_steps_index = 0;
 		kg.coverage_asset = kg.coverage_object = kg.coverage_material = NULL;
+		numa_bind_kernel_globals(&kg);
 #ifdef WITH_OSL
 		OSLShader::thread_init(&kg, &kernel_globals, &osl_globals);
 #endif
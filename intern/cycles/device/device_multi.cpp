@@ -27,6 +27,7 @@
 #include "util/util_list.h"
 #include "util/util_logging.h"
 #include "util/util_map.h"
+#include "util/util_thread.h"
 #include "util/util_time.h"
 
 CCL_NAMESPACE_BEGIN
@@ -44,9 +45,25 @@ public:
 
 	list<SubDevice> devices;
 	device_ptr unique_key;
+	/* Host memory of each allocation, to combine the results of shader tasks. */
+	map<device_ptr, device_memory*> mem_map;
+
+	/* Range of texels of a shader task and the device that evaluated it. */
+	struct ShaderChunk {
+		int x, w;
+		SubDevice *sub;
+	};
+
+	DeviceTask shader_task;
+	vector<ShaderChunk> shader_chunks;
+	size_t shader_next_chunk;
+	bool shader_cancel;
+	thread_mutex shader_mutex;
+	vector<thread*> shader_threads;
 
 	MultiDevice(DeviceInfo& info, Stats &stats, Profiler &profiler, bool background_)
-	: Device(info, stats, profiler, background_), unique_key(1)
+	: Device(info, stats, profiler, background_), unique_key(1),
+	  shader_next_chunk(0), shader_cancel(false)
 	{
 		foreach(DeviceInfo& subinfo, info.multi_devices) {
 			Device *device = Device::create(subinfo, sub_stats_, profiler, background);
@@ -133,6 +150,8 @@ public:
 			sub.ptr_map[key] = mem.device_pointer;
 		}
 
+		mem_map[key] = &mem;
+
 		mem.device = this;
 		mem.device_pointer = key;
 		stats.mem_alloc(mem.device_size);
@@ -155,6 +174,7 @@ public:
 
 		mem.device = this;
 		mem.device_pointer = key;
+		mem_map[key] = &mem;
 		stats.mem_alloc(mem.device_size - existing_size);
 	}
 
@@ -195,6 +215,7 @@ public:
 
 		mem.device = this;
 		mem.device_pointer = key;
+		mem_map[key] = &mem;
 		stats.mem_alloc(mem.device_size - existing_size);
 	}
 
@@ -212,6 +233,8 @@ public:
 			sub.ptr_map.erase(sub.ptr_map.find(key));
 		}
 
+		mem_map.erase(key);
+
 		mem.device = this;
 		mem.device_pointer = 0;
 		mem.device_size = 0;
@@ -346,6 +369,11 @@ public:
 
 	void task_add(DeviceTask& task)
 	{
+		if(task.type == DeviceTask::SHADER && devices.size() > 1) {
+			shader_task_add(task);
+			return;
+		}
+
 		list<DeviceTask> tasks;
 		task.split(tasks, devices.size());
 
@@ -354,11 +382,7 @@ public:
 				DeviceTask subtask = tasks.front();
 				tasks.pop_front();
 
-				if(task.buffer) subtask.buffer = sub.ptr_map[task.buffer];
-				if(task.rgba_byte) subtask.rgba_byte = sub.ptr_map[task.rgba_byte];
-				if(task.rgba_half) subtask.rgba_half = sub.ptr_map[task.rgba_half];
-				if(task.shader_input) subtask.shader_input = sub.ptr_map[task.shader_input];
-				if(task.shader_output) subtask.shader_output = sub.ptr_map[task.shader_output];
+				map_task(sub, task, subtask);
 
 				sub.device->task_add(subtask);
 			}
@@ -367,16 +391,163 @@ public:
 
 	void task_wait()
 	{
+		if(!shader_threads.empty()) {
+			shader_task_wait();
+		}
+
 		foreach(SubDevice& sub, devices)
 			sub.device->task_wait();
 	}
 
 	void task_cancel()
 	{
+		{
+			thread_scoped_lock lock(shader_mutex);
+			shader_cancel = true;
+		}
+
 		foreach(SubDevice& sub, devices)
 			sub.device->task_cancel();
 	}
 
+protected:
+	void map_task(SubDevice& sub, const DeviceTask& task, DeviceTask& subtask)
+	{
+		if(task.buffer) subtask.buffer = sub.ptr_map[task.buffer];
+		if(task.rgba_byte) subtask.rgba_byte = sub.ptr_map[task.rgba_byte];
+		if(task.rgba_half) subtask.rgba_half = sub.ptr_map[task.rgba_half];
+		if(task.shader_input) subtask.shader_input = sub.ptr_map[task.shader_input];
+		if(task.shader_output) subtask.shader_output = sub.ptr_map[task.shader_output];
+		if(task.uvs_array) subtask.uvs_array = sub.ptr_map[task.uvs_array];
+		if(task.uvs_array_offset_ele_size) subtask.uvs_array_offset_ele_size = sub.ptr_map[task.uvs_array_offset_ele_size];
+	}
+
+	/* Shader tasks are cut into chunks which devices take from a queue as they
+	 * finish the previous one, so devices that are faster or finish early take
+	 * over more of the work. The kernel evaluates texels by their index in the
+	 * whole task, so the result doesn't depend on which device got a chunk. */
+	void shader_task_add(DeviceTask& task)
+	{
+		shader_task = task;
+		shader_chunks.clear();
+		shader_next_chunk = 0;
+		shader_cancel = false;
+
+		const int chunks_per_device = 8;
+		const int min_chunk_size = 1024;
+		int chunk_size = max(task.shader_w / ((int)devices.size() * chunks_per_device), min_chunk_size);
+
+		for(int x = task.shader_x; x < task.shader_x + task.shader_w; x += chunk_size) {
+			ShaderChunk chunk;
+			chunk.x = x;
+			chunk.w = min(chunk_size, task.shader_x + task.shader_w - x);
+			chunk.sub = NULL;
+			shader_chunks.push_back(chunk);
+		}
+
+		foreach(SubDevice& sub, devices) {
+			shader_threads.push_back(new thread(function_bind(&MultiDevice::shader_thread, this, &sub)));
+		}
+	}
+
+	void shader_thread(SubDevice *sub)
+	{
+		/* Network devices don't report progress while the task is running. */
+		const bool report_progress = (sub->device->info.type == DEVICE_NETWORK);
+
+		for(;;) {
+			ShaderChunk chunk;
+			{
+				thread_scoped_lock lock(shader_mutex);
+				if(shader_cancel || shader_next_chunk == shader_chunks.size()) {
+					break;
+				}
+				shader_chunks[shader_next_chunk].sub = sub;
+				chunk = shader_chunks[shader_next_chunk++];
+			}
+
+			DeviceTask subtask = shader_task;
+			subtask.shader_x = chunk.x;
+			subtask.shader_w = chunk.w;
+			map_task(*sub, shader_task, subtask);
+
+			sub->device->task_add(subtask);
+			sub->device->task_wait();
+
+			if(shader_task.get_cancel && shader_task.get_cancel()) {
+				break;
+			}
+
+			if(report_progress && shader_task.update_progress_sample) {
+				shader_task.update_progress_sample((long)chunk.w * shader_task.num_samples, 0);
+			}
+		}
+	}
+
+	void shader_task_wait()
+	{
+		foreach(thread *t, shader_threads) {
+			t->join();
+			delete t;
+		}
+		shader_threads.clear();
+
+		foreach(SubDevice& sub, devices) {
+			int num_chunks = 0, num_texels = 0;
+			foreach(const ShaderChunk& chunk, shader_chunks) {
+				if(chunk.sub == &sub) {
+					num_chunks++;
+					num_texels += chunk.w;
+				}
+			}
+			VLOG(1) << sub.device->info.description << " evaluated "
+			        << num_texels << " texels in " << num_chunks << " chunks.";
+		}
+
+		shader_output_combine();
+	}
+
+	/* Read the output of every chunk back from the device that evaluated it,
+	 * then send the combined output to all devices, so the output can be
+	 * copied from the devices like for any other task. */
+	void shader_output_combine()
+	{
+		device_ptr key = shader_task.shader_output;
+		map<device_ptr, device_memory*>::iterator it = mem_map.find(key);
+		if(it == mem_map.end()) {
+			return;
+		}
+
+		device_memory& mem = *it->second;
+		const size_t existing_size = mem.device_size;
+		const int elem = (int)(mem.data_elements * datatype_size(mem.data_type));
+		const int scale = (int)mem.data_size / (shader_task.shader_x + shader_task.shader_w);
+
+		foreach(const ShaderChunk& chunk, shader_chunks) {
+			if(!chunk.sub) {
+				continue;
+			}
+
+			mem.device = chunk.sub->device;
+			mem.device_pointer = chunk.sub->ptr_map[key];
+
+			chunk.sub->device->mem_copy_from(mem, chunk.x * scale, 1, chunk.w * scale, elem);
+		}
+
+		foreach(SubDevice& sub, devices) {
+			mem.device = sub.device;
+			mem.device_pointer = sub.ptr_map[key];
+			mem.device_size = existing_size;
+
+			sub.device->mem_copy_to(mem);
+			sub.ptr_map[key] = mem.device_pointer;
+		}
+
+		mem.device = this;
+		mem.device_pointer = key;
+		mem.device_size = existing_size;
+	}
+
 protected:
 	Stats sub_stats_;
 };
@@ -45,34 +45,61 @@ class NetworkDevice : public Device
 {
 public:
 	boost::asio::io_service io_service;
-	tcp::socket socket;
+	network_socket socket;
 	device_ptr mem_counter;
 	DeviceTask the_task; /* todo: handle multiple tasks */
 
 	thread_mutex rpc_lock;
 
+	/* Compressing costs more than it saves on local sockets. */
+	bool compress_buffers;
+	NetworkStats upload_stats;
+
 	virtual bool show_samples() const
 	{
 		return false;
 	}
 
 	NetworkDevice(DeviceInfo& info, Stats &stats, Profiler &profiler, const char *address)
-	: Device(info, stats, profiler, true), socket(io_service)
+	: Device(info, stats, profiler, true), socket(io_service), compress_buffers(true)
 	{
 		error_func = NetworkError();
-		stringstream portstr;
-		portstr << SERVER_PORT;
+		boost::system::error_code error = boost::asio::error::host_not_found;
 
-		tcp::resolver resolver(io_service);
-		tcp::resolver::query query(address, portstr.str());
-		tcp::resolver::iterator endpoint_iterator = resolver.resolve(query);
-		tcp::resolver::iterator end;
+		if(string_startswith(address, LOCAL_SOCKET_PREFIX.c_str())) {
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+			string path = string(address).substr(LOCAL_SOCKET_PREFIX.size());
+			boost::asio::local::stream_protocol::socket local_socket(io_service);
+			local_socket.connect(boost::asio::local::stream_protocol::endpoint(path), error);
+			if(!error) {
+				socket = network_socket(std::move(local_socket));
+			}
+			compress_buffers = false;
+#else
+			error = boost::asio::error::operation_not_supported;
+#endif
+		}
+		else {
+			stringstream portstr;
+			portstr << SERVER_PORT;
+
+			tcp::resolver resolver(io_service);
+			tcp::resolver::query query(address, portstr.str());
+			tcp::resolver::iterator endpoint_iterator = resolver.resolve(query);
+			tcp::resolver::iterator end;
+
+			tcp::socket tcp_socket(io_service);
+			while(error && endpoint_iterator != end)
+			{
+				tcp_socket.close();
+				tcp_socket.connect(*endpoint_iterator++, error);
+			}
 
-		boost::system::error_code error = boost::asio::error::host_not_found;
-		while(error && endpoint_iterator != end)
-		{
-			socket.close();
-			socket.connect(*endpoint_iterator++, error);
+			if(!error) {
+				/* RPCs are small and synchronous, don't wait to fill packets. */
+				tcp_socket.set_option(tcp::no_delay(true));
+				socket = network_socket(std::move(tcp_socket));
+			}
 		}
 
 		if(error)
@@ -85,6 +112,10 @@ public:
 	{
 		RPCSend snd(socket, &error_func, "stop");
 		snd.write();
+
+		if(upload_stats.num_buffers) {
+			VLOG(1) << "Network device upload statistics:\n" << upload_stats.full_report();
+		}
 	}
 
 	virtual BVHLayoutMask get_bvh_layout_mask() const {
@@ -116,14 +147,17 @@ public:
 
 		snd.add(mem);
 		snd.write();
-		snd.write_buffer(mem.host_pointer, mem.memory_size());
+		snd.write_compressed_buffer(mem.host_pointer, mem.memory_size(), compress_buffers, &upload_stats);
 	}
 
 	void mem_copy_from(device_memory& mem, int y, int w, int h, int elem)
 	{
 		thread_scoped_lock lock(rpc_lock);
 
-		size_t data_size = mem.memory_size();
+		/* Only transfer the requested rows, other devices may have computed
+		 * the rest of the buffer. */
+		size_t offset = (size_t)y*w*elem;
+		size_t size = (size_t)h*w*elem;
 
 		RPCSend snd(socket, &error_func, "mem_copy_from");
 
@@ -135,7 +169,7 @@ public:
 		snd.write();
 
 		RPCReceive rcv(socket, &error_func);
-		rcv.read_buffer(mem.host_pointer, data_size);
+		rcv.read_buffer((uint8_t*)mem.host_pointer + offset, size);
 	}
 
 	void mem_zero(device_memory& mem)
@@ -185,7 +219,6 @@ public:
 
 		RPCSend snd(socket, &error_func, "load_kernels");
 		snd.add(requested_features.experimental);
-		snd.add(requested_features.max_closure);
 		snd.add(requested_features.max_nodes_group);
 		snd.add(requested_features.nodes_features);
 		snd.write();
@@ -325,7 +358,7 @@ public:
 
 	bool have_error() { return error_func.have_error(); }
 
-	DeviceServer(Device *device_, tcp::socket& socket_)
+	DeviceServer(Device *device_, network_socket& socket_)
 	: device(device_), socket(socket_), stop(false), blocked_waiting(false)
 	{
 		error_func = NetworkError();
@@ -340,6 +373,10 @@ public:
 			if(stop)
 				break;
 		}
+
+		if(upload_stats.num_buffers) {
+			VLOG(1) << "Network server upload statistics:\n" << upload_stats.full_report();
+		}
 	}
 
 protected:
@@ -474,7 +511,7 @@ protected:
 			}
 
 			/* Copy data from network into memory buffer. */
-			rcv.read_buffer((uint8_t*)mem.host_pointer, data_size);
+			rcv.read_compressed_buffer((uint8_t*)mem.host_pointer, data_size, &upload_stats);
 
 			/* Copy the data from the memory buffer to the device buffer. */
 			device->mem_copy_to(mem);
@@ -500,15 +537,16 @@ protected:
 
 			DataVector &data_v = data_vector_find(client_pointer);
 
-			mem.host_pointer = (device_ptr)&(data_v[0]);
+			mem.host_pointer = (void*)&(data_v[0]);
 
 			device->mem_copy_from(mem, y, w, h, elem);
 
-			size_t data_size = mem.memory_size();
+			size_t offset = (size_t)y*w*elem;
+			size_t size = (size_t)h*w*elem;
 
 			RPCSend snd(socket, &error_func, "mem_copy_from");
 			snd.write();
-			snd.write_buffer((uint8_t*)mem.host_pointer, data_size);
+			snd.write_buffer((uint8_t*)mem.host_pointer + offset, size);
 			lock.unlock();
 		}
 		else if(rcv.name == "mem_zero") {
@@ -531,7 +569,7 @@ protected:
 			else {
 				/* Allocate host side data buffer. */
 				DataVector &data_v = data_vector_insert(client_pointer, data_size);
-				mem.host_pointer = (void*)? (device_ptr)&(data_v[0]): 0;
+				mem.host_pointer = (data_size)? (void*)&(data_v[0]): 0;
 			}
 
 			/* Zero memory. */
@@ -571,7 +609,6 @@ protected:
 		else if(rcv.name == "load_kernels") {
 			DeviceRequestedFeatures requested_features;
 			rcv.read(requested_features.experimental);
-			rcv.read(requested_features.max_closure);
 			rcv.read(requested_features.max_nodes_group);
 			rcv.read(requested_features.nodes_features);
 
@@ -603,6 +640,12 @@ protected:
 			if(task.shader_output)
 				task.shader_output = device_ptr_from_client_pointer(task.shader_output);
 
+			if(task.uvs_array)
+				task.uvs_array = device_ptr_from_client_pointer(task.uvs_array);
+
+			if(task.uvs_array_offset_ele_size)
+				task.uvs_array_offset_ele_size = device_ptr_from_client_pointer(task.uvs_array_offset_ele_size);
+
 			task.acquire_tile = function_bind(&DeviceServer::task_acquire_tile, this, _1, _2);
 			task.release_tile = function_bind(&DeviceServer::task_release_tile, this, _1);
 			task.update_progress_sample = function_bind(&DeviceServer::task_update_progress_sample, this);
@@ -745,7 +788,7 @@ protected:
 
 	/* properties */
 	Device *device;
-	tcp::socket& socket;
+	network_socket& socket;
 
 	/* mapping of remote to local pointer */
 	PtrMap ptr_map;
@@ -762,6 +805,8 @@ protected:
 
 	bool stop;
 	bool blocked_waiting;
+
+	NetworkStats upload_stats;
 private:
 	NetworkError error_func;
 
@@ -769,9 +814,35 @@ private:
 
 };
 
-void Device::server_run()
+void Device::server_run(const string& socket_path)
 {
 	try {
+		if(!socket_path.empty()) {
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+			/* Local server, no discovery since clients are given the path. */
+			for(;;) {
+				boost::asio::io_service io_service;
+				::unlink(socket_path.c_str());
+				boost::asio::local::stream_protocol::acceptor acceptor(
+				        io_service, boost::asio::local::stream_protocol::endpoint(socket_path));
+
+				boost::asio::local::stream_protocol::socket local_socket(io_service);
+				acceptor.accept(local_socket);
+
+				printf("Connected to local client at: %s\n", socket_path.c_str());
+
+				network_socket socket(std::move(local_socket));
+				DeviceServer server(this, socket);
+				server.listen();
+
+				printf("Disconnected.\n");
+			}
+#else
+			fprintf(stderr, "Network server error: local sockets are not supported on this platform\n");
+			return;
+#endif
+		}
+
 		/* starts thread that responds to discovery requests */
 		ServerDiscovery discovery;
 
@@ -780,12 +851,14 @@ void Device::server_run()
 			boost::asio::io_service io_service;
 			tcp::acceptor acceptor(io_service, tcp::endpoint(tcp::v4(), SERVER_PORT));
 
-			tcp::socket socket(io_service);
-			acceptor.accept(socket);
+			tcp::socket tcp_socket(io_service);
+			acceptor.accept(tcp_socket);
+			tcp_socket.set_option(tcp::no_delay(true));
 
-			string remote_address = socket.remote_endpoint().address().to_string();
+			string remote_address = tcp_socket.remote_endpoint().address().to_string();
 			printf("Connected to remote client at: %s\n", remote_address.c_str());
 
+			network_socket socket(std::move(tcp_socket));
 			DeviceServer server(this, socket);
 			server.listen();
 
@@ -19,27 +19,27 @@
 
 #ifdef WITH_NETWORK
 
-#include <boost/archive/text_iarchive.hpp>
-#include <boost/archive/text_oarchive.hpp>
-#include <boost/archive/binary_iarchive.hpp>
-#include <boost/archive/binary_oarchive.hpp>
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
-#include <boost/serialization/vector.hpp>
 #include <boost/thread.hpp>
 
 #include <iostream>
 #include <sstream>
 #include <deque>
 
+#include <zlib.h>
+
 #include "render/buffers.h"
 
 #include "util/util_foreach.h"
 #include "util/util_list.h"
+#include "util/util_logging.h"
 #include "util/util_map.h"
 #include "util/util_param.h"
 #include "util/util_string.h"
+#include "util/util_thread.h"
+#include "util/util_time.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -51,18 +51,148 @@ using std::exception;
 
 using boost::asio::ip::tcp;
 
+/* Both TCP and Unix domain socket connections are handled through a socket of
+ * the generic stream protocol. */
+typedef boost::asio::generic::stream_protocol::socket network_socket;
+
 static const int SERVER_PORT = 5120;
 static const int DISCOVER_PORT = 5121;
 static const string DISCOVER_REQUEST_MSG = "REQUEST_RENDER_SERVER_IP";
 static const string DISCOVER_REPLY_MSG = "REPLY_RENDER_SERVER_IP";
 
-#if 0
-typedef boost::archive::text_oarchive o_archive;
-typedef boost::archive::text_iarchive i_archive;
-#else
-typedef boost::archive::binary_oarchive o_archive;
-typedef boost::archive::binary_iarchive i_archive;
-#endif
+/* Addresses with this prefix refer to a Unix domain socket on the local
+ * machine, for running multiple servers on one node. */
+static const string LOCAL_SOCKET_PREFIX = "unix:";
+
+/* Buffers smaller than this are not worth compressing. */
+static const size_t COMPRESS_MIN_SIZE = 64 * 1024;
+
+/* Binary framed protocol
+ *
+ * Every RPC is sent as a fixed size header followed by a frame with the name
+ * and arguments in native binary layout, so both ends must be the same
+ * architecture. Large buffers are sent directly from host memory after the
+ * frame, without being copied into it. */
+
+static const uint32_t RPC_FRAME_MAGIC = 0x43594352;
+
+struct RPCFrameHeader {
+	uint32_t magic;
+	uint32_t size;
+};
+
+/* Header of a buffer that may be compressed, a wire size equal to the buffer
+ * size means the data is sent uncompressed. */
+struct RPCBufferHeader {
+	uint64_t size;
+	uint64_t wire_size;
+};
+
+class o_archive {
+public:
+	template<typename T> o_archive& operator&(const T& value)
+	{
+		const uint8_t *bytes = (const uint8_t*)&value;
+		data.insert(data.end(), bytes, bytes + sizeof(T));
+		return *this;
+	}
+
+	o_archive& operator&(const string& value)
+	{
+		*this & (uint32_t)value.size();
+		data.insert(data.end(), value.begin(), value.end());
+		return *this;
+	}
+
+	vector<uint8_t> data;
+};
+
+class i_archive {
+public:
+	i_archive(const vector<uint8_t>& data_)
+	: failed(false), data(data_), offset(0)
+	{
+	}
+
+	template<typename T> i_archive& operator&(T& value)
+	{
+		if(read_check(sizeof(T))) {
+			memcpy(&value, &data[offset], sizeof(T));
+			offset += sizeof(T);
+		}
+		return *this;
+	}
+
+	i_archive& operator&(string& value)
+	{
+		uint32_t size = 0;
+		*this & size;
+		if(read_check(size)) {
+			value.assign((const char*)&data[offset], size);
+			offset += size;
+		}
+		return *this;
+	}
+
+	bool failed;
+
+protected:
+	bool read_check(size_t size)
+	{
+		if(failed || offset + size > data.size()) {
+			failed = true;
+			return false;
+		}
+		return true;
+	}
+
+	const vector<uint8_t>& data;
+	size_t offset;
+};
+
+/* Throughput of buffer transfers, compression included. */
+class NetworkStats {
+public:
+	NetworkStats()
+	: num_buffers(0), buffer_size(0), wire_size(0),
+	  time_compress(0.0), time_transfer(0.0)
+	{
+	}
+
+	void add(size_t buffer_size_, size_t wire_size_, double time_compress_, double time_transfer_)
+	{
+		thread_scoped_lock lock(mutex);
+		num_buffers++;
+		buffer_size += buffer_size_;
+		wire_size += wire_size_;
+		time_compress += time_compress_;
+		time_transfer += time_transfer_;
+	}
+
+	string full_report()
+	{
+		thread_scoped_lock lock(mutex);
+		double time_total = time_compress + time_transfer;
+		double throughput = (time_total > 0.0)? buffer_size / time_total: 0.0;
+		return string_printf("Buffers:            %lu\n", (unsigned long)num_buffers) +
+		       string_printf("Buffer size:        %s\n", string_human_readable_size(buffer_size).c_str()) +
+		       string_printf("Wire size:          %s (%.1f%%)\n",
+		                     string_human_readable_size(wire_size).c_str(),
+		                     (buffer_size)? 100.0 * wire_size / buffer_size: 100.0) +
+		       string_printf("Compression time:   %f\n", time_compress) +
+		       string_printf("Transfer time:      %f\n", time_transfer) +
+		       string_printf("Throughput:         %s/s\n", string_human_readable_size((size_t)throughput).c_str());
+	}
+
+	size_t num_buffers;
+	size_t buffer_size;
+	size_t wire_size;
+	double time_compress;
+	double time_transfer;
+
+protected:
+	thread_mutex mutex;
+};
 
 /* Serialization of device memory */
 
@@ -111,12 +241,12 @@ private:
 
 class RPCSend {
 public:
-	RPCSend(tcp::socket& socket_, NetworkError* e, const string& name_ = "")
-	: name(name_), socket(socket_), archive(archive_stream), sent(false)
+	RPCSend(network_socket& socket_, NetworkError* e, const string& name_ = "")
+	: name(name_), socket(socket_), sent(false)
 	{
 		archive & name_;
 		error_func = e;
-		fprintf(stderr, "rpc send %s\n", name.c_str());
+		VLOG(4) << "RPC send " << name;
 	}
 
 	~RPCSend()
@@ -144,7 +274,8 @@ public:
 		archive & task.rgba_byte & task.rgba_half & task.buffer & task.sample & task.num_samples;
 		archive & task.offset & task.stride;
 		archive & task.shader_input & task.shader_output & task.shader_eval_type;
-		archive & task.shader_x & task.shader_w;
+		archive & task.shader_filter & task.shader_x & task.shader_w;
+		archive & task.uvs_array & task.uvs_array_offset_ele_size;
 		archive & task.need_finish_queue;
 	}
 
@@ -158,50 +289,76 @@ public:
 
 	void write()
 	{
-		boost::system::error_code error;
+		RPCFrameHeader header;
+		header.magic = RPC_FRAME_MAGIC;
+		header.size = (uint32_t)archive.data.size();
 
-		/* get string from stream */
-		string archive_str = archive_stream.str();
+		/* Header and frame in a single write. */
+		vector<boost::asio::const_buffer> buffers;
+		buffers.push_back(boost::asio::buffer(&header, sizeof(header)));
+		buffers.push_back(boost::asio::buffer(archive.data));
+		write_buffers(buffers);
 
-		/* first send fixed size header with size of following data */
-		ostringstream header_stream;
-		header_stream << setw(8) << hex << archive_str.size();
-		string header_str = header_stream.str();
+		sent = true;
+	}
 
-		boost::asio::write(socket,
-			boost::asio::buffer(header_str),
-			boost::asio::transfer_all(), error);
+	void write_buffer(void *buffer, size_t size)
+	{
+		write_buffers(vector<boost::asio::const_buffer>(1, boost::asio::buffer(buffer, size)));
+	}
 
-		if(error.value())
-			error_func->network_error(error.message());
+	/* Write a buffer that is compressed if that makes it smaller. */
+	void write_compressed_buffer(void *buffer, size_t size, bool compress, NetworkStats *stats)
+	{
+		RPCBufferHeader header;
+		header.size = size;
+		header.wire_size = size;
+
+		double time_start = time_dt();
+
+		/* zlib sizes are 32 bit on some platforms. */
+		vector<uint8_t> compressed;
+		if(compress && size >= COMPRESS_MIN_SIZE && size < ((size_t)1 << 31)) {
+			uLongf compressed_size = compressBound((uLong)size);
+			compressed.resize(compressed_size);
+			if(compress2(&compressed[0], &compressed_size,
+			             (const Bytef*)buffer, (uLong)size, Z_BEST_SPEED) == Z_OK &&
+			   compressed_size < size)
+			{
+				header.wire_size = compressed_size;
+			}
+		}
 
-		/* then send actual data */
-		boost::asio::write(socket,
-			boost::asio::buffer(archive_str),
-			boost::asio::transfer_all(), error);
+		double time_compressed = time_dt();
 
-		if(error.value())
-			error_func->network_error(error.message());
+		vector<boost::asio::const_buffer> buffers;
+		buffers.push_back(boost::asio::buffer(&header, sizeof(header)));
+		if(header.wire_size != size) {
+			buffers.push_back(boost::asio::buffer(&compressed[0], header.wire_size));
+		}
+		else if(size) {
+			buffers.push_back(boost::asio::buffer(buffer, size));
+		}
+		write_buffers(buffers);
 
-		sent = true;
+		if(stats) {
+			stats->add(size, header.wire_size, time_compressed - time_start, time_dt() - time_compressed);
+		}
 	}
 
-	void write_buffer(void *buffer, size_t size)
+protected:
+	void write_buffers(const vector<boost::asio::const_buffer>& buffers)
 	{
 		boost::system::error_code error;
 
-		boost::asio::write(socket,
-			boost::asio::buffer(buffer, size),
-			boost::asio::transfer_all(), error);
+		boost::asio::write(socket, buffers, boost::asio::transfer_all(), error);
 
 		if(error.value())
 			error_func->network_error(error.message());
 	}
 
-protected:
 	string name;
-	tcp::socket& socket;
-	ostringstream archive_stream;
+	network_socket& socket;
 	o_archive archive;
 	bool sent;
 	NetworkError *error_func;
@@ -211,51 +368,41 @@ protected:
 
 class RPCReceive {
 public:
-	RPCReceive(tcp::socket& socket_, NetworkError* e )
-	: socket(socket_), archive_stream(NULL), archive(NULL)
+	RPCReceive(network_socket& socket_, NetworkError* e )
+	: socket(socket_), archive(NULL)
 	{
 		error_func = e;
 		/* read head with fixed size */
-		vector<char> header(8);
+		RPCFrameHeader header;
 		boost::system::error_code error;
-		size_t len = boost::asio::read(socket, boost::asio::buffer(header), error);
+		size_t len = boost::asio::read(socket, boost::asio::buffer(&header, sizeof(header)), error);
 
 		if(error.value()) {
 			error_func->network_error(error.message());
 		}
 
 		/* verify if we got something */
-		if(len == header.size()) {
-			/* decode header */
-			string header_str(&header[0], header.size());
-			istringstream header_stream(header_str);
-
-			size_t data_size;
-
-			if((header_stream >> hex >> data_size)) {
-
-				vector<char> data(data_size);
+		if(len == sizeof(header)) {
+			if(header.magic == RPC_FRAME_MAGIC) {
+				data.resize(header.size);
 				size_t len = boost::asio::read(socket, boost::asio::buffer(data), error);
 
 				if(error.value())
 					error_func->network_error(error.message());
 
-
-				if(len == data_size) {
-					archive_str = (data.size())? string(&data[0], data.size()): string("");
-
-					archive_stream = new istringstream(archive_str);
-					archive = new i_archive(*archive_stream);
+				if(len == header.size) {
+					archive = new i_archive(data);
 
 					*archive & name;
-					fprintf(stderr, "rpc receive %s\n", name.c_str());
+					check_archive();
+					VLOG(4) << "RPC receive " << name;
 				}
 				else {
 					error_func->network_error("Network receive error: data size doesn't match header");
 				}
 			}
 			else {
-				error_func->network_error("Network receive error: can't decode data size from header");
+				error_func->network_error("Network receive error: invalid frame header");
 			}
 		}
 		else {
@@ -266,7 +413,6 @@ public:
 	~RPCReceive()
 	{
 		delete archive;
-		delete archive_stream;
 	}
 
 	void read(network_device_memory& mem, string& name)
@@ -277,6 +423,8 @@ public:
 		*archive & mem.interpolation & mem.extension;
 		*archive & mem.device_pointer;
 
+		check_archive();
+
 		mem.name = name.c_str();
 		mem.host_pointer = 0;
 
@@ -289,19 +437,74 @@ public:
 	template<typename T> void read(T& data)
 	{
 		*archive & data;
+		check_archive();
 	}
 
-	void read_buffer(void *buffer, size_t size)
+	bool read_buffer(void *buffer, size_t size)
 	{
 		boost::system::error_code error;
 		size_t len = boost::asio::read(socket, boost::asio::buffer(buffer, size), error);
 
 		if(error.value()) {
 			error_func->network_error(error.message());
+			return false;
 		}
 
-		if(len != size)
+		if(len != size) {
 			cout << "Network receive error: buffer size doesn't match expected size\n";
+			return false;
+		}
+
+		return true;
+	}
+
+	/* Read a buffer written with RPCSend::write_compressed_buffer. */
+	void read_compressed_buffer(void *buffer, size_t size, NetworkStats *stats)
+	{
+		double time_start = time_dt();
+
+		RPCBufferHeader header;
+		if(!read_buffer(&header, sizeof(header))) {
+			return;
+		}
+
+		if(header.size != size) {
+			error_func->network_error("Network receive error: buffer size doesn't match expected size");
+			return;
+		}
+
+		if(header.wire_size == size) {
+			read_buffer(buffer, size);
+			if(stats) {
+				stats->add(size, size, 0.0, time_dt() - time_start);
+			}
+			return;
+		}
+
+		/* the size is sent by the peer, don't trust it for the allocation */
+		if(header.wire_size == 0 || header.wire_size > compressBound((uLong)size)) {
+			error_func->network_error("Network receive error: invalid compressed buffer size");
+			return;
+		}
+
+		vector<uint8_t> compressed(header.wire_size);
+		if(!read_buffer(&compressed[0], compressed.size())) {
+			return;
+		}
+
+		double time_received = time_dt();
+
+		uLongf uncompressed_size = (uLongf)size;
+		if(uncompress((Bytef*)buffer, &uncompressed_size, &compressed[0], (uLong)compressed.size()) != Z_OK ||
+		   uncompressed_size != size)
+		{
+			error_func->network_error("Network receive error: failed to decompress buffer");
+			return;
+		}
+
+		if(stats) {
+			stats->add(size, header.wire_size, time_dt() - time_received, time_received - time_start);
+		}
 	}
 
 	void read(DeviceTask& task)
@@ -312,8 +515,10 @@ public:
 		*archive & task.rgba_byte & task.rgba_half & task.buffer & task.sample & task.num_samples;
 		*archive & task.offset & task.stride;
 		*archive & task.shader_input & task.shader_output & task.shader_eval_type;
-		*archive & task.shader_x & task.shader_w;
+		*archive & task.shader_filter & task.shader_x & task.shader_w;
+		*archive & task.uvs_array & task.uvs_array_offset_ele_size;
 		*archive & task.need_finish_queue;
+		check_archive();
 
 		task.type = (DeviceTask::Type)type;
 	}
@@ -324,6 +529,7 @@ public:
 		*archive & tile.start_sample & tile.num_samples & tile.sample;
 		*archive & tile.resolution & tile.offset & tile.stride;
 		*archive & tile.buffer;
+		check_archive();
 
 		tile.buffers = NULL;
 	}
@@ -331,9 +537,16 @@ public:
 	string name;
 
 protected:
-	tcp::socket& socket;
-	string archive_str;
-	istringstream *archive_stream;
+	/* Report messages which are shorter than what was read from them. */
+	void check_archive()
+	{
+		if(archive->failed) {
+			error_func->network_error("Network receive error: message is shorter than expected");
+		}
+	}
+
+	network_socket& socket;
+	vector<uint8_t> data;
 	i_archive *archive;
 	NetworkError *error_func;
 };
@@ -44,7 +44,11 @@
 #include "kernel/filter/filter_reconstruction.h"
 
 #ifdef __KERNEL_CPU__
-#  include "kernel/filter/filter_nlm_cpu.h"
+#  ifdef __KERNEL_AVX__
+#    include "kernel/filter/filter_nlm_cpu_avx.h"
+#  else
+#    include "kernel/filter/filter_nlm_cpu.h"
+#  endif
 #else
 #  include "kernel/filter/filter_nlm_gpu.h"
 #endif
@@ -0,0 +1,276 @@
+/*
+ * Copyright 2011-2017 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* 8-wide variant of filter_nlm_cpu.h, used by the AVX and AVX2 filter kernels.
+ *
+ * Rows are only guaranteed to be aligned to 16 bytes, so all accesses are
+ * unaligned. The last block of a row is loaded and stored with a lane mask,
+ * which also keeps the horizontal blur from reading outside of the buffer. */
+
+CCL_NAMESPACE_BEGIN
+
+ccl_device_inline __m256i nlm_lane_mask(int n)
+{
+	const __m256 lanes = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+	return _mm256_castps_si256(_mm256_cmp_ps(lanes, _mm256_set1_ps((float) n), _CMP_LT_OQ));
+}
+
+/* Active lanes of a block starting at x8 whose shifted position lies in [lowx, highx). */
+ccl_device_inline __m256i nlm_range_mask(const avxf& x8, const avxf& lowx, const avxf& highx)
+{
+	return _mm256_castps_si256(_mm256_and_ps(_mm256_cmp_ps(x8, lowx, _CMP_GE_OQ),
+	                                         _mm256_cmp_ps(x8, highx, _CMP_LT_OQ)));
+}
+
+ccl_device_inline avxf nlm_load8(const float *buf, int ofs, int n)
+{
+	if(n >= 8) {
+		return avxf(_mm256_loadu_ps(buf + ofs));
+	}
+	return avxf(_mm256_maskload_ps(buf + ofs, nlm_lane_mask(n)));
+}
+
+ccl_device_inline void nlm_store8(float *buf, int ofs, int n, const avxf& value)
+{
+	if(n >= 8) {
+		_mm256_storeu_ps(buf + ofs, value.m256);
+	}
+	else {
+		_mm256_maskstore_ps(buf + ofs, nlm_lane_mask(n), value.m256);
+	}
+}
+
+ccl_device_inline avxf nlm_lane_offset()
+{
+	return avxf(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+}
+
+/* Sum of the 2f+1 neighbors of the eight pixels starting at x, only counting
+ * neighbors inside of [rect.x, rect.z). */
+ccl_device_inline avxf nlm_box_sum_horizontal(const float *ccl_restrict row,
+                                              int x,
+                                              const avxf& lowx,
+                                              const avxf& highx,
+                                              int f)
+{
+	const avxf x8 = avxf((float) x) + nlm_lane_offset();
+	avxf sum(0.0f);
+	for(int dx = -f; dx <= f; dx++) {
+		const __m256i active = nlm_range_mask(x8 + avxf((float) dx), lowx, highx);
+		sum = sum + avxf(_mm256_maskload_ps(row + x + dx, active));
+	}
+	const avxf low = max(lowx, x8 - avxf((float) f));
+	const avxf high = min(highx, x8 + avxf((float) (f+1)));
+	return sum / (high - low);
+}
+
+ccl_device_inline void kernel_filter_nlm_calc_difference(int dx, int dy,
+                                                         const float *ccl_restrict weight_image,
+                                                         const float *ccl_restrict variance_image,
+                                                         const float *ccl_restrict scale_image,
+                                                         float *difference_image,
+                                                         int4 rect,
+                                                         int stride,
+                                                         int channel_offset,
+                                                         int frame_offset,
+                                                         float a,
+                                                         float k_2)
+{
+	/* Strides need to be aligned to 16 bytes. */
+	kernel_assert((stride % 4) == 0 && (channel_offset % 4) == 0);
+
+	int aligned_lowx = round_down(rect.x, 4);
+	const int numChannels = (channel_offset > 0)? 3 : 1;
+	const avxf channel_fac(1.0f / numChannels);
+
+	for(int y = rect.y; y < rect.w; y++) {
+		int idx_p = y*stride + aligned_lowx;
+		int idx_q = (y+dy)*stride + aligned_lowx + dx + frame_offset;
+		for(int x = aligned_lowx; x < rect.z; x += 8, idx_p += 8, idx_q += 8) {
+			const int n = rect.z - x;
+			avxf diff(0.0f);
+			avxf scale_fac(1.0f);
+			if(scale_image) {
+				scale_fac = min(max(nlm_load8(scale_image, idx_p, n) / nlm_load8(scale_image, idx_q, n),
+				                    avxf(0.25f)), avxf(4.0f));
+			}
+			for(int c = 0, chan_ofs = 0; c < numChannels; c++, chan_ofs += channel_offset) {
+				avxf color_p = nlm_load8(weight_image, idx_p + chan_ofs, n);
+				avxf color_q = scale_fac*nlm_load8(weight_image, idx_q + chan_ofs, n);
+				avxf cdiff = color_p - color_q;
+				avxf var_p = nlm_load8(variance_image, idx_p + chan_ofs, n);
+				avxf var_q = scale_fac*scale_fac*nlm_load8(variance_image, idx_q + chan_ofs, n);
+				diff = diff + (cdiff*cdiff - a*(var_p + min(var_p, var_q))) / (avxf(1e-8f) + k_2*(var_p+var_q));
+			}
+			nlm_store8(difference_image, idx_p, n, diff*channel_fac);
+		}
+	}
+}
+
+ccl_device_inline void kernel_filter_nlm_blur(const float *ccl_restrict difference_image,
+                                              float *out_image,
+                                              int4 rect,
+                                              int stride,
+                                              int f)
+{
+	int aligned_lowx = round_down(rect.x, 4);
+	for(int y = rect.y; y < rect.w; y++) {
+		const int low = max(rect.y, y-f);
+		const int high = min(rect.w, y+f+1);
+		const avxf fac(1.0f/(high - low));
+		/* Accumulate in registers instead of the output row. */
+		for(int x = aligned_lowx; x < rect.z; x += 8) {
+			const int n = rect.z - x;
+			avxf sum(0.0f);
+			for(int y1 = low; y1 < high; y1++) {
+				sum = sum + nlm_load8(difference_image, y1*stride + x, n);
+			}
+			nlm_store8(out_image, y*stride + x, n, sum*fac);
+		}
+	}
+}
+
+ccl_device_inline void nlm_blur_horizontal(const float *ccl_restrict difference_image,
+                                           float *out_image,
+                                           int4 rect,
+                                           int stride,
+                                           int f)
+{
+	int aligned_lowx = round_down(rect.x, 4);
+	const avxf lowx((float) rect.x), highx((float) rect.z);
+	for(int y = rect.y; y < rect.w; y++) {
+		for(int x = aligned_lowx; x < rect.z; x += 8) {
+			nlm_store8(out_image, y*stride + x, rect.z - x,
+			           nlm_box_sum_horizontal(difference_image + y*stride, x, lowx, highx, f));
+		}
+	}
+}
+
+ccl_device_inline void kernel_filter_nlm_calc_weight(const float *ccl_restrict difference_image,
+                                                     float *out_image,
+                                                     int4 rect,
+                                                     int stride,
+                                                     int f)
+{
+	int aligned_lowx = round_down(rect.x, 4);
+	const avxf lowx((float) rect.x), highx((float) rect.z);
+	for(int y = rect.y; y < rect.w; y++) {
+		for(int x = aligned_lowx; x < rect.z; x += 8) {
+			avxf blurred = nlm_box_sum_horizontal(difference_image + y*stride, x, lowx, highx, f);
+			nlm_store8(out_image, y*stride + x, rect.z - x,
+			           fast_expf8(avxf(0.0f) - max(blurred, avxf(0.0f))));
+		}
+	}
+}
+
+ccl_device_inline void kernel_filter_nlm_update_output(int dx, int dy,
+                                                       const float *ccl_restrict difference_image,
+                                                       const float *ccl_restrict image,
+                                                       float *temp_image,
+                                                       float *out_image,
+                                                       float *accum_image,
+                                                       int4 rect,
+                                                       int channel_offset,
+                                                       int stride,
+                                                       int f)
+{
+	nlm_blur_horizontal(difference_image, temp_image, rect, stride, f);
+
+	int aligned_lowx = round_down(rect.x, 4);
+	const avxf lowx((float) rect.x), highx((float) rect.z);
+	for(int y = rect.y; y < rect.w; y++) {
+		for(int x = aligned_lowx; x < rect.z; x += 8) {
+			const int n = rect.z - x;
+			const avxf active = avxf(nlm_range_mask(avxf((float) x) + nlm_lane_offset(), lowx, highx));
+
+			int idx_p = y*stride + x, idx_q = (y+dy)*stride + (x+dx);
+
+			avxf weight = nlm_load8(temp_image, idx_p, n) & active;
+			nlm_store8(accum_image, idx_p, n, nlm_load8(accum_image, idx_p, n) + weight);
+
+			avxf val = nlm_load8(image, idx_q, n);
+			if(channel_offset) {
+				val = val + nlm_load8(image, idx_q + channel_offset, n);
+				val = val + nlm_load8(image, idx_q + 2*channel_offset, n);
+				val = val * (1.0f/3.0f);
+			}
+
+			nlm_store8(out_image, idx_p, n, nlm_load8(out_image, idx_p, n) + ((weight*val) & active));
+		}
+	}
+}
+
+ccl_device_inline void kernel_filter_nlm_construct_gramian(int dx, int dy, int t,
+                                                           const float *ccl_restrict difference_image,
+                                                           const float *ccl_restrict buffer,
+                                                           float *transform,
+                                                           int *rank,
+                                                           float *XtWX,
+                                                           float3 *XtWY,
+                                                           int4 rect,
+                                                           int4 filter_window,
+                                                           int stride, int f,
+                                                           int pass_stride,
+                                                           int frame_offset,
+                                                           bool use_time)
+{
+	int4 clip_area = rect_clip(rect, filter_window);
+	const avxf lowx((float) rect.x), highx((float) rect.z);
+	/* fy and fy are in filter-window-relative coordinates, while x and y are in feature-window-relative coordinates. */
+	for(int y = clip_area.y; y < clip_area.w; y++) {
+		for(int x0 = clip_area.x; x0 < clip_area.z; x0 += 8) {
+			/* Weights of eight pixels at once, the gramian update stays per pixel. */
+			float weights[8];
+			_mm256_storeu_ps(weights, nlm_box_sum_horizontal(difference_image + y*stride, x0, lowx, highx, f).m256);
+
+			const int num_pixels = min(8, clip_area.z - x0);
+			for(int i = 0; i < num_pixels; i++) {
+				const int x = x0 + i;
+				int storage_ofs = coord_to_local_index(filter_window, x, y);
+				float  *l_transform = transform + storage_ofs*TRANSFORM_SIZE;
+				float  *l_XtWX = XtWX + storage_ofs*XTWX_SIZE;
+				float3 *l_XtWY = XtWY + storage_ofs*XTWY_SIZE;
+				int    *l_rank = rank + storage_ofs;
+
+				kernel_filter_construct_gramian(x, y, 1,
+				                                dx, dy, t,
+				                                stride,
+				                                pass_stride,
+				                                frame_offset,
+				                                use_time,
+				                                buffer,
+				                                l_transform, l_rank,
+				                                weights[i], l_XtWX, l_XtWY, 0);
+			}
+		}
+	}
+}
+
+ccl_device_inline void kernel_filter_nlm_normalize(float *out_image,
+                                                   const float *ccl_restrict accum_image,
+                                                   int4 rect,
+                                                   int w)
+{
+	for(int y = rect.y; y < rect.w; y++) {
+		for(int x = rect.x; x < rect.z; x += 8) {
+			const int n = rect.z - x;
+			nlm_store8(out_image, y*w + x, n,
+			           nlm_load8(out_image, y*w + x, n) / nlm_load8(accum_image, y*w + x, n));
+		}
+	}
+}
+
+CCL_NAMESPACE_END
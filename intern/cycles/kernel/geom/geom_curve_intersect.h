@@ -25,6 +25,147 @@ ccl_device_inline ssef transform_point_T3(const ssef t[3], const ssef &a)
 }
 #endif
 
+/* Intersect a curve segment as a flat ribbon facing the ray, using the points
+ * the segment was tessellated into on the host. Instead of recursively
+ * subdividing the cardinal curve, the closest point of every linear piece to
+ * the ray is tested against the radius, all pieces at once with SSE. */
+ccl_device_forceinline bool curve_ribbon_intersect(
+        KernelGlobals *kg,
+        Intersection *isect,
+        const float3 ccl_ref P,
+        const float3 ccl_ref dir,
+        uint visibility,
+        int object,
+        int curveAddr,
+        int type,
+        uint *lcg_state,
+        float difl,
+        float extmax)
+{
+	const int prim = kernel_tex_fetch(__prim_index, curveAddr);
+	const float4 v00 = kernel_tex_fetch(__curves, prim);
+	const int k0 = __float_as_int(v00.x) + PRIMITIVE_UNPACK_SEGMENT(type);
+	/* Curves and keys are packed in the same order, so the segment index is
+	 * the key index minus the number of preceding curves. */
+	const int ribbon = (k0 - prim) * (CURVE_RIBBON_PIECES - 1);
+	const float step = 1.0f / CURVE_RIBBON_PIECES;
+
+	float t = isect->t, u = 0.0f;
+	float r = 1.0f, r_ext = 1.0f;
+	bool found = false;
+
+#if defined(__KERNEL_SSE2__) && (CURVE_RIBBON_PIECES == 4)
+	const ssef p0 = load4f(&kg->__curve_keys.data[k0].x);
+	const ssef p1 = load4f(&kg->__curve_ribbons.data[ribbon].x);
+	const ssef p2 = load4f(&kg->__curve_ribbons.data[ribbon + 1].x);
+	const ssef p3 = load4f(&kg->__curve_ribbons.data[ribbon + 2].x);
+	const ssef p4 = load4f(&kg->__curve_keys.data[k0 + 1].x);
+
+	/* Start and end points of the four pieces, with the radius in w. */
+	ssef x_st, y_st, z_st, r_st, x_en, y_en, z_en, r_en;
+	transpose(p0, p1, p2, p3, x_st, y_st, z_st, r_st);
+	transpose(p1, p2, p3, p4, x_en, y_en, z_en, r_en);
+
+	const ssef dx = x_en - x_st, dy = y_en - y_st, dz = z_en - z_st;
+	const ssef wx = x_st - ssef(P.x), wy = y_st - ssef(P.y), wz = z_st - ssef(P.z);
+	const ssef Dx(dir.x), Dy(dir.y), Dz(dir.z);
+
+	/* Closest points of the ray and every piece. */
+	const ssef a = madd(dx, dx, madd(dy, dy, dz*dz));
+	const ssef b = madd(dx, Dx, madd(dy, Dy, dz*Dz));
+	const ssef c = madd(dx, wx, madd(dy, wy, dz*wz));
+	const ssef e = madd(Dx, wx, madd(Dy, wy, Dz*wz));
+	const ssef s = min(max(msub(e, b, c) / max(nmadd(b, b, a), ssef(1e-20f)), ssef(0.0f)), ssef(1.0f));
+	const ssef vt = madd(s, b, e);
+
+	const ssef qx = nmadd(vt, Dx, madd(s, dx, wx));
+	const ssef qy = nmadd(vt, Dy, madd(s, dy, wy));
+	const ssef qz = nmadd(vt, Dz, madd(s, dz, wz));
+
+	const ssef vr = madd(s, r_en - r_st, r_st);
+	/* minimum width extension */
+	const ssef vr_ext = (difl != 0.0f)? vr + min(ssef(difl) * vt, ssef(extmax)): vr;
+
+	/* Ribbons face every ray, skip the ribbon a ray leaves from. */
+	const ssef epsilon = ssef(2.0f) * max(r_st, r_en);
+
+	const sseb valid = (madd(qx, qx, madd(qy, qy, qz*qz)) <= vr_ext*vr_ext) & (vt > epsilon) & (vt < ssef(t));
+	if(movemask(valid)) {
+		const size_t i = select_min(valid, vt);
+		t = vt[i];
+		u = (i + s[i]) * step;
+		r = vr[i];
+		r_ext = vr_ext[i];
+		found = true;
+	}
+#else
+	float4 p[CURVE_RIBBON_PIECES + 1];
+	p[0] = kernel_tex_fetch(__curve_keys, k0);
+	for(int i = 1; i < CURVE_RIBBON_PIECES; i++) {
+		p[i] = kernel_tex_fetch(__curve_ribbons, ribbon + i - 1);
+	}
+	p[CURVE_RIBBON_PIECES] = kernel_tex_fetch(__curve_keys, k0 + 1);
+
+	for(int i = 0; i < CURVE_RIBBON_PIECES; i++) {
+		const float3 d = float4_to_float3(p[i + 1] - p[i]);
+		const float3 w = float4_to_float3(p[i]) - P;
+
+		/* Closest points of the ray and the piece. */
+		const float a = dot(d, d);
+		const float b = dot(d, dir);
+		const float c = dot(d, w);
+		const float e = dot(dir, w);
+		const float s = saturate((e*b - c) / max(a - b*b, 1e-20f));
+		const float q_t = e + s*b;
+		const float3 q = w + s*d - q_t*dir;
+
+		const float q_r = p[i].w + s*(p[i + 1].w - p[i].w);
+		/* minimum width extension */
+		const float q_r_ext = (difl != 0.0f)? q_r + min(difl * q_t, extmax): q_r;
+
+		/* Ribbons face every ray, skip the ribbon a ray leaves from. */
+		const float epsilon = 2.0f * max(p[i].w, p[i + 1].w);
+
+		if(dot(q, q) <= q_r_ext*q_r_ext && q_t > epsilon && q_t < t) {
+			t = q_t;
+			u = (i + s) * step;
+			r = q_r;
+			r_ext = q_r_ext;
+			found = true;
+		}
+	}
+#endif
+
+	if(!found) {
+		return false;
+	}
+
+	/* stochastic fade from minimum width */
+	if(difl != 0.0f && lcg_state && r != r_ext) {
+		if(lcg_step_float(lcg_state) > r / r_ext) {
+			return false;
+		}
+	}
+
+#ifdef __VISIBILITY_FLAG__
+	/* visibility flag test. we do it here under the assumption
+	 * that most triangles are culled by node flags */
+	if(!(kernel_tex_fetch(__prim_visibility, curveAddr) & visibility)) {
+		return false;
+	}
+#endif
+
+	/* record intersection */
+	isect->t = t;
+	isect->u = u;
+	isect->v = 0.0f;
+	isect->prim = curveAddr;
+	isect->object = object;
+	isect->type = type;
+
+	return true;
+}
+
 /* On CPU pass P and dir by reference to aligned vector. */
 ccl_device_forceinline bool cardinal_curve_intersect(
         KernelGlobals *kg,
@@ -49,6 +190,22 @@ ccl_device_forceinline bool cardinal_curve_intersect(
 		}
 	}
 
+	/* Motion blurred curves are not tessellated, and intersected as
+	 * subdivided ribbons instead. */
+	if(is_curve_primitive && (kernel_data.curve.curveflags & CURVE_KN_TESSELLATED_RIBBONS)) {
+		return curve_ribbon_intersect(kg,
+		                              isect,
+		                              P,
+		                              dir,
+		                              visibility,
+		                              object,
+		                              curveAddr,
+		                              type,
+		                              lcg_state,
+		                              difl,
+		                              extmax);
+	}
+
 	int segment = PRIMITIVE_UNPACK_SEGMENT(type);
 	float epsilon = 0.0f;
 	float r_st, r_en;
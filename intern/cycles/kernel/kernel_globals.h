@@ -50,6 +50,29 @@ typedef unordered_map<float, float> CoverageMap;
 struct Intersection;
 struct VolumeStep;
 
+#  define SHADOW_TRANSPARENCY_CACHE_SIZE 8
+
+/* Transparency of surfaces recently shaded for shadow rays of the current
+ * path. Surfaces with SD_HAS_CONSTANT_TRANSPARENCY are keyed by object and
+ * primitive only, so every shadow ray of the path crossing them reuses the
+ * result. Other surfaces are keyed by the full intersection, ray direction
+ * and bounce, which only matches repeated identical shadow rays. */
+typedef struct ShadowTransparencyCacheEntry {
+	int object;
+	int prim;
+	int constant;
+	int bounce, transparent_bounce;
+	float u, v, t;
+	float3 D;
+	float3 transparency;
+} ShadowTransparencyCacheEntry;
+
+typedef struct ShadowTransparencyCache {
+	ShadowTransparencyCacheEntry entries[SHADOW_TRANSPARENCY_CACHE_SIZE];
+	int num_entries;
+	int next_entry;
+} ShadowTransparencyCache;
+
 typedef struct KernelGlobals {
 #  define KERNEL_TEX(type, name) texture<type> name;
 #  include "kernel/kernel_textures.h"
@@ -69,6 +92,9 @@ typedef struct KernelGlobals {
 	/* Heap-allocated storage for transparent shadows intersections. */
 	Intersection *transparent_shadow_intersections;
 
+	/* Recently shaded transparent shadow intersections. */
+	ShadowTransparencyCache shadow_transparency_cache;
+
 	/* Storage for decoupled volume steps. */
 	VolumeStep *decoupled_volume_steps[2];
 	int decoupled_volume_steps_index;
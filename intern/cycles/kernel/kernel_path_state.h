@@ -65,6 +65,12 @@ ccl_device_inline void path_state_init(KernelGlobals *kg,
 		state->volume_stack[0].shader = SHADER_NONE;
 	}
 #endif
+
+#ifdef __KERNEL_CPU__
+	/* Shadow transparency is only reused within a path. */
+	kg->shadow_transparency_cache.num_entries = 0;
+	kg->shadow_transparency_cache.next_entry = 0;
+#endif
 }
 
 ccl_device_inline void path_state_next(KernelGlobals *kg, ccl_addr_space PathState *state, int label)
@@ -49,7 +49,7 @@ ccl_device_inline void kernel_path_volume_connect_light(
 			/* trace shadow ray */
 			float3 shadow;
 
-			if(!shadow_blocked(kg, sd, emission_sd, state, &light_ray, &shadow)) {
+			if(!shadow_blocked(kg, sd, emission_sd, state, &light_ray, &shadow, (ls.shader & SHADER_OPAQUE_SHADOW) != 0)) {
 				/* accumulate */
 				path_radiance_accum_light(L, state, throughput, &L_light, shadow, 1.0f, is_lamp);
 			}
@@ -189,7 +189,7 @@ ccl_device void kernel_branched_path_volume_connect_light(
 						/* trace shadow ray */
 						float3 shadow;
 
-						if(!shadow_blocked(kg, sd, emission_sd, state, &light_ray, &shadow)) {
+						if(!shadow_blocked(kg, sd, emission_sd, state, &light_ray, &shadow, (ls.shader & SHADER_OPAQUE_SHADOW) != 0)) {
 							/* accumulate */
 							path_radiance_accum_light(L, state, tp*num_samples_inv, &L_light, shadow, num_samples_inv, is_lamp);
 						}
@@ -235,7 +235,7 @@ ccl_device void kernel_branched_path_volume_connect_light(
 						/* trace shadow ray */
 						float3 shadow;
 
-						if(!shadow_blocked(kg, sd, emission_sd, state, &light_ray, &shadow)) {
+						if(!shadow_blocked(kg, sd, emission_sd, state, &light_ray, &shadow, (ls.shader & SHADER_OPAQUE_SHADOW) != 0)) {
 							/* accumulate */
 							path_radiance_accum_light(L, state, tp*num_samples_inv, &L_light, shadow, num_samples_inv, is_lamp);
 						}
@@ -270,7 +270,7 @@ ccl_device void kernel_branched_path_volume_connect_light(
 				/* trace shadow ray */
 				float3 shadow;
 
-				if(!shadow_blocked(kg, sd, emission_sd, state, &light_ray, &shadow)) {
+				if(!shadow_blocked(kg, sd, emission_sd, state, &light_ray, &shadow, (ls.shader & SHADER_OPAQUE_SHADOW) != 0)) {
 					/* accumulate */
 					path_radiance_accum_light(L, state, tp, &L_light, shadow, 1.0f, is_lamp);
 				}
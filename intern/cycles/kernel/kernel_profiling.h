@@ -28,11 +28,13 @@ CCL_NAMESPACE_BEGIN
 #  define PROFILING_EVENT(event) profiling_helper.set_event(event)
 #  define PROFILING_SHADER(shader) if((shader) != SHADER_NONE) { profiling_helper.set_shader((shader) & SHADER_MASK); }
 #  define PROFILING_OBJECT(object) if((object) != PRIM_NONE) { profiling_helper.set_object(object); }
+#  define PROFILING_COUNT(kg, counter) (kg)->profiler.counters[counter]++
 #else
 #  define PROFILING_INIT(kg, event)
 #  define PROFILING_EVENT(event)
 #  define PROFILING_SHADER(shader)
 #  define PROFILING_OBJECT(object)
+#  define PROFILING_COUNT(kg, counter)
 #endif  /* __KERNEL_CPU__ */
 
 CCL_NAMESPACE_END
@@ -50,6 +50,30 @@ ccl_device uint sobol_dimension(KernelGlobals *kg, int index, int dimension)
 	return result;
 }
 
+ccl_device_inline uint sobol_reverse_bits(uint x)
+{
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+	x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+/* Nested uniform (Owen) scrambling of a sobol sample, with the hash based
+ * approximation from "Practical Hash-based Owen Scrambling", Burley 2020.
+ * Unlike a Cranley-Patterson rotation this keeps the stratification of the
+ * sequence, so estimates converge faster. */
+ccl_device_inline uint sobol_owen_scramble(uint x, uint seed)
+{
+	x = sobol_reverse_bits(x);
+	x ^= x * 0x3d20adeau;
+	x += seed;
+	x *= (seed >> 16) | 1u;
+	x ^= x * 0x05526c56u;
+	x ^= x * 0x53a22864u;
+	return sobol_reverse_bits(x);
+}
+
 #endif  /* __SOBOL__ */
 
 
@@ -76,6 +100,14 @@ ccl_device_forceinline float path_rng_1D(KernelGlobals *kg,
 #ifdef __SOBOL__
 	/* Sobol sequence value using direction vectors. */
 	uint result = sobol_dimension(kg, sample, dimension);
+
+	if(kernel_data.integrator.sampling_pattern == SAMPLING_PATTERN_SOBOL_OWEN) {
+		/* Scramble with the rng seed, hashed with the dimension so that
+		 * every dimension is scrambled independently. */
+		result = sobol_owen_scramble(result, cmj_hash_simple(dimension, rng_hash));
+		return (float)(result >> 8) * (1.0f/16777216.0f);
+	}
+
 	float r = (float)result * (1.0f/(float)0xFFFFFFFF);
 
 	/* Cranly-Patterson rotation using rng seed */
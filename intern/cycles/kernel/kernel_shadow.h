@@ -52,6 +52,61 @@ ccl_device_inline PathState *shadow_blocked_volume_path_state(
 }
 #endif  /* __VOLUME__ */
 
+#ifdef __KERNEL_CPU__
+/* Look up the transparency of a surface that was already shaded for a shadow
+ * ray of this path. */
+ccl_device_inline bool shadow_transparency_cache_lookup(KernelGlobals *kg,
+                                                        const ShaderData *shadow_sd,
+                                                        const PathState *state,
+                                                        const Intersection *isect,
+                                                        const Ray *ray,
+                                                        float3 *transparency)
+{
+	const ShadowTransparencyCache *cache = &kg->shadow_transparency_cache;
+	const bool constant = (shadow_sd->flag & SD_HAS_CONSTANT_TRANSPARENCY) != 0;
+	for(int i = 0; i < cache->num_entries; i++) {
+		const ShadowTransparencyCacheEntry *entry = &cache->entries[i];
+		if(entry->prim != isect->prim || entry->object != isect->object) {
+			continue;
+		}
+		if(constant ||
+		   (entry->u == isect->u && entry->v == isect->v && entry->t == isect->t &&
+		    entry->D == ray->D && entry->bounce == state->bounce &&
+		    entry->transparent_bounce == state->transparent_bounce))
+		{
+			*transparency = entry->transparency;
+			return true;
+		}
+	}
+	return false;
+}
+
+ccl_device_inline void shadow_transparency_cache_store(KernelGlobals *kg,
+                                                       const ShaderData *shadow_sd,
+                                                       const PathState *state,
+                                                       const Intersection *isect,
+                                                       const Ray *ray,
+                                                       float3 transparency)
+{
+	ShadowTransparencyCache *cache = &kg->shadow_transparency_cache;
+	/* Replace the oldest entry once the cache is full. */
+	ShadowTransparencyCacheEntry *entry = &cache->entries[cache->next_entry];
+	entry->object = isect->object;
+	entry->prim = isect->prim;
+	entry->constant = (shadow_sd->flag & SD_HAS_CONSTANT_TRANSPARENCY) != 0;
+	entry->bounce = state->bounce;
+	entry->transparent_bounce = state->transparent_bounce;
+	entry->u = isect->u;
+	entry->v = isect->v;
+	entry->t = isect->t;
+	entry->D = ray->D;
+	entry->transparency = transparency;
+
+	cache->next_entry = (cache->next_entry + 1) % SHADOW_TRANSPARENCY_CACHE_SIZE;
+	cache->num_entries = min(cache->num_entries + 1, SHADOW_TRANSPARENCY_CACHE_SIZE);
+}
+#endif  /* __KERNEL_CPU__ */
+
 /* Attenuate throughput accordingly to the given intersection event.
  * Returns true if the throughput is zero and traversal can be aborted.
  */
@@ -82,6 +137,24 @@ ccl_device_forceinline bool shadow_handle_transparent_isect(
 	shader_setup_from_ray(kg, shadow_sd, isect, ray);
 	/* Attenuation from transparent surface. */
 	if(!(shadow_sd->flag & SD_HAS_ONLY_VOLUME)) {
+#ifdef __KERNEL_CPU__
+		float3 transparency;
+		if(shadow_transparency_cache_lookup(kg, shadow_sd, state, isect, ray, &transparency)) {
+			PROFILING_COUNT(kg, PROFILING_COUNTER_SHADOW_SHADER_CACHED);
+		}
+		else {
+			path_state_modify_bounce(state, true);
+			shader_eval_surface(kg,
+			                    shadow_sd,
+			                    state,
+			                    PATH_RAY_SHADOW);
+			path_state_modify_bounce(state, false);
+			transparency = shader_bsdf_transparency(kg, shadow_sd);
+			shadow_transparency_cache_store(kg, shadow_sd, state, isect, ray, transparency);
+			PROFILING_COUNT(kg, PROFILING_COUNTER_SHADOW_SHADER_EVAL);
+		}
+		*throughput *= transparency;
+#else
 		path_state_modify_bounce(state, true);
 		shader_eval_surface(kg,
 		                    shadow_sd,
@@ -89,6 +162,7 @@ ccl_device_forceinline bool shadow_handle_transparent_isect(
 		                    PATH_RAY_SHADOW);
 		path_state_modify_bounce(state, false);
 		*throughput *= shader_bsdf_transparency(kg, shadow_sd);
+#endif
 	}
 	/* Stop if all light is blocked. */
 	if(is_zero(*throughput)) {
@@ -448,12 +522,15 @@ ccl_device bool shadow_blocked_transparent_stepped(
 #  endif  /* __KERNEL_GPU__ || !__SHADOW_RECORD_ALL__ */
 #endif  /* __TRANSPARENT_SHADOWS__ */
 
+/* Lights can opt out of transparent shadows, any surface then blocks them and
+ * no shaders are evaluated for their shadow rays. */
 ccl_device_inline bool shadow_blocked(KernelGlobals *kg,
                                       ShaderData *sd,
                                       ShaderData *shadow_sd,
                                       ccl_addr_space PathState *state,
                                       Ray *ray_input,
-                                      float3 *shadow)
+                                      float3 *shadow,
+                                      const bool opaque_only)
 {
 	Ray *ray = ray_input;
 	Intersection isect;
@@ -474,7 +551,10 @@ ccl_device_inline bool shadow_blocked(KernelGlobals *kg,
 	 * if not, we use simplest and fastest ever way to calculate occlusion.
 	 */
 #ifdef __TRANSPARENT_SHADOWS__
-	if(!kernel_data.integrator.transparent_shadows)
+	if(opaque_only && kernel_data.integrator.transparent_shadows) {
+		PROFILING_COUNT(kg, PROFILING_COUNTER_SHADOW_OPAQUE_RAY);
+	}
+	if(opaque_only || !kernel_data.integrator.transparent_shadows)
 #endif
 	{
 		return shadow_blocked_opaque(kg,
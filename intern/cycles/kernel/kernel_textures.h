@@ -49,6 +49,7 @@ KERNEL_TEX(float2, __tri_patch_uv)
 /* curves */
 KERNEL_TEX(float4, __curves)
 KERNEL_TEX(float4, __curve_keys)
+KERNEL_TEX(float4, __curve_ribbons)
 
 /* patches */
 KERNEL_TEX(uint, __patches)
@@ -322,6 +322,7 @@ enum PathTraceDimension {
 enum SamplingPattern {
 	SAMPLING_PATTERN_SOBOL = 0,
 	SAMPLING_PATTERN_CMJ = 1,
+	SAMPLING_PATTERN_SOBOL_OWEN = 2,
 
 	SAMPLING_NUM_PATTERNS,
 };
@@ -658,9 +659,10 @@ typedef enum ShaderFlag {
 	SHADER_EXCLUDE_TRANSMIT = (1 << 25),
 	SHADER_EXCLUDE_CAMERA = (1 << 24),
 	SHADER_EXCLUDE_SCATTER = (1 << 23),
+	SHADER_OPAQUE_SHADOW = (1 << 22),
 	SHADER_EXCLUDE_ANY = (SHADER_EXCLUDE_DIFFUSE|SHADER_EXCLUDE_GLOSSY|SHADER_EXCLUDE_TRANSMIT|SHADER_EXCLUDE_CAMERA|SHADER_EXCLUDE_SCATTER),
 
-	SHADER_MASK = ~(SHADER_SMOOTH_NORMAL|SHADER_CAST_SHADOW|SHADER_AREA_LIGHT|SHADER_USE_MIS|SHADER_EXCLUDE_ANY)
+	SHADER_MASK = ~(SHADER_SMOOTH_NORMAL|SHADER_CAST_SHADOW|SHADER_AREA_LIGHT|SHADER_USE_MIS|SHADER_OPAQUE_SHADOW|SHADER_EXCLUDE_ANY)
 } ShaderFlag;
 
 /* Light Type */
@@ -953,6 +955,8 @@ enum ShaderDataFlag {
 	SD_HAS_CONSTANT_EMISSION  = (1 << 27),
 	/* Needs to access attributes */
 	SD_NEED_ATTRIBUTES        = (1 << 28),
+	/* Transparency only depends on the object and primitive */
+	SD_HAS_CONSTANT_TRANSPARENCY = (1 << 29),
 
 	SD_SHADER_FLAGS = (SD_USE_MIS |
 	                   SD_HAS_TRANSPARENT_SHADOW |
@@ -966,7 +970,8 @@ enum ShaderDataFlag {
 	                   SD_HAS_BUMP |
 	                   SD_HAS_DISPLACEMENT |
 	                   SD_HAS_CONSTANT_EMISSION |
-	                   SD_NEED_ATTRIBUTES)
+	                   SD_NEED_ATTRIBUTES |
+	                   SD_HAS_CONSTANT_TRANSPARENCY)
 };
 
 	/* Object flags. */
@@ -1450,8 +1455,13 @@ typedef enum CurveFlag {
 	CURVE_KN_INTERSECTCORRECTION = 16,		/* correct for width after determing closest midpoint? */
 	CURVE_KN_TRUETANGENTGNORMAL = 32,		/* use tangent normal for geometry? */
 	CURVE_KN_RIBBONS = 64,					/* use flat curve ribbons */
+	CURVE_KN_TESSELLATED_RIBBONS = 128,		/* intersect ribbons as tessellated linear pieces? */
 } CurveFlag;
 
+/* Number of linear pieces curve segments are tessellated into for
+ * CURVE_KN_TESSELLATED_RIBBONS. */
+#define CURVE_RIBBON_PIECES 4
+
 typedef struct KernelCurves {
 	int curveflags;
 	int subdivisions;
@@ -49,6 +49,7 @@ ccl_device void kernel_shadow_blocked_dl(KernelGlobals *kg)
 	BsdfEval L_light = kernel_split_state.bsdf_eval[ray_index];
 	ShaderData *emission_sd = AS_SHADER_DATA(&kernel_split_state.sd_DL_shadow[ray_index]);
 	bool is_lamp = kernel_split_state.is_lamp[ray_index];
+	bool opaque_shadow = kernel_split_state.opaque_shadow[ray_index];
 
 #  if defined(__BRANCHED_PATH__) || defined(__SHADOW_TRICKS__)
 	bool use_branched = false;
@@ -93,7 +94,8 @@ ccl_device void kernel_shadow_blocked_dl(KernelGlobals *kg)
 		                   emission_sd,
 		                   state,
 		                   &ray,
-		                   &shadow))
+		                   &shadow,
+		                   opaque_shadow))
 		{
 			/* accumulate */
 			path_radiance_accum_light(L, state, throughput, &L_light, shadow, 1.0f, is_lamp);
@@ -19,8 +19,11 @@
 #include "render/object.h"
 #include "render/shader.h"
 #include "render/integrator.h"
+#include "render/stats.h"
 
+#include "util/util_algorithm.h"
 #include "util/util_foreach.h"
+#include "util/util_logging.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -159,6 +162,7 @@ BakeManager::BakeManager()
 	m_bake_data = NULL;
 	m_is_baking = false;
 	need_update = true;
+	use_profiling = false;
 	m_shader_limit = 512 * 512;
 }
 
@@ -190,17 +194,55 @@ void BakeManager::set_shader_limit(const size_t x, const size_t y)
 	m_shader_limit = (size_t)pow(2, ceil(log(m_shader_limit)/log(2)));
 }
 
+/* Order the valid texels by (object, shader), so a chunk and each of its CPU
+ * sub-tasks mostly evaluate a single SVM program and sample the same image
+ * tiles, instead of interleaving materials in lightmap layout order. Invalid
+ * texels are dropped, the kernel would skip them anyway. The sort is stable
+ * to keep lightmap locality within a run. */
+void BakeManager::sort_texels(DeviceScene *dscene, BakeData *bake_data, vector<int>& texels)
+{
+	const size_t num_pixels = bake_data->size();
+	const uint *tri_shader = dscene->tri_shader.data();
+	const size_t num_triangles = dscene->tri_shader.size();
+
+	vector<uint64_t> keys(num_pixels, 0);
+	texels.clear();
+	texels.reserve(num_pixels);
+
+	for(size_t i = 0; i < num_pixels; i++) {
+		if(!bake_data->is_valid(i)) {
+			continue;
+		}
+
+		const uint4 in = bake_data->data(i);
+		const uint shader = (in.y < num_triangles)? (tri_shader[in.y] & SHADER_MASK): 0;
+		keys[i] = ((uint64_t)in.x << 32) | shader;
+		texels.push_back(i);
+	}
+
+	std::stable_sort(texels.begin(), texels.end(),
+	                 [&keys](const int a, const int b) { return keys[a] < keys[b]; });
+}
+
 bool BakeManager::bake(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress, ShaderEvalType shader_type, const int pass_filter, BakeData *bake_data, float result[])
 {
-	size_t num_pixels = bake_data->size();
+	/* texels grouped by shader, indices into bake_data */
+	vector<int> texels;
+	sort_texels(dscene, bake_data, texels);
+	size_t num_texels = texels.size();
+
+	if(num_texels == 0) {
+		m_is_baking = false;
+		return false;
+	}
 
 	scene->integrator->aa_samples = 256;
 	int num_samples = aa_samples(scene, bake_data, shader_type);
 
 	/* calculate the total pixel samples for the progress bar */
 	total_pixel_samples = 0;
-	for(size_t shader_offset = 0; shader_offset < num_pixels; shader_offset += m_shader_limit) {
-		size_t shader_size = (size_t)fminf(num_pixels - shader_offset, m_shader_limit);
+	for(size_t shader_offset = 0; shader_offset < num_texels; shader_offset += m_shader_limit) {
+		size_t shader_size = (size_t)fminf(num_texels - shader_offset, m_shader_limit);
 		total_pixel_samples += shader_size * num_samples;
 	}
 	progress.reset_sample();
@@ -210,8 +252,19 @@ bool BakeManager::bake(Device *device, DeviceScene *dscene, Scene *scene, Progre
 	dscene->data.integrator.aa_samples = num_samples;
 	device->const_copy_to("__data", &dscene->data, sizeof(dscene->data));
 
-	for(size_t shader_offset = 0; shader_offset < num_pixels; shader_offset += m_shader_limit) {
-		size_t shader_size = (size_t)fminf(num_pixels - shader_offset, m_shader_limit);
+	/* per shader timings, sampled while the shader tasks run */
+	Profiler& profiler = device->profiler;
+	const bool do_profiling = use_profiling && device->info.has_profiling && !profiler.active();
+
+	if(do_profiling) {
+		profiler.reset(scene->shaders.size(), scene->objects.size());
+		profiler.start();
+	}
+
+	bool success = true;
+
+	for(size_t shader_offset = 0; shader_offset < num_texels; shader_offset += m_shader_limit) {
+		size_t shader_size = (size_t)fminf(num_texels - shader_offset, m_shader_limit);
 
 		/* setup input for device task */
 		device_vector<uint4> d_input(device, "bake_input", MEM_READ_ONLY);
@@ -219,7 +272,8 @@ bool BakeManager::bake(Device *device, DeviceScene *dscene, Scene *scene, Progre
 		size_t d_input_size = 0;
 
 		int uvs_array_size = 0;
-		for(size_t i = shader_offset; i < (shader_offset + shader_size); i++) {
+		for(size_t k = 0; k < shader_size; k++) {
+			const int i = texels[shader_offset + k];
 			d_input_data[d_input_size++] = bake_data->data(i);
 			d_input_data[d_input_size++] = bake_data->differentials(i);
 
@@ -240,9 +294,8 @@ bool BakeManager::bake(Device *device, DeviceScene *dscene, Scene *scene, Progre
 			uint2* d_uvs_array_offset_ele_size_data = d_uvs_array_offset_ele_size.alloc(shader_size);
 			int uvs_array_index = 0;
 			int array_offset_pos = 0;
-			float2* curr_uvs_array_data_pos = d_uvs_array_data;
-			for (size_t i = shader_offset; i < (shader_offset + shader_size); i++) {
-				const BakeData::UVArray* puv_array = bake_data->sample_uvs(i);
+			for (size_t k = 0; k < shader_size; k++) {
+				const BakeData::UVArray* puv_array = bake_data->sample_uvs(texels[shader_offset + k]);
 				const int uvs_array_size = puv_array ? puv_array->size() : 0;
 				uint2* p_offset_ele_size_data = &d_uvs_array_offset_ele_size_data[uvs_array_index];
 				p_offset_ele_size_data->x = array_offset_pos;
@@ -261,11 +314,6 @@ bool BakeManager::bake(Device *device, DeviceScene *dscene, Scene *scene, Progre
 			d_uvs_array_offset_ele_size.copy_to_device();
 		}
 
-		if(d_input_size == 0) {
-			m_is_baking = false;
-			return false;
-		}		
-
 		/* run device task */
 		device_vector<float4> d_output(device, "bake_output", MEM_READ_WRITE);
 
@@ -302,33 +350,32 @@ bool BakeManager::bake(Device *device, DeviceScene *dscene, Scene *scene, Progre
 		if(progress.get_cancel()) {
 			d_input.free();
 			d_output.free();
-			m_is_baking = false;
-			return false;
+			success = false;
+			break;
 		}
 
 		d_output.copy_from_device(0, 1, d_output.size());
 		d_input.free();
 
-		/* read result */
-		int k = 0;
-
+		/* read result, scattering texels back to their lightmap position */
 		float4 *offset = d_output.data();
 
 		if (shader_type == SHADER_EVAL_SH4)
 		{
-			memcpy(result + shader_offset * 12, offset, d_output.size() * sizeof(float4));
+			for (size_t k = 0; k < shader_size; k++) {
+				const int i = texels[shader_offset + k];
+				memcpy(result + i * 12, offset + k * 3, sizeof(float4) * 3);
+			}
 		}
 		else
 		{
 			size_t depth = 4;
-			for (size_t i = shader_offset; i < (shader_offset + shader_size); i++) {
-				size_t index = i * depth;
-				float4 out = offset[k++];
-
-				if (bake_data->is_valid(i)) {
-					for (size_t j = 0; j < 4; j++) {
-						result[index + j] = out[j];
-					}
+			for (size_t k = 0; k < shader_size; k++) {
+				size_t index = texels[shader_offset + k] * depth;
+				float4 out = offset[k];
+
+				for (size_t j = 0; j < 4; j++) {
+					result[index + j] = out[j];
 				}
 			}
 		}		
@@ -336,8 +383,20 @@ bool BakeManager::bake(Device *device, DeviceScene *dscene, Scene *scene, Progre
 		d_output.free();
 	}
 
+	if(do_profiling) {
+		profiler.stop();
+
+		if(success) {
+			profiling_stats = RenderStats();
+			profiling_stats.collect_profiling(scene, profiler);
+			VLOG(1) << "Bake kernel statistics:\n" << profiling_stats.kernel.full_report(1)
+			        << "Bake shader statistics:\n" << profiling_stats.shaders.full_report(1)
+			        << "Bake object statistics:\n" << profiling_stats.objects.full_report(1);
+		}
+	}
+
 	m_is_baking = false;
-	return true;
+	return success;
 }
 
 void BakeManager::device_update(Device * /*device*/,
@@ -19,6 +19,7 @@
 
 #include "device/device.h"
 #include "render/scene.h"
+#include "render/stats.h"
 
 #include "util/util_progress.h"
 #include "util/util_vector.h"
@@ -81,9 +82,17 @@ public:
 
 	bool need_update;
 
+	/* Sample the kernel with the device profiler while baking and report
+	 * the time spent per shader. Only has effect on CPU devices. */
+	bool use_profiling;
+	/* Profiling statistics of the last bake that was profiled. */
+	RenderStats profiling_stats;
+
 	size_t total_pixel_samples;
 
 private:
+	void sort_texels(DeviceScene *dscene, BakeData *bake_data, vector<int>& texels);
+
 	BakeData *m_bake_data;
 	bool m_is_baking;
 	size_t m_shader_limit;
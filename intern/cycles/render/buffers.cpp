@@ -15,6 +15,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "render/buffers.h"
 #include "device/device.h"
@@ -139,13 +140,20 @@ RenderBuffers::~RenderBuffers()
 	buffer.free();
 }
 
-void RenderBuffers::reset(BufferParams& params_)
+void RenderBuffers::reset(BufferParams& params_, bool first_touch)
 {
 	params = params_;
 
 	/* re-allocate buffer */
 	buffer.alloc(params.width*params.height*params.get_passes_size());
-	buffer.zero_to_device();
+
+	if(first_touch) {
+		/* only maps the host memory for the CPU device */
+		buffer.copy_to_device();
+	}
+	else {
+		buffer.zero_to_device();
+	}
 }
 
 void RenderBuffers::zero()
@@ -153,6 +161,17 @@ void RenderBuffers::zero()
 	buffer.zero_to_device();
 }
 
+void RenderBuffers::zero_tile(int offset, int stride, int x, int y, int w, int h)
+{
+	int pass_stride = params.get_passes_size();
+	float *data = buffer.data();
+
+	for(int row = y; row < y + h; row++) {
+		size_t index = (size_t)(offset + x + row*stride)*pass_stride;
+		memset(data + index, 0, sizeof(float)*w*pass_stride);
+	}
+}
+
 bool RenderBuffers::copy_from_device()
 {
 	if(!buffer.device_pointer)
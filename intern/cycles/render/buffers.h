@@ -85,8 +85,11 @@ public:
 	explicit RenderBuffers(Device *device);
 	~RenderBuffers();
 
-	void reset(BufferParams& params);
+	/* With first_touch the memory is allocated but left untouched, every
+	 * tile is zeroed with zero_tile() by the thread that renders it. */
+	void reset(BufferParams& params, bool first_touch = false);
 	void zero();
+	void zero_tile(int offset, int stride, int x, int y, int w, int h);
 
 	bool copy_from_device();
 	bool get_pass_rect(PassType type, float exposure, int sample, int components, float *pixels, const string &name);
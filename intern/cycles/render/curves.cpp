@@ -105,7 +105,7 @@ CurveSystemManager::~CurveSystemManager()
 
 void CurveSystemManager::device_update(Device *device,
                                        DeviceScene *dscene,
-                                       Scene * /*scene*/,
+                                       Scene *scene,
                                        Progress& progress)
 {
 	if(!need_update)
@@ -117,13 +117,16 @@ void CurveSystemManager::device_update(Device *device,
 
 	KernelCurves *kcurve = &dscene->data.curve;
 
+	const int prev_curveflags = kcurve->curveflags;
 	kcurve->curveflags = 0;
 
 	if(use_curves) {
-		if(primitive == CURVE_SEGMENTS || primitive == CURVE_RIBBONS)
+		if(primitive == CURVE_SEGMENTS || primitive == CURVE_RIBBONS || primitive == CURVE_TESSELLATED_RIBBONS)
 			kcurve->curveflags |= CURVE_KN_INTERPOLATE;
-		if(primitive == CURVE_RIBBONS)
+		if(primitive == CURVE_RIBBONS || primitive == CURVE_TESSELLATED_RIBBONS)
 			kcurve->curveflags |= CURVE_KN_RIBBONS;
+		if(primitive == CURVE_TESSELLATED_RIBBONS)
+			kcurve->curveflags |= CURVE_KN_TESSELLATED_RIBBONS;
 
 		if(line_method == CURVE_ACCURATE)
 			kcurve->curveflags |= CURVE_KN_ACCURATE;
@@ -142,6 +145,11 @@ void CurveSystemManager::device_update(Device *device,
 		kcurve->subdivisions = subdivisions;
 	}
 
+	/* Tessellated ribbons are packed with the meshes. */
+	if((prev_curveflags ^ kcurve->curveflags) & CURVE_KN_TESSELLATED_RIBBONS) {
+		scene->mesh_manager->need_update = true;
+	}
+
 	if(progress.get_cancel()) return;
 
 	need_update = false;
@@ -34,6 +34,9 @@ typedef enum CurvePrimitiveType {
 	CURVE_LINE_SEGMENTS = 1,
 	CURVE_SEGMENTS = 2,
 	CURVE_RIBBONS = 3,
+	/* Curve segments tessellated into ribbons facing the ray, faster to
+	 * intersect than subdivided curve segments for dense foliage. */
+	CURVE_TESSELLATED_RIBBONS = 4,
 
 	CURVE_NUM_PRIMITIVE_TYPES,
 } CurvePrimitiveType;
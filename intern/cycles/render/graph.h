@@ -158,6 +158,7 @@ public:
 	virtual bool has_object_dependency() { return false; }
 	virtual bool has_attribute_dependency() { return false; }
 	virtual bool has_integrator_dependency() { return false; }
+	virtual bool has_path_state_dependency() { return false; }
 	virtual bool has_volume_support() { return false; }
 	virtual bool has_raytrace() { return false; }
 	vector<ShaderInput*> inputs;
@@ -23,7 +23,9 @@
 #include "util/util_logging.h"
 #include "util/util_path.h"
 #include "util/util_progress.h"
+#include "util/util_system.h"
 #include "util/util_texture.h"
+#include "util/util_time.h"
 #include "util/util_unique_ptr.h"
 
 #ifdef WITH_OSL
@@ -97,6 +99,9 @@ ImageManager::ImageManager(const DeviceInfo& info)
 	for(size_t type = 0; type < IMAGE_DATA_NUM_TYPES; type++) {
 		tex_num_images[type] = 0;
 	}
+
+	load_memory_limit = system_physical_ram() / 4;
+	load_memory_used = 0;
 }
 
 ImageManager::~ImageManager()
@@ -379,6 +384,7 @@ int ImageManager::add_image(const string& filename,
 	img->users = 1;
 	img->use_alpha = use_alpha;
 	img->mem = NULL;
+	img->load_time = 0.0;
 
 	images[type][slot] = img;
 
@@ -712,6 +718,57 @@ bool ImageManager::file_load_image(Image *img,
 	return true;
 }
 
+/* Memory needed while loading an image, before it is uploaded. */
+static size_t image_load_memory(const ImageMetaData& metadata,
+                                ImageDataType type,
+                                int texture_limit)
+{
+	size_t pixel_size = 0;
+	switch(type) {
+		case IMAGE_DATA_TYPE_FLOAT4: pixel_size = sizeof(float4); break;
+		case IMAGE_DATA_TYPE_FLOAT: pixel_size = sizeof(float); break;
+		case IMAGE_DATA_TYPE_BYTE4: pixel_size = sizeof(uchar4); break;
+		case IMAGE_DATA_TYPE_BYTE: pixel_size = sizeof(uchar); break;
+		case IMAGE_DATA_TYPE_HALF4: pixel_size = sizeof(half4); break;
+		case IMAGE_DATA_TYPE_HALF: pixel_size = sizeof(half); break;
+		case IMAGE_DATA_TYPE_USHORT4: pixel_size = sizeof(ushort4); break;
+		case IMAGE_DATA_TYPE_USHORT: pixel_size = sizeof(uint16_t); break;
+		case IMAGE_DATA_NUM_TYPES: break;
+	}
+
+	size_t size = ((size_t)metadata.width)*metadata.height*max(metadata.depth, 1)*pixel_size;
+
+	/* Images that are scaled down are read into temporary storage first. */
+	const int max_size = max(max(metadata.width, metadata.height), metadata.depth);
+	if(texture_limit > 0 && max_size > texture_limit) {
+		size *= 2;
+	}
+
+	return size;
+}
+
+void ImageManager::load_memory_acquire(size_t size)
+{
+	thread_scoped_lock lock(load_memory_mutex);
+
+	/* A single image bigger than the limit is still loaded, on its own. */
+	while(load_memory_used > 0 && load_memory_used + size > load_memory_limit) {
+		load_memory_cond.wait(lock);
+	}
+
+	load_memory_used += size;
+}
+
+void ImageManager::load_memory_release(size_t size)
+{
+	{
+		thread_scoped_lock lock(load_memory_mutex);
+		load_memory_used -= size;
+	}
+
+	load_memory_cond.notify_all();
+}
+
 void ImageManager::device_load_image(Device *device,
                                      Scene *scene,
                                      ImageDataType type,
@@ -743,6 +800,11 @@ void ImageManager::device_load_image(Device *device,
 		img->mem = NULL;
 	}
 
+	const size_t load_memory = image_load_memory(img->metadata, type, texture_limit);
+	load_memory_acquire(load_memory);
+
+	const double start_time = time_dt();
+
 	/* Create new texture. */
 	if(type == IMAGE_DATA_TYPE_FLOAT4) {
 		device_vector<float4> *tex_img
@@ -935,6 +997,12 @@ void ImageManager::device_load_image(Device *device,
 		thread_scoped_lock device_lock(device_mutex);
 		tex_img->copy_to_device();
 	}
+
+	img->load_time = time_dt() - start_time;
+	load_memory_release(load_memory);
+
+	VLOG(2) << "Loaded image " << filename << " in " << img->load_time << " seconds.";
+
 	img->need_load = false;
 }
 
@@ -969,7 +1037,9 @@ void ImageManager::device_update(Device *device,
 		return;
 	}
 
-	TaskPool pool;
+	/* Images to load, with their size. */
+	vector<std::pair<size_t, int> > load_slots;
+
 	for(int type = 0; type < IMAGE_DATA_NUM_TYPES; type++) {
 		for(size_t slot = 0; slot < images[type].size(); slot++) {
 			if(!images[type][slot])
@@ -979,20 +1049,43 @@ void ImageManager::device_update(Device *device,
 				device_free_image(device, (ImageDataType)type, slot);
 			}
 			else if(images[type][slot]->need_load) {
-				if(!osl_texture_system || images[type][slot]->builtin_data)
-					pool.push(function_bind(&ImageManager::device_load_image,
-					                        this,
-					                        device,
-					                        scene,
-					                        (ImageDataType)type,
-					                        slot,
-					                        &progress));
+				if(!osl_texture_system || images[type][slot]->builtin_data) {
+					size_t size = image_load_memory(images[type][slot]->metadata,
+					                                (ImageDataType)type,
+					                                scene->params.texture_limit);
+					load_slots.push_back(std::make_pair(size, type_index_to_flattened_slot(slot, (ImageDataType)type)));
+				}
 			}
 		}
 	}
 
+	/* Start with the biggest images, so that loading a few big images
+	 * doesn't keep the other threads waiting at the end. */
+	sort(load_slots.begin(), load_slots.end(), std::greater<std::pair<size_t, int> >());
+
+	double start_time = time_dt();
+
+	TaskPool pool;
+	for(size_t i = 0; i < load_slots.size(); i++) {
+		ImageDataType type;
+		int slot = flattened_slot_to_type_index(load_slots[i].second, &type);
+
+		pool.push(function_bind(&ImageManager::device_load_image,
+		                        this,
+		                        device,
+		                        scene,
+		                        type,
+		                        slot,
+		                        &progress));
+	}
+
 	pool.wait_work();
 
+	if(load_slots.size()) {
+		VLOG(1) << "Loaded " << load_slots.size() << " images in "
+		        << time_dt() - start_time << " seconds.";
+	}
+
 	need_update = false;
 }
 
@@ -1080,6 +1173,9 @@ void ImageManager::collect_statistics(RenderStats *stats)
 			stats->image.textures.add_entry(
 			        NamedSizeEntry(path_filename(image->filename),
 			                       image->mem->memory_size()));
+			stats->image.load_times.add_entry(
+			        NamedTimeEntry(path_filename(image->filename),
+			                       image->load_time));
 		}
 	}
 }
@@ -145,6 +145,9 @@ public:
 		device_memory *mem;
 
 		int users;
+
+		/* Time spent loading the image into device memory, in seconds. */
+		double load_time;
 	};
 
 private:
@@ -155,6 +158,16 @@ private:
 	thread_mutex device_mutex;
 	int animation_frame;
 
+	/* Bounds the memory of images that are being loaded at the same time,
+	 * loading waits until enough of the other images are uploaded. */
+	thread_mutex load_memory_mutex;
+	thread_condition_variable load_memory_cond;
+	size_t load_memory_limit;
+	size_t load_memory_used;
+
+	void load_memory_acquire(size_t size);
+	void load_memory_release(size_t size);
+
 	vector<Image*> images[IMAGE_DATA_NUM_TYPES];
 	void *osl_texture_system;
 
@@ -76,6 +76,7 @@ NODE_DEFINE(Integrator)
 	static NodeEnum sampling_pattern_enum;
 	sampling_pattern_enum.insert("sobol", SAMPLING_PATTERN_SOBOL);
 	sampling_pattern_enum.insert("cmj", SAMPLING_PATTERN_CMJ);
+	sampling_pattern_enum.insert("sobol_owen", SAMPLING_PATTERN_SOBOL_OWEN);
 	SOCKET_ENUM(sampling_pattern, "Sampling Pattern", sampling_pattern_enum, SAMPLING_PATTERN_SOBOL);
 
 	return type;
@@ -96,8 +97,6 @@ void Integrator::device_update(Device *device, DeviceScene *dscene, Scene *scene
 	if(!need_update)
 		return;
 
-	device_free(device, dscene);
-
 	KernelIntegrator *kintegrator = &dscene->data.integrator;
 
 	/* integrator parameters */
@@ -197,11 +196,14 @@ void Integrator::device_update(Device *device, DeviceScene *dscene, Scene *scene
 	int dimensions = PRNG_BASE_NUM + max_samples*PRNG_BOUNCE_NUM;
 	dimensions = min(dimensions, SOBOL_MAX_DIMENSIONS);
 
-	uint *directions = dscene->sobol_directions.alloc(SOBOL_BITS*dimensions);
+	/* Directions only depend on the number of dimensions. */
+	if(dscene->sobol_directions.size() != SOBOL_BITS*dimensions) {
+		uint *directions = dscene->sobol_directions.alloc(SOBOL_BITS*dimensions);
 
-	sobol_generate_direction_vectors((uint(*)[SOBOL_BITS])directions, dimensions);
+		sobol_generate_direction_vectors((uint(*)[SOBOL_BITS])directions, dimensions);
 
-	dscene->sobol_directions.copy_to_device();
+		dscene->sobol_directions.copy_to_device();
+	}
 
 	/* Clamping. */
 	bool use_sample_clamp = (sample_clamp_direct != 0.0f ||
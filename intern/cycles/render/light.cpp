@@ -128,6 +128,7 @@ NODE_DEFINE(Light)
 	SOCKET_TRANSFORM(tfm, "Transform", transform_identity());
 
 	SOCKET_BOOLEAN(cast_shadow, "Cast Shadow", true);
+	SOCKET_BOOLEAN(use_transparent_shadow, "Use Transparent Shadow", true);
 	SOCKET_BOOLEAN(use_mis, "Use Mis", false);
 	SOCKET_BOOLEAN(use_diffuse, "Use Diffuse", true);
 	SOCKET_BOOLEAN(use_glossy, "Use Glossy", true);
@@ -671,6 +672,8 @@ void LightManager::device_update_points(Device *,
 
 		if(!light->cast_shadow)
 			shader_id &= ~SHADER_CAST_SHADOW;
+		if(!light->use_transparent_shadow)
+			shader_id |= SHADER_OPAQUE_SHADOW;
 
 		if(!light->use_diffuse) {
 			shader_id |= SHADER_EXCLUDE_DIFFUSE;
@@ -61,6 +61,7 @@ public:
 	float spot_smooth;
 
 	bool cast_shadow;
+	bool use_transparent_shadow;
 	bool use_mis;
 	bool use_diffuse;
 	bool use_glossy;
@@ -31,6 +31,7 @@
 
 #include "kernel/osl/osl_globals.h"
 
+#include "subd/subd_cache.h"
 #include "subd/subd_split.h"
 #include "subd/subd_patch_table.h"
 
@@ -459,6 +460,7 @@ Mesh::Mesh()
 
 	subdivision_type = SUBDIVISION_NONE;
 	subd_params = NULL;
+	subd_dice_cache = NULL;
 
 	patch_table = NULL;
 }
@@ -468,6 +470,7 @@ Mesh::~Mesh()
 	delete bvh;
 	delete patch_table;
 	delete subd_params;
+	delete subd_dice_cache;
 }
 
 void Mesh::resize_mesh(int numverts, int numtris)
@@ -965,6 +968,45 @@ void Mesh::pack_curves(Scene *scene, float4 *curve_key_co, float4 *curve_data, s
 	}
 }
 
+/* Points of a cardinal curve segment between P[1] and P[2], matching the
+ * curve the kernel intersects. */
+static float3 curve_ribbon_point(const float3 P[4], float u)
+{
+	const float fc = 0.71f;
+	const float3 c0 = P[1];
+	const float3 c1 = fc * (P[2] - P[0]);
+	const float3 c2 = 2.0f * fc * P[0] + (fc - 3.0f) * P[1] + (3.0f - 2.0f * fc) * P[2] - fc * P[3];
+	const float3 c3 = -fc * P[0] + (2.0f - fc) * P[1] + (fc - 2.0f) * P[2] + fc * P[3];
+	return ((c3 * u + c2) * u + c1) * u + c0;
+}
+
+void Mesh::pack_curve_ribbons(float4 *curve_ribbons)
+{
+	size_t curve_num = num_curves();
+
+	for(size_t i = 0; i < curve_num; i++) {
+		Curve curve = get_curve(i);
+
+		for(int k = 0; k < curve.num_segments(); k++) {
+			float3 P[4];
+			P[0] = curve_keys[max(curve.first_key + k - 1, curve.first_key)];
+			P[1] = curve_keys[curve.first_key + k];
+			P[2] = curve_keys[curve.first_key + k + 1];
+			P[3] = curve_keys[min(curve.first_key + k + 2, curve.first_key + curve.num_keys - 1)];
+
+			const float r1 = curve_radius[curve.first_key + k];
+			const float r2 = curve_radius[curve.first_key + k + 1];
+
+			/* Only the interior points are stored, the end points are the keys. */
+			for(int j = 1; j < CURVE_RIBBON_PIECES; j++) {
+				const float u = (float)j / CURVE_RIBBON_PIECES;
+				const float3 co = curve_ribbon_point(P, u);
+				*(curve_ribbons++) = make_float4(co.x, co.y, co.z, r1 + (r2 - r1) * u);
+			}
+		}
+	}
+}
+
 void Mesh::pack_patches(uint *patch_data, uint vert_offset, uint face_offset, uint corner_offset)
 {
 	size_t num_faces = subd_faces.size();
@@ -1794,6 +1836,20 @@ void MeshManager::device_update_mesh(Device *,
 
 		dscene->curve_keys.copy_to_device();
 		dscene->curves.copy_to_device();
+
+		/* Tessellated ribbons, CURVE_RIBBON_PIECES - 1 points for every segment. */
+		if(dscene->data.curve.curveflags & CURVE_KN_TESSELLATED_RIBBONS) {
+			size_t ribbon_size = (curve_key_size - curve_size) * (CURVE_RIBBON_PIECES - 1);
+			float4 *curve_ribbons = dscene->curve_ribbons.alloc(ribbon_size);
+
+			foreach(Mesh *mesh, scene->meshes) {
+				size_t ribbon_offset = (mesh->curvekey_offset - mesh->curve_offset) * (CURVE_RIBBON_PIECES - 1);
+				mesh->pack_curve_ribbons(&curve_ribbons[ribbon_offset]);
+				if(progress.get_cancel()) return;
+			}
+
+			dscene->curve_ribbons.copy_to_device();
+		}
 	}
 
 	if(patch_size != 0) {
@@ -2262,6 +2318,7 @@ void MeshManager::device_free(Device *device, DeviceScene *dscene)
 	dscene->tri_patch_uv.free();
 	dscene->curves.free();
 	dscene->curve_keys.free();
+	dscene->curve_ribbons.free();
 	dscene->patches.free();
 	dscene->attributes_map.free();
 	dscene->attributes_float.free();
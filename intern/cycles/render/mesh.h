@@ -45,6 +45,7 @@ class SceneParams;
 class AttributeRequest;
 struct SubdParams;
 class DiagSplit;
+class SubdDiceCache;
 struct PackedPatchTable;
 
 /* Mesh */
@@ -220,6 +221,8 @@ public:
 	array<SubdEdgeCrease> subd_creases;
 
 	SubdParams *subd_params;
+	/* Diced geometry kept across clear(), to skip dicing on small changes. */
+	SubdDiceCache *subd_dice_cache;
 
 	vector<Shader*> used_shaders;
 	AttributeSet attributes;
@@ -289,6 +292,7 @@ public:
 	                size_t vert_offset,
 	                size_t tri_offset);
 	void pack_curves(Scene *scene, float4 *curve_key_co, float4 *curve_data, size_t curvekey_offset);
+	void pack_curve_ribbons(float4 *curve_ribbons);
 	void pack_patches(uint *patch_data, uint vert_offset, uint face_offset, uint corner_offset);
 
 	void compute_bvh(Device *device,
@@ -18,12 +18,15 @@
 #include "render/attribute.h"
 #include "render/camera.h"
 
+#include "subd/subd_cache.h"
 #include "subd/subd_split.h"
 #include "subd/subd_patch.h"
 #include "subd/subd_patch_table.h"
 
 #include "util/util_foreach.h"
 #include "util/util_algorithm.h"
+#include "util/util_logging.h"
+#include "util/util_time.h"
 
 CCL_NAMESPACE_BEGIN
 
@@ -369,6 +372,38 @@ void Mesh::tessellate(DiagSplit *split)
 	Attribute *attr_vN = subd_attributes.find(ATTR_STD_VERTEX_NORMAL);
 	float3* vN = attr_vN->data_float3();
 
+	/* Hash the control mesh before dicing adds to it. */
+	bool use_dice_cache = split->params.use_dice_cache;
+	string dice_hash;
+
+	if(use_dice_cache) {
+		if(!subd_dice_cache) {
+			subd_dice_cache = new SubdDiceCache();
+		}
+		dice_hash = SubdDiceCache::mesh_hash(this);
+	}
+	else if(subd_dice_cache) {
+		delete subd_dice_cache;
+		subd_dice_cache = NULL;
+	}
+
+	/* Patches must stay alive until dicing is done, reserve so pointers to
+	 * them remain valid. */
+	size_t num_patches = 0;
+	for(int f = 0; f < num_faces; f++) {
+		num_patches += subd_faces[f].is_quad()? 1: subd_faces[f].num_corners;
+	}
+
+	vector<LinearQuadPatch> linear_patches;
+	linear_patches.reserve(num_patches);
+#ifdef WITH_OPENSUBDIV
+	vector<OsdPatch> osd_patches;
+	osd_patches.reserve(num_patches);
+#endif
+
+	vector<QuadDice::SubPatch> subpatches;
+	subpatches.reserve(num_patches*4);
+
 	for(int f = 0; f < num_faces; f++) {
 		SubdFace& face = subd_faces[f];
 
@@ -376,11 +411,11 @@ void Mesh::tessellate(DiagSplit *split)
 			/* quad */
 			QuadDice::SubPatch subpatch;
 
-			LinearQuadPatch quad_patch;
 #ifdef WITH_OPENSUBDIV
-			OsdPatch osd_patch(&osd_data);
-
 			if(subdivision_type == SUBDIVISION_CATMULL_CLARK) {
+				osd_patches.push_back(OsdPatch(&osd_data));
+				OsdPatch& osd_patch = osd_patches.back();
+
 				osd_patch.patch_index = face.ptex_offset;
 
 				subpatch.patch = &osd_patch;
@@ -388,6 +423,9 @@ void Mesh::tessellate(DiagSplit *split)
 			else
 #endif
 			{
+				linear_patches.push_back(LinearQuadPatch());
+				LinearQuadPatch& quad_patch = linear_patches.back();
+
 				float3 *hull = quad_patch.hull;
 				float3 *normals = quad_patch.normals;
 
@@ -424,38 +462,45 @@ void Mesh::tessellate(DiagSplit *split)
 			subpatch.P10 = make_float2(0.5f, 0.0f);
 			subpatch.P01 = make_float2(0.0f, 0.5f);
 			subpatch.P11 = make_float2(0.5f, 0.5f);
-			split->split_quad(subpatch.patch, &subpatch);
+			subpatches.push_back(subpatch);
 
 			subpatch.P00 = make_float2(0.5f, 0.0f);
 			subpatch.P10 = make_float2(1.0f, 0.0f);
 			subpatch.P01 = make_float2(0.5f, 0.5f);
 			subpatch.P11 = make_float2(1.0f, 0.5f);
-			split->split_quad(subpatch.patch, &subpatch);
+			subpatches.push_back(subpatch);
 
 			subpatch.P00 = make_float2(0.0f, 0.5f);
 			subpatch.P10 = make_float2(0.5f, 0.5f);
 			subpatch.P01 = make_float2(0.0f, 1.0f);
 			subpatch.P11 = make_float2(0.5f, 1.0f);
-			split->split_quad(subpatch.patch, &subpatch);
+			subpatches.push_back(subpatch);
 
 			subpatch.P00 = make_float2(0.5f, 0.5f);
 			subpatch.P10 = make_float2(1.0f, 0.5f);
 			subpatch.P01 = make_float2(0.5f, 1.0f);
 			subpatch.P11 = make_float2(1.0f, 1.0f);
-			split->split_quad(subpatch.patch, &subpatch);
+			subpatches.push_back(subpatch);
 		}
 		else {
 			/* ngon */
+			QuadDice::SubPatch subpatch;
+			subpatch.P00 = make_float2(0.0f, 0.0f);
+			subpatch.P10 = make_float2(1.0f, 0.0f);
+			subpatch.P01 = make_float2(0.0f, 1.0f);
+			subpatch.P11 = make_float2(1.0f, 1.0f);
+
 #ifdef WITH_OPENSUBDIV
 			if(subdivision_type == SUBDIVISION_CATMULL_CLARK) {
-				OsdPatch patch(&osd_data);
-
-				patch.shader = face.shader;
-
 				for(int corner = 0; corner < face.num_corners; corner++) {
+					osd_patches.push_back(OsdPatch(&osd_data));
+					OsdPatch& patch = osd_patches.back();
+
+					patch.shader = face.shader;
 					patch.patch_index = face.ptex_offset + corner;
 
-					split->split_quad(&patch);
+					subpatch.patch = &patch;
+					subpatches.push_back(subpatch);
 				}
 			}
 			else
@@ -471,7 +516,8 @@ void Mesh::tessellate(DiagSplit *split)
 				}
 
 				for(int corner = 0; corner < face.num_corners; corner++) {
-					LinearQuadPatch patch;
+					linear_patches.push_back(LinearQuadPatch());
+					LinearQuadPatch& patch = linear_patches.back();
 					float3 *hull = patch.hull;
 					float3 *normals = patch.normals;
 
@@ -503,12 +549,32 @@ void Mesh::tessellate(DiagSplit *split)
 						}
 					}
 
-					split->split_quad(&patch);
+					subpatch.patch = &patch;
+					subpatches.push_back(subpatch);
 				}
 			}
 		}
 	}
 
+	/* split and dice patches */
+	double start_time = time_dt();
+
+	split->split_quads(subpatches);
+
+	if(!(use_dice_cache && subd_dice_cache->restore(this, dice_hash, *split))) {
+		size_t vert_offset = verts.size();
+		size_t tri_offset = num_triangles();
+
+		split->dice();
+
+		if(use_dice_cache) {
+			subd_dice_cache->store(this, dice_hash, *split, vert_offset, tri_offset);
+		}
+	}
+
+	VLOG(2) << "Tessellated mesh " << name << " into " << split->subpatches_quad.size()
+	        << " subpatches in " << time_dt() - start_time << " seconds.";
+
 	/* interpolate center points for attributes */
 	foreach(Attribute& attr, subd_attributes.attributes) {
 #ifdef WITH_OPENSUBDIV
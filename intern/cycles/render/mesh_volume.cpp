@@ -19,10 +19,17 @@
 #include "render/scene.h"
 
 #include "util/util_foreach.h"
+#include "util/util_hash.h"
 #include "util/util_logging.h"
 #include "util/util_progress.h"
+#include "util/util_task.h"
 #include "util/util_types.h"
 
+#ifdef WITH_OPENVDB
+#  include <openvdb/openvdb.h>
+#  include <openvdb/tools/Morphology.h>
+#endif
+
 CCL_NAMESPACE_BEGIN
 
 static size_t compute_voxel_index(const int3 &resolution, size_t x, size_t y, size_t z)
@@ -87,41 +94,116 @@ const float3 quads_normals[6] = {
 	make_float3(0.0f, 0.0f, 1.0f),
 };
 
-static int add_vertex(int3 v, vector<int3> &vertices, int3 res, unordered_map<size_t, int> &used_verts)
-{
-	size_t vert_key = v.x + v.y * (res.x+1) + v.z * (res.x+1)*(res.y+1);
-	unordered_map<size_t, int>::iterator it = used_verts.find(vert_key);
+struct VolumeParams {
+	int3 resolution;
+	float3 cell_size;
+	float3 start_point;
+	int pad_size;
+};
+
+static const int CUBE_SIZE = 8;
+
+struct VoxelAttributeGrid {
+	float *data;
+	int channels;
+};
 
-	if(it != used_verts.end()) {
-		return it->second;
+/* Open addressing hash from vertex coordinates to vertex index. Slots only
+ * store the index, coordinates are compared against the vertex array. */
+class VertexHash {
+public:
+	explicit VertexHash(vector<int3> &vertices)
+	: vertices(vertices)
+	{
+		slots.resize(1024, -1);
 	}
 
-	int vertex_offset = vertices.size();
-	used_verts[vert_key] = vertex_offset;
-	vertices.push_back(v);
-	return vertex_offset;
-}
+	void reserve(size_t num_verts)
+	{
+		if(num_verts*2 > slots.size()) {
+			rehash(next_power_of_two(num_verts*2));
+		}
+	}
+
+	int add(const int3& v)
+	{
+		if((vertices.size() + 1)*2 > slots.size()) {
+			rehash(slots.size()*2);
+		}
+
+		const size_t mask = slots.size() - 1;
+		for(size_t i = hash(v) & mask;; i = (i + 1) & mask) {
+			if(slots[i] == -1) {
+				slots[i] = vertices.size();
+				vertices.push_back(v);
+				return slots[i];
+			}
+			if(vertices[slots[i]] == v) {
+				return slots[i];
+			}
+		}
+	}
+
+private:
+	static size_t next_power_of_two(size_t n)
+	{
+		size_t size = 1;
+		while(size < n) {
+			size *= 2;
+		}
+		return size;
+	}
+
+	static size_t hash(const int3& v)
+	{
+		return hash_int_2d(hash_int_2d(v.x, v.y), v.z);
+	}
+
+	void rehash(size_t size)
+	{
+		slots.clear();
+		slots.resize(size, -1);
 
-static void create_quad(int3 corners[8], vector<int3> &vertices, vector<QuadData> &quads, int3 res, unordered_map<size_t, int> &used_verts, int face_index)
+		const size_t mask = size - 1;
+		for(size_t j = 0; j < vertices.size(); j++) {
+			size_t i = hash(vertices[j]) & mask;
+			while(slots[i] != -1) {
+				i = (i + 1) & mask;
+			}
+			slots[i] = j;
+		}
+	}
+
+	vector<int3> &vertices;
+	vector<int> slots;
+};
+
+static void create_quad(int3 corners[8], VertexHash &used_verts, vector<QuadData> &quads, int face_index)
 {
 	QuadData quad;
-	quad.v0 = add_vertex(corners[quads_indices[face_index][0]], vertices, res, used_verts);
-	quad.v1 = add_vertex(corners[quads_indices[face_index][1]], vertices, res, used_verts);
-	quad.v2 = add_vertex(corners[quads_indices[face_index][2]], vertices, res, used_verts);
-	quad.v3 = add_vertex(corners[quads_indices[face_index][3]], vertices, res, used_verts);
+	quad.v0 = used_verts.add(corners[quads_indices[face_index][0]]);
+	quad.v1 = used_verts.add(corners[quads_indices[face_index][1]]);
+	quad.v2 = used_verts.add(corners[quads_indices[face_index][2]]);
+	quad.v3 = used_verts.add(corners[quads_indices[face_index][3]]);
 	quad.normal = quads_normals[face_index];
 
 	quads.push_back(quad);
 }
 
-struct VolumeParams {
-	int3 resolution;
-	float3 cell_size;
-	float3 start_point;
-	int pad_size;
-};
-
-static const int CUBE_SIZE = 8;
+static void node_corners(const int3& min, int3 corners[8])
+{
+	/* Maximum is just CUBE_SIZE voxels away from minimum on each axis. */
+	const int3 max = make_int3(min.x + CUBE_SIZE, min.y + CUBE_SIZE, min.z + CUBE_SIZE);
+
+	corners[0] = make_int3(min[0], min[1], min[2]);
+	corners[1] = make_int3(max[0], min[1], min[2]);
+	corners[2] = make_int3(max[0], max[1], min[2]);
+	corners[3] = make_int3(min[0], max[1], min[2]);
+	corners[4] = make_int3(min[0], min[1], max[2]);
+	corners[5] = make_int3(max[0], min[1], max[2]);
+	corners[6] = make_int3(max[0], max[1], max[2]);
+	corners[7] = make_int3(min[0], max[1], max[2]);
+}
 
 /* Create a mesh from a volume.
  *
@@ -133,8 +215,16 @@ static const int CUBE_SIZE = 8;
  * coordinate of the auxilliary volume.
  * - quads are created between active and non-active voxels in the auxialliary
  * volume to generate a tight mesh around the volume.
+ *
+ * With OpenVDB the auxilliary volume is a sparse mask grid instead, its leaf
+ * nodes are CUBE_SIZE voxels wide and serve as the nodes of the mesh, so the
+ * cost of creating the mesh only depends on the number of active nodes.
  */
 class VolumeMeshBuilder {
+#ifdef WITH_OPENVDB
+	/* Active voxels, dilated by the padding. */
+	openvdb::MaskGrid::Ptr topology_grid;
+#else
 	/* Auxilliary volume that is used to check if a node already added. */
 	vector<char> grid;
 
@@ -142,28 +232,45 @@ class VolumeMeshBuilder {
 	 * of the original volume on each axis. */
 	int3 res;
 
-	size_t number_of_nodes;
-
 	/* Offset due to padding in the original grid. Padding will transform the
 	 * coordinates of the original grid from 0...res to -padding...res+padding,
 	 * so some coordinates are negative, and we need to properly account for
 	 * them. */
 	int3 pad_offset;
+#endif
+
+	size_t number_of_nodes;
 
 	VolumeParams *params;
 
 public:
 	VolumeMeshBuilder(VolumeParams *volume_params);
 
-	void add_node(int x, int y, int z);
-
-	void add_node_with_padding(int x, int y, int z);
+	/* Add nodes for all voxels with a value above the isovalue. */
+	void add_voxels(const vector<VoxelAttributeGrid> &voxel_grids, float isovalue);
 
 	void create_mesh(vector<float3> &vertices,
 	                 vector<int> &indices,
 	                 vector<float3> &face_normals);
 
 private:
+#ifdef WITH_OPENVDB
+	void add_voxels_slices(const vector<VoxelAttributeGrid> *voxel_grids,
+	                       float isovalue,
+	                       int z_begin,
+	                       int z_end,
+	                       openvdb::MaskGrid::Ptr *slices_grid);
+
+	void generate_leaf_quads(const vector<const openvdb::MaskTree::LeafNodeType*> *leaves,
+	                         size_t begin,
+	                         size_t end,
+	                         vector<int3> *quad_corners);
+#else
+	void add_node(int x, int y, int z);
+
+	void add_node_with_padding(int x, int y, int z);
+#endif
+
 	void generate_vertices_and_quads(vector<int3> &vertices_is,
 	                                 vector<QuadData> &quads);
 
@@ -175,6 +282,190 @@ private:
 	                           vector<float3> &face_normals);
 };
 
+static bool voxel_is_active(const vector<VoxelAttributeGrid> &voxel_grids,
+                            size_t voxel_index,
+                            float isovalue)
+{
+	for(size_t i = 0; i < voxel_grids.size(); ++i) {
+		const VoxelAttributeGrid &voxel_grid = voxel_grids[i];
+		const int channels = voxel_grid.channels;
+
+		for(int c = 0; c < channels; c++) {
+			if(voxel_grid.data[voxel_index * channels + c] >= isovalue) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+#ifdef WITH_OPENVDB
+
+VolumeMeshBuilder::VolumeMeshBuilder(VolumeParams *volume_params)
+{
+	params = volume_params;
+	number_of_nodes = 0;
+
+	topology_grid = openvdb::MaskGrid::create();
+}
+
+void VolumeMeshBuilder::add_voxels_slices(const vector<VoxelAttributeGrid> *voxel_grids,
+                                          float isovalue,
+                                          int z_begin,
+                                          int z_end,
+                                          openvdb::MaskGrid::Ptr *slices_grid)
+{
+	const int3 resolution = params->resolution;
+	openvdb::MaskGrid::Accessor accessor = (*slices_grid)->getAccessor();
+
+	for(int z = z_begin; z < z_end; ++z) {
+		for(int y = 0; y < resolution.y; ++y) {
+			for(int x = 0; x < resolution.x; ++x) {
+				size_t voxel_index = compute_voxel_index(resolution, x, y, z);
+
+				if(voxel_is_active(*voxel_grids, voxel_index, isovalue)) {
+					accessor.setValueOn(openvdb::Coord(x, y, z));
+				}
+			}
+		}
+	}
+}
+
+void VolumeMeshBuilder::add_voxels(const vector<VoxelAttributeGrid> &voxel_grids, float isovalue)
+{
+	/* Every task fills its own grid for a block of slices aligned to the
+	 * leaf nodes, the topology of the grids is merged afterwards. */
+	const int3 resolution = params->resolution;
+	const int num_blocks = divide_up(resolution.z, CUBE_SIZE);
+	vector<openvdb::MaskGrid::Ptr> block_grids(num_blocks);
+
+	TaskPool pool;
+	for(int i = 0; i < num_blocks; i++) {
+		block_grids[i] = openvdb::MaskGrid::create();
+		pool.push(function_bind(&VolumeMeshBuilder::add_voxels_slices,
+		                        this,
+		                        &voxel_grids,
+		                        isovalue,
+		                        i*CUBE_SIZE,
+		                        min((i + 1)*CUBE_SIZE, resolution.z),
+		                        &block_grids[i]));
+	}
+	pool.wait_work();
+
+	foreach(openvdb::MaskGrid::Ptr& block_grid, block_grids) {
+		topology_grid->tree().topologyUnion(block_grid->tree());
+	}
+
+	if(params->pad_size) {
+		openvdb::tools::dilateActiveValues(topology_grid->tree(),
+		                                   params->pad_size,
+		                                   openvdb::tools::NN_FACE_EDGE_VERTEX);
+	}
+
+	/* Leaf nodes are the nodes of the mesh, so there must be no tiles. */
+	topology_grid->tree().voxelizeActiveTiles();
+
+	number_of_nodes = topology_grid->tree().leafCount();
+}
+
+void VolumeMeshBuilder::generate_leaf_quads(const vector<const openvdb::MaskTree::LeafNodeType*> *leaves,
+                                            size_t begin,
+                                            size_t end,
+                                            vector<int3> *quad_corners)
+{
+	const openvdb::MaskTree &tree = topology_grid->constTree();
+	const int offsets[6][3] = {
+		{-CUBE_SIZE, 0, 0}, {CUBE_SIZE, 0, 0},
+		{0, -CUBE_SIZE, 0}, {0, CUBE_SIZE, 0},
+		{0, 0, -CUBE_SIZE}, {0, 0, CUBE_SIZE},
+	};
+
+	for(size_t i = begin; i < end; ++i) {
+		const openvdb::Coord origin = (*leaves)[i]->origin();
+
+		int3 corners[8];
+		node_corners(make_int3(origin.x(), origin.y(), origin.z()), corners);
+
+		/* Only create a quad if on the border between an active and
+		 * an inactive node.
+		 */
+		for(int face = 0; face < 6; face++) {
+			const openvdb::Coord neighbor = origin.offsetBy(offsets[face][0],
+			                                                offsets[face][1],
+			                                                offsets[face][2]);
+			const openvdb::MaskTree::LeafNodeType *leaf = tree.probeConstLeaf(neighbor);
+
+			if(leaf == NULL || leaf->isEmpty()) {
+				for(int j = 0; j < 4; j++) {
+					quad_corners->push_back(corners[quads_indices[face][j]]);
+				}
+				quad_corners->push_back(make_int3(face, 0, 0));
+			}
+		}
+	}
+}
+
+void VolumeMeshBuilder::generate_vertices_and_quads(
+		vector<ccl::int3> &vertices_is,
+		vector<QuadData> &quads)
+{
+	vector<const openvdb::MaskTree::LeafNodeType*> leaves;
+	leaves.reserve(number_of_nodes);
+
+	for(openvdb::MaskTree::LeafCIter iter = topology_grid->constTree().cbeginLeaf(); iter; ++iter) {
+		if(!iter->isEmpty()) {
+			leaves.push_back(iter.getLeaf());
+		}
+	}
+
+	/* Quads of blocks of leaves are generated in parallel, each as four
+	 * corners followed by the face index. Merging the blocks in order keeps
+	 * the mesh the same regardless of scheduling. */
+	const size_t block_size = 1024;
+	const size_t num_blocks = divide_up(leaves.size(), block_size);
+	vector<vector<int3> > block_quads(num_blocks);
+
+	TaskPool pool;
+	for(size_t i = 0; i < num_blocks; i++) {
+		size_t begin = i*block_size;
+		size_t end = (i + 1 == num_blocks)? leaves.size(): begin + block_size;
+		pool.push(function_bind(&VolumeMeshBuilder::generate_leaf_quads,
+		                        this,
+		                        &leaves,
+		                        begin,
+		                        end,
+		                        &block_quads[i]));
+	}
+	pool.wait_work();
+
+	size_t num_quads = 0;
+	foreach(const vector<int3>& corners, block_quads) {
+		num_quads += corners.size() / 5;
+	}
+
+	/* Neighboring quads share vertices, so there are fewer than four
+	 * vertices per quad. */
+	VertexHash used_verts(vertices_is);
+	used_verts.reserve(num_quads*2);
+	quads.reserve(num_quads);
+
+	foreach(const vector<int3>& corners, block_quads) {
+		for(size_t i = 0; i < corners.size(); i += 5) {
+			QuadData quad;
+			quad.v0 = used_verts.add(corners[i + 0]);
+			quad.v1 = used_verts.add(corners[i + 1]);
+			quad.v2 = used_verts.add(corners[i + 2]);
+			quad.v3 = used_verts.add(corners[i + 3]);
+			quad.normal = quads_normals[corners[i + 4].x];
+
+			quads.push_back(quad);
+		}
+	}
+}
+
+#else  /* WITH_OPENVDB */
+
 VolumeMeshBuilder::VolumeMeshBuilder(VolumeParams *volume_params)
 {
 	params = volume_params;
@@ -228,27 +519,28 @@ void VolumeMeshBuilder::add_node_with_padding(int x, int y, int z)
 	}
 }
 
-void VolumeMeshBuilder::create_mesh(vector<float3> &vertices,
-                                    vector<int> &indices,
-                                    vector<float3> &face_normals)
+void VolumeMeshBuilder::add_voxels(const vector<VoxelAttributeGrid> &voxel_grids, float isovalue)
 {
-	/* We create vertices in index space (is), and only convert them to object
-	 * space when done. */
-	vector<int3> vertices_is;
-	vector<QuadData> quads;
-
-	generate_vertices_and_quads(vertices_is, quads);
+	const int3 resolution = params->resolution;
 
-	convert_object_space(vertices_is, vertices);
+	for(int z = 0; z < resolution.z; ++z) {
+		for(int y = 0; y < resolution.y; ++y) {
+			for(int x = 0; x < resolution.x; ++x) {
+				size_t voxel_index = compute_voxel_index(resolution, x, y, z);
 
-	convert_quads_to_tris(quads, indices, face_normals);
+				if(voxel_is_active(voxel_grids, voxel_index, isovalue)) {
+					add_node_with_padding(x, y, z);
+				}
+			}
+		}
+	}
 }
 
 void VolumeMeshBuilder::generate_vertices_and_quads(
 		vector<ccl::int3> &vertices_is,
 		vector<QuadData> &quads)
 {
-	unordered_map<size_t, int> used_verts;
+	VertexHash used_verts(vertices_is);
 
 	for(int z = 0; z < res.z; ++z) {
 		for(int y = 0; y < res.y; ++y) {
@@ -259,23 +551,11 @@ void VolumeMeshBuilder::generate_vertices_and_quads(
 				}
 
 				/* Compute min and max coords of the node in index space. */
-				int3 min = make_int3((x - pad_offset.x)*CUBE_SIZE,
-				                     (y - pad_offset.y)*CUBE_SIZE,
-				                     (z - pad_offset.z)*CUBE_SIZE);
-
-				/* Maximum is just CUBE_SIZE voxels away from minimum on each axis. */
-				int3 max = make_int3(min.x + CUBE_SIZE, min.y + CUBE_SIZE, min.z + CUBE_SIZE);
-
-				int3 corners[8] = {
-					make_int3(min[0], min[1], min[2]),
-					make_int3(max[0], min[1], min[2]),
-					make_int3(max[0], max[1], min[2]),
-					make_int3(min[0], max[1], min[2]),
-					make_int3(min[0], min[1], max[2]),
-					make_int3(max[0], min[1], max[2]),
-					make_int3(max[0], max[1], max[2]),
-					make_int3(min[0], max[1], max[2]),
-				};
+				int3 corners[8];
+				node_corners(make_int3((x - pad_offset.x)*CUBE_SIZE,
+				                       (y - pad_offset.y)*CUBE_SIZE,
+				                       (z - pad_offset.z)*CUBE_SIZE),
+				             corners);
 
 				/* Only create a quad if on the border between an active and
 				 * an inactive node.
@@ -283,38 +563,60 @@ void VolumeMeshBuilder::generate_vertices_and_quads(
 
 				voxel_index = compute_voxel_index(res, x - 1, y, z);
 				if(voxel_index == -1 || grid[voxel_index] == 0) {
-					create_quad(corners, vertices_is, quads, res, used_verts, QUAD_X_MIN);
+					create_quad(corners, used_verts, quads, QUAD_X_MIN);
 				}
 
 				voxel_index = compute_voxel_index(res, x + 1, y, z);
 				if(voxel_index == -1 || grid[voxel_index] == 0) {
-					create_quad(corners, vertices_is, quads, res, used_verts, QUAD_X_MAX);
+					create_quad(corners, used_verts, quads, QUAD_X_MAX);
 				}
 
 				voxel_index = compute_voxel_index(res, x, y - 1, z);
 				if(voxel_index == -1 || grid[voxel_index] == 0) {
-					create_quad(corners, vertices_is, quads, res, used_verts, QUAD_Y_MIN);
+					create_quad(corners, used_verts, quads, QUAD_Y_MIN);
 				}
 
 				voxel_index = compute_voxel_index(res, x, y + 1, z);
 				if(voxel_index == -1 || grid[voxel_index] == 0) {
-					create_quad(corners, vertices_is, quads, res, used_verts, QUAD_Y_MAX);
+					create_quad(corners, used_verts, quads, QUAD_Y_MAX);
 				}
 
 				voxel_index = compute_voxel_index(res, x, y, z - 1);
 				if(voxel_index == -1 || grid[voxel_index] == 0) {
-					create_quad(corners, vertices_is, quads, res, used_verts, QUAD_Z_MIN);
+					create_quad(corners, used_verts, quads, QUAD_Z_MIN);
 				}
 
 				voxel_index = compute_voxel_index(res, x, y, z + 1);
 				if(voxel_index == -1 || grid[voxel_index] == 0) {
-					create_quad(corners, vertices_is, quads, res, used_verts, QUAD_Z_MAX);
+					create_quad(corners, used_verts, quads, QUAD_Z_MAX);
 				}
 			}
 		}
 	}
 }
 
+#endif  /* WITH_OPENVDB */
+
+void VolumeMeshBuilder::create_mesh(vector<float3> &vertices,
+                                    vector<int> &indices,
+                                    vector<float3> &face_normals)
+{
+	/* We create vertices in index space (is), and only convert them to object
+	 * space when done. */
+	vector<int3> vertices_is;
+	vector<QuadData> quads;
+
+	generate_vertices_and_quads(vertices_is, quads);
+
+	convert_object_space(vertices_is, vertices);
+
+	convert_quads_to_tris(quads, indices, face_normals);
+
+	VLOG(1) << "Volume mesh nodes: " << number_of_nodes
+	        << ", vertices: " << vertices.size()
+	        << ", quads: " << quads.size() << ".";
+}
+
 void VolumeMeshBuilder::convert_object_space(const vector<int3> &vertices,
 	                                         vector<float3> &out_vertices)
 {
@@ -354,11 +656,6 @@ void VolumeMeshBuilder::convert_quads_to_tris(const vector<QuadData> &quads,
 
 /* ************************************************************************** */
 
-struct VoxelAttributeGrid {
-	float *data;
-	int channels;
-};
-
 void MeshManager::create_volume_mesh(Scene *scene,
                                      Mesh *mesh,
                                      Progress& progress)
@@ -447,27 +744,7 @@ void MeshManager::create_volume_mesh(Scene *scene,
 
 	/* Build bounding mesh around non-empty volume cells. */
 	VolumeMeshBuilder builder(&volume_params);
-	const float isovalue = mesh->volume_isovalue;
-
-	for(int z = 0; z < resolution.z; ++z) {
-		for(int y = 0; y < resolution.y; ++y) {
-			for(int x = 0; x < resolution.x; ++x) {
-				size_t voxel_index = compute_voxel_index(resolution, x, y, z);
-
-				for(size_t i = 0; i < voxel_grids.size(); ++i) {
-					const VoxelAttributeGrid &voxel_grid = voxel_grids[i];
-					const int channels = voxel_grid.channels;
-
-					for(int c = 0; c < channels; c++) {
-						if(voxel_grid.data[voxel_index * channels + c] >= isovalue) {
-							builder.add_node_with_padding(x, y, z);
-							break;
-						}
-					}
-				}
-			}
-		}
-	}
+	builder.add_voxels(voxel_grids, mesh->volume_isovalue);
 
 	/* Create mesh. */
 	vector<float3> vertices;
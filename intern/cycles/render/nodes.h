@@ -702,6 +702,7 @@ class LightPathNode : public ShaderNode {
 public:
 	SHADER_NODE_CLASS(LightPathNode)
 	virtual int get_group() { return NODE_GROUP_LEVEL_1; }
+	bool has_path_state_dependency() { return true; }
 };
 
 class LightFalloffNode : public ShaderNode {
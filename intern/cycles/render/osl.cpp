@@ -1156,6 +1156,7 @@ void OSLCompiler::compile(Scene *scene, OSLGlobals *og, Shader *shader)
 		shader->has_volume = false;
 		shader->has_displacement = false;
 		shader->has_surface_spatial_varying = false;
+		shader->has_surface_transparent_varying = true; /* can't detect yet */
 		shader->has_volume_spatial_varying = false;
 		shader->has_object_dependency = false;
 		shader->has_attribute_dependency = false;
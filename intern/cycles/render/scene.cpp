@@ -58,6 +58,7 @@ DeviceScene::DeviceScene(Device *device)
   tri_patch_uv(device, "__tri_patch_uv", MEM_TEXTURE),
   curves(device, "__curves", MEM_TEXTURE),
   curve_keys(device, "__curve_keys", MEM_TEXTURE),
+  curve_ribbons(device, "__curve_ribbons", MEM_TEXTURE),
   patches(device, "__patches", MEM_TEXTURE),
   objects(device, "__objects", MEM_TEXTURE),
   object_motion_pass(device, "__object_motion_pass", MEM_TEXTURE),
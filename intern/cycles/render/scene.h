@@ -83,6 +83,7 @@ public:
 
 	device_vector<float4> curves;
 	device_vector<float4> curve_keys;
+	device_vector<float4> curve_ribbons;
 
 	device_vector<uint> patches;
 
@@ -19,6 +19,7 @@
 
 #include "render/buffers.h"
 #include "render/camera.h"
+#include "render/film.h"
 #include "device/device.h"
 #include "render/graph.h"
 #include "render/integrator.h"
@@ -34,6 +35,7 @@
 #include "util/util_logging.h"
 #include "util/util_math.h"
 #include "util/util_opengl.h"
+#include "util/util_path.h"
 #include "util/util_task.h"
 #include "util/util_time.h"
 
@@ -53,11 +55,19 @@ Session::Session(const SessionParams& params_)
 {
 	device_use_gl = ((params.device.type != DEVICE_CPU) && !params.background);
 
-	TaskScheduler::init(params.threads);
+	TaskScheduler::init(params.threads, params.numa_affinity);
+
+	/* Streamed tiles have to line up with the tiles of the EXR file. */
+	tile_manager.adaptive_tiles = params.adaptive_tiles && params.out_of_core_path.empty();
 
 	device = Device::create(params.device, stats, profiler, params.background);
 
-	if(params.background && !params.write_render_cb) {
+	/* Number of tiles the device renders at once, one per CPU thread and one
+	 * per GPU. */
+	DeviceTask render_task(DeviceTask::RENDER);
+	tile_manager.num_workers = max(device->get_split_task_count(render_task), 1);
+
+	if(params.background && (!params.write_render_cb || !params.out_of_core_path.empty())) {
 		buffers = NULL;
 		display = NULL;
 	}
@@ -66,6 +76,7 @@ Session::Session(const SessionParams& params_)
 		display = new DisplayBuffer(device, params.display_buffer_linear);
 	}
 
+	buffers_first_touch = false;
 	session_thread = NULL;
 	scene = NULL;
 
@@ -105,7 +116,7 @@ Session::~Session()
 		wait();
 	}
 
-	if(params.write_render_cb) {
+	if(params.write_render_cb && buffers) {
 		/* tonemap and write out image if requested */
 		delete display;
 
@@ -120,7 +131,9 @@ Session::~Session()
 	}
 
 	/* clean up */
+	tile_writer.close();
 	tile_manager.device_free();
+	tile_cache.clear();
 
 	delete buffers;
 	delete display;
@@ -286,6 +299,8 @@ void Session::run_gpu()
 
 			device->task_wait();
 
+			tile_manager.report_idle_time();
+
 			if(!device->error_message().empty())
 				progress.set_cancel(device->error_message());
 
@@ -395,8 +410,10 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 	Tile *tile;
 	int device_num = device->device_number(tile_device);
 
-	if(!tile_manager.next_tile(tile, device_num))
+	if(!tile_manager.next_tile(tile, device_num)) {
+		tile_manager.worker_finished(device_num);
 		return false;
+	}
 
 	/* fill render tile */
 	rtile.x = tile_manager.state.buffer.full_x + tile->x;
@@ -409,6 +426,13 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 	rtile.tile_index = tile->index;
 	rtile.task = (tile->state == Tile::DENOISE)? RenderTile::DENOISE: RenderTile::PATH_TRACE;
 
+	if(!buffers && tile->buffers == NULL && tile->state == Tile::DENOISE) {
+		/* buffers of a tile waiting for denoising were spilled to disk,
+		 * restored under the lock since neighbor mapping and eviction
+		 * access the same tiles */
+		tile_cache.restore(*tile, tile_device);
+	}
+
 	tile_lock.unlock();
 
 	/* in case of a permanent buffer, return it, otherwise we will allocate
@@ -416,6 +440,15 @@ bool Session::acquire_tile(Device *tile_device, RenderTile& rtile)
 	if(buffers) {
 		tile_manager.state.buffer.get_offset_stride(rtile.offset, rtile.stride);
 
+		if(buffers_first_touch &&
+		   rtile.task == RenderTile::PATH_TRACE &&
+		   rtile.start_sample == tile_manager.range_start_sample)
+		{
+			/* first touch from the worker, so the pages of its rows are
+			 * placed on the NUMA node the worker is bound to */
+			buffers->zero_tile(rtile.offset, rtile.stride, rtile.x, rtile.y, rtile.w, rtile.h);
+		}
+
 		rtile.buffer = buffers->buffer.device_pointer;
 		rtile.buffers = buffers;
 
@@ -480,6 +513,13 @@ void Session::release_tile(RenderTile& rtile)
 			write_render_tile_cb(rtile);
 		}
 
+		if(tile_writer.is_open()) {
+			tile_writer.write_tile(rtile,
+			                       rtile.x - tile_manager.state.buffer.full_x,
+			                       rtile.y - tile_manager.state.buffer.full_y,
+			                       scene->film->exposure);
+		}
+
 		if(delete_tile) {
 			delete rtile.buffers;
 			tile_manager.state.tiles[rtile.tile_index].buffers = NULL;
@@ -491,6 +531,11 @@ void Session::release_tile(RenderTile& rtile)
 		}
 	}
 
+	if(!params.out_of_core_path.empty()) {
+		tile_cache.release_done(tile_manager.state.tiles);
+		tile_cache.evict(tile_manager.state.tiles);
+	}
+
 	update_status_time();
 }
 
@@ -512,8 +557,13 @@ void Session::map_neighbor_tiles(RenderTile *tiles, Device *tile_device)
 			   px <  image_region.z && py <  image_region.w) {
 				int tile_index = center_idx + dy*tile_manager.state.tile_stride + dx;
 				Tile *tile = &tile_manager.state.tiles[tile_index];
+				if(!params.out_of_core_path.empty()) {
+					tile_cache.restore(*tile, tile_device);
+					tile_cache.pin(tile_index);
+				}
 				assert(tile->buffers);
 
+				tiles[i].tile_index = tile_index;
 				tiles[i].buffer = tile->buffers->buffer.device_pointer;
 				tiles[i].x = tile_manager.state.buffer.full_x + tile->x;
 				tiles[i].y = tile_manager.state.buffer.full_y + tile->y;
@@ -526,6 +576,7 @@ void Session::map_neighbor_tiles(RenderTile *tiles, Device *tile_device)
 			else {
 				tiles[i].buffer = (device_ptr)NULL;
 				tiles[i].buffers = NULL;
+				tiles[i].tile_index = -1;
 				tiles[i].x = clamp(px, image_region.x, image_region.z);
 				tiles[i].y = clamp(py, image_region.y, image_region.w);
 				tiles[i].w = tiles[i].h = 0;
@@ -552,6 +603,14 @@ void Session::unmap_neighbor_tiles(RenderTile *tiles, Device *tile_device)
 {
 	thread_scoped_lock tile_lock(tile_mutex);
 	device->unmap_neighbor_tiles(tile_device, tiles);
+
+	if(!params.out_of_core_path.empty()) {
+		for(int i = 0; i < 9; i++) {
+			if(tiles[i].tile_index != -1) {
+				tile_cache.unpin(tiles[i].tile_index);
+			}
+		}
+	}
 }
 
 void Session::run_cpu()
@@ -655,6 +714,10 @@ void Session::run_cpu()
 
 		device->task_wait();
 
+		if(!no_tiles) {
+			tile_manager.report_idle_time();
+		}
+
 		{
 			thread_scoped_lock reset_lock(delayed_reset.mutex);
 			thread_scoped_lock buffers_lock(buffers_mutex);
@@ -825,7 +888,9 @@ void Session::reset_(BufferParams& buffer_params, int samples)
 {
 	if(buffers && buffer_params.modified(tile_manager.params)) {
 		gpu_draw_ready = false;
-		buffers->reset(buffer_params);
+		/* leave the pages of a new CPU buffer to the bound workers */
+		buffers_first_touch = (params.device.type == DEVICE_CPU && TaskScheduler::numa_affinity());
+		buffers->reset(buffer_params, buffers_first_touch);
 		if(display) {
 			display->reset(buffer_params);
 		}
@@ -834,6 +899,11 @@ void Session::reset_(BufferParams& buffer_params, int samples)
 	tile_manager.reset(buffer_params, samples);
 	progress.reset_sample();
 
+	if(!params.out_of_core_path.empty()) {
+		tile_cache.reset(path_dirname(params.out_of_core_path), params.tile_memory_budget);
+		tile_writer.open(params.out_of_core_path, buffer_params.width, buffer_params.height, params.tile_size);
+	}
+
 	bool show_progress = params.background || tile_manager.get_num_effective_samples() != INT_MAX;
 	progress.set_total_pixel_samples(show_progress? tile_manager.state.total_pixel_samples : 0);
 
@@ -1008,9 +1078,15 @@ void Session::update_status_time(bool show_pause, bool show_done)
 
 void Session::render()
 {
-	/* Clear buffers. */
+	/* Clear buffers, tiles of a newly allocated buffer are cleared in
+	 * acquire_tile() instead. */
 	if(buffers && tile_manager.state.sample == tile_manager.range_start_sample) {
-		buffers->zero();
+		if(!buffers_first_touch) {
+			buffers->zero();
+		}
+	}
+	else {
+		buffers_first_touch = false;
 	}
 
 	/* Add path trace task. */
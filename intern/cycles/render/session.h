@@ -22,6 +22,7 @@
 #include "render/shader.h"
 #include "render/stats.h"
 #include "render/tile.h"
+#include "render/tile_cache.h"
 
 #include "util/util_progress.h"
 #include "util/util_stats.h"
@@ -56,8 +57,22 @@ public:
 	int pixel_size;
 	int threads;
 
+	/* Split tiles near the end of a pass and order them by previous cost. */
+	bool adaptive_tiles;
+
+	/* Bind CPU worker threads to NUMA nodes, so tile buffers are allocated
+	 * on the node of the thread rendering them. */
+	bool numa_affinity;
+
 	bool use_profiling;
 
+	/* Out-of-core rendering for very large images: when set, no full frame
+	 * buffers are kept, finished tiles are streamed into this tiled EXR file
+	 * and tile buffers waiting for denoising neighbors are spilled to disk
+	 * once they use more than tile_memory_budget bytes (zero is unlimited). */
+	string out_of_core_path;
+	size_t tile_memory_budget;
+
 	bool display_buffer_linear;
 
 	bool run_denoising;
@@ -90,8 +105,13 @@ public:
 		pixel_size = 1;
 		threads = 0;
 
+		adaptive_tiles = false;
+		numa_affinity = false;
+
 		use_profiling = false;
 
+		tile_memory_budget = 0;
+
 		run_denoising = false;
 		write_denoising_passes = false;
 		full_denoising = false;
@@ -118,7 +138,11 @@ public:
 		&& start_resolution == params.start_resolution
 		&& pixel_size == params.pixel_size
 		&& threads == params.threads
+		&& adaptive_tiles == params.adaptive_tiles
+		&& numa_affinity == params.numa_affinity
 		&& use_profiling == params.use_profiling
+		&& out_of_core_path == params.out_of_core_path
+		&& tile_memory_budget == params.tile_memory_budget
 		&& display_buffer_linear == params.display_buffer_linear
 		&& cancel_timeout == params.cancel_timeout
 		&& reset_timeout == params.reset_timeout
@@ -145,6 +169,8 @@ public:
 	TileManager tile_manager;
 	Stats stats;
 	Profiler profiler;
+	TileBufferCache tile_cache;
+	TileImageWriter tile_writer;
 
 	typedef void (*render_image_cb)(const half* data, const int w, const int h, const int data_type); //For unity interactive rendering call bcak
 	render_image_cb render_icb;
@@ -210,6 +236,10 @@ protected:
 
 	bool device_use_gl;
 
+	/* Permanent buffers were allocated without being touched, tiles are
+	 * zeroed by the worker that acquires them in the first pass. */
+	bool buffers_first_touch;
+
 	thread *session_thread;
 
 	volatile bool display_outdated;
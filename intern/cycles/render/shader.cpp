@@ -195,6 +195,7 @@ Shader::Shader()
 	has_bump = false;
 	has_bssrdf_bump = false;
 	has_surface_spatial_varying = false;
+	has_surface_transparent_varying = false;
 	has_volume_spatial_varying = false;
 	has_object_dependency = false;
 	has_attribute_dependency = false;
@@ -505,6 +506,8 @@ void ShaderManager::device_update_common(Device *device,
 			flag |= SD_HETEROGENEOUS_VOLUME;
 		if(shader->has_attribute_dependency)
 			flag |= SD_NEED_ATTRIBUTES;
+		if(!shader->has_surface_transparent_varying)
+			flag |= SD_HAS_CONSTANT_TRANSPARENCY;
 		if(shader->has_bssrdf_bump)
 			flag |= SD_HAS_BSSRDF_BUMP;
 		if(device->info.has_volume_decoupled) {
@@ -120,6 +120,8 @@ public:
 	bool has_bump;
 	bool has_bssrdf_bump;
 	bool has_surface_spatial_varying;
+	/* transparency differs within a primitive or depends on the ray */
+	bool has_surface_transparent_varying;
 	bool has_volume_spatial_varying;
 	bool has_object_dependency;
 	bool has_attribute_dependency;
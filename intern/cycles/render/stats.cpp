@@ -34,6 +34,11 @@ bool namedSizeEntryComparator(const NamedSizeEntry& a, const NamedSizeEntry& b)
 	return a.size > b.size;
 }
 
+bool namedTimeEntryComparator(const NamedTimeEntry& a, const NamedTimeEntry& b)
+{
+	return a.time > b.time;
+}
+
 bool namedTimeSampleEntryComparator(const NamedNestedSampleStats& a, const NamedNestedSampleStats& b)
 {
 	return a.sum_samples > b.sum_samples;
@@ -44,6 +49,30 @@ bool namedSampleCountPairComparator(const NamedSampleCountPair& a, const NamedSa
 	return a.samples > b.samples;
 }
 
+/* Quoted string with JSON escapes. */
+string json_string(const string& str)
+{
+	string result = "\"";
+	foreach(char c, str) {
+		switch(c) {
+			case '"': result += "\\\""; break;
+			case '\\': result += "\\\\"; break;
+			case '\n': result += "\\n"; break;
+			case '\r': result += "\\r"; break;
+			case '\t': result += "\\t"; break;
+			default:
+				if((unsigned char)c < 0x20) {
+					result += string_printf("\\u%04x", (unsigned char)c);
+				}
+				else {
+					result += c;
+				}
+				break;
+		}
+	}
+	return result + "\"";
+}
+
 }  // namespace
 
 NamedSizeEntry::NamedSizeEntry()
@@ -88,6 +117,48 @@ string NamedSizeStats::full_report(int indent_level)
 	return result;
 }
 
+/* Named time entry. */
+
+NamedTimeEntry::NamedTimeEntry()
+    : name(""),
+      time(0.0) {
+}
+
+NamedTimeEntry::NamedTimeEntry(const string& name, double time)
+    : name(name),
+      time(time) {
+}
+
+/* Named time statistics. */
+
+NamedTimeStats::NamedTimeStats()
+    : total_time(0.0) {
+}
+
+void NamedTimeStats::add_entry(const NamedTimeEntry& entry) {
+	total_time += entry.time;
+	entries.push_back(entry);
+}
+
+string NamedTimeStats::full_report(int indent_level)
+{
+	const string indent(indent_level * kIndentNumSpaces, ' ');
+	const string double_indent = indent + indent;
+	string result = "";
+	result += string_printf("%sTotal time: %.2fs\n",
+	                        indent.c_str(),
+	                        total_time);
+	sort(entries.begin(), entries.end(), namedTimeEntryComparator);
+	foreach(const NamedTimeEntry& entry, entries) {
+		result += string_printf(
+		        "%s%-32s %.2fs\n",
+		        double_indent.c_str(),
+		        entry.name.c_str(),
+		        entry.time);
+	}
+	return result;
+}
+
 /* Named time sample statistics. */
 
 NamedNestedSampleStats::NamedNestedSampleStats()
@@ -142,6 +213,29 @@ string NamedNestedSampleStats::full_report(int indent_level, uint64_t total_samp
 	return result;
 }
 
+string NamedNestedSampleStats::json_report(uint64_t total_samples)
+{
+	update_sum();
+
+	if(total_samples == 0) {
+		total_samples = sum_samples;
+	}
+
+	const double sum_fraction = (total_samples)? ((double) sum_samples) / total_samples: 0.0;
+	string result = string_printf("{\"name\": %s, \"time\": %.3f, \"self_time\": %.3f, \"fraction\": %.4f, \"entries\": [",
+	                              json_string(name).c_str(),
+	                              sum_samples * 0.001,
+	                              self_samples * 0.001,
+	                              sum_fraction);
+
+	sort(entries.begin(), entries.end(), namedTimeSampleEntryComparator);
+	for(size_t i = 0; i < entries.size(); i++) {
+		result += (i == 0)? "": ", ";
+		result += entries[i].json_report(total_samples);
+	}
+	return result + "]}";
+}
+
 /* Named sample count pairs. */
 
 NamedSampleCountPair::NamedSampleCountPair(const ustring& name, uint64_t samples, uint64_t hits)
@@ -195,6 +289,39 @@ string NamedSampleCountStats::full_report(int indent_level)
 	return result;
 }
 
+string NamedSampleCountStats::json_report()
+{
+	vector<NamedSampleCountPair> sorted_entries;
+	sorted_entries.reserve(entries.size());
+
+	uint64_t total_hits = 0, total_samples = 0;
+	foreach(entry_map::const_reference entry, entries) {
+		const NamedSampleCountPair &pair = entry.second;
+
+		total_hits += pair.hits;
+		total_samples += pair.samples;
+
+		sorted_entries.push_back(pair);
+	}
+	const double avg_samples_per_hit = ((double) total_samples) / total_hits;
+
+	sort(sorted_entries.begin(), sorted_entries.end(), namedSampleCountPairComparator);
+
+	string result = "[";
+	for(size_t i = 0; i < sorted_entries.size(); i++) {
+		const NamedSampleCountPair& entry = sorted_entries[i];
+		const double relative = (entry.hits && total_samples)? ((double) entry.samples) / (entry.hits * avg_samples_per_hit): 0.0;
+
+		result += (i == 0)? "\n    ": ",\n    ";
+		result += string_printf("{\"name\": %s, \"time\": %.3f, \"hits\": %llu, \"relative_cost\": %.3f}",
+		                        json_string(entry.name.string()).c_str(),
+		                        entry.samples * 0.001,
+		                        (unsigned long long) entry.hits,
+		                        relative);
+	}
+	return result + (sorted_entries.size()? "\n  ]": "]");
+}
+
 /* Mesh statistics. */
 
 MeshStats::MeshStats() {
@@ -218,9 +345,37 @@ string ImageStats::full_report(int indent_level)
 	const string indent(indent_level * kIndentNumSpaces, ' ');
 	string result = "";
 	result += indent + "Textures:\n" + textures.full_report(indent_level + 1);
+	if(load_times.entries.size()) {
+		result += indent + "Load Times:\n" + load_times.full_report(indent_level + 1);
+	}
 	return result;
 }
 
+/* Shadow statistics. */
+
+ShadowStats::ShadowStats()
+: shader_evals(0), avoided_shader_evals(0), opaque_rays(0)
+{
+}
+
+string ShadowStats::full_report(int indent_level)
+{
+	const string indent(indent_level * kIndentNumSpaces, ' ');
+	string result = "";
+	result += indent + string_printf("Transparent shader evaluations: %llu\n", (unsigned long long) shader_evals);
+	result += indent + string_printf("Shader evaluations avoided by cache: %llu\n", (unsigned long long) avoided_shader_evals);
+	result += indent + string_printf("Opaque light shadow rays: %llu\n", (unsigned long long) opaque_rays);
+	return result;
+}
+
+string ShadowStats::json_report()
+{
+	return string_printf("{\"shader_evals\": %llu, \"avoided_shader_evals\": %llu, \"opaque_rays\": %llu}",
+	                     (unsigned long long) shader_evals,
+	                     (unsigned long long) avoided_shader_evals,
+	                     (unsigned long long) opaque_rays);
+}
+
 /* Overall statistics. */
 
 RenderStats::RenderStats() {
@@ -275,6 +430,10 @@ void RenderStats::collect_profiling(Scene *scene, Profiler& prof)
 	prefilter.add_entry("Detect Outliers", prof.get_event(PROFILING_DENOISING_DETECT_OUTLIERS));
 	prefilter.add_entry("Combine Halves", prof.get_event(PROFILING_DENOISING_COMBINE_HALVES));
 
+	shadow.shader_evals = prof.get_counter(PROFILING_COUNTER_SHADOW_SHADER_EVAL);
+	shadow.avoided_shader_evals = prof.get_counter(PROFILING_COUNTER_SHADOW_SHADER_CACHED);
+	shadow.opaque_rays = prof.get_counter(PROFILING_COUNTER_SHADOW_OPAQUE_RAY);
+
 	shaders.entries.clear();
 	foreach(Shader *shader, scene->shaders) {
 		uint64_t samples, hits;
@@ -301,6 +460,7 @@ string RenderStats::full_report()
 		result += "Kernel statistics:\n" + kernel.full_report(1);
 		result += "Shader statistics:\n" + shaders.full_report(1);
 		result += "Object statistics:\n" + objects.full_report(1);
+		result += "Shadow statistics:\n" + shadow.full_report(1);
 	}
 	else {
 		result += "Profiling information not available (only works with CPU rendering)";
@@ -308,4 +468,17 @@ string RenderStats::full_report()
 	return result;
 }
 
+string RenderStats::json_report()
+{
+	string result = "{\n";
+	result += string_printf("  \"has_profiling\": %s", has_profiling? "true": "false");
+	if(has_profiling) {
+		result += ",\n  \"kernel\": " + kernel.json_report();
+		result += ",\n  \"shaders\": " + shaders.json_report();
+		result += ",\n  \"objects\": " + objects.json_report();
+		result += ",\n  \"shadow\": " + shadow.json_report();
+	}
+	return result + "\n}\n";
+}
+
 CCL_NAMESPACE_END
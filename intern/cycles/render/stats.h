@@ -64,6 +64,33 @@ public:
 	vector<NamedSizeEntry> entries;
 };
 
+/* Named statistics entry, which corresponds to a time in seconds. */
+class NamedTimeEntry {
+public:
+	NamedTimeEntry();
+	NamedTimeEntry(const string& name, double time);
+
+	string name;
+	double time;
+};
+
+/* Container of named time entries, for example per-image load times. */
+class NamedTimeStats {
+public:
+	NamedTimeStats();
+
+	/* Add entry to the statistics. */
+	void add_entry(const NamedTimeEntry& entry);
+
+	/* Generate full human-readable report. */
+	string full_report(int indent_level = 0);
+
+	/* Sum of all entries. */
+	double total_time;
+
+	vector<NamedTimeEntry> entries;
+};
+
 class NamedNestedSampleStats {
 public:
 	NamedNestedSampleStats();
@@ -75,6 +102,8 @@ public:
 	void update_sum();
 
 	string full_report(int indent_level = 0, uint64_t total_samples = 0);
+	/* Same information as a JSON object, with times in seconds. */
+	string json_report(uint64_t total_samples = 0);
 
 	string name;
 
@@ -103,6 +132,8 @@ public:
 	NamedSampleCountStats();
 
 	string full_report(int indent_level = 0);
+	/* JSON array of the entries, sorted by time. */
+	string json_report();
 	void add(const ustring& name, uint64_t samples, uint64_t hits);
 
 	typedef unordered_map<ustring, NamedSampleCountPair, ustringHash> entry_map;
@@ -133,6 +164,23 @@ public:
 	string full_report(int indent_level = 0);
 
 	NamedSizeStats textures;
+	NamedTimeStats load_times;
+};
+
+/* Shader evaluations done and avoided for shadow rays. */
+class ShadowStats {
+public:
+	ShadowStats();
+
+	/* Generate full human-readable report. */
+	string full_report(int indent_level = 0);
+	string json_report();
+
+	uint64_t shader_evals;
+	/* Transparent hits that reused an earlier evaluation of the path. */
+	uint64_t avoided_shader_evals;
+	/* Rays of lights without transparent shadows. */
+	uint64_t opaque_rays;
 };
 
 /* Render process statistics. */
@@ -143,6 +191,10 @@ public:
 	/* Return full report as string. */
 	string full_report();
 
+	/* Return the profiling statistics as a JSON document, for tools that look
+	 * for the most expensive shaders and objects of a scene. */
+	string json_report();
+
 	/* Collect kernel sampling information from Stats. */
 	void collect_profiling(Scene *scene, Profiler& prof);
 
@@ -153,6 +205,7 @@ public:
 	NamedNestedSampleStats kernel;
 	NamedSampleCountStats shaders;
 	NamedSampleCountStats objects;
+	ShadowStats shadow;
 };
 
 CCL_NAMESPACE_END
@@ -25,7 +25,9 @@
 
 #include "util/util_logging.h"
 #include "util/util_foreach.h"
+#include "util/util_md5.h"
 #include "util/util_progress.h"
+#include "util/util_set.h"
 #include "util/util_task.h"
 
 CCL_NAMESPACE_BEGIN
@@ -33,6 +35,7 @@ CCL_NAMESPACE_BEGIN
 /* Shader Manager */
 
 SVMShaderManager::SVMShaderManager()
+: num_compiled(0), time_compile(0.0)
 {
 }
 
@@ -42,12 +45,78 @@ SVMShaderManager::~SVMShaderManager()
 
 void SVMShaderManager::reset(Scene * /*scene*/)
 {
+	compiled_shaders.clear();
+	layout_shaders.clear();
+}
+
+SVMShaderManager::CompiledShader::CompiledShader()
+: graph(NULL), offset(0), capacity(0), placed(false)
+{
+}
+
+void SVMShaderManager::CompiledShader::store_flags(const Shader *shader)
+{
+	has_surface = shader->has_surface;
+	has_surface_emission = shader->has_surface_emission;
+	has_surface_transparent = shader->has_surface_transparent;
+	has_surface_bssrdf = shader->has_surface_bssrdf;
+	has_bump = shader->has_bump;
+	has_bssrdf_bump = shader->has_bssrdf_bump;
+	has_volume = shader->has_volume;
+	has_displacement = shader->has_displacement;
+	has_surface_spatial_varying = shader->has_surface_spatial_varying;
+	has_surface_transparent_varying = shader->has_surface_transparent_varying;
+	has_volume_spatial_varying = shader->has_volume_spatial_varying;
+	has_object_dependency = shader->has_object_dependency;
+	has_attribute_dependency = shader->has_attribute_dependency;
+	has_integrator_dependency = shader->has_integrator_dependency;
+}
+
+void SVMShaderManager::CompiledShader::restore_flags(Shader *shader) const
+{
+	shader->has_surface = has_surface;
+	shader->has_surface_emission = has_surface_emission;
+	shader->has_surface_transparent = has_surface_transparent;
+	shader->has_surface_bssrdf = has_surface_bssrdf;
+	shader->has_bump = has_bump;
+	shader->has_bssrdf_bump = has_bssrdf_bump;
+	shader->has_volume = has_volume;
+	shader->has_displacement = has_displacement;
+	shader->has_surface_spatial_varying = has_surface_spatial_varying;
+	shader->has_surface_transparent_varying = has_surface_transparent_varying;
+	shader->has_volume_spatial_varying = has_volume_spatial_varying;
+	shader->has_object_dependency = has_object_dependency;
+	shader->has_attribute_dependency = has_attribute_dependency;
+	shader->has_integrator_dependency = has_integrator_dependency;
+}
+
+string SVMShaderManager::shader_hash(Scene *scene, Shader *shader)
+{
+	/* Same scheme as the displacement hash, but over the whole graph. */
+	MD5Hash md5;
+	shader->hash(md5);
+
+	uint8_t background = (shader == scene->default_background);
+	md5.append(&background, sizeof(background));
+
+	foreach(ShaderNode *node, shader->graph->nodes) {
+		node->hash(md5);
+		foreach(ShaderInput *input, node->inputs) {
+			int link_id = (input->link) ? input->link->parent->id : 0;
+			md5.append((uint8_t*)&link_id, sizeof(link_id));
+			if(input->link) {
+				md5.append(input->link->name().string());
+			}
+		}
+	}
+
+	return md5.get_hex();
 }
 
 void SVMShaderManager::device_update_shader(Scene *scene,
                                             Shader *shader,
                                             Progress *progress,
-                                            array<int4> *global_svm_nodes)
+                                            CompiledShader *compiled)
 {
 	if(progress->get_cancel()) {
 		return;
@@ -66,29 +135,63 @@ void SVMShaderManager::device_update_shader(Scene *scene,
 	        << "Shader name: " << shader->name << "\n"
 	        << summary.full_report();
 
+	/* Hash the finalized graph, that is what the program was generated from. */
+	compiled->graph = shader->graph;
+	compiled->hash = shader_hash(scene, shader);
+	compiled->svm_nodes.steal_data(svm_nodes);
+	compiled->store_flags(shader);
+
 	nodes_lock_.lock();
 	if(shader->use_mis && shader->has_surface_emission) {
 		scene->light_manager->need_update = true;
 	}
-
-	/* The copy needs to be done inside the lock, if another thread resizes the array
-	 * while memcpy is running, it'll be copying into possibly invalid/freed ram.
-	 */
-	size_t global_nodes_size = global_svm_nodes->size();
-	global_svm_nodes->resize(global_nodes_size + svm_nodes.size());
-
-	/* Offset local SVM nodes to a global address space. */
-	int4& jump_node = (*global_svm_nodes)[shader->id];
-	jump_node.y = svm_nodes[0].y + global_nodes_size - 1;
-	jump_node.z = svm_nodes[0].z + global_nodes_size - 1;
-	jump_node.w = svm_nodes[0].w + global_nodes_size - 1;
-	/* Copy new nodes to global storage. */
-	memcpy(&(*global_svm_nodes)[global_nodes_size],
-	       &svm_nodes[1],
-	       sizeof(int4) * (svm_nodes.size() - 1));
+	num_compiled++;
+	time_compile += summary.time_total;
 	nodes_lock_.unlock();
 }
 
+void SVMShaderManager::device_update_layout(DeviceScene *dscene, Scene *scene, bool rebuild)
+{
+	if(rebuild) {
+		/* Lay out all programs after the jump table, leaving no slack so the
+		 * array stays as small as with a full recompile. */
+		size_t size = scene->shaders.size();
+		foreach(Shader *shader, scene->shaders) {
+			CompiledShader& compiled = compiled_shaders[shader];
+			compiled.offset = size;
+			compiled.capacity = compiled.svm_nodes.size() - 1;
+			compiled.placed = false;
+			size += compiled.capacity;
+		}
+
+		dscene->svm_nodes.free();
+		dscene->svm_nodes.alloc(size);
+		layout_shaders = scene->shaders;
+	}
+
+	int4 *svm_nodes = dscene->svm_nodes.data();
+
+	foreach(Shader *shader, scene->shaders) {
+		CompiledShader& compiled = compiled_shaders[shader];
+		if(compiled.placed) {
+			continue;
+		}
+
+		/* Offset local SVM nodes to a global address space. */
+		const int4& local_jump = compiled.svm_nodes[0];
+		const int offset = (int)compiled.offset - 1;
+		svm_nodes[shader->id] = make_int4(NODE_SHADER_JUMP,
+		                                  local_jump.y + offset,
+		                                  local_jump.z + offset,
+		                                  local_jump.w + offset);
+		/* Copy nodes into the range of the shader. */
+		memcpy(&svm_nodes[compiled.offset],
+		       &compiled.svm_nodes[1],
+		       sizeof(int4) * (compiled.svm_nodes.size() - 1));
+		compiled.placed = true;
+	}
+}
+
 void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene *scene, Progress& progress)
 {
 	if(!need_update)
@@ -98,28 +201,50 @@ void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene
 
 	double start_time = time_dt();
 
-	/* test if we need to update */
-	device_free(device, dscene, scene);
-
 	/* determine which shaders are in use */
 	device_update_shaders_used(scene);
 
-	/* svm_nodes */
-	array<int4> svm_nodes;
-	size_t i;
-
-	for(i = 0; i < scene->shaders.size(); i++) {
-		svm_nodes.push_back_slow(make_int4(NODE_SHADER_JUMP, 0, 0, 0));
+	/* Forget programs of shaders which were removed from the scene. */
+	set<Shader*> scene_shaders(scene->shaders.begin(), scene->shaders.end());
+	for(map<Shader*, CompiledShader>::iterator it = compiled_shaders.begin();
+	    it != compiled_shaders.end();)
+	{
+		if(scene_shaders.find(it->first) == scene_shaders.end()) {
+			compiled_shaders.erase(it++);
+		}
+		else {
+			++it;
+		}
 	}
 
+	/* Only compile shaders whose graph changed since the last update. Programs
+	 * reference image slots acquired by the nodes of the graph they were
+	 * compiled from, so they are never shared between graph instances. */
+	num_compiled = 0;
+	time_compile = 0.0;
+	int num_reused = 0;
+	bool rebuild = (layout_shaders != scene->shaders) || (dscene->svm_nodes.size() == 0);
+
 	TaskPool task_pool;
 	foreach(Shader *shader, scene->shaders) {
+		CompiledShader& compiled = compiled_shaders[shader];
+		if(!shader->need_update &&
+		   compiled.graph == shader->graph &&
+		   shader->graph->finalized &&
+		   compiled.hash == shader_hash(scene, shader))
+		{
+			compiled.restore_flags(shader);
+			num_reused++;
+			continue;
+		}
+
+		compiled.placed = false;
 		task_pool.push(function_bind(&SVMShaderManager::device_update_shader,
 		                             this,
 		                             scene,
 		                             shader,
 		                             &progress,
-		                             &svm_nodes),
+		                             &compiled),
 		               false);
 	}
 	task_pool.wait_work();
@@ -128,11 +253,20 @@ void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene
 		return;
 	}
 
-	dscene->svm_nodes.steal_data(svm_nodes);
+	/* Programs that outgrew their range force a new layout. */
+	foreach(Shader *shader, scene->shaders) {
+		const CompiledShader& compiled = compiled_shaders[shader];
+		if(compiled.svm_nodes.size() - 1 > compiled.capacity) {
+			rebuild = true;
+		}
+	}
+
+	device_update_layout(dscene, scene, rebuild);
+	/* There is no partial upload of device vectors, so the whole array is
+	 * copied, still skipping the compilation of unchanged shaders. */
 	dscene->svm_nodes.copy_to_device();
 
-	for(i = 0; i < scene->shaders.size(); i++) {
-		Shader *shader = scene->shaders[i];
+	foreach(Shader *shader, scene->shaders) {
 		shader->need_update = false;
 	}
 
@@ -140,6 +274,10 @@ void SVMShaderManager::device_update(Device *device, DeviceScene *dscene, Scene
 
 	need_update = false;
 
+	VLOG(1) << "Shader manager compiled " << num_compiled << " shaders in "
+	        << time_compile << " seconds, reused " << num_reused
+	        << (rebuild ? ", rebuilt" : ", patched") << " node array of "
+	        << dscene->svm_nodes.size() << " nodes.";
 	VLOG(1) << "Shader manager updated "
 	        << scene->shaders.size() << " shaders in "
 	        << time_dt() - start_time << " seconds.";
@@ -150,6 +288,10 @@ void SVMShaderManager::device_free(Device *device, DeviceScene *dscene, Scene *s
 	device_free_common(device, dscene, scene);
 
 	dscene->svm_nodes.free();
+
+	/* Shaders are freed together with the device data. */
+	compiled_shaders.clear();
+	layout_shaders.clear();
 }
 
 /* Graph Compiler */
@@ -516,8 +658,11 @@ void SVMCompiler::generate_closure_node(ShaderNode *node,
 	if(current_type == SHADER_TYPE_SURFACE) {
 		if(node->has_surface_emission())
 			current_shader->has_surface_emission = true;
-		if(node->has_surface_transparent())
+		if(node->has_surface_transparent()) {
 			current_shader->has_surface_transparent = true;
+			if(has_varying_weight(node))
+				current_shader->has_surface_transparent_varying = true;
+		}
 		if(node->has_surface_bssrdf()) {
 			current_shader->has_surface_bssrdf = true;
 			if(node->has_bssrdf_bump())
@@ -529,6 +674,25 @@ void SVMCompiler::generate_closure_node(ShaderNode *node,
 	}
 }
 
+/* Whether the weight of a closure can differ between points of the same
+ * primitive or between rays, from the nodes its inputs depend on. Closure
+ * nodes themselves count as spatially varying because of their normal, which
+ * does not affect the weight. */
+bool SVMCompiler::has_varying_weight(ShaderNode *node)
+{
+	ShaderNodeSet dependencies;
+	foreach(ShaderInput *in, node->inputs) {
+		find_dependencies(dependencies, ShaderNodeSet(), in);
+	}
+
+	foreach(ShaderNode *dependency, dependencies) {
+		if(dependency->has_spatial_varying() || dependency->has_path_state_dependency())
+			return true;
+	}
+
+	return false;
+}
+
 void SVMCompiler::generated_shared_closure_nodes(ShaderNode *root_node,
                                                  ShaderNode *node,
                                                  CompilerState *state,
@@ -832,6 +996,7 @@ void SVMCompiler::compile(Scene *scene,
 	shader->has_volume = false;
 	shader->has_displacement = false;
 	shader->has_surface_spatial_varying = false;
+	shader->has_surface_transparent_varying = false;
 	shader->has_volume_spatial_varying = false;
 	shader->has_object_dependency = false;
 	shader->has_attribute_dependency = false;
@@ -22,6 +22,7 @@
 #include "render/shader.h"
 
 #include "util/util_array.h"
+#include "util/util_map.h"
 #include "util/util_set.h"
 #include "util/util_string.h"
 #include "util/util_thread.h"
@@ -50,13 +51,60 @@ public:
 	void device_free(Device *device, DeviceScene *dscene, Scene *scene);
 
 protected:
+	/* Node program of a shader kept between updates, so only shaders whose
+	 * graph changed are compiled again. Programs are tied to the graph they
+	 * were compiled from since nodes acquire image slots while compiling. */
+	struct CompiledShader {
+		CompiledShader();
+
+		ShaderGraph *graph;
+		/* Hash of the finalized graph and the shader settings it was compiled with. */
+		string hash;
+		/* Jump node followed by the node program. */
+		array<int4> svm_nodes;
+		/* Range of the program in the global svm_nodes array. */
+		size_t offset;
+		size_t capacity;
+		bool placed;
+
+		/* Shader flags set by the compiler. */
+		bool has_surface;
+		bool has_surface_emission;
+		bool has_surface_transparent;
+		bool has_surface_bssrdf;
+		bool has_bump;
+		bool has_bssrdf_bump;
+		bool has_volume;
+		bool has_displacement;
+		bool has_surface_spatial_varying;
+		bool has_surface_transparent_varying;
+		bool has_volume_spatial_varying;
+		bool has_object_dependency;
+		bool has_attribute_dependency;
+		bool has_integrator_dependency;
+
+		void store_flags(const Shader *shader);
+		void restore_flags(Shader *shader) const;
+	};
+
+	map<Shader*, CompiledShader> compiled_shaders;
+	/* Shaders in the order their programs are laid out in svm_nodes. */
+	vector<Shader*> layout_shaders;
+
 	/* Lock used to synchronize threaded nodes compilation. */
 	thread_spin_lock nodes_lock_;
 
+	/* Accumulated compilation statistics of the current update. */
+	int num_compiled;
+	double time_compile;
+
+	static string shader_hash(Scene *scene, Shader *shader);
+
 	void device_update_shader(Scene *scene,
 	                          Shader *shader,
 	                          Progress *progress,
-	                          array<int4> *global_svm_nodes);
+	                          CompiledShader *compiled);
+	void device_update_layout(DeviceScene *dscene, Scene *scene, bool rebuild);
 };
 
 /* Graph Compiler */
@@ -195,6 +243,7 @@ protected:
 	                       ShaderNode *skip_node = NULL);
 	void generate_node(ShaderNode *node, ShaderNodeSet& done);
 	void generate_closure_node(ShaderNode *node, CompilerState *state);
+	bool has_varying_weight(ShaderNode *node);
 	void generated_shared_closure_nodes(ShaderNode *root_node,
 	                                    ShaderNode *node,
 	                                    CompilerState *state,
@@ -18,6 +18,8 @@
 
 #include "util/util_algorithm.h"
 #include "util/util_foreach.h"
+#include "util/util_logging.h"
+#include "util/util_time.h"
 #include "util/util_types.h"
 
 CCL_NAMESPACE_BEGIN
@@ -103,6 +105,10 @@ TileManager::TileManager(bool progressive_, int num_samples_, int2 tile_size_, i
 	background = background_;
 	schedule_denoising = false;
 
+	adaptive_tiles = false;
+	num_workers = 1;
+	min_tile_size = 16;
+
 	range_start_sample = 0;
 	range_num_samples = -1;
 
@@ -153,6 +159,7 @@ void TileManager::reset(BufferParams& params_, int num_samples_)
 	state.resolution_divider = get_divider(params.width, params.height, start_resolution);
 	state.render_tiles.clear();
 	state.denoising_tiles.clear();
+	state.worker_finish_time.clear();
 	device_free();
 }
 
@@ -354,6 +361,16 @@ void TileManager::gen_render_tiles()
 	foreach(Tile& tile, state.tiles) {
 		state.render_tiles[tile.device].push_back(tile.index);
 	}
+
+	if(adaptive_tiles && !state.tiles.empty()) {
+		/* Longest tiles first, so the cheap ones fill the gaps at the end of the pass. */
+		const Tile *tiles = &state.tiles[0];
+		foreach(list<int>& tile_list, state.render_tiles) {
+			tile_list.sort([tiles](const int a, const int b) {
+				return tiles[a].cost * tiles[a].w * tiles[a].h > tiles[b].cost * tiles[b].w * tiles[b].h;
+			});
+		}
+	}
 }
 
 void TileManager::set_tiles()
@@ -364,6 +381,12 @@ void TileManager::set_tiles()
 
 	state.num_tiles = gen_tiles(!background);
 
+	if(adaptive_tiles) {
+		/* Tiles handed out to devices are referenced by pointer, so reserve
+		 * room for the split tiles up front and stop splitting once it's used. */
+		state.tiles.reserve(state.tiles.size() + max(state.num_tiles, 8 * num_workers));
+	}
+
 	state.buffer.width = image_w;
 	state.buffer.height = image_h;
 
@@ -412,6 +435,11 @@ bool TileManager::finish_tile(int index, bool &delete_tile)
 {
 	delete_tile = false;
 
+	Tile& finished_tile = state.tiles[index];
+	if(finished_tile.state == Tile::RENDER) {
+		finished_tile.cost = (time_dt() - finished_tile.start_time) / (finished_tile.w * finished_tile.h);
+	}
+
 	if(progressive) {
 		return true;
 	}
@@ -481,10 +509,101 @@ bool TileManager::next_tile(Tile* &tile, int device)
 
 	int idx = state.render_tiles[logical_device].front();
 	state.render_tiles[logical_device].pop_front();
+
+	if(adaptive_tiles) {
+		split_tile(idx, logical_device);
+	}
+
 	tile = &state.tiles[idx];
+	tile->start_time = time_dt();
 	return true;
 }
 
+/* Halve the tile that is about to be handed out and queue the other half in
+ * front, as long as there are fewer tiles left than workers to render them. */
+void TileManager::split_tile(int index, int logical_device)
+{
+	list<int>& tile_list = state.render_tiles[logical_device];
+
+	/* Denoising relies on the regular tile grid to find neighbors. */
+	if(schedule_denoising || tile_list.size() >= (size_t)num_workers) {
+		return;
+	}
+	if(state.tiles.size() >= state.tiles.capacity()) {
+		return;
+	}
+
+	Tile& tile = state.tiles[index];
+
+	/* Tile already holds samples of previous passes. */
+	if(tile.buffers != NULL) {
+		return;
+	}
+
+	Tile half = tile;
+	half.index = state.tiles.size();
+
+	if(tile.w >= tile.h) {
+		if(tile.w < 2 * min_tile_size) {
+			return;
+		}
+		tile.w /= 2;
+		half.x += tile.w;
+		half.w -= tile.w;
+	}
+	else {
+		if(tile.h < 2 * min_tile_size) {
+			return;
+		}
+		tile.h /= 2;
+		half.y += tile.h;
+		half.h -= tile.h;
+	}
+
+	state.tiles.push_back(half);
+	tile_list.push_front(half.index);
+	state.num_tiles++;
+}
+
+void TileManager::worker_finished(int worker)
+{
+	if((size_t)worker >= state.worker_finish_time.size()) {
+		state.worker_finish_time.resize(worker + 1, -1.0);
+	}
+	/* Workers may ask for a tile again after failing, keep the first time. */
+	if(state.worker_finish_time[worker] < 0.0) {
+		state.worker_finish_time[worker] = time_dt();
+	}
+}
+
+void TileManager::report_idle_time()
+{
+	if(state.worker_finish_time.empty()) {
+		return;
+	}
+
+	const double end_time = time_dt();
+	double total_idle = 0.0, max_idle = 0.0;
+	int num_finished = 0;
+
+	for(size_t i = 0; i < state.worker_finish_time.size(); i++) {
+		if(state.worker_finish_time[i] < 0.0) {
+			continue;
+		}
+		const double idle = end_time - state.worker_finish_time[i];
+		VLOG(2) << "Worker " << i << " idle for " << idle << "s at the end of the pass.";
+		total_idle += idle;
+		max_idle = max(max_idle, idle);
+		num_finished++;
+	}
+
+	VLOG(1) << "Pass idle time over " << num_finished << " workers: "
+	        << total_idle << "s total, " << max_idle << "s max, "
+	        << state.num_tiles << " tiles.";
+
+	state.worker_finish_time.clear();
+}
+
 bool TileManager::done()
 {
 	int end_sample = (range_num_samples == -1)
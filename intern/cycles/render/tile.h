@@ -40,11 +40,17 @@ public:
 	State state;
 	RenderBuffers *buffers;
 
+	/* Render time per pixel measured the last time this tile was rendered,
+	 * zero while unknown. Used to order and split tiles of following passes. */
+	double cost;
+	double start_time;
+
 	Tile()
 	{}
 
 	Tile(int index_, int x_, int y_, int w_, int h_, int device_, State state_ = RENDER)
-	: index(index_), x(x_), y(y_), w(w_), h(h_), device(device_), state(state_), buffers(NULL) {}
+	: index(index_), x(x_), y(y_), w(w_), h(h_), device(device_), state(state_), buffers(NULL),
+	  cost(0.0), start_time(0.0) {}
 };
 
 /* Tile order */
@@ -83,6 +89,10 @@ public:
 		 * Each list in each vector is for one logical device. */
 		vector<list<int> > render_tiles;
 		vector<list<int> > denoising_tiles;
+
+		/* Time at which each worker found no more tiles in the current pass,
+		 * indexed by worker, negative for workers which didn't finish yet. */
+		vector<double> worker_finish_time;
 	} state;
 
 	int num_samples;
@@ -114,9 +124,30 @@ public:
 
 	/* Schedule tiles for denoising after they've been rendered. */
 	bool schedule_denoising;
+
+	/* ** Adaptive tile scheduling. ** */
+
+	/* Split tiles in halves once fewer tiles than workers are left in a pass,
+	 * and hand out the most expensive tiles of the previous pass first. */
+	bool adaptive_tiles;
+
+	/* Number of threads acquiring tiles, decides when to start splitting. */
+	int num_workers;
+
+	/* Tiles are not split below this size in pixels. */
+	int min_tile_size;
+
+	/* Called when a worker found no tile to render, the worker stays idle
+	 * until the whole pass is finished. Workers are the logical devices
+	 * acquiring tiles, as returned by Device::device_number(). */
+	void worker_finished(int worker);
+
+	/* Log how long every worker was idle at the end of the pass. */
+	void report_idle_time();
 protected:
 
 	void set_tiles();
+	void split_tile(int index, int logical_device);
 
 	bool progressive;
 	int2 tile_size;
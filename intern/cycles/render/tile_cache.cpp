@@ -0,0 +1,316 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/tile_cache.h"
+
+#include "device/device.h"
+
+#include "util/util_foreach.h"
+#include "util/util_logging.h"
+#include "util/util_path.h"
+
+#include <OpenImageIO/filesystem.h>
+
+CCL_NAMESPACE_BEGIN
+
+/* Tile Buffer Cache */
+
+TileBufferCache::TileBufferCache()
+: peak_resident_size(0), num_spilled(0), num_restored(0), memory_budget(0)
+{
+}
+
+TileBufferCache::~TileBufferCache()
+{
+	clear();
+}
+
+void TileBufferCache::reset(const string& directory_, size_t memory_budget_)
+{
+	clear();
+
+	directory = directory_;
+	prefix = ".cycles-tile-" + OIIO::Filesystem::unique_path() + "-";
+	memory_budget = memory_budget_;
+}
+
+void TileBufferCache::clear()
+{
+	for(size_t i = 0; i < entries.size(); i++) {
+		if(entries[i].spilled) {
+			path_remove(spill_filepath(i));
+		}
+	}
+
+	if(num_spilled) {
+		VLOG(1) << "Tile buffer cache: spilled " << num_spilled << " tiles, restored " << num_restored
+		        << ", peak resident size " << string_human_readable_size(peak_resident_size) << ".";
+	}
+
+	entries.clear();
+	peak_resident_size = 0;
+	num_spilled = 0;
+	num_restored = 0;
+}
+
+TileBufferCache::Entry& TileBufferCache::entry(int index)
+{
+	/* Tiles are created when the tile manager starts a pass. */
+	if(index >= (int)entries.size()) {
+		entries.resize(index + 1);
+	}
+	return entries[index];
+}
+
+void TileBufferCache::pin(int index)
+{
+	entry(index).users++;
+}
+
+void TileBufferCache::unpin(int index)
+{
+	assert(entry(index).users > 0);
+	entry(index).users--;
+}
+
+string TileBufferCache::spill_filepath(int index)
+{
+	return path_join(directory, prefix + string_printf("%d", index));
+}
+
+size_t TileBufferCache::resident_size(vector<Tile>& tiles)
+{
+	size_t size = 0;
+	foreach(Tile& tile, tiles) {
+		if(tile.buffers) {
+			size += tile.buffers->buffer.memory_size();
+		}
+	}
+	return size;
+}
+
+bool TileBufferCache::spill(Tile& tile)
+{
+	RenderBuffers *buffers = tile.buffers;
+	buffers->copy_from_device();
+
+	string filepath = spill_filepath(tile.index);
+	FILE *f = path_fopen(filepath, "wb");
+	if(!f) {
+		return false;
+	}
+
+	size_t size = buffers->buffer.memory_size();
+	bool ok = fwrite(buffers->buffer.data(), 1, size, f) == size;
+	fclose(f);
+
+	if(!ok) {
+		path_remove(filepath);
+		return false;
+	}
+
+	Entry& tile_entry = entry(tile.index);
+	tile_entry.params = buffers->params;
+	tile_entry.spilled = true;
+
+	delete buffers;
+	tile.buffers = NULL;
+	num_spilled++;
+
+	return true;
+}
+
+void TileBufferCache::evict(vector<Tile>& tiles)
+{
+	size_t size = resident_size(tiles);
+	peak_resident_size = max(peak_resident_size, size);
+
+	if(memory_budget == 0 || size <= memory_budget) {
+		return;
+	}
+
+	/* Tiles that were denoised only wait for neighbors to finish, spill those
+	 * first since tiles that still have to be denoised are read again sooner. */
+	for(int pass = 0; pass < 2 && size > memory_budget; pass++) {
+		Tile::State state = (pass == 0)? Tile::DENOISED: Tile::RENDERED;
+
+		foreach(Tile& tile, tiles) {
+			if(size <= memory_budget) {
+				break;
+			}
+			if(tile.state != state || !tile.buffers || entry(tile.index).users) {
+				continue;
+			}
+
+			size_t tile_size = tile.buffers->buffer.memory_size();
+			if(!spill(tile)) {
+				VLOG(1) << "Failed to spill tile " << tile.index << " to " << directory << ".";
+				return;
+			}
+			size -= tile_size;
+		}
+	}
+}
+
+bool TileBufferCache::restore(Tile& tile, Device *device)
+{
+	Entry& tile_entry = entry(tile.index);
+	if(tile.buffers || !tile_entry.spilled) {
+		return tile.buffers != NULL;
+	}
+
+	string filepath = spill_filepath(tile.index);
+	size_t size;
+	void *data = path_map_file(filepath, &size);
+	if(!data) {
+		return false;
+	}
+
+	RenderBuffers *buffers = new RenderBuffers(device);
+	buffers->reset(tile_entry.params);
+
+	bool ok = (size == buffers->buffer.memory_size());
+	if(ok) {
+		memcpy(buffers->buffer.data(), data, size);
+		buffers->buffer.copy_to_device();
+	}
+
+	path_unmap_file(data, size);
+
+	if(!ok) {
+		delete buffers;
+		return false;
+	}
+
+	path_remove(filepath);
+	tile_entry.spilled = false;
+	tile.buffers = buffers;
+	num_restored++;
+
+	return true;
+}
+
+void TileBufferCache::release_done(vector<Tile>& tiles)
+{
+	foreach(Tile& tile, tiles) {
+		Entry& tile_entry = entry(tile.index);
+		if(tile.state == Tile::DONE && tile_entry.spilled) {
+			path_remove(spill_filepath(tile.index));
+			tile_entry.spilled = false;
+		}
+	}
+}
+
+/* Tile Image Writer */
+
+TileImageWriter::TileImageWriter()
+: out(NULL), width(0), height(0), tile_size(make_int2(0, 0))
+{
+}
+
+TileImageWriter::~TileImageWriter()
+{
+	close();
+}
+
+bool TileImageWriter::open(const string& filepath_, int width_, int height_, int2 tile_size_)
+{
+	close();
+
+	filepath = filepath_;
+	width = width_;
+	height = height_;
+	tile_size = tile_size_;
+
+	out = ImageOutput::create(filepath);
+	if(!out) {
+		VLOG(1) << "Failed to create image output for " << filepath << ".";
+		return false;
+	}
+	if(!out->supports("tiles")) {
+		VLOG(1) << "Image format of " << filepath << " doesn't support tiles.";
+		delete out;
+		out = NULL;
+		return false;
+	}
+
+	/* Cycles tiles are aligned to the bottom of the image while EXR tiles are
+	 * aligned to the top of the data window, so the data window extends above
+	 * the image by the part of the topmost tile row that is outside of it. */
+	int pad_y = (tile_size.y - height % tile_size.y) % tile_size.y;
+
+	ImageSpec spec(width, height + pad_y, 4, TypeDesc::FLOAT);
+	spec.y = -pad_y;
+	spec.full_x = 0;
+	spec.full_y = 0;
+	spec.full_width = width;
+	spec.full_height = height;
+	spec.tile_width = tile_size.x;
+	spec.tile_height = tile_size.y;
+	spec.attribute("openexr:lineOrder", "randomY");
+	spec.attribute("compression", "zip");
+
+	if(!out->open(filepath, spec)) {
+		VLOG(1) << "Failed to open " << filepath << ": " << out->geterror();
+		delete out;
+		out = NULL;
+		return false;
+	}
+
+	tile_pixels.resize(tile_size.x*tile_size.y*4);
+
+	return true;
+}
+
+bool TileImageWriter::write_tile(RenderTile& rtile, int x, int y, float exposure)
+{
+	if(!out || !rtile.buffers) {
+		return false;
+	}
+
+	RenderBuffers *buffers = rtile.buffers;
+	buffers->copy_from_device();
+
+	int w = buffers->params.width;
+	int h = buffers->params.height;
+	pixels.resize(w*h*4);
+	if(!buffers->get_pass_rect(PASS_COMBINED, exposure, rtile.sample, 4, &pixels[0], "Combined")) {
+		return false;
+	}
+
+	/* Flip rows into the top-down EXR tile, rows outside of the image stay zero. */
+	std::fill(tile_pixels.begin(), tile_pixels.end(), 0.0f);
+	for(int row = 0; row < tile_size.y; row++) {
+		int src_row = tile_size.y - 1 - row;
+		if(src_row < h) {
+			memcpy(&tile_pixels[row*tile_size.x*4], &pixels[src_row*w*4], sizeof(float)*w*4);
+		}
+	}
+
+	return out->write_tile(x, height - y - tile_size.y, 0, TypeDesc::FLOAT, &tile_pixels[0]);
+}
+
+void TileImageWriter::close()
+{
+	if(out) {
+		out->close();
+		delete out;
+		out = NULL;
+		VLOG(1) << "Finished writing " << filepath << ".";
+	}
+}
+
+CCL_NAMESPACE_END
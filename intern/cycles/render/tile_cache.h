@@ -0,0 +1,113 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TILE_CACHE_H__
+#define __TILE_CACHE_H__
+
+#include "render/buffers.h"
+#include "render/tile.h"
+
+#include "util/util_image.h"
+#include "util/util_string.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class Device;
+
+/* Tile Buffer Cache
+ *
+ * Bounds the memory used by per-tile render buffers during out-of-core
+ * rendering. Tiles that are only kept because neighbors still need them for
+ * denoising are written to a scratch file once the resident buffers exceed
+ * the budget, and memory mapped back in when they are needed again. */
+
+class TileBufferCache {
+public:
+	TileBufferCache();
+	~TileBufferCache();
+
+	/* A budget of zero disables spilling. */
+	void reset(const string& directory, size_t memory_budget);
+	void clear();
+
+	/* Tiles mapped for denoising a neighbor must stay resident. */
+	void pin(int index);
+	void unpin(int index);
+
+	/* Spill tiles that wait for their neighbors until the resident buffers fit
+	 * into the budget. */
+	void evict(vector<Tile>& tiles);
+	/* Bring the buffers of a spilled tile back, no-op if it is resident. */
+	bool restore(Tile& tile, Device *device);
+	/* Remove the scratch files of tiles that are done. */
+	void release_done(vector<Tile>& tiles);
+
+	size_t resident_size(vector<Tile>& tiles);
+
+	size_t peak_resident_size;
+	int num_spilled;
+	int num_restored;
+
+protected:
+	struct Entry {
+		Entry() : users(0), spilled(false) {}
+
+		int users;
+		bool spilled;
+		BufferParams params;
+	};
+
+	Entry& entry(int index);
+	string spill_filepath(int index);
+	bool spill(Tile& tile);
+
+	string directory;
+	string prefix;
+	size_t memory_budget;
+	vector<Entry> entries;
+};
+
+/* Tile Image Writer
+ *
+ * Streams the combined pass of finished tiles into a tiled EXR file, so the
+ * full frame never has to be in memory. Tiles are written in random order. */
+
+class TileImageWriter {
+public:
+	TileImageWriter();
+	~TileImageWriter();
+
+	bool open(const string& filepath, int width, int height, int2 tile_size);
+	/* x and y are relative to the image, in Cycles' bottom-up convention. */
+	bool write_tile(RenderTile& rtile, int x, int y, float exposure);
+	void close();
+
+	bool is_open() { return out != NULL; }
+
+protected:
+	ImageOutput *out;
+	string filepath;
+	int width, height;
+	int2 tile_size;
+	vector<float> pixels;
+	vector<float> tile_pixels;
+};
+
+CCL_NAMESPACE_END
+
+#endif  /* __TILE_CACHE_H__ */
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render/mesh.h"
+
+#include "subd/subd_cache.h"
+#include "subd/subd_patch.h"
+#include "subd/subd_split.h"
+
+#include "util/util_logging.h"
+#include "util/util_md5.h"
+
+CCL_NAMESPACE_BEGIN
+
+template<typename T>
+static void copy_range(array<T>& to, const T *from, size_t size)
+{
+	to.resize(size);
+	if(size) {
+		memcpy(to.data(), from, sizeof(T)*size);
+	}
+}
+
+template<typename T>
+static void md5_append_array(MD5Hash& md5, const array<T>& data)
+{
+	if(data.size()) {
+		md5.append((const uint8_t*)data.data(), sizeof(T)*data.size());
+	}
+}
+
+template<typename T>
+static void md5_append_value(MD5Hash& md5, const T& value)
+{
+	md5.append((const uint8_t*)&value, sizeof(T));
+}
+
+SubdDiceCache::SubdDiceCache()
+: num_hits(0), num_misses(0)
+{
+}
+
+string SubdDiceCache::mesh_hash(Mesh *mesh)
+{
+	const SubdParams& params = *mesh->subd_params;
+	MD5Hash md5;
+
+	md5_append_array(md5, mesh->verts);
+	md5_append_array(md5, mesh->subd_face_corners);
+	md5_append_array(md5, mesh->subd_creases);
+
+	/* Field by field, the struct has padding. */
+	for(size_t i = 0; i < mesh->subd_faces.size(); i++) {
+		const Mesh::SubdFace& face = mesh->subd_faces[i];
+		md5_append_value(md5, face.start_corner);
+		md5_append_value(md5, face.num_corners);
+		md5_append_value(md5, face.shader);
+		md5_append_value(md5, face.smooth);
+		md5_append_value(md5, face.ptex_offset);
+	}
+
+	Attribute *attr_vN = mesh->subd_attributes.find(ATTR_STD_VERTEX_NORMAL);
+	if(attr_vN) {
+		md5.append((const uint8_t*)attr_vN->data(), attr_vN->buffer.size());
+	}
+
+	md5_append_value(md5, mesh->subdivision_type);
+	md5_append_value(md5, mesh->num_triangles());
+	md5_append_value(md5, params.ptex);
+	md5_append_value(md5, params.test_steps);
+	md5_append_value(md5, params.split_threshold);
+	md5_append_value(md5, params.max_level);
+
+	return md5.get_hex();
+}
+
+bool SubdDiceCache::edge_factors_match(const DiagSplit& split)
+{
+	size_t num_subpatches = split.subpatches_quad.size();
+	if(num_subpatches != patch_index.size()) {
+		return false;
+	}
+
+	float tolerance = split.params.dice_cache_tolerance;
+
+	for(size_t i = 0; i < num_subpatches; i++) {
+		if(split.subpatches_quad[i].patch->patch_index != patch_index[i]) {
+			return false;
+		}
+
+		const QuadDice::EdgeFactors& a = split.edgefactors_quad[i];
+		const QuadDice::EdgeFactors& b = edge_factors[i];
+		int ta[4] = {a.tu0, a.tu1, a.tv0, a.tv1};
+		int tb[4] = {b.tu0, b.tu1, b.tv0, b.tv1};
+
+		for(int j = 0; j < 4; j++) {
+			/* Factors are clamped to at least one segment when dicing. */
+			int t0 = max(ta[j], 1);
+			int t1 = max(tb[j], 1);
+
+			if(t0 != t1 && abs(t0 - t1) > tolerance * max(t0, t1)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool SubdDiceCache::restore(Mesh *mesh, const string& hash_, const DiagSplit& split)
+{
+	if(hash_ != hash || !edge_factors_match(split)) {
+		num_misses++;
+		VLOG(2) << "Dice cache miss for mesh " << mesh->name << ".";
+		return false;
+	}
+
+	size_t vert_offset = mesh->verts.size();
+	size_t tri_offset = mesh->num_triangles();
+	size_t num_verts = verts.size();
+	size_t num_tris = shader.size();
+
+	mesh->resize_mesh(vert_offset + num_verts, tri_offset + num_tris);
+	mesh->num_subd_verts += num_verts;
+
+	Attribute *attr_vN = mesh->attributes.add(ATTR_STD_VERTEX_NORMAL);
+
+	memcpy(mesh->verts.data() + vert_offset, verts.data(), sizeof(float3)*num_verts);
+	memcpy(attr_vN->data_float3() + vert_offset, vN.data(), sizeof(float3)*num_verts);
+	memcpy(mesh->vert_patch_uv.data() + vert_offset, vert_patch_uv.data(), sizeof(float2)*num_verts);
+	memcpy(mesh->triangles.data() + tri_offset*3, triangles.data(), sizeof(int)*num_tris*3);
+	memcpy(mesh->shader.data() + tri_offset, shader.data(), sizeof(int)*num_tris);
+	memcpy(mesh->smooth.data() + tri_offset, smooth.data(), sizeof(bool)*num_tris);
+	memcpy(mesh->triangle_patch.data() + tri_offset, triangle_patch.data(), sizeof(int)*num_tris);
+
+	if(split.params.ptex) {
+		Attribute *attr_ptex_uv = mesh->attributes.add(ATTR_STD_PTEX_UV);
+		Attribute *attr_ptex_face_id = mesh->attributes.add(ATTR_STD_PTEX_FACE_ID);
+
+		memcpy(attr_ptex_uv->data_float3() + vert_offset, ptex_uv.data(), sizeof(float3)*num_verts);
+		memcpy(attr_ptex_face_id->data_float() + tri_offset, ptex_face_id.data(), sizeof(float)*num_tris);
+	}
+
+	num_hits++;
+	VLOG(1) << "Reusing diced geometry of mesh " << mesh->name << ", "
+	        << num_verts << " vertices, " << num_tris << " triangles.";
+
+	return true;
+}
+
+void SubdDiceCache::store(Mesh *mesh, const string& hash_, const DiagSplit& split,
+                          size_t vert_offset, size_t tri_offset)
+{
+	size_t num_verts = mesh->verts.size() - vert_offset;
+	size_t num_tris = mesh->num_triangles() - tri_offset;
+
+	hash = hash_;
+
+	patch_index.resize(split.subpatches_quad.size());
+	for(size_t i = 0; i < split.subpatches_quad.size(); i++) {
+		patch_index[i] = split.subpatches_quad[i].patch->patch_index;
+	}
+	edge_factors = split.edgefactors_quad;
+
+	Attribute *attr_vN = mesh->attributes.find(ATTR_STD_VERTEX_NORMAL);
+
+	copy_range(verts, mesh->verts.data() + vert_offset, num_verts);
+	copy_range(vN, attr_vN->data_float3() + vert_offset, num_verts);
+	copy_range(vert_patch_uv, mesh->vert_patch_uv.data() + vert_offset, num_verts);
+	copy_range(triangles, mesh->triangles.data() + tri_offset*3, num_tris*3);
+	copy_range(shader, mesh->shader.data() + tri_offset, num_tris);
+	copy_range(smooth, mesh->smooth.data() + tri_offset, num_tris);
+	copy_range(triangle_patch, mesh->triangle_patch.data() + tri_offset, num_tris);
+
+	if(split.params.ptex) {
+		Attribute *attr_ptex_uv = mesh->attributes.find(ATTR_STD_PTEX_UV);
+		Attribute *attr_ptex_face_id = mesh->attributes.find(ATTR_STD_PTEX_FACE_ID);
+
+		copy_range(ptex_uv, attr_ptex_uv->data_float3() + vert_offset, num_verts);
+		copy_range(ptex_face_id, attr_ptex_face_id->data_float() + tri_offset, num_tris);
+	}
+	else {
+		ptex_uv.clear();
+		ptex_face_id.clear();
+	}
+}
+
+void SubdDiceCache::clear()
+{
+	hash = "";
+	patch_index.clear();
+	edge_factors.clear();
+
+	verts.clear();
+	vN.clear();
+	vert_patch_uv.clear();
+	ptex_uv.clear();
+	triangles.clear();
+	shader.clear();
+	smooth.clear();
+	triangle_patch.clear();
+	ptex_face_id.clear();
+}
+
+CCL_NAMESPACE_END
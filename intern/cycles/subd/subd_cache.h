@@ -0,0 +1,78 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SUBD_CACHE_H__
+#define __SUBD_CACHE_H__
+
+/* Dice Cache
+ *
+ * Keeps the diced geometry of a mesh across tessellations, so that small
+ * changes of the dicing camera don't dice the whole mesh again. Geometry is
+ * only reused for the mesh as a whole, reusing it for some of the patches
+ * would leave cracks along edges shared with freshly diced patches. */
+
+#include "subd/subd_dice.h"
+
+#include "util/util_array.h"
+#include "util/util_string.h"
+#include "util/util_types.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+class DiagSplit;
+class Mesh;
+
+class SubdDiceCache {
+public:
+	SubdDiceCache();
+
+	/* Hash of everything that affects dicing apart from the edge factors,
+	 * computed from the mesh before it is tessellated. */
+	static string mesh_hash(Mesh *mesh);
+
+	/* Add the cached geometry to the mesh if the hash matches and the split
+	 * produced the same subpatches with edge factors within tolerance. */
+	bool restore(Mesh *mesh, const string& hash, const DiagSplit& split);
+	/* Remember the geometry diced from the split, starting at the offsets. */
+	void store(Mesh *mesh, const string& hash, const DiagSplit& split,
+	           size_t vert_offset, size_t tri_offset);
+	void clear();
+
+	int num_hits;
+	int num_misses;
+
+protected:
+	bool edge_factors_match(const DiagSplit& split);
+
+	string hash;
+	vector<int> patch_index;
+	vector<QuadDice::EdgeFactors> edge_factors;
+
+	array<float3> verts;
+	array<float3> vN;
+	array<float2> vert_patch_uv;
+	array<float3> ptex_uv;
+	array<int> triangles;
+	array<int> shader;
+	array<bool> smooth;
+	array<int> triangle_patch;
+	array<float> ptex_face_id;
+};
+
+CCL_NAMESPACE_END
+
+#endif  /* __SUBD_CACHE_H__ */
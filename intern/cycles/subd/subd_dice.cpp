@@ -29,7 +29,15 @@ EdgeDice::EdgeDice(const SubdParams& params_)
 {
 	mesh_P = NULL;
 	mesh_N = NULL;
+	mesh_patch_uv = NULL;
+	mesh_ptex_uv = NULL;
+	mesh_triangles = NULL;
+	mesh_shader = NULL;
+	mesh_smooth = NULL;
+	mesh_triangle_patch = NULL;
+	mesh_ptex_face_id = NULL;
 	vert_offset = 0;
+	tri_offset = 0;
 
 	params.mesh->attributes.add(ATTR_STD_VERTEX_NORMAL);
 
@@ -39,24 +47,30 @@ EdgeDice::EdgeDice(const SubdParams& params_)
 	}
 }
 
-void EdgeDice::reserve(int num_verts)
+void EdgeDice::reserve(size_t num_verts, size_t num_tris)
 {
 	Mesh *mesh = params.mesh;
 
 	vert_offset = mesh->verts.size();
 	tri_offset = mesh->num_triangles();
 
-	/* todo: optimize so we can reserve in advance, this is like push_back_slow() */
-	if(vert_offset + num_verts > mesh->verts.capacity()) {
-		mesh->reserve_mesh(size_t((vert_offset + num_verts) * 1.2), mesh->num_triangles());
-	}
-
-	mesh->resize_mesh(vert_offset + num_verts, tri_offset);
+	mesh->resize_mesh(vert_offset + num_verts, tri_offset + num_tris);
+	mesh->num_subd_verts += num_verts;
 
 	Attribute *attr_vN = mesh->attributes.add(ATTR_STD_VERTEX_NORMAL);
 
 	mesh_P = mesh->verts.data();
 	mesh_N = attr_vN->data_float3();
+	mesh_patch_uv = mesh->vert_patch_uv.data();
+	mesh_triangles = mesh->triangles.data();
+	mesh_shader = mesh->shader.data();
+	mesh_smooth = mesh->smooth.data();
+	mesh_triangle_patch = mesh->triangle_patch.data();
+
+	if(params.ptex) {
+		mesh_ptex_uv = mesh->attributes.add(ATTR_STD_PTEX_UV)->data_float3();
+		mesh_ptex_face_id = mesh->attributes.add(ATTR_STD_PTEX_FACE_ID)->data_float();
+	}
 }
 
 int EdgeDice::add_vert(Patch *patch, float2 uv)
@@ -69,38 +83,28 @@ int EdgeDice::add_vert(Patch *patch, float2 uv)
 
 	mesh_P[vert_offset] = P;
 	mesh_N[vert_offset] = N;
-	params.mesh->vert_patch_uv[vert_offset] = make_float2(uv.x, uv.y);
+	mesh_patch_uv[vert_offset] = make_float2(uv.x, uv.y);
 
 	if(params.ptex) {
-		Attribute *attr_ptex_uv = params.mesh->attributes.add(ATTR_STD_PTEX_UV);
-		params.mesh->attributes.resize();
-
-		float3 *ptex_uv = attr_ptex_uv->data_float3();
-		ptex_uv[vert_offset] = make_float3(uv.x, uv.y, 0.0f);
+		mesh_ptex_uv[vert_offset] = make_float3(uv.x, uv.y, 0.0f);
 	}
 
-	params.mesh->num_subd_verts++;
-
 	return vert_offset++;
 }
 
 void EdgeDice::add_triangle(Patch *patch, int v0, int v1, int v2)
 {
-	Mesh *mesh = params.mesh;
+	assert(tri_offset < params.mesh->num_triangles());
 
-	/* todo: optimize so we can reserve in advance, this is like push_back_slow() */
-	if(mesh->triangles.size() == mesh->triangles.capacity())
-		mesh->reserve_mesh(mesh->verts.size(), size_t(max(mesh->num_triangles() + 1, 1) * 1.2));
-
-	mesh->add_triangle(v0, v1, v2, patch->shader, true);
-	params.mesh->triangle_patch[params.mesh->num_triangles()-1] = patch->patch_index;
+	mesh_triangles[tri_offset*3 + 0] = v0;
+	mesh_triangles[tri_offset*3 + 1] = v1;
+	mesh_triangles[tri_offset*3 + 2] = v2;
+	mesh_shader[tri_offset] = patch->shader;
+	mesh_smooth[tri_offset] = true;
+	mesh_triangle_patch[tri_offset] = patch->patch_index;
 
 	if(params.ptex) {
-		Attribute *attr_ptex_face_id = params.mesh->attributes.add(ATTR_STD_PTEX_FACE_ID);
-		params.mesh->attributes.resize();
-
-		float *ptex_face_id = attr_ptex_face_id->data_float();
-		ptex_face_id[tri_offset] = (float)patch->ptex_face_id();
+		mesh_ptex_face_id[tri_offset] = (float)patch->ptex_face_id();
 	}
 
 	tri_offset++;
@@ -150,11 +154,34 @@ QuadDice::QuadDice(const SubdParams& params_)
 {
 }
 
-void QuadDice::reserve(EdgeFactors& ef, int Mu, int Mv)
+void QuadDice::grid_size(const EdgeFactors& ef, int *Mu, int *Mv)
+{
+	/* compute inner grid size with scale factor */
+	*Mu = max(ef.tu0, ef.tu1);
+	*Mv = max(ef.tv0, ef.tv1);
+
+#if 0 /* Doesnt work very well, especially at grazing angles. */
+	float S = scale_factor(sub, ef, Mu, Mv);
+#else
+	float S = 1.0f;
+#endif
+
+	*Mu = max((int)ceil(S * *Mu), 2); // XXX handle 0 & 1?
+	*Mv = max((int)ceil(S * *Mv), 2); // XXX handle 0 & 1?
+}
+
+void QuadDice::count(const EdgeFactors& ef, int *num_verts, int *num_tris)
 {
 	/* XXX need to make this also work for edge factor 0 and 1 */
-	int num_verts = (ef.tu0 + ef.tu1 + ef.tv0 + ef.tv1) + (Mu - 1)*(Mv - 1);
-	EdgeDice::reserve(num_verts);
+	int Mu, Mv;
+	grid_size(ef, &Mu, &Mv);
+
+	/* Corners, edges and inner grid. */
+	*num_verts = (ef.tu0 + ef.tu1 + ef.tv0 + ef.tv1) + (Mu - 1)*(Mv - 1);
+	/* Inner grid, and stitching of every side to the grid. */
+	*num_tris = 2*(Mu - 2)*(Mv - 2) +
+	            (ef.tu0 + ef.tu1 + 2*(Mu - 2)) +
+	            (ef.tv0 + ef.tv1 + 2*(Mv - 2));
 }
 
 float2 QuadDice::map_uv(SubPatch& sub, float u, float v)
@@ -303,24 +330,15 @@ void QuadDice::add_grid(SubPatch& sub, int Mu, int Mv, int offset)
 	}
 }
 
-void QuadDice::dice(SubPatch& sub, EdgeFactors& ef)
+void QuadDice::dice(SubPatch& sub, EdgeFactors& ef, size_t vert_offset_, size_t tri_offset_)
 {
-	/* compute inner grid size with scale factor */
-	int Mu = max(ef.tu0, ef.tu1);
-	int Mv = max(ef.tv0, ef.tv1);
+	int Mu, Mv;
+	grid_size(ef, &Mu, &Mv);
 
-#if 0 /* Doesnt work very well, especially at grazing angles. */
-	float S = scale_factor(sub, ef, Mu, Mv);
-#else
-	float S = 1.0f;
-#endif
-
-	Mu = max((int)ceil(S*Mu), 2); // XXX handle 0 & 1?
-	Mv = max((int)ceil(S*Mv), 2); // XXX handle 0 & 1?
-
-	/* reserve space for new verts */
-	int offset = params.mesh->verts.size();
-	reserve(ef, Mu, Mv);
+	/* verts and triangles were reserved in advance */
+	int offset = vert_offset_;
+	vert_offset = vert_offset_;
+	tri_offset = tri_offset_;
 
 	/* corners and inner grid */
 	add_corners(sub);
@@ -344,7 +362,12 @@ void QuadDice::dice(SubPatch& sub, EdgeFactors& ef)
 	add_side_v(sub, outer, inner, Mu, Mv, ef.tv1, 1, offset);
 	stitch_triangles(sub.patch, outer, inner);
 
-	assert(vert_offset == params.mesh->verts.size());
+#ifndef NDEBUG
+	int num_verts, num_tris;
+	count(ef, &num_verts, &num_tris);
+	assert(vert_offset == vert_offset_ + num_verts);
+	assert(tri_offset == tri_offset_ + num_tris);
+#endif
 }
 
 CCL_NAMESPACE_END
@@ -42,6 +42,11 @@ struct SubdParams {
 	Camera *camera;
 	Transform objecttoworld;
 
+	/* Reuse diced geometry from the previous tessellation when no edge factor
+	 * changed by more than this fraction. */
+	bool use_dice_cache;
+	float dice_cache_tolerance;
+
 	SubdParams(Mesh *mesh_, bool ptex_ = false)
 	{
 		mesh = mesh_;
@@ -52,6 +57,9 @@ struct SubdParams {
 		dicing_rate = 1.0f;
 		max_level = 12;
 		camera = NULL;
+
+		use_dice_cache = true;
+		dice_cache_tolerance = 0.1f;
 	}
 
 };
@@ -63,12 +71,21 @@ public:
 	SubdParams params;
 	float3 *mesh_P;
 	float3 *mesh_N;
+	float2 *mesh_patch_uv;
+	float3 *mesh_ptex_uv;
+	int *mesh_triangles;
+	int *mesh_shader;
+	bool *mesh_smooth;
+	int *mesh_triangle_patch;
+	float *mesh_ptex_face_id;
 	size_t vert_offset;
 	size_t tri_offset;
 
 	explicit EdgeDice(const SubdParams& params);
 
-	void reserve(int num_verts);
+	/* Grow the mesh once for all patches, copies of the dicer then write their
+	 * patches into disjoint ranges of it from multiple threads. */
+	void reserve(size_t num_verts, size_t num_tris);
 
 	int add_vert(Patch *patch, float2 uv);
 	void add_triangle(Patch *patch, int v0, int v1, int v2);
@@ -109,7 +126,10 @@ public:
 
 	explicit QuadDice(const SubdParams& params);
 
-	void reserve(EdgeFactors& ef, int Mu, int Mv);
+	static void grid_size(const EdgeFactors& ef, int *Mu, int *Mv);
+	/* Number of vertices and triangles dice() adds for the edge factors. */
+	static void count(const EdgeFactors& ef, int *num_verts, int *num_tris);
+
 	float3 eval_projected(SubPatch& sub, float u, float v);
 
 	float2 map_uv(SubPatch& sub, float u, float v);
@@ -129,7 +149,9 @@ public:
 	float quad_area(const float3& a, const float3& b, const float3& c, const float3& d);
 	float scale_factor(SubPatch& sub, EdgeFactors& ef, int Mu, int Mv);
 
-	void dice(SubPatch& sub, EdgeFactors& ef);
+	/* Dice into the vertices and triangles starting at the offsets, which
+	 * have to be reserved in advance. */
+	void dice(SubPatch& sub, EdgeFactors& ef, size_t vert_offset, size_t tri_offset);
 };
 
 CCL_NAMESPACE_END
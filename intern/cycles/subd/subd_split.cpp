@@ -21,7 +21,9 @@
 #include "subd/subd_patch.h"
 #include "subd/subd_split.h"
 
+#include "util/util_foreach.h"
 #include "util/util_math.h"
+#include "util/util_task.h"
 #include "util/util_types.h"
 
 CCL_NAMESPACE_BEGIN
@@ -238,11 +240,68 @@ void DiagSplit::split_quad(Patch *patch, QuadDice::SubPatch *subpatch)
 	limit_edge_factors(sub_split, ef_split, 1 << params.max_level);
 
 	split(sub_split, ef_split);
+}
 
-	QuadDice dice(params);
+void DiagSplit::split_quads_range(const vector<QuadDice::SubPatch> *patches, size_t begin, size_t end,
+                                  DiagSplit *result)
+{
+	for(size_t i = begin; i < end; i++) {
+		QuadDice::SubPatch subpatch = (*patches)[i];
+		result->split_quad(subpatch.patch, &subpatch);
+	}
+}
+
+void DiagSplit::split_quads(const vector<QuadDice::SubPatch>& patches)
+{
+	/* Patches are split in fixed blocks, so that concatenating the results of
+	 * the blocks gives the same order regardless of thread scheduling. */
+	const size_t block_size = 64;
+	size_t num_blocks = (patches.size() + block_size - 1) / block_size;
+	vector<DiagSplit> results(num_blocks, DiagSplit(params));
+
+	TaskPool pool;
+	for(size_t i = 0; i < num_blocks; i++) {
+		size_t begin = i*block_size;
+		size_t end = (i + 1 == num_blocks)? patches.size(): begin + block_size;
+		pool.push(function_bind(&DiagSplit::split_quads_range, this, &patches, begin, end, &results[i]));
+	}
+	pool.wait_work();
+
+	foreach(DiagSplit& result, results) {
+		subpatches_quad.insert(subpatches_quad.end(),
+		                       result.subpatches_quad.begin(),
+		                       result.subpatches_quad.end());
+		edgefactors_quad.insert(edgefactors_quad.end(),
+		                        result.edgefactors_quad.begin(),
+		                        result.edgefactors_quad.end());
+	}
+}
 
-	for(size_t i = 0; i < subpatches_quad.size(); i++) {
-		QuadDice::SubPatch& sub = subpatches_quad[i];
+void DiagSplit::dice_range(const QuadDice *dice, size_t begin, size_t end,
+                           const vector<size_t> *vert_offsets, const vector<size_t> *tri_offsets)
+{
+	/* Each thread dices with its own copy, since the dicer tracks the offsets
+	 * it writes to. */
+	QuadDice local_dice = *dice;
+
+	for(size_t i = begin; i < end; i++) {
+		local_dice.dice(subpatches_quad[i], edgefactors_quad[i],
+		                dice->vert_offset + (*vert_offsets)[i],
+		                dice->tri_offset + (*tri_offsets)[i]);
+	}
+}
+
+void DiagSplit::dice()
+{
+	size_t num_subpatches = subpatches_quad.size();
+
+	/* Assign every subpatch its range of vertices and triangles up front,
+	 * so patches can be diced in parallel into the same mesh arrays with
+	 * the same result as dicing them in order. */
+	vector<size_t> vert_offsets(num_subpatches + 1, 0);
+	vector<size_t> tri_offsets(num_subpatches + 1, 0);
+
+	for(size_t i = 0; i < num_subpatches; i++) {
 		QuadDice::EdgeFactors& ef = edgefactors_quad[i];
 
 		ef.tu0 = max(ef.tu0, 1);
@@ -250,11 +309,22 @@ void DiagSplit::split_quad(Patch *patch, QuadDice::SubPatch *subpatch)
 		ef.tv0 = max(ef.tv0, 1);
 		ef.tv1 = max(ef.tv1, 1);
 
-		dice.dice(sub, ef);
+		int num_verts, num_tris;
+		QuadDice::count(ef, &num_verts, &num_tris);
+		vert_offsets[i+1] = vert_offsets[i] + num_verts;
+		tri_offsets[i+1] = tri_offsets[i] + num_tris;
 	}
 
-	subpatches_quad.clear();
-	edgefactors_quad.clear();
+	QuadDice dice(params);
+	dice.reserve(vert_offsets[num_subpatches], tri_offsets[num_subpatches]);
+
+	const size_t block_size = 256;
+	TaskPool pool;
+	for(size_t begin = 0; begin < num_subpatches; begin += block_size) {
+		size_t end = (begin + block_size < num_subpatches)? begin + block_size: num_subpatches;
+		pool.push(function_bind(&DiagSplit::dice_range, this, &dice, begin, end, &vert_offsets, &tri_offsets));
+	}
+	pool.wait_work();
 }
 
 CCL_NAMESPACE_END
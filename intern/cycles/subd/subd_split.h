@@ -51,7 +51,20 @@ public:
 	void dispatch(QuadDice::SubPatch& sub, QuadDice::EdgeFactors& ef);
 	void split(QuadDice::SubPatch& sub, QuadDice::EdgeFactors& ef, int depth=0);
 
+	/* Split a patch, the resulting subpatches are appended to the lists. */
 	void split_quad(Patch *patch, QuadDice::SubPatch *subpatch=NULL);
+	/* Split patches in parallel, with subpatches in the same order as when
+	 * splitting them one after another. */
+	void split_quads(const vector<QuadDice::SubPatch>& patches);
+
+	/* Dice all subpatches into the mesh in parallel. */
+	void dice();
+
+protected:
+	void split_quads_range(const vector<QuadDice::SubPatch> *patches, size_t begin, size_t end,
+	                       DiagSplit *result);
+	void dice_range(const QuadDice *dice, size_t begin, size_t end,
+	                const vector<size_t> *vert_offsets, const vector<size_t> *tri_offsets);
 };
 
 CCL_NAMESPACE_END
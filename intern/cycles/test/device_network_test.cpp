@@ -0,0 +1,143 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "device/device.h"
+#include "device/device_network.h"
+
+#include "util/util_thread.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Pair of connected local sockets, so the protocol can be tested without a
+ * server process. */
+class LocalSocketPair {
+public:
+	LocalSocketPair()
+	: client(io_service), server(io_service)
+	{
+		boost::asio::local::stream_protocol::socket a(io_service), b(io_service);
+		boost::asio::local::connect_pair(a, b);
+		client = network_socket(std::move(a));
+		server = network_socket(std::move(b));
+	}
+
+	boost::asio::io_service io_service;
+	network_socket client;
+	network_socket server;
+	NetworkError client_error;
+	NetworkError server_error;
+};
+
+void send_buffer(LocalSocketPair *sockets, vector<uint8_t> *data, bool compress, NetworkStats *stats)
+{
+	RPCSend snd(sockets->client, &sockets->client_error, "buffer");
+	snd.add(data->size());
+	snd.write();
+	snd.write_compressed_buffer(&(*data)[0], data->size(), compress, stats);
+}
+
+void receive_buffer(LocalSocketPair& sockets, vector<uint8_t>& data, NetworkStats *stats)
+{
+	RPCReceive rcv(sockets.server, &sockets.server_error);
+	EXPECT_EQ(rcv.name, "buffer");
+
+	size_t size;
+	rcv.read(size);
+	data.resize(size);
+	rcv.read_compressed_buffer(&data[0], size, stats);
+}
+
+}  // namespace
+
+TEST(device_network, frame_round_trip) {
+	LocalSocketPair sockets;
+
+	RPCSend snd(sockets.client, &sockets.client_error, "frame");
+	snd.add(42);
+	snd.add(string("network"));
+	snd.add((size_t)1 << 40);
+	snd.add(true);
+	snd.write();
+
+	RPCReceive rcv(sockets.server, &sockets.server_error);
+	EXPECT_EQ(rcv.name, "frame");
+
+	int i;
+	string s;
+	size_t size;
+	bool b;
+	rcv.read(i);
+	rcv.read(s);
+	rcv.read(size);
+	rcv.read(b);
+
+	EXPECT_EQ(i, 42);
+	EXPECT_EQ(s, "network");
+	EXPECT_EQ(size, (size_t)1 << 40);
+	EXPECT_TRUE(b);
+	EXPECT_FALSE(sockets.client_error.have_error());
+	EXPECT_FALSE(sockets.server_error.have_error());
+}
+
+TEST(device_network, compressed_buffer) {
+	LocalSocketPair sockets;
+
+	vector<uint8_t> data(4 * 1024 * 1024);
+	for(size_t i = 0; i < data.size(); i++) {
+		data[i] = (uint8_t)(i / 1024);
+	}
+
+	NetworkStats send_stats, receive_stats;
+	vector<uint8_t> received;
+	thread sender(function_bind(send_buffer, &sockets, &data, true, &send_stats));
+	receive_buffer(sockets, received, &receive_stats);
+	sender.join();
+
+	EXPECT_TRUE(received == data);
+	EXPECT_EQ(send_stats.buffer_size, data.size());
+	EXPECT_LT(send_stats.wire_size, data.size() / 10);
+	EXPECT_EQ(receive_stats.wire_size, send_stats.wire_size);
+	EXPECT_FALSE(sockets.server_error.have_error());
+}
+
+TEST(device_network, incompressible_buffer) {
+	LocalSocketPair sockets;
+
+	vector<uint8_t> data(1024 * 1024);
+	uint state = 1;
+	for(size_t i = 0; i < data.size(); i++) {
+		state = state*1664525u + 1013904223u;
+		data[i] = (uint8_t)(state >> 24);
+	}
+
+	NetworkStats send_stats;
+	vector<uint8_t> received;
+	thread sender(function_bind(send_buffer, &sockets, &data, true, &send_stats));
+	receive_buffer(sockets, received, NULL);
+	sender.join();
+
+	/* Sent as is when compression doesn't help. */
+	EXPECT_TRUE(received == data);
+	EXPECT_EQ(send_stats.wire_size, data.size());
+	EXPECT_FALSE(sockets.server_error.have_error());
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "test/filter_nlm_test.h"
+
+#include "util/util_time.h"
+
+CCL_NAMESPACE_BEGIN
+
+TEST(filter_nlm, benchmark) {
+	vector<NLMKernels> kernels = available_kernels();
+
+	NLMImage img(1024, 1024);
+	for(size_t k = 0; k < kernels.size(); k++) {
+		double start = time_dt();
+		run_nlm(kernels[k], img, 4, 4);
+		printf("NLM %s: %.3fs\n", kernels[k].name, time_dt() - start);
+	}
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "test/filter_nlm_test.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Denoising buffer, per-pixel feature transforms and gramian storage, as
+ * used by CPUDevice::denoising_accumulate. */
+struct NLMGramian {
+	NLMImage color;
+	int pass_stride;
+	vector<float> buffer;
+	int filter_window[4];
+	vector<float> transform;
+	vector<int> rank;
+	vector<float> XtWX;
+	vector<float3> XtWY;
+
+	NLMGramian(int w, int h) : color(w, h)
+	{
+		pass_stride = color.stride*h;
+		/* Eight feature passes followed by the color. */
+		buffer.resize(11*pass_stride);
+		uint state = 7;
+		for(size_t i = 0; i < buffer.size(); i++) {
+			buffer[i] = nlm_test_random(&state);
+		}
+		/* Some pixels are flagged as outliers. */
+		for(int i = 0; i < pass_stride; i += 13) {
+			buffer[i] = -buffer[i];
+		}
+
+		/* Smaller than the image, so the clipping against the rect is used. */
+		filter_window[0] = 2;
+		filter_window[1] = 3;
+		filter_window[2] = w - 3;
+		filter_window[3] = h - 2;
+		const int storage_num = (filter_window[2] - filter_window[0]) *
+		                        (filter_window[3] - filter_window[1]);
+		transform.resize(storage_num*TRANSFORM_SIZE);
+		for(size_t i = 0; i < transform.size(); i++) {
+			transform[i] = nlm_test_random(&state) - 0.5f;
+		}
+		rank.resize(storage_num);
+		for(int i = 0; i < storage_num; i++) {
+			rank[i] = 1 + i % 10;
+		}
+		XtWX.resize(storage_num*XTWX_SIZE, 0.0f);
+		XtWY.resize(storage_num*XTWY_SIZE, make_float3(0.0f, 0.0f, 0.0f));
+	}
+};
+
+/* Mirrors the loop in CPUDevice::denoising_accumulate. */
+void run_nlm_gramian(const NLMKernels& kernels, NLMGramian& g, int r, int f)
+{
+	NLMImage& img = g.color;
+	int w = img.stride;
+	vector<float> temporary(2*g.pass_stride, 0.0f);
+	float *difference     = &temporary[0];
+	float *blurDifference = difference + g.pass_stride;
+
+	for(int i = 0; i < (2*r+1)*(2*r+1); i++) {
+		int dy = i / (2*r+1) - r;
+		int dx = i % (2*r+1) - r;
+
+		int local_rect[4] = {max(0, -dx), max(0, -dy), img.w - max(0, dx), img.h - max(0, dy)};
+		kernels.calc_difference(dx, dy, &img.image[0], &img.variance[0], NULL, difference, local_rect, w, 0, 0, 1.0f, 0.25f);
+		kernels.blur(difference, blurDifference, local_rect, w, f);
+		kernels.calc_weight(blurDifference, difference, local_rect, w, f);
+		kernels.blur(difference, blurDifference, local_rect, w, f);
+		kernels.construct_gramian(dx, dy, 0,
+		                          blurDifference,
+		                          &g.buffer[0],
+		                          &g.transform[0],
+		                          &g.rank[0],
+		                          &g.XtWX[0],
+		                          &g.XtWY[0],
+		                          local_rect,
+		                          g.filter_window,
+		                          w, f,
+		                          g.pass_stride,
+		                          0,
+		                          false);
+	}
+}
+
+}  // namespace
+
+TEST(filter_nlm, architectures_match) {
+	vector<NLMKernels> kernels = available_kernels();
+
+	NLMImage reference(61, 37);
+	run_nlm(kernels[0], reference, 3, 2);
+
+	for(size_t k = 1; k < kernels.size(); k++) {
+		NLMImage img(61, 37);
+		run_nlm(kernels[k], img, 3, 2);
+		for(int y = 0; y < img.h; y++) {
+			for(int x = 0; x < img.w; x++) {
+				int idx = y*img.stride + x;
+				EXPECT_NEAR(reference.out[idx], img.out[idx], 1e-4f) << kernels[k].name << " at " << x << ", " << y;
+			}
+		}
+	}
+}
+
+TEST(filter_nlm, gramian_architectures_match) {
+	vector<NLMKernels> kernels = available_kernels();
+
+	NLMGramian reference(61, 37);
+	run_nlm_gramian(kernels[0], reference, 2, 4);
+
+	for(size_t k = 1; k < kernels.size(); k++) {
+		NLMGramian g(61, 37);
+		run_nlm_gramian(kernels[k], g, 2, 4);
+		for(size_t i = 0; i < g.XtWX.size(); i++) {
+			EXPECT_NEAR(reference.XtWX[i], g.XtWX[i], 1e-4f*max(1.0f, fabsf(reference.XtWX[i])))
+			        << kernels[k].name << " XtWX " << i;
+		}
+		for(size_t i = 0; i < g.XtWY.size(); i++) {
+			const float3 ref = reference.XtWY[i], val = g.XtWY[i];
+			const float tolerance = 1e-4f*max(1.0f, max3(fabs(ref)));
+			EXPECT_NEAR(ref.x, val.x, tolerance) << kernels[k].name << " XtWY " << i;
+			EXPECT_NEAR(ref.y, val.y, tolerance) << kernels[k].name << " XtWY " << i;
+			EXPECT_NEAR(ref.z, val.z, tolerance) << kernels[k].name << " XtWY " << i;
+		}
+	}
+}
+
+CCL_NAMESPACE_END
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FILTER_NLM_TEST_H__
+#define __FILTER_NLM_TEST_H__
+
+/* NLM kernels of every available architecture, shared by the correctness and
+ * performance tests. */
+
+#include "kernel/filter/filter.h"
+
+#include "util/util_math.h"
+#include "util/util_optimization.h"
+#include "util/util_system.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+typedef void (*NLMCalcDifferenceFunction)(int, int, float*, float*, float*, float*, int*, int, int, int, float, float);
+typedef void (*NLMBlurFunction)(float*, float*, int*, int, int);
+typedef void (*NLMUpdateOutputFunction)(int, int, float*, float*, float*, float*, float*, int*, int, int, int);
+typedef void (*NLMConstructGramianFunction)(int, int, int, float*, float*, float*, int*, float*, float3*, int*, int*, int, int, int, int, bool);
+typedef void (*NLMNormalizeFunction)(float*, float*, int*, int);
+
+struct NLMKernels {
+	const char *name;
+	NLMCalcDifferenceFunction calc_difference;
+	NLMBlurFunction blur;
+	NLMBlurFunction calc_weight;
+	NLMUpdateOutputFunction update_output;
+	NLMConstructGramianFunction construct_gramian;
+	NLMNormalizeFunction normalize;
+};
+
+NLMKernels make_nlm_kernels(const char *name,
+                            NLMCalcDifferenceFunction calc_difference,
+                            NLMBlurFunction blur,
+                            NLMBlurFunction calc_weight,
+                            NLMUpdateOutputFunction update_output,
+                            NLMConstructGramianFunction construct_gramian,
+                            NLMNormalizeFunction normalize)
+{
+	NLMKernels kernels = {name, calc_difference, blur, calc_weight, update_output, construct_gramian, normalize};
+	return kernels;
+}
+
+#define NLM_KERNELS(arch, name) make_nlm_kernels(name, \
+	kernel_##arch##_filter_nlm_calc_difference, \
+	kernel_##arch##_filter_nlm_blur, \
+	kernel_##arch##_filter_nlm_calc_weight, \
+	kernel_##arch##_filter_nlm_update_output, \
+	kernel_##arch##_filter_nlm_construct_gramian, \
+	kernel_##arch##_filter_nlm_normalize)
+
+/* Deterministic values in [0, 1). */
+inline float nlm_test_random(uint *state)
+{
+	*state = (*state)*1664525u + 1013904223u;
+	return (*state >> 8) * (1.0f / 16777216.0f);
+}
+
+/* Odd sizes, so the last block of every row is a partial one. */
+struct NLMImage {
+	int w, h, stride;
+	vector<float> image, variance, out;
+
+	NLMImage(int w, int h) : w(w), h(h)
+	{
+		stride = (int) align_up(w, 4);
+		image.resize(stride*h);
+		variance.resize(stride*h);
+		out.resize(stride*h, 0.0f);
+		uint state = 1;
+		for(int i = 0; i < stride*h; i++) {
+			image[i] = nlm_test_random(&state);
+			variance[i] = 0.01f + 0.1f*image[i];
+		}
+	}
+};
+
+/* Mirrors the loop in CPUDevice::denoising_non_local_means. */
+void run_nlm(const NLMKernels& kernels, NLMImage& img, int r, int f)
+{
+	int w = img.stride;
+	int pass_stride = w*img.h;
+	vector<float> temporary(4*pass_stride, 0.0f);
+	float *difference     = &temporary[0];
+	float *blurDifference = difference + pass_stride;
+	float *weightAccum    = blurDifference + pass_stride;
+	float *temp           = weightAccum + pass_stride;
+	float *image = &img.image[0];
+	float *variance = &img.variance[0];
+	float *out = &img.out[0];
+
+	std::fill(img.out.begin(), img.out.end(), 0.0f);
+
+	for(int i = 0; i < (2*r+1)*(2*r+1); i++) {
+		int dy = i / (2*r+1) - r;
+		int dx = i % (2*r+1) - r;
+
+		int local_rect[4] = {max(0, -dx), max(0, -dy), img.w - max(0, dx), img.h - max(0, dy)};
+		kernels.calc_difference(dx, dy, image, variance, NULL, difference, local_rect, w, 0, 0, 1.0f, 0.25f);
+		kernels.blur(difference, blurDifference, local_rect, w, f);
+		kernels.calc_weight(blurDifference, difference, local_rect, w, f);
+		kernels.blur(difference, blurDifference, local_rect, w, f);
+		kernels.update_output(dx, dy, blurDifference, image, temp, out, weightAccum, local_rect, 0, w, f);
+	}
+
+	int local_rect[4] = {0, 0, img.w, img.h};
+	kernels.normalize(out, weightAccum, local_rect, w);
+}
+
+vector<NLMKernels> available_kernels()
+{
+	vector<NLMKernels> kernels;
+	kernels.push_back(NLM_KERNELS(cpu, "default"));
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_SSE41
+	if(system_cpu_support_sse41()) {
+		kernels.push_back(NLM_KERNELS(cpu_sse41, "SSE4.1"));
+	}
+#endif
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX
+	if(system_cpu_support_avx()) {
+		kernels.push_back(NLM_KERNELS(cpu_avx, "AVX"));
+	}
+#endif
+#ifdef WITH_CYCLES_OPTIMIZED_KERNEL_AVX2
+	if(system_cpu_support_avx2()) {
+		kernels.push_back(NLM_KERNELS(cpu_avx2, "AVX2"));
+	}
+#endif
+	return kernels;
+}
+
+}  // namespace
+
+CCL_NAMESPACE_END
+
+#endif  /* __FILTER_NLM_TEST_H__ */
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "test/kernel_curve_test.h"
+
+#include "util/util_time.h"
+
+CCL_NAMESPACE_BEGIN
+
+TEST(kernel_curve, benchmark) {
+	CurveScene scene;
+	make_grass_patch(scene, 2000);
+	vector<float3> P, D;
+	make_rays(5000, P, D);
+
+	const int flags[2] = {kCurveFlags, kTessellatedFlags};
+	const char *names[2] = {"curve segments", "tessellated ribbons"};
+
+	for(int m = 0; m < 2; m++) {
+		scene.set_flags(flags[m]);
+
+		int num_hits = 0;
+		double start = time_dt();
+		for(size_t i = 0; i < P.size(); i++) {
+			Intersection isect;
+			num_hits += scene.intersect(P[i], D[i], &isect);
+		}
+		printf("Curve intersection %s: %.3fs (%d hits)\n", names[m], time_dt() - start, num_hits);
+	}
+}
+
+CCL_NAMESPACE_END
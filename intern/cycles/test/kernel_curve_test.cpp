@@ -0,0 +1,107 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "testing/testing.h"
+
+#include "test/kernel_curve_test.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Straight blade along Y with a key every 0.1. */
+CurveKeys straight_curve(float z, int num_keys)
+{
+	CurveKeys keys;
+	for(int k = 0; k < num_keys; k++) {
+		keys.push_back(make_float4(0.0f, 0.1f*k, z, 0.01f));
+	}
+	return keys;
+}
+
+}  // namespace
+
+TEST(kernel_curve, tessellated_ribbon_hit) {
+	/* Curves with different numbers of keys in two meshes, so every curve
+	 * uses a different ribbon offset. */
+	const int num_keys[4] = {5, 3, 4, 6};
+	const float z[4] = {0.5f, 1.0f, 1.5f, 2.0f};
+	vector<CurveKeys> mesh_curves[2];
+	for(int i = 0; i < 4; i++) {
+		mesh_curves[i / 2].push_back(straight_curve(z[i], num_keys[i]));
+	}
+
+	CurveScene scene;
+	scene.add_mesh(mesh_curves[0]);
+	scene.add_mesh(mesh_curves[1]);
+	scene.pack();
+	scene.set_flags(kTessellatedFlags);
+
+	for(int i = 0; i < 4; i++) {
+		for(int segment = 0; segment < num_keys[i] - 1; segment++) {
+			const float y = 0.1f*segment + 0.05f;
+			Intersection isect;
+			EXPECT_TRUE(scene.intersect(make_float3(-1.0f, y, z[i] + 0.005f), make_float3(1.0f, 0.0f, 0.0f), &isect))
+			        << "curve " << i << " segment " << segment;
+			EXPECT_EQ(isect.prim, scene.curve_prim(i));
+			EXPECT_EQ(PRIMITIVE_UNPACK_SEGMENT(isect.type), segment);
+			EXPECT_NEAR(isect.t, 1.0f, 1e-5f);
+			/* The end segments of the cardinal curve are not uniformly
+			 * parametrized, even for collinear keys. */
+			if(segment > 0 && segment < num_keys[i] - 2) {
+				EXPECT_NEAR(isect.u, 0.5f, 1e-5f);
+			}
+		}
+
+		Intersection isect;
+		EXPECT_FALSE(scene.intersect(make_float3(-1.0f, 0.05f, z[i] + 0.02f), make_float3(1.0f, 0.0f, 0.0f), &isect));
+		EXPECT_FALSE(scene.intersect(make_float3(-1.0f, 0.1f*num_keys[i], z[i]), make_float3(1.0f, 0.0f, 0.0f), &isect));
+	}
+}
+
+TEST(kernel_curve, tessellated_ribbons_match_curve_segments) {
+	CurveScene scene;
+	make_grass_patch(scene, 500);
+	vector<float3> P, D;
+	make_rays(5000, P, D);
+
+	int num_curve_hits = 0, num_ribbon_hits = 0, num_same_hits = 0;
+	for(size_t i = 0; i < P.size(); i++) {
+		Intersection curve_isect, ribbon_isect;
+
+		scene.set_flags(kCurveFlags);
+		bool curve_hit = scene.intersect(P[i], D[i], &curve_isect);
+		scene.set_flags(kTessellatedFlags);
+		bool ribbon_hit = scene.intersect(P[i], D[i], &ribbon_isect);
+
+		num_curve_hits += curve_hit;
+		num_ribbon_hits += ribbon_hit;
+
+		if(curve_hit && ribbon_hit && curve_isect.prim == ribbon_isect.prim) {
+			num_same_hits++;
+			EXPECT_NEAR(curve_isect.t, ribbon_isect.t, 0.01f);
+		}
+	}
+
+	printf("Curve segments: %d hits, tessellated ribbons: %d hits, %d on the same curve\n",
+	       num_curve_hits, num_ribbon_hits, num_same_hits);
+
+	EXPECT_GT(num_curve_hits, 0);
+	EXPECT_NEAR(num_ribbon_hits, num_curve_hits, num_curve_hits / 20);
+	EXPECT_GT(num_same_hits, num_curve_hits * 9 / 10);
+}
+
+CCL_NAMESPACE_END
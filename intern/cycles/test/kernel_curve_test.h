@@ -0,0 +1,226 @@
+/*
+ * Copyright 2011-2018 Blender Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __KERNEL_CURVE_TEST_H__
+#define __KERNEL_CURVE_TEST_H__
+
+/* Curves of several meshes packed into kernel textures, shared by the
+ * correctness and performance tests. */
+
+#include "kernel/kernel_compat_cpu.h"
+#include "kernel/kernel_math.h"
+#include "kernel/kernel_types.h"
+#include "kernel/split/kernel_split_data.h"
+#include "kernel/kernel_globals.h"
+#include "kernel/kernel_random.h"
+#include "kernel/geom/geom_attribute.h"
+#include "kernel/geom/geom_object.h"
+#include "kernel/geom/geom_motion_curve.h"
+#include "kernel/geom/geom_curve.h"
+#include "kernel/geom/geom_curve_intersect.h"
+
+#include "render/mesh.h"
+
+#include "util/util_foreach.h"
+#include "util/util_vector.h"
+
+CCL_NAMESPACE_BEGIN
+
+namespace {
+
+/* Keys of a single curve, with the radius in w. */
+typedef vector<float4> CurveKeys;
+
+class CurveScene {
+public:
+	CurveScene()
+	{
+		memset(&kg, 0, sizeof(kg));
+		kg.__data.curve.subdivisions = 3;
+	}
+
+	~CurveScene()
+	{
+		foreach(Mesh *mesh, meshes) {
+			delete mesh;
+		}
+	}
+
+	void add_mesh(const vector<CurveKeys>& mesh_curves)
+	{
+		int num_keys = 0;
+		foreach(const CurveKeys& keys, mesh_curves) {
+			num_keys += keys.size();
+		}
+
+		Mesh *mesh = new Mesh();
+		mesh->reserve_curves(mesh_curves.size(), num_keys);
+		foreach(const CurveKeys& keys, mesh_curves) {
+			mesh->add_curve(mesh->curve_keys.size(), 0);
+			foreach(const float4& key, keys) {
+				mesh->add_curve_key(float4_to_float3(key), key.w);
+			}
+		}
+		meshes.push_back(mesh);
+	}
+
+	/* Same offsets and layout as MeshManager::device_update_mesh(). */
+	void pack()
+	{
+		size_t curve_key_size = 0, curve_size = 0;
+		foreach(Mesh *mesh, meshes) {
+			mesh->curvekey_offset = curve_key_size;
+			mesh->curve_offset = curve_size;
+			curve_key_size += mesh->curve_keys.size();
+			curve_size += mesh->num_curves();
+		}
+
+		keys.resize(curve_key_size);
+		curves.resize(curve_size);
+		ribbons.resize((curve_key_size - curve_size) * (CURVE_RIBBON_PIECES - 1));
+
+		foreach(Mesh *mesh, meshes) {
+			/* Mesh::pack_curves() needs a scene for the shaders, the keys and
+			 * curves are packed the same way here. */
+			for(size_t i = 0; i < mesh->curve_keys.size(); i++) {
+				const float3 co = mesh->curve_keys[i];
+				keys[mesh->curvekey_offset + i] = make_float4(co.x, co.y, co.z, mesh->curve_radius[i]);
+			}
+			for(size_t i = 0; i < mesh->num_curves(); i++) {
+				Mesh::Curve curve = mesh->get_curve(i);
+				curves[mesh->curve_offset + i] = make_float4(__int_as_float(curve.first_key + mesh->curvekey_offset),
+				                                             __int_as_float(curve.num_keys),
+				                                             0.0f,
+				                                             0.0f);
+			}
+
+			size_t ribbon_offset = (mesh->curvekey_offset - mesh->curve_offset) * (CURVE_RIBBON_PIECES - 1);
+			mesh->pack_curve_ribbons(&ribbons[ribbon_offset]);
+		}
+
+		/* The BVH references curves in its own order, reverse it so primitive
+		 * and curve indices differ. */
+		prim_index.resize(curve_size);
+		prim_visibility.resize(curve_size);
+		for(size_t i = 0; i < curve_size; i++) {
+			prim_index[i] = curve_size - 1 - i;
+			prim_visibility[i] = PATH_RAY_ALL_VISIBILITY;
+		}
+
+		kg.__curves.data = &curves[0];
+		kg.__curves.width = curves.size();
+		kg.__curve_keys.data = &keys[0];
+		kg.__curve_keys.width = keys.size();
+		kg.__prim_index.data = &prim_index[0];
+		kg.__prim_index.width = prim_index.size();
+		kg.__prim_visibility.data = &prim_visibility[0];
+		kg.__prim_visibility.width = prim_visibility.size();
+		kg.__curve_ribbons.data = &ribbons[0];
+		kg.__curve_ribbons.width = ribbons.size();
+	}
+
+	void set_flags(int curveflags)
+	{
+		kg.__data.curve.curveflags = curveflags;
+	}
+
+	/* Primitive index of a curve, as stored in the intersection. */
+	int curve_prim(int curve) const
+	{
+		return prim_index.size() - 1 - curve;
+	}
+
+	/* Nearest hit of all curve segments, like the BVH leaf loop. */
+	bool intersect(const float3& P, const float3& dir, Intersection *isect)
+	{
+		isect->t = FLT_MAX;
+		isect->prim = PRIM_NONE;
+
+		bool hit = false;
+		for(int i = 0; i < (int)prim_index.size(); i++) {
+			const int num_segments = __float_as_int(curves[prim_index[i]].y) - 1;
+			for(int segment = 0; segment < num_segments; segment++) {
+				int type = PRIMITIVE_PACK_SEGMENT(PRIMITIVE_CURVE, segment);
+				hit |= cardinal_curve_intersect(&kg, isect, P, dir, PATH_RAY_ALL_VISIBILITY,
+				                                OBJECT_NONE, i, 0.0f, type, NULL, 0.0f, 0.0f);
+			}
+		}
+		return hit;
+	}
+
+	KernelGlobals kg;
+	vector<Mesh*> meshes;
+	vector<float4> curves;
+	vector<float4> keys;
+	vector<float4> ribbons;
+	vector<uint> prim_index;
+	vector<uint> prim_visibility;
+};
+
+float curve_test_random(uint *state)
+{
+	*state = *state*1664525u + 1013904223u;
+	return (*state >> 8) * (1.0f / 16777216.0f);
+}
+
+/* Patch of grass blades split over two meshes, every blade is a curve with a
+ * few bent segments. */
+void make_grass_patch(CurveScene& scene, int num_curves)
+{
+	uint state = 1;
+	vector<CurveKeys> mesh_curves[2];
+	for(int i = 0; i < num_curves; i++) {
+		float x = curve_test_random(&state), z = curve_test_random(&state);
+		float bend_x = curve_test_random(&state) - 0.5f, bend_z = curve_test_random(&state) - 0.5f;
+		/* Varying number of keys, so curve and key offsets diverge. */
+		const int num_keys = 3 + i % 3;
+
+		CurveKeys keys;
+		for(int k = 0; k < num_keys; k++) {
+			float f = (float)k / (num_keys - 1);
+			float radius = 0.004f * (1.0f - f) + 0.001f * f;
+			keys.push_back(make_float4(x + 0.1f*bend_x*f*f, 0.3f*f, z + 0.1f*bend_z*f*f, radius));
+		}
+		mesh_curves[i % 2].push_back(keys);
+	}
+
+	scene.add_mesh(mesh_curves[0]);
+	scene.add_mesh(mesh_curves[1]);
+	scene.pack();
+}
+
+/* Rays from the side of the patch towards random points inside of it. */
+void make_rays(int num_rays, vector<float3>& P, vector<float3>& D)
+{
+	uint state = 7;
+	for(int i = 0; i < num_rays; i++) {
+		float3 target = make_float3(curve_test_random(&state),
+		                            0.25f*curve_test_random(&state),
+		                            curve_test_random(&state));
+		float3 origin = make_float3(-1.0f, 0.4f*curve_test_random(&state), 2.0f*curve_test_random(&state) - 0.5f);
+		P.push_back(origin);
+		D.push_back(normalize(target - origin));
+	}
+}
+
+const int kCurveFlags = CURVE_KN_INTERPOLATE | CURVE_KN_RIBBONS;
+const int kTessellatedFlags = kCurveFlags | CURVE_KN_TESSELLATED_RIBBONS;
+
+}  // namespace
+
+CCL_NAMESPACE_END
+
+#endif  /* __KERNEL_CURVE_TEST_H__ */
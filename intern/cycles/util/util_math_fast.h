@@ -463,6 +463,38 @@ ccl_device_inline float4 fast_expf4(float4 x)
 {
 	return fast_exp2f4(x / M_LN2_F);
 }
+
+#  ifdef __KERNEL_AVX__
+ccl_device avxf fast_exp2f8(avxf x)
+{
+	const avxf one(1.0f);
+	x = min(max(x, avxf(-126.0f)), avxf(126.0f));
+	__m256i m = _mm256_cvtps_epi32(x);
+	x = one - (one - (x - avxf(_mm256_cvtepi32_ps(m))));
+	avxf r(1.33336498402e-3f);
+	r = madd(x, r, avxf(9.810352697968e-3f));
+	r = madd(x, r, avxf(5.551834031939e-2f));
+	r = madd(x, r, avxf(0.2401793301105f));
+	r = madd(x, r, avxf(0.693144857883f));
+	r = madd(x, r, avxf(1.0f));
+#    ifdef __KERNEL_AVX2__
+	return avxf(_mm256_add_epi32(_mm256_castps_si256(r), _mm256_slli_epi32(m, 23)));
+#    else
+	/* No 256-bit integer arithmetic before AVX2, adjust the exponent per half. */
+	__m256i ri = _mm256_castps_si256(r);
+	__m128i lo = _mm_add_epi32(_mm256_castsi256_si128(ri),
+	                           _mm_slli_epi32(_mm256_castsi256_si128(m), 23));
+	__m128i hi = _mm_add_epi32(_mm256_extractf128_si256(ri, 1),
+	                           _mm_slli_epi32(_mm256_extractf128_si256(m, 1), 23));
+	return avxf(_mm256_insertf128_si256(_mm256_castsi128_si256(lo), hi, 1));
+#    endif
+}
+
+ccl_device_inline avxf fast_expf8(avxf x)
+{
+	return fast_exp2f8(x / M_LN2_F);
+}
+#  endif
 #endif
 
 ccl_device_inline float fast_exp10(float x)
@@ -36,7 +36,9 @@ OIIO_NAMESPACE_USING
 #  define DIR_SEP '/'
 #  include <dirent.h>
 #  include <pwd.h>
+#  include <fcntl.h>
 #  include <unistd.h>
+#  include <sys/mman.h>
 #  include <sys/types.h>
 #endif
 
@@ -754,6 +756,67 @@ bool path_read_text(const string& path, string& text)
 	return true;
 }
 
+void *path_map_file(const string& path, size_t *size)
+{
+	*size = 0;
+#ifdef _WIN32
+	wstring path_wc = string_to_wstring(path);
+	HANDLE file = CreateFileW(path_wc.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+	                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+	LARGE_INTEGER file_size;
+	if(!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file);
+		return NULL;
+	}
+	HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if(mapping == NULL) {
+		return NULL;
+	}
+	/* The view keeps the mapping alive. */
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if(data == NULL) {
+		return NULL;
+	}
+	*size = (size_t)file_size.QuadPart;
+	return data;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd == -1) {
+		return NULL;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED) {
+		return NULL;
+	}
+	*size = st.st_size;
+	return data;
+#endif
+}
+
+void path_unmap_file(void *data, size_t size)
+{
+	if(data == NULL) {
+		return;
+	}
+#ifdef _WIN32
+	(void) size;
+	UnmapViewOfFile(data);
+#else
+	munmap(data, size);
+#endif
+}
+
 uint64_t path_modified_time(const string& path)
 {
 	path_stat_t st;
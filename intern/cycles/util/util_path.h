@@ -62,6 +62,10 @@ bool path_write_text(const string& path, string& text);
 bool path_read_binary(const string& path, vector<uint8_t>& binary);
 bool path_read_text(const string& path, string& text);
 
+/* Read-only memory mapping of a whole file, NULL on failure. */
+void *path_map_file(const string& path, size_t *size);
+void path_unmap_file(void *data, size_t size);
+
 /* File manipulation. */
 bool path_remove(const string& path);
 
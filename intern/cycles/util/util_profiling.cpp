@@ -80,6 +80,7 @@ void Profiler::reset(int num_shaders, int num_objects)
 	/* Resize and clear the accumulation vectors. */
 	shader_hits.assign(num_shaders, 0);
 	object_hits.assign(num_objects, 0);
+	counters.assign(PROFILING_NUM_COUNTERS, 0);
 
 	event_samples.assign(PROFILING_NUM_EVENTS, 0);
 	shader_samples.assign(num_shaders, 0);
@@ -108,6 +109,11 @@ void Profiler::stop()
 	}
 }
 
+bool Profiler::active()
+{
+	return (worker != NULL);
+}
+
 void Profiler::add_state(ProfilingState *state)
 {
 	thread_scoped_lock lock(mutex);
@@ -119,6 +125,9 @@ void Profiler::add_state(ProfilingState *state)
 	/* Resize thread-local hit counters. */
 	state->shader_hits.assign(shader_hits.size(), 0);
 	state->object_hits.assign(object_hits.size(), 0);
+	for(int i = 0; i < PROFILING_NUM_COUNTERS; i++) {
+		state->counters[i] = 0;
+	}
 
 	/* Initialize the state. */
 	state->event = PROFILING_UNKNOWN;
@@ -145,6 +154,12 @@ void Profiler::remove_state(ProfilingState *state)
 	for(int i = 0; i < object_hits.size(); i++) {
 		object_hits[i] += state->object_hits[i];
 	}
+
+	if(counters.size() == PROFILING_NUM_COUNTERS) {
+		for(int i = 0; i < PROFILING_NUM_COUNTERS; i++) {
+			counters[i] += state->counters[i];
+		}
+	}
 }
 
 uint64_t Profiler::get_event(ProfilingEvent event)
@@ -153,6 +168,12 @@ uint64_t Profiler::get_event(ProfilingEvent event)
 	return event_samples[event];
 }
 
+uint64_t Profiler::get_counter(ProfilingCounter counter)
+{
+	assert(worker == NULL);
+	return (counter < counters.size())? counters[counter]: 0;
+}
+
 bool Profiler::get_shader(int shader, uint64_t &samples, uint64_t &hits)
 {
 	assert(worker == NULL);
@@ -65,6 +65,15 @@ enum ProfilingEvent : uint32_t {
 	PROFILING_NUM_EVENTS,
 };
 
+/* Counts of work that was done or avoided, accumulated per worker thread. */
+enum ProfilingCounter : uint32_t {
+	PROFILING_COUNTER_SHADOW_SHADER_EVAL,
+	PROFILING_COUNTER_SHADOW_SHADER_CACHED,
+	PROFILING_COUNTER_SHADOW_OPAQUE_RAY,
+
+	PROFILING_NUM_COUNTERS,
+};
+
 /* Contains the current execution state of a worker thread.
  * These values are constantly updated by the worker.
  * Periodically the profiler thread will wake up, read them
@@ -86,6 +95,9 @@ struct ProfilingState {
 
 	vector<uint64_t> shader_hits;
 	vector<uint64_t> object_hits;
+
+	/* Only written by the worker, merged when the state is removed. */
+	uint64_t counters[PROFILING_NUM_COUNTERS] = {0};
 };
 
 class Profiler {
@@ -98,10 +110,14 @@ public:
 	void start();
 	void stop();
 
+	/* Whether the sampling thread is running. */
+	bool active();
+
 	void add_state(ProfilingState *state);
 	void remove_state(ProfilingState *state);
 
 	uint64_t get_event(ProfilingEvent event);
+	uint64_t get_counter(ProfilingCounter counter);
 	bool get_shader(int shader, uint64_t &samples, uint64_t &hits);
 	bool get_object(int object, uint64_t &samples, uint64_t &hits);
 
@@ -122,6 +138,9 @@ protected:
 	vector<uint64_t> shader_hits;
 	vector<uint64_t> object_hits;
 
+	/* Totals of the ProfilingCounter values of all removed states. */
+	vector<uint64_t> counters;
+
 	volatile bool do_stop_worker;
 	thread *worker;
 
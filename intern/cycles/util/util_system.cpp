@@ -118,6 +118,21 @@ bool system_cpu_run_thread_on_node(int node)
 	return numaAPI_RunThreadOnNode(node);
 }
 
+void *system_cpu_allocate_on_node(size_t size, int node)
+{
+	if(!system_cpu_ensure_initialized()) {
+		return NULL;
+	}
+	return numaAPI_AllocateOnNode(size, node);
+}
+
+void system_cpu_free_on_node(void *ptr, size_t size)
+{
+	if(ptr != NULL) {
+		numaAPI_Free(ptr, size);
+	}
+}
+
 int system_console_width()
 {
 	int columns = 0;
@@ -48,6 +48,13 @@ int system_cpu_num_numa_node_processors(int node);
  * Returns truth if affinity has successfully changed. */
 bool system_cpu_run_thread_on_node(int node);
 
+/* Allocate memory physically placed on the given node.
+ *
+ * Returns NULL if NUMA allocation is not supported, memory is to be freed with
+ * system_cpu_free_on_node(). */
+void *system_cpu_allocate_on_node(size_t size, int node);
+void system_cpu_free_on_node(void *ptr, size_t size);
+
 /* Number of processors within the current CPU group (or within active thread
  * thread affinity). */
 int system_cpu_num_active_group_processors();
@@ -180,6 +180,7 @@ thread_mutex TaskScheduler::mutex;
 int TaskScheduler::users = 0;
 vector<thread*> TaskScheduler::threads;
 bool TaskScheduler::do_exit = false;
+bool TaskScheduler::numa_affinity_active = false;
 
 list<TaskScheduler::Entry> TaskScheduler::queue;
 thread_mutex TaskScheduler::queue_mutex;
@@ -224,7 +225,8 @@ int get_num_total_processors(const vector<int>& num_per_node_processors)
 }
 
 /* Compute NUMA node for every thread to run on, for the best performance. */
-vector<int> distribute_threads_on_nodes(const int num_threads)
+vector<int> distribute_threads_on_nodes(const int num_threads,
+                                        const bool use_numa_affinity)
 {
 	/* Start with all threads unassigned to any specific NUMA node. */
 	vector<int> thread_nodes(num_threads, -1);
@@ -232,7 +234,12 @@ vector<int> distribute_threads_on_nodes(const int num_threads)
 	        system_cpu_num_active_group_processors();
 	VLOG(1) << "Detected " << num_active_group_processors << " processors "
 	        << "in active group.";
-	if(num_active_group_processors >= num_threads) {
+	if(use_numa_affinity && system_cpu_num_numa_nodes() > 1) {
+		/* Explicitly requested, so threads stay on the node which holds the
+		 * memory they first touched (tile buffers, replicated scene data). */
+		VLOG(1) << "Forcing NUMA node affinity of worker threads.";
+	}
+	else if(num_active_group_processors >= num_threads) {
 		/* If the current thread is set up in a way that its affinity allows to
 		 * use at least requested number of threads we do not explicitly set
 		 * affinity to the worker therads.
@@ -302,6 +309,7 @@ vector<int> distribute_threads_on_nodes(const int num_threads)
 		}
 		VLOG(1) << "Scheduling thread " << thread_index << " to node "
 		        << current_node_index << ".";
+		thread_nodes[thread_index] = current_node_index;
 		++thread_index;
 		current_node_index = (current_node_index + 1) % num_nodes;
 	}
@@ -311,7 +319,7 @@ vector<int> distribute_threads_on_nodes(const int num_threads)
 
 }  // namespace
 
-void TaskScheduler::init(int num_threads)
+void TaskScheduler::init(int num_threads, bool use_numa_affinity)
 {
 	thread_scoped_lock lock(mutex);
 	/* Multiple cycles instances can use this task scheduler, sharing the same
@@ -329,7 +337,14 @@ void TaskScheduler::init(int num_threads)
 	VLOG(1) << "Creating pool of " << num_threads << " threads.";
 
 	/* Compute distribution on NUMA nodes. */
-	vector<int> thread_nodes = distribute_threads_on_nodes(num_threads);
+	vector<int> thread_nodes = distribute_threads_on_nodes(num_threads,
+	                                                       use_numa_affinity);
+	numa_affinity_active = false;
+	foreach(int node, thread_nodes) {
+		if(node != -1) {
+			numa_affinity_active = true;
+		}
+	}
 
 	/* Launch threads that will be waiting for work. */
 	threads.resize(num_threads);
@@ -358,6 +373,7 @@ void TaskScheduler::exit()
 			delete t;
 		}
 		threads.clear();
+		numa_affinity_active = false;
 	}
 }
 
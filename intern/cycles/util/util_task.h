@@ -125,7 +125,9 @@ protected:
 class TaskScheduler
 {
 public:
-	static void init(int num_threads = 0);
+	/* When use_numa_affinity is set worker threads are bound to NUMA nodes
+	 * even if the affinity of the parent thread allows all processors. */
+	static void init(int num_threads = 0, bool use_numa_affinity = false);
 	static void exit();
 	static void free_memory();
 
@@ -135,6 +137,9 @@ public:
 	/* test if any session is using the scheduler */
 	static bool active() { return users != 0; }
 
+	/* test if worker threads are bound to NUMA nodes */
+	static bool numa_affinity() { return numa_affinity_active; }
+
 protected:
 	friend class TaskPool;
 
@@ -147,6 +152,7 @@ protected:
 	static int users;
 	static vector<thread*> threads;
 	static bool do_exit;
+	static bool numa_affinity_active;
 
 	static list<Entry> queue;
 	static thread_mutex queue_mutex;
@@ -21,6 +21,8 @@
 
 CCL_NAMESPACE_BEGIN
 
+static thread_local int thread_node = -1;
+
 thread::thread(function<void()> run_cb, int node)
   : run_cb_(run_cb),
     joined_(false),
@@ -50,12 +52,19 @@ void *thread::run(void *arg)
 {
 	thread *self = (thread*)(arg);
 	if (self->node_ != -1) {
-		system_cpu_run_thread_on_node(self->node_);
+		if(system_cpu_run_thread_on_node(self->node_)) {
+			thread_node = self->node_;
+		}
 	}
 	self->run_cb_();
 	return NULL;
 }
 
+int thread::current_node()
+{
+	return thread_node;
+}
+
 bool thread::join()
 {
 	joined_ = true;
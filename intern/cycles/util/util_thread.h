@@ -54,6 +54,10 @@ public:
 	static void *run(void *arg);
 	bool join();
 
+	/* Node the calling thread was bound to on creation, -1 if it was not
+	 * bound to any node. */
+	static int current_node();
+
 protected:
 	function<void()> run_cb_;
 #ifdef __APPLE__
@@ -209,6 +209,11 @@ extern const char *(*MEM_name_ptr)(void *vmemh);
 /* Switch allocator to slower but fully guarded mode. */
 void MEM_use_guarded_allocator(void);
 
+/* Switch allocator to one with per-thread caches of small blocks.
+ * Can be done after allocating with the default (lock-free) allocator,
+ * but not combined with the guarded allocator. */
+void MEM_use_slab_allocator(void);
+
 #ifdef __cplusplus
 /* alloc funcs for C++ only */
 #define MEM_CXX_CLASS_ALLOC_FUNCS(_id)                                        \
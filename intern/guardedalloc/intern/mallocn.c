@@ -131,3 +131,22 @@ void MEM_use_guarded_allocator(void)
 	MEM_name_ptr = MEM_guarded_name_ptr;
 #endif
 }
+
+void MEM_use_slab_allocator(void)
+{
+	MEM_slab_init();
+
+	MEM_freeN = MEM_slab_freeN;
+	MEM_dupallocN = MEM_slab_dupallocN;
+	MEM_reallocN_id = MEM_slab_reallocN_id;
+	MEM_recallocN_id = MEM_slab_recallocN_id;
+	MEM_callocN = MEM_slab_callocN;
+	MEM_calloc_arrayN = MEM_slab_calloc_arrayN;
+	MEM_mallocN = MEM_slab_mallocN;
+	MEM_malloc_arrayN = MEM_slab_malloc_arrayN;
+	MEM_printmemlist_stats = MEM_slab_printmemlist_stats;
+	MEM_get_memory_in_use = MEM_slab_get_memory_in_use;
+	MEM_get_memory_blocks_in_use = MEM_slab_get_memory_blocks_in_use;
+	MEM_reset_peak_memory = MEM_slab_reset_peak_memory;
+	MEM_get_peak_memory = MEM_slab_get_peak_memory;
+}
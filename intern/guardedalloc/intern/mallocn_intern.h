@@ -137,6 +137,23 @@ size_t MEM_lockfree_get_peak_memory(void) ATTR_WARN_UNUSED_RESULT;
 const char *MEM_lockfree_name_ptr(void *vmemh);
 #endif
 
+/* Prototypes for slab allocator functions, the others are lock-free */
+void MEM_slab_init(void);
+void MEM_slab_freeN(void *vmemh);
+void *MEM_slab_dupallocN(const void *vmemh) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+/* May return 'vmemh' resized in place, so not ATTR_MALLOC. */
+void *MEM_slab_reallocN_id(void *vmemh, size_t len, const char *UNUSED(str)) ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(2);
+void *MEM_slab_recallocN_id(void *vmemh, size_t len, const char *UNUSED(str)) ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(2);
+void *MEM_slab_callocN(size_t len, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1) ATTR_NONNULL(2);
+void *MEM_slab_calloc_arrayN(size_t len, size_t size, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1,2) ATTR_NONNULL(3);
+void *MEM_slab_mallocN(size_t len, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1) ATTR_NONNULL(2);
+void *MEM_slab_malloc_arrayN(size_t len, size_t size, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1,2) ATTR_NONNULL(3);
+void MEM_slab_printmemlist_stats(void);
+size_t MEM_slab_get_memory_in_use(void);
+unsigned int MEM_slab_get_memory_blocks_in_use(void);
+void MEM_slab_reset_peak_memory(void);
+size_t MEM_slab_get_peak_memory(void) ATTR_WARN_UNUSED_RESULT;
+
 /* Prototypes for fully guarded allocator functions */
 size_t MEM_guarded_allocN_len(const void *vmemh) ATTR_WARN_UNUSED_RESULT;
 void MEM_guarded_freeN(void *vmemh);
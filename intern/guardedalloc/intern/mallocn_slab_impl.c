@@ -0,0 +1,570 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup MEM
+ *
+ * Allocator for small blocks, enabled with #MEM_use_slab_allocator.
+ *
+ * Blocks of up to #SLAB_BLOCK_SIZE_MAX bytes (including the header) are carved out of
+ * larger chunks, one size class per chunk. Freed blocks go into a free list of the
+ * freeing thread, threads exchange them through global lists in batches of
+ * #SLAB_BATCH_LEN blocks, so a lock is only taken once per batch.
+ *
+ * Memory counters are kept per thread without atomics and summed when queried.
+ *
+ * Larger, aligned and mapped blocks are passed on to the lock-free allocator,
+ * which also frees blocks allocated before switching to this allocator.
+ * Chunks are never returned to the system.
+ */
+
+#include <stdlib.h>
+#include <string.h> /* memcpy */
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <pthread.h>
+#endif
+
+#include "MEM_guardedalloc.h"
+
+/* to ensure strict conversions */
+#include "../../source/blender/blenlib/BLI_strict_flags.h"
+
+#include "atomic_ops.h"
+#include "mallocn_intern.h"
+
+/* Same layout as the lock-free allocator. */
+typedef struct MemHead {
+	/* Length of allocated memory block. */
+	size_t len;
+} MemHead;
+
+/* Both the lock-free mmap and align flags, which it never sets together. */
+#define MEMHEAD_SLAB_FLAG ((size_t)3)
+
+#define MEMHEAD_FROM_PTR(ptr) (((MemHead *)ptr) - 1)
+#define PTR_FROM_MEMHEAD(memhead) (memhead + 1)
+#define MEMHEAD_IS_SLAB(memhead) (((memhead)->len & MEMHEAD_SLAB_FLAG) == MEMHEAD_SLAB_FLAG)
+/* Slab or unaligned lock-free block, which can be reallocated as a slab block. */
+#define MEMHEAD_IS_PLAIN(memhead) \
+	(((memhead)->len & MEMHEAD_SLAB_FLAG) == 0 || MEMHEAD_IS_SLAB(memhead))
+
+#define SLAB_CLASS_STEP 16
+#define SLAB_CLASS_NUM 32
+#define SLAB_BLOCK_SIZE_MAX (SLAB_CLASS_STEP * SLAB_CLASS_NUM)
+#define SLAB_LEN_MAX (SLAB_BLOCK_SIZE_MAX - sizeof(MemHead))
+
+#define SLAB_CHUNK_SIZE (1 << 16)
+#define SLAB_BATCH_LEN 64
+
+/* A free block, 'next' overlaps the header. */
+typedef struct SlabFreeBlock {
+	struct SlabFreeBlock *next;
+	/* Next batch in #SlabClass.batches, only set for the first block of a batch. */
+	struct SlabFreeBlock *batch_next;
+} SlabFreeBlock;
+
+typedef struct SlabClass {
+	uint32_t lock;
+	SlabFreeBlock *batches;
+} SlabClass;
+
+typedef struct SlabThreadCache {
+	/* All caches, to sum the counters. */
+	struct SlabThreadCache *next;
+	/* Caches of threads which exited, reused by new threads. */
+	struct SlabThreadCache *unused_next;
+
+	SlabFreeBlock *free[SLAB_CLASS_NUM];
+	unsigned int free_len[SLAB_CLASS_NUM];
+
+	/* Only changed by the owning thread, negative when freeing blocks of other threads. */
+	ptrdiff_t mem_in_use;
+	int totblock;
+} SlabThreadCache;
+
+static SlabClass slab_classes[SLAB_CLASS_NUM];
+
+static uint32_t slab_caches_lock = 0;
+static SlabThreadCache *slab_caches = NULL;
+static SlabThreadCache *slab_caches_unused = NULL;
+
+static size_t slab_chunks_size = 0;
+static size_t peak_mem = 0;
+
+/* The cache of the calling thread, the key is only used to release it when the thread exits. */
+#if defined(_WIN32)
+static __declspec(thread) SlabThreadCache *slab_thread_cache = NULL;
+static DWORD slab_thread_key;
+#else
+#  ifndef __APPLE__
+static __thread SlabThreadCache *slab_thread_cache = NULL;
+#  endif
+static pthread_key_t slab_thread_key;
+#endif
+
+/* -------------------------------------------------------------------- */
+/** \name Internal Utilities
+ * \{ */
+
+MEM_INLINE void slab_lock(uint32_t *lock)
+{
+	while (atomic_cas_uint32(lock, 0, 1) != 0) {
+		while (*(volatile uint32_t *)lock) {
+			/* pass */
+		}
+	}
+}
+
+MEM_INLINE void slab_unlock(uint32_t *lock)
+{
+	atomic_cas_uint32(lock, 1, 0);
+}
+
+MEM_INLINE unsigned int slab_class_from_len(const size_t len)
+{
+	return (unsigned int)((len + sizeof(MemHead) - 1) / SLAB_CLASS_STEP);
+}
+
+/**
+ * Split a list of free blocks into batches, and make them available to all threads.
+ */
+static void slab_class_push(SlabClass *sc, SlabFreeBlock *block)
+{
+	while (block) {
+		SlabFreeBlock *batch = block;
+		for (int i = 1; i < SLAB_BATCH_LEN && block->next; i++) {
+			block = block->next;
+		}
+		SlabFreeBlock *block_next = block->next;
+		block->next = NULL;
+
+		slab_lock(&sc->lock);
+		batch->batch_next = sc->batches;
+		sc->batches = batch;
+		slab_unlock(&sc->lock);
+
+		block = block_next;
+	}
+}
+
+/**
+ * Allocate a chunk and link all its blocks.
+ */
+static SlabFreeBlock *slab_chunk_alloc(const unsigned int c)
+{
+	const size_t block_size = (c + 1) * SLAB_CLASS_STEP;
+	const size_t blocks_len = SLAB_CHUNK_SIZE / block_size;
+	char *chunk = malloc(SLAB_CHUNK_SIZE);
+
+	if (UNLIKELY(chunk == NULL)) {
+		return NULL;
+	}
+	atomic_add_and_fetch_z(&slab_chunks_size, SLAB_CHUNK_SIZE);
+
+	for (size_t i = 0; i < blocks_len - 1; i++) {
+		((SlabFreeBlock *)(chunk + i * block_size))->next = (SlabFreeBlock *)(chunk + (i + 1) * block_size);
+	}
+	((SlabFreeBlock *)(chunk + (blocks_len - 1) * block_size))->next = NULL;
+
+	return (SlabFreeBlock *)chunk;
+}
+
+static void slab_update_peak(void)
+{
+	atomic_fetch_and_update_max_z(&peak_mem, MEM_slab_get_memory_in_use());
+}
+
+/**
+ * Give the free blocks of a class to other threads, except the \a keep_len most recently freed ones.
+ */
+static void slab_cache_flush(SlabThreadCache *cache, const unsigned int c, const unsigned int keep_len)
+{
+	SlabFreeBlock *block = cache->free[c], *block_last = NULL;
+	for (unsigned int i = 0; i < keep_len; i++) {
+		block_last = block;
+		block = block->next;
+	}
+	if (block_last) {
+		block_last->next = NULL;
+	}
+	else {
+		cache->free[c] = NULL;
+	}
+	cache->free_len[c] = keep_len;
+
+	slab_class_push(&slab_classes[c], block);
+}
+
+static SlabFreeBlock *slab_cache_refill(SlabThreadCache *cache, const unsigned int c)
+{
+	SlabClass *sc = &slab_classes[c];
+	SlabFreeBlock *batch = NULL;
+
+	/* Unlocked check, there is no need to lock when there are no batches. */
+	if (sc->batches) {
+		slab_lock(&sc->lock);
+		batch = sc->batches;
+		if (batch) {
+			sc->batches = batch->batch_next;
+		}
+		slab_unlock(&sc->lock);
+	}
+
+	if (batch == NULL) {
+		batch = slab_chunk_alloc(c);
+		if (UNLIKELY(batch == NULL)) {
+			return NULL;
+		}
+		/* Only check the peak when the memory used by slabs grows. */
+		slab_update_peak();
+	}
+
+	unsigned int batch_len = 0;
+	for (SlabFreeBlock *block = batch; block; block = block->next) {
+		batch_len++;
+	}
+
+	cache->free[c] = batch;
+	cache->free_len[c] = batch_len;
+	return batch;
+}
+
+static void slab_thread_cache_release(SlabThreadCache *cache)
+{
+	for (unsigned int c = 0; c < SLAB_CLASS_NUM; c++) {
+		slab_cache_flush(cache, c, 0);
+	}
+
+	slab_lock(&slab_caches_lock);
+	cache->unused_next = slab_caches_unused;
+	slab_caches_unused = cache;
+	slab_unlock(&slab_caches_lock);
+}
+
+#ifdef _WIN32
+static void WINAPI slab_thread_exit(void *data)
+#else
+static void slab_thread_exit(void *data)
+#endif
+{
+	if (data) {
+#ifndef __APPLE__
+		/* Frees in later thread exit callbacks get a new cache. */
+		slab_thread_cache = NULL;
+#endif
+		slab_thread_cache_release(data);
+	}
+}
+
+static SlabThreadCache *slab_thread_cache_create(void)
+{
+	SlabThreadCache *cache;
+
+	slab_lock(&slab_caches_lock);
+	cache = slab_caches_unused;
+	if (cache) {
+		/* Counters are kept, they include the blocks of the thread which used it before. */
+		slab_caches_unused = cache->unused_next;
+	}
+	else {
+		cache = calloc(1, sizeof(*cache));
+		if (UNLIKELY(cache == NULL)) {
+			abort();
+		}
+		cache->next = slab_caches;
+		slab_caches = cache;
+	}
+	slab_unlock(&slab_caches_lock);
+
+#ifdef _WIN32
+	slab_thread_cache = cache;
+	FlsSetValue(slab_thread_key, cache);
+#else
+#  ifndef __APPLE__
+	slab_thread_cache = cache;
+#  endif
+	pthread_setspecific(slab_thread_key, cache);
+#endif
+	return cache;
+}
+
+MEM_INLINE SlabThreadCache *slab_thread_cache_get(void)
+{
+#ifdef __APPLE__
+	SlabThreadCache *cache = pthread_getspecific(slab_thread_key);
+#else
+	SlabThreadCache *cache = slab_thread_cache;
+#endif
+	if (UNLIKELY(cache == NULL)) {
+		cache = slab_thread_cache_create();
+	}
+	return cache;
+}
+
+/**
+ * \param len: Aligned length, at most #SLAB_LEN_MAX.
+ */
+static void *slab_alloc(const size_t len)
+{
+	SlabThreadCache *cache = slab_thread_cache_get();
+	const unsigned int c = slab_class_from_len(len);
+	SlabFreeBlock *block = cache->free[c];
+
+	if (UNLIKELY(block == NULL)) {
+		block = slab_cache_refill(cache, c);
+		if (UNLIKELY(block == NULL)) {
+			return NULL;
+		}
+	}
+	cache->free[c] = block->next;
+	cache->free_len[c]--;
+
+	cache->mem_in_use += (ptrdiff_t)len;
+	cache->totblock++;
+
+	MemHead *memh = (MemHead *)block;
+	memh->len = len | MEMHEAD_SLAB_FLAG;
+	return PTR_FROM_MEMHEAD(memh);
+}
+
+static void slab_free(MemHead *memh)
+{
+	SlabThreadCache *cache = slab_thread_cache_get();
+	const size_t len = memh->len & ~MEMHEAD_SLAB_FLAG;
+	const unsigned int c = slab_class_from_len(len);
+	SlabFreeBlock *block = (SlabFreeBlock *)memh;
+
+	cache->mem_in_use -= (ptrdiff_t)len;
+	cache->totblock--;
+
+	block->next = cache->free[c];
+	cache->free[c] = block;
+	if (UNLIKELY(++cache->free_len[c] >= SLAB_BATCH_LEN * 2)) {
+		slab_cache_flush(cache, c, SLAB_BATCH_LEN);
+	}
+}
+
+/**
+ * Change the length of a slab block, when it stays in the same size class.
+ */
+static bool slab_resize(MemHead *memh, size_t len)
+{
+	const size_t old_len = memh->len & ~MEMHEAD_SLAB_FLAG;
+
+	len = SIZET_ALIGN_4(len);
+	if (len > SLAB_LEN_MAX || slab_class_from_len(len) != slab_class_from_len(old_len)) {
+		return false;
+	}
+
+	SlabThreadCache *cache = slab_thread_cache_get();
+	cache->mem_in_use += (ptrdiff_t)len - (ptrdiff_t)old_len;
+	memh->len = len | MEMHEAD_SLAB_FLAG;
+	return true;
+}
+
+/** \} */
+
+void MEM_slab_init(void)
+{
+	static bool initialized = false;
+	if (initialized) {
+		return;
+	}
+	initialized = true;
+
+#ifdef _WIN32
+	slab_thread_key = FlsAlloc(slab_thread_exit);
+#else
+	pthread_key_create(&slab_thread_key, slab_thread_exit);
+#endif
+}
+
+void MEM_slab_freeN(void *vmemh)
+{
+	if (vmemh && MEMHEAD_IS_SLAB(MEMHEAD_FROM_PTR(vmemh))) {
+		slab_free(MEMHEAD_FROM_PTR(vmemh));
+	}
+	else {
+		MEM_lockfree_freeN(vmemh);
+	}
+}
+
+void *MEM_slab_dupallocN(const void *vmemh)
+{
+	if (vmemh && MEMHEAD_IS_PLAIN(MEMHEAD_FROM_PTR(vmemh))) {
+		const size_t len = MEM_lockfree_allocN_len(vmemh);
+		void *newp = MEM_slab_mallocN(len, "dupli_malloc");
+		if (newp) {
+			memcpy(newp, vmemh, len);
+		}
+		return newp;
+	}
+	return MEM_lockfree_dupallocN(vmemh);
+}
+
+void *MEM_slab_reallocN_id(void *vmemh, size_t len, const char *str)
+{
+	if (vmemh == NULL) {
+		return MEM_slab_mallocN(len, str);
+	}
+
+	MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
+	if (!MEMHEAD_IS_PLAIN(memh)) {
+		return MEM_lockfree_reallocN_id(vmemh, len, str);
+	}
+	if (MEMHEAD_IS_SLAB(memh) && slab_resize(memh, len)) {
+		return vmemh;
+	}
+
+	const size_t old_len = MEM_lockfree_allocN_len(vmemh);
+	void *newp = MEM_slab_mallocN(len, "realloc");
+	if (newp) {
+		memcpy(newp, vmemh, (len < old_len) ? len : old_len);
+	}
+	MEM_slab_freeN(vmemh);
+	return newp;
+}
+
+void *MEM_slab_recallocN_id(void *vmemh, size_t len, const char *str)
+{
+	if (vmemh == NULL) {
+		return MEM_slab_callocN(len, str);
+	}
+
+	MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
+	if (!MEMHEAD_IS_PLAIN(memh)) {
+		return MEM_lockfree_recallocN_id(vmemh, len, str);
+	}
+
+	const size_t old_len = MEM_lockfree_allocN_len(vmemh);
+	void *newp;
+	if (MEMHEAD_IS_SLAB(memh) && slab_resize(memh, len)) {
+		newp = vmemh;
+	}
+	else {
+		newp = MEM_slab_mallocN(len, "recalloc");
+		if (newp) {
+			memcpy(newp, vmemh, (len < old_len) ? len : old_len);
+		}
+		MEM_slab_freeN(vmemh);
+	}
+
+	if (newp && len > old_len) {
+		/* zero new bytes */
+		memset(((char *)newp) + old_len, 0, len - old_len);
+	}
+	return newp;
+}
+
+void *MEM_slab_callocN(size_t len, const char *str)
+{
+	len = SIZET_ALIGN_4(len);
+
+	if (LIKELY(len <= SLAB_LEN_MAX)) {
+		void *ptr = slab_alloc(len);
+		if (LIKELY(ptr)) {
+			return memset(ptr, 0, len);
+		}
+	}
+	return MEM_lockfree_callocN(len, str);
+}
+
+void *MEM_slab_calloc_arrayN(size_t len, size_t size, const char *str)
+{
+	size_t total_size;
+	if (UNLIKELY(!MEM_size_safe_multiply(len, size, &total_size))) {
+		/* Reports the overflow. */
+		return MEM_lockfree_calloc_arrayN(len, size, str);
+	}
+
+	return MEM_slab_callocN(total_size, str);
+}
+
+void *MEM_slab_mallocN(size_t len, const char *str)
+{
+	len = SIZET_ALIGN_4(len);
+
+	if (LIKELY(len <= SLAB_LEN_MAX)) {
+		void *ptr = slab_alloc(len);
+		if (LIKELY(ptr)) {
+			return ptr;
+		}
+	}
+	return MEM_lockfree_mallocN(len, str);
+}
+
+void *MEM_slab_malloc_arrayN(size_t len, size_t size, const char *str)
+{
+	size_t total_size;
+	if (UNLIKELY(!MEM_size_safe_multiply(len, size, &total_size))) {
+		/* Reports the overflow. */
+		return MEM_lockfree_malloc_arrayN(len, size, str);
+	}
+
+	return MEM_slab_mallocN(total_size, str);
+}
+
+void MEM_slab_printmemlist_stats(void)
+{
+	printf("\ntotal memory len: %.3f MB\n",
+	       (double)MEM_slab_get_memory_in_use() / (double)(1024 * 1024));
+	printf("peak memory len: %.3f MB\n",
+	       (double)MEM_slab_get_peak_memory() / (double)(1024 * 1024));
+	printf("slab chunks len: %.3f MB\n",
+	       (double)slab_chunks_size / (double)(1024 * 1024));
+	printf("\nFor more detailed per-block statistics run Blender with memory debugging command line argument.\n");
+
+#ifdef HAVE_MALLOC_STATS
+	printf("System Statistics:\n");
+	malloc_stats();
+#endif
+}
+
+size_t MEM_slab_get_memory_in_use(void)
+{
+	ptrdiff_t mem_in_use = 0;
+	for (SlabThreadCache *cache = slab_caches; cache; cache = cache->next) {
+		mem_in_use += cache->mem_in_use;
+	}
+	return MEM_lockfree_get_memory_in_use() + (size_t)mem_in_use;
+}
+
+unsigned int MEM_slab_get_memory_blocks_in_use(void)
+{
+	int totblock = 0;
+	for (SlabThreadCache *cache = slab_caches; cache; cache = cache->next) {
+		totblock += cache->totblock;
+	}
+	return MEM_lockfree_get_memory_blocks_in_use() + (unsigned int)totblock;
+}
+
+void MEM_slab_reset_peak_memory(void)
+{
+	MEM_lockfree_reset_peak_memory();
+	peak_mem = MEM_slab_get_memory_in_use();
+}
+
+size_t MEM_slab_get_peak_memory(void)
+{
+	slab_update_peak();
+	const size_t lockfree_peak_mem = MEM_lockfree_get_peak_memory();
+	return (peak_mem > lockfree_peak_mem) ? peak_mem : lockfree_peak_mem;
+}
@@ -1283,31 +1283,22 @@ void BKE_mesh_looptri_get_real_edges(const Mesh *mesh, const MLoopTri *looptri,
 /* basic vertex data functions */
 bool BKE_mesh_minmax(const Mesh *me, float r_min[3], float r_max[3])
 {
-	int i = me->totvert;
-	MVert *mvert;
-	for (mvert = me->mvert; i--; mvert++) {
-		minmax_v3v3_v3(r_min, r_max, mvert->co);
-	}
+	minmax_v3v3_v3_array_stride(r_min, r_max, (const float *)me->mvert, me->totvert, sizeof(*me->mvert));
 
 	return (me->totvert != 0);
 }
 
 void BKE_mesh_transform(Mesh *me, float mat[4][4], bool do_keys)
 {
-	int i;
-	MVert *mvert = me->mvert;
 	float (*lnors)[3] = CustomData_get_layer(&me->ldata, CD_NORMAL);
 
-	for (i = 0; i < me->totvert; i++, mvert++)
-		mul_m4_v3(mat, mvert->co);
+	/* #MVert.co is the first member. */
+	mul_m4_v3_array_stride(mat, (float *)me->mvert, me->totvert, sizeof(*me->mvert));
 
 	if (do_keys && me->key) {
 		KeyBlock *kb;
 		for (kb = me->key->block.first; kb; kb = kb->next) {
-			float *fp = kb->data;
-			for (i = kb->totelem; i--; fp += 3) {
-				mul_m4_v3(mat, fp);
-			}
+			mul_m4_v3_array(mat, kb->data, kb->totelem);
 		}
 	}
 
@@ -1318,9 +1309,7 @@ void BKE_mesh_transform(Mesh *me, float mat[4][4], bool do_keys)
 
 		copy_m3_m4(m3, mat);
 		normalize_m3(m3);
-		for (i = 0; i < me->totloop; i++, lnors++) {
-			mul_m3_v3(m3, *lnors);
-		}
+		mul_m3_v3_array(m3, lnors, me->totloop);
 	}
 }
 
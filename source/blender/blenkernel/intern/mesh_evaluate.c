@@ -185,6 +185,7 @@ typedef struct MeshCalcNormalsData {
 	float (*pnors)[3];
 	float (*lnors_weighted)[3];
 	float (*vnors)[3];
+	int numVerts;
 } MeshCalcNormalsData;
 
 static void mesh_calc_normals_poly_cb(
@@ -263,22 +264,32 @@ static void mesh_calc_normals_poly_prepare_cb(
 	}
 }
 
+/* Vertices finalized by each iteration, so they can be normalized in bulk. */
+#define MESH_NORMALS_FINALIZE_CHUNK_SIZE 256
+
 static void mesh_calc_normals_poly_finalize_cb(
         void *__restrict userdata,
-        const int vidx,
+        const int chunk,
         const ParallelRangeTLS *__restrict UNUSED(tls))
 {
 	MeshCalcNormalsData *data = userdata;
+	const int vidx_start = chunk * MESH_NORMALS_FINALIZE_CHUNK_SIZE;
+	const int vidx_end = min_ii(vidx_start + MESH_NORMALS_FINALIZE_CHUNK_SIZE, data->numVerts);
 
-	MVert *mv = &data->mverts[vidx];
-	float *no = data->vnors[vidx];
+	normalize_v3_array(&data->vnors[vidx_start], vidx_end - vidx_start);
 
-	if (UNLIKELY(normalize_v3(no) == 0.0f)) {
-		/* following Mesh convention; we use vertex coordinate itself for normal in this case */
-		normalize_v3_v3(no, mv->co);
-	}
+	for (int vidx = vidx_start; vidx < vidx_end; vidx++) {
+		MVert *mv = &data->mverts[vidx];
+		float *no = data->vnors[vidx];
+
+		/* Normalizing only gives a zero vector when the length is zero. */
+		if (UNLIKELY(is_zero_v3(no))) {
+			/* following Mesh convention; we use vertex coordinate itself for normal in this case */
+			normalize_v3_v3(no, mv->co);
+		}
 
-	normal_float_to_short_v3(mv->no, no);
+		normal_float_to_short_v3(mv->no, no);
+	}
 }
 
 void BKE_mesh_calc_normals_poly(
@@ -320,7 +331,7 @@ void BKE_mesh_calc_normals_poly(
 
 	MeshCalcNormalsData data = {
 	    .mpolys = mpolys, .mloop = mloop, .mverts = mverts,
-	    .pnors = pnors, .lnors_weighted = lnors_weighted, .vnors = vnors,
+	    .pnors = pnors, .lnors_weighted = lnors_weighted, .vnors = vnors, .numVerts = numVerts,
 	};
 
 	/* Compute poly normals, and prepare weighted loop normals. */
@@ -334,7 +345,10 @@ void BKE_mesh_calc_normals_poly(
 	}
 
 	/* Normalize and validate computed vertex normals. */
-	BLI_task_parallel_range(0, numVerts, &data, mesh_calc_normals_poly_finalize_cb, &settings);
+	settings.min_iter_per_thread = 1024 / MESH_NORMALS_FINALIZE_CHUNK_SIZE;
+	BLI_task_parallel_range(
+	        0, (numVerts + MESH_NORMALS_FINALIZE_CHUNK_SIZE - 1) / MESH_NORMALS_FINALIZE_CHUNK_SIZE, &data,
+	        mesh_calc_normals_poly_finalize_cb, &settings);
 
 	if (free_vnors) {
 		MEM_freeN(vnors);
@@ -1535,10 +1549,12 @@ void BKE_mesh_normals_loop_split(
 	 * store the negated value of loop index instead of INDEX_INVALID to retrieve the real value later in code).
 	 * Note also that lose edges always have both values set to 0!
 	 */
-	int (*edge_to_loops)[2] = MEM_calloc_arrayN((size_t)numEdges, sizeof(*edge_to_loops), __func__);
+	MemArenaMark arena_mark;
+	MemArena *arena = BLI_memarena_thread_begin(&arena_mark);
+	int (*edge_to_loops)[2] = BLI_memarena_calloc(arena, sizeof(*edge_to_loops) * (size_t)numEdges);
 
 	/* Simple mapping from a loop to its polygon index. */
-	int *loop_to_poly = r_loop_to_poly ? r_loop_to_poly : MEM_malloc_arrayN((size_t)numLoops, sizeof(*loop_to_poly), __func__);
+	int *loop_to_poly = r_loop_to_poly ? r_loop_to_poly : BLI_memarena_alloc(arena, sizeof(*loop_to_poly) * (size_t)numLoops);
 
 	/* When using custom loop normals, disable the angle feature! */
 	const bool check_angle = (split_angle < (float)M_PI) && (clnors_data == NULL);
@@ -1595,10 +1611,7 @@ void BKE_mesh_normals_loop_split(
 		BLI_task_pool_free(task_pool);
 	}
 
-	MEM_freeN(edge_to_loops);
-	if (!r_loop_to_poly) {
-		MEM_freeN(loop_to_poly);
-	}
+	BLI_memarena_thread_end(arena, &arena_mark);
 
 	if (r_lnors_spacearr) {
 		if (r_lnors_spacearr == &_lnors_spacearr) {
@@ -2719,6 +2732,7 @@ int BKE_mesh_recalc_tessellation(
 	MLoop *ml, *mloop;
 	MFace *mface, *mf;
 	MemArena *arena = NULL;
+	MemArenaMark arena_mark = {NULL};
 	int *mface_to_poly_map;
 	unsigned int (*lindices)[4];
 	int poly_index, mface_index;
@@ -2820,7 +2834,7 @@ int BKE_mesh_recalc_tessellation(
 			const unsigned int totfilltri = mp_totloop - 2;
 
 			if (UNLIKELY(arena == NULL)) {
-				arena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, __func__);
+				arena = BLI_memarena_thread_begin(&arena_mark);
 			}
 
 			tris = BLI_memarena_alloc(arena, sizeof(*tris) * (size_t)totfilltri);
@@ -2880,12 +2894,12 @@ int BKE_mesh_recalc_tessellation(
 				mface_index++;
 			}
 
-			BLI_memarena_clear(arena);
+			BLI_memarena_reset_to_mark(arena, &arena_mark);
 		}
 	}
 
 	if (arena) {
-		BLI_memarena_free(arena);
+		BLI_memarena_thread_end(arena, &arena_mark);
 		arena = NULL;
 	}
 
@@ -2972,6 +2986,7 @@ void BKE_mesh_recalc_looptri(
 	const MLoop *ml;
 	MLoopTri *mlt;
 	MemArena *arena = NULL;
+	MemArenaMark arena_mark = {NULL};
 	int poly_index, mlooptri_index;
 	unsigned int j;
 
@@ -3032,7 +3047,7 @@ void BKE_mesh_recalc_looptri(
 			const unsigned int totfilltri = mp_totloop - 2;
 
 			if (UNLIKELY(arena == NULL)) {
-				arena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, __func__);
+				arena = BLI_memarena_thread_begin(&arena_mark);
 			}
 
 			tris = BLI_memarena_alloc(arena, sizeof(*tris) * (size_t)totfilltri);
@@ -3079,12 +3094,12 @@ void BKE_mesh_recalc_looptri(
 				mlooptri_index++;
 			}
 
-			BLI_memarena_clear(arena);
+			BLI_memarena_reset_to_mark(arena, &arena_mark);
 		}
 	}
 
 	if (arena) {
-		BLI_memarena_free(arena);
+		BLI_memarena_thread_end(arena, &arena_mark);
 		arena = NULL;
 	}
 
@@ -57,6 +57,14 @@ void BLI_kdtree_range_search_cb(
         const KDTree *tree, const float co[3], float range,
         bool (*search_cb)(void *user_data, int index, const float co[3], float dist_sq), void *user_data);
 
+/* batched searches, in parallel */
+void BLI_kdtree_find_nearest_n_batch(
+        const KDTree *tree, const float (*co)[3], int co_len,
+        KDTreeNearest *r_nearest, unsigned int n, int *r_found) ATTR_NONNULL(1, 2, 4);
+void BLI_kdtree_range_search_batch(
+        const KDTree *tree, const float (*co)[3], int co_len, float range,
+        KDTreeNearest **r_nearest, int *r_nearest_len) ATTR_NONNULL(1, 2, 5, 6);
+
 int BLI_kdtree_calc_duplicates_fast(
         const KDTree *tree, const float range, bool use_index_order,
         int *doubles);
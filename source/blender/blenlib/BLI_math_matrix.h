@@ -128,6 +128,8 @@ void _va_mul_m4_series_9(
 #define mul_m4_series(...) VA_NARGS_CALL_OVERLOAD(_va_mul_m4_series_, __VA_ARGS__)
 
 void mul_m4_v3(const float M[4][4], float r[3]);
+void mul_m4_v3_array(const float M[4][4], float (*r_arr)[3], const int arr_len);
+void mul_m4_v3_array_stride(const float M[4][4], float *r_arr, const int arr_len, const size_t arr_stride);
 void mul_v3_m4v3(float r[3], const float M[4][4], const float v[3]);
 void mul_v2_m4v3(float r[2], const float M[4][4], const float v[3]);
 void mul_v2_m2v2(float r[2], const float M[2][2], const float v[2]);
@@ -144,6 +146,8 @@ void mul_v2_project_m4_v3(float r[2], const float M[4][4], const float vec[3]);
 void mul_m3_v2(const float m[3][3], float r[2]);
 void mul_v2_m3v2(float r[2], const float m[3][3], const float v[2]);
 void mul_m3_v3(const float M[3][3], float r[3]);
+void mul_m3_v3_array(const float M[3][3], float (*r_arr)[3], const int arr_len);
+void mul_m3_v3_array_stride(const float M[3][3], float *r_arr, const int arr_len, const size_t arr_stride);
 void mul_v3_m3v3(float r[3], const float M[3][3], const float a[3]);
 void mul_v2_m3v3(float r[2], const float M[3][3], const float a[3]);
 void mul_transposed_m3_v3(const float M[3][3], float r[3]);
@@ -356,6 +356,8 @@ void minmax_v3v3_v3(float min[3], float max[3], const float vec[3]);
 void minmax_v2v2_v2(float min[2], float max[2], const float vec[2]);
 
 void minmax_v3v3_v3_array(float r_min[3], float r_max[3], const float (*vec_arr)[3], int nbr);
+void minmax_v3v3_v3_array_stride(
+        float r_min[3], float r_max[3], const float *arr, const int arr_len, const size_t arr_stride);
 
 void dist_ensure_v3_v3fl(float v1[3], const float v2[3], const float dist);
 void dist_ensure_v2_v2fl(float v1[2], const float v2[2], const float dist);
@@ -368,6 +370,7 @@ double dot_vn_vn(const float *array_src_a, const float *array_src_b, const int s
 double len_squared_vn(const float *array, const int size) ATTR_WARN_UNUSED_RESULT;
 float normalize_vn_vn(float *array_tar, const float *array_src, const int size);
 float normalize_vn(float *array_tar, const int size);
+void normalize_v3_array(float (*arr)[3], const int arr_len);
 void range_vn_i(int *array_tar, const int size, const int start);
 void range_vn_u(unsigned int *array_tar, const int size, const unsigned int start);
 void range_vn_fl(float *array_tar, const int size, const float start, const float step);
@@ -49,6 +49,24 @@ void               *BLI_memarena_calloc(struct MemArena *ma, size_t size) ATTR_W
 
 void BLI_memarena_clear(MemArena *ma) ATTR_NONNULL(1);
 
+/**
+ * Position in an arena, allocations made after it can be released
+ * with #BLI_memarena_reset_to_mark, in last-in first-out order.
+ */
+typedef struct MemArenaMark {
+	void *buf;
+	void *curbuf;
+	size_t cursize;
+} MemArenaMark;
+
+void BLI_memarena_mark(struct MemArena *ma, MemArenaMark *r_mark) ATTR_NONNULL(1, 2);
+void BLI_memarena_reset_to_mark(struct MemArena *ma, const MemArenaMark *mark) ATTR_NONNULL(1, 2);
+
+struct MemArena    *BLI_memarena_thread_get(void) ATTR_WARN_UNUSED_RESULT;
+struct MemArena    *BLI_memarena_thread_begin(MemArenaMark *r_mark) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL(1);
+void                BLI_memarena_thread_end(struct MemArena *ma, const MemArenaMark *mark) ATTR_NONNULL(1, 2);
+void                BLI_memarena_thread_free_all(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -76,6 +76,13 @@ enum {
 	 * \note order of iteration is only assured to be the order of allocation when no chunks have been freed.
 	 */
 	BLI_MEMPOOL_ALLOW_ITER = (1 << 0),
+	/** allow allocating and freeing from multiple threads at once.
+	 *
+	 * Each thread allocates from and frees into its own free list.
+	 * \note other functions (clear, iteration, conversion to arrays) must not run while elements are allocated or
+	 * freed, and chunks aren't freed when the pool becomes empty, only on clear or destroy.
+	 */
+	BLI_MEMPOOL_CONCURRENT = (1 << 1),
 };
 
 void  BLI_mempool_iternew(BLI_mempool *pool, BLI_mempool_iter *iter) ATTR_NONNULL();
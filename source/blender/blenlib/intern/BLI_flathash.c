@@ -0,0 +1,772 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup bli
+ *
+ * Open-addressing hash-map, see: #BLI_flathash.h
+ *
+ * Entries are stored in groups of #FLATHASH_GROUP_SIZE slots. Each slot has a
+ * one byte control value next to the others of its group, which is either
+ * #FLATHASH_CTRL_EMPTY, #FLATHASH_CTRL_DELETED or the lowest 7 bits of the hash
+ * of the key stored in the slot. A lookup compares the control bytes of a whole
+ * group to those 7 bits at once (with SSE2 when available), and only compares
+ * keys of slots which match. Groups are probed quadratically until one with an
+ * empty slot is found.
+ *
+ * Based on the design of Abseil's "Swiss tables".
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_sys_types.h"  /* for intptr_t support */
+#include "BLI_utildefines.h"
+#include "BLI_math_bits.h"
+
+#include "BLI_flathash.h"  /* own include */
+
+/* keep last */
+#include "BLI_strict_flags.h"
+
+/* -------------------------------------------------------------------- */
+/** \name Structs & Constants
+ * \{ */
+
+#define FLATHASH_GROUP_SIZE 16
+
+#define FLATHASH_CTRL_EMPTY   ((signed char)-128)
+#define FLATHASH_CTRL_DELETED ((signed char)-2)
+
+/* Grow when more than 7/8 of the slots are used (including deleted ones). */
+#define FLATHASH_MAX_LOAD(capacity) ((capacity) - (capacity) / 8)
+
+/* Keys are hashed and compared inline, depending on their type. */
+typedef enum eFlatHashKeyType {
+	FLATHASH_KEY_GENERIC = 0,
+	FLATHASH_KEY_PTR     = 1,
+	FLATHASH_KEY_INT     = 2,
+	FLATHASH_KEY_STR     = 3,
+} eFlatHashKeyType;
+
+/* Layout must match the FlatHashIterator accessors. */
+typedef struct FlatHashSlot {
+	void *key;
+	void *val;
+} FlatHashSlot;
+
+struct FlatHash {
+	GHashHashFP hashfp;
+	GHashCmpFP cmpfp;
+	eFlatHashKeyType key_type;
+
+	/* Control bytes and slots, (group_mask + 1) * FLATHASH_GROUP_SIZE of each. */
+	signed char *ctrl;
+	FlatHashSlot *slots;
+	uint group_mask;
+
+	uint nentries;
+	/* Number of empty slots which can be filled before growing. */
+	uint growth_left;
+};
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Internal Utility API
+ * \{ */
+
+/* Bit masks of the slots of a group matching a condition. */
+
+#ifdef __SSE2__
+BLI_INLINE uint flathash_group_match(const signed char *group, const signed char h2)
+{
+	const __m128i ctrl = _mm_load_si128((const __m128i *)group);
+	return (uint)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+}
+
+BLI_INLINE uint flathash_group_match_empty_or_deleted(const signed char *group)
+{
+	/* Only empty and deleted slots have the sign bit set. */
+	const __m128i ctrl = _mm_load_si128((const __m128i *)group);
+	return (uint)_mm_movemask_epi8(ctrl);
+}
+#else
+BLI_INLINE uint flathash_group_match(const signed char *group, const signed char h2)
+{
+	uint mask = 0;
+	for (uint i = 0; i < FLATHASH_GROUP_SIZE; i++) {
+		mask |= (uint)(group[i] == h2) << i;
+	}
+	return mask;
+}
+
+BLI_INLINE uint flathash_group_match_empty_or_deleted(const signed char *group)
+{
+	uint mask = 0;
+	for (uint i = 0; i < FLATHASH_GROUP_SIZE; i++) {
+		mask |= (uint)(group[i] < 0) << i;
+	}
+	return mask;
+}
+#endif
+
+BLI_INLINE uint flathash_group_match_empty(const signed char *group)
+{
+	return flathash_group_match(group, FLATHASH_CTRL_EMPTY);
+}
+
+BLI_INLINE uint flathash_capacity(const FlatHash *fh)
+{
+	return (fh->group_mask + 1) * FLATHASH_GROUP_SIZE;
+}
+
+/**
+ * Final mix of the hash, all of its bits are used to choose the group and the
+ * control byte, while the hash callbacks often only vary in the lower bits.
+ */
+BLI_INLINE uint flathash_mix(uint h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+BLI_INLINE uint flathash_keyhash(const FlatHash *fh, const void *key, const eFlatHashKeyType key_type)
+{
+	switch (key_type) {
+		case FLATHASH_KEY_PTR:
+		{
+			const uintptr_t y = (uintptr_t)key;
+			return flathash_mix((uint)y ^ (uint)((uint64_t)y >> 32));
+		}
+		case FLATHASH_KEY_INT:
+			return flathash_mix(POINTER_AS_UINT(key));
+		case FLATHASH_KEY_STR:
+		{
+			/* Same as #BLI_ghashutil_strhash_p. */
+			uint h = 5381;
+			for (const signed char *p = key; *p != '\0'; p++) {
+				h = (uint)((h << 5) + h) + (uint)*p;
+			}
+			return flathash_mix(h);
+		}
+		case FLATHASH_KEY_GENERIC:
+		default:
+			return flathash_mix(fh->hashfp(key));
+	}
+}
+
+/* Unlike #GHashCmpFP, returns true when equal. */
+BLI_INLINE bool flathash_keyeq(const FlatHash *fh, const void *a, const void *b, const eFlatHashKeyType key_type)
+{
+	switch (key_type) {
+		case FLATHASH_KEY_PTR:
+		case FLATHASH_KEY_INT:
+			return a == b;
+		case FLATHASH_KEY_STR:
+			return STREQ(a, b);
+		case FLATHASH_KEY_GENERIC:
+		default:
+			return !fh->cmpfp(a, b);
+	}
+}
+
+BLI_INLINE signed char flathash_h2(const uint hash)
+{
+	return (signed char)(hash & 0x7f);
+}
+
+BLI_INLINE uint flathash_h1(const uint hash)
+{
+	return hash >> 7;
+}
+
+/**
+ * Find the slot of \a key, key_type is a constant in every caller so the key
+ * hashing and comparisons are inlined.
+ *
+ * \return the slot index or -1 when not found.
+ */
+BLI_INLINE int flathash_find_ex(
+        const FlatHash *fh, const void *key, const uint hash, const eFlatHashKeyType key_type)
+{
+	const signed char h2 = flathash_h2(hash);
+	uint group = flathash_h1(hash) & fh->group_mask;
+
+	for (uint step = 1; ; step++) {
+		const signed char *ctrl = &fh->ctrl[group * FLATHASH_GROUP_SIZE];
+		const FlatHashSlot *slots = &fh->slots[group * FLATHASH_GROUP_SIZE];
+
+		uint match = flathash_group_match(ctrl, h2);
+		while (match) {
+			const uint i = bitscan_forward_clear_uint(&match);
+			if (flathash_keyeq(fh, key, slots[i].key, key_type)) {
+				return (int)(group * FLATHASH_GROUP_SIZE + i);
+			}
+		}
+		if (flathash_group_match_empty(ctrl)) {
+			return -1;
+		}
+		/* Triangular numbers visit every group, since the group count is a power of two. */
+		group = (group + step) & fh->group_mask;
+	}
+}
+
+static int flathash_find(const FlatHash *fh, const void *key, uint *r_hash)
+{
+	switch (fh->key_type) {
+		case FLATHASH_KEY_PTR:
+			*r_hash = flathash_keyhash(fh, key, FLATHASH_KEY_PTR);
+			return flathash_find_ex(fh, key, *r_hash, FLATHASH_KEY_PTR);
+		case FLATHASH_KEY_INT:
+			*r_hash = flathash_keyhash(fh, key, FLATHASH_KEY_INT);
+			return flathash_find_ex(fh, key, *r_hash, FLATHASH_KEY_INT);
+		case FLATHASH_KEY_STR:
+			*r_hash = flathash_keyhash(fh, key, FLATHASH_KEY_STR);
+			return flathash_find_ex(fh, key, *r_hash, FLATHASH_KEY_STR);
+		case FLATHASH_KEY_GENERIC:
+		default:
+			*r_hash = flathash_keyhash(fh, key, FLATHASH_KEY_GENERIC);
+			return flathash_find_ex(fh, key, *r_hash, FLATHASH_KEY_GENERIC);
+	}
+}
+
+/**
+ * First empty or deleted slot on the probe sequence of \a hash,
+ * the table must have at least one.
+ */
+static uint flathash_find_free(const FlatHash *fh, const uint hash)
+{
+	uint group = flathash_h1(hash) & fh->group_mask;
+
+	for (uint step = 1; ; step++) {
+		const uint mask = flathash_group_match_empty_or_deleted(&fh->ctrl[group * FLATHASH_GROUP_SIZE]);
+		if (mask) {
+			return group * FLATHASH_GROUP_SIZE + bitscan_forward_uint(mask);
+		}
+		group = (group + step) & fh->group_mask;
+	}
+}
+
+/* Number of groups needed to hold \a nentries without growing. */
+static uint flathash_groups_for_entries(const uint nentries)
+{
+	uint num_groups = 1;
+	while (FLATHASH_MAX_LOAD(num_groups * FLATHASH_GROUP_SIZE) < nentries) {
+		num_groups *= 2;
+	}
+	return num_groups;
+}
+
+static void flathash_alloc(FlatHash *fh, const uint num_groups)
+{
+	const uint capacity = num_groups * FLATHASH_GROUP_SIZE;
+	fh->ctrl = MEM_mallocN_aligned((size_t)capacity, 16, "FlatHash ctrl");
+	fh->slots = MEM_mallocN(sizeof(*fh->slots) * (size_t)capacity, "FlatHash slots");
+	memset(fh->ctrl, FLATHASH_CTRL_EMPTY, (size_t)capacity);
+	fh->group_mask = num_groups - 1;
+	fh->growth_left = FLATHASH_MAX_LOAD(capacity);
+}
+
+static void flathash_set_ctrl(FlatHash *fh, const uint index, const signed char h2)
+{
+	if (fh->ctrl[index] == FLATHASH_CTRL_EMPTY) {
+		fh->growth_left--;
+	}
+	fh->ctrl[index] = h2;
+}
+
+/**
+ * Move all entries to tables of \a num_groups groups,
+ * this also gets rid of deleted slots.
+ */
+static void flathash_resize(FlatHash *fh, const uint num_groups)
+{
+	signed char *ctrl_old = fh->ctrl;
+	FlatHashSlot *slots_old = fh->slots;
+	const uint capacity_old = flathash_capacity(fh);
+
+	flathash_alloc(fh, num_groups);
+
+	for (uint i = 0; i < capacity_old; i++) {
+		if (ctrl_old[i] >= 0) {
+			const uint hash = flathash_keyhash(fh, slots_old[i].key, fh->key_type);
+			const uint index = flathash_find_free(fh, hash);
+			flathash_set_ctrl(fh, index, flathash_h2(hash));
+			fh->slots[index] = slots_old[i];
+		}
+	}
+
+	MEM_freeN(ctrl_old);
+	MEM_freeN(slots_old);
+}
+
+/* Make sure one more entry can be added. */
+static void flathash_ensure_growth(FlatHash *fh)
+{
+	if (fh->growth_left != 0) {
+		return;
+	}
+	const uint num_groups = fh->group_mask + 1;
+	if (fh->nentries >= FLATHASH_MAX_LOAD(flathash_capacity(fh)) / 2) {
+		flathash_resize(fh, num_groups * 2);
+	}
+	else {
+		/* Mostly deleted slots, clean them up in place. */
+		flathash_resize(fh, num_groups);
+	}
+}
+
+/**
+ * Add a new entry, \a key must not be in \a fh.
+ *
+ * \return the slot index.
+ */
+static uint flathash_insert_ex(FlatHash *fh, void *key, uint hash)
+{
+	flathash_ensure_growth(fh);
+	const uint index = flathash_find_free(fh, hash);
+	flathash_set_ctrl(fh, index, flathash_h2(hash));
+	fh->slots[index].key = key;
+	fh->nentries++;
+	return index;
+}
+
+static void flathash_remove_ex(FlatHash *fh, const uint index)
+{
+	const uint group = index & ~(uint)(FLATHASH_GROUP_SIZE - 1);
+	/* Probing stops at groups with an empty slot, so the slot can only be made
+	 * empty again when no probe sequence was continued past this group. */
+	fh->ctrl[index] = flathash_group_match_empty(&fh->ctrl[group]) ? FLATHASH_CTRL_EMPTY : FLATHASH_CTRL_DELETED;
+	if (fh->ctrl[index] == FLATHASH_CTRL_EMPTY) {
+		fh->growth_left++;
+	}
+	fh->nentries--;
+}
+
+static void flathash_free_entries(FlatHash *fh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	if (keyfreefp == NULL && valfreefp == NULL) {
+		return;
+	}
+	const uint capacity = flathash_capacity(fh);
+	for (uint i = 0; i < capacity; i++) {
+		if (fh->ctrl[i] >= 0) {
+			if (keyfreefp) {
+				keyfreefp(fh->slots[i].key);
+			}
+			if (valfreefp) {
+				valfreefp(fh->slots[i].val);
+			}
+		}
+	}
+}
+
+static FlatHash *flathash_new(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const eFlatHashKeyType key_type,
+        const char *info, const uint nentries_reserve)
+{
+	FlatHash *fh = MEM_mallocN(sizeof(*fh), info);
+	fh->hashfp = hashfp;
+	fh->cmpfp = cmpfp;
+	fh->key_type = key_type;
+	fh->nentries = 0;
+	flathash_alloc(fh, flathash_groups_for_entries(nentries_reserve));
+	return fh;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name FlatHash Public API
+ * \{ */
+
+/**
+ * Creates a new, empty FlatHash.
+ *
+ * \param hashfp: Hash callback.
+ * \param cmpfp: Comparison callback.
+ * \param info: Identifier string for the FlatHash.
+ * \param nentries_reserve: Optionally reserve the number of members that the hash will hold.
+ * \return  An empty FlatHash.
+ */
+FlatHash *BLI_flathash_new_ex(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+        const uint nentries_reserve)
+{
+	return flathash_new(hashfp, cmpfp, FLATHASH_KEY_GENERIC, info, nentries_reserve);
+}
+
+/**
+ * Wraps #BLI_flathash_new_ex with zero entries reserved.
+ */
+FlatHash *BLI_flathash_new(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info)
+{
+	return BLI_flathash_new_ex(hashfp, cmpfp, info, 0);
+}
+
+/**
+ * Frees the FlatHash and its members.
+ *
+ * \param keyfreefp: Optional callback to free the key.
+ * \param valfreefp: Optional callback to free the value.
+ */
+void BLI_flathash_free(FlatHash *fh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	flathash_free_entries(fh, keyfreefp, valfreefp);
+	MEM_freeN(fh->ctrl);
+	MEM_freeN(fh->slots);
+	MEM_freeN(fh);
+}
+
+/**
+ * Reserve given amount of entries (resize \a fh accordingly if needed).
+ */
+void BLI_flathash_reserve(FlatHash *fh, const uint nentries_reserve)
+{
+	const uint num_groups = flathash_groups_for_entries(nentries_reserve);
+	if (num_groups > fh->group_mask + 1) {
+		flathash_resize(fh, num_groups);
+	}
+}
+
+/**
+ * \return size of the FlatHash.
+ */
+uint BLI_flathash_len(FlatHash *fh)
+{
+	return fh->nentries;
+}
+
+/**
+ * Insert a key/value pair into the \a fh.
+ *
+ * \note Duplicates are not checked,
+ * the caller is expected to ensure elements are unique.
+ */
+void BLI_flathash_insert(FlatHash *fh, void *key, void *val)
+{
+	BLI_assert(!BLI_flathash_haskey(fh, key));
+	const uint hash = flathash_keyhash(fh, key, fh->key_type);
+	const uint index = flathash_insert_ex(fh, key, hash);
+	fh->slots[index].val = val;
+}
+
+/**
+ * Inserts a new value to a key that may already be in \a fh.
+ *
+ * \returns true if a new key has been added.
+ */
+bool BLI_flathash_reinsert(
+        FlatHash *fh, void *key, void *val, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	uint hash;
+	const int index = flathash_find(fh, key, &hash);
+	if (index != -1) {
+		FlatHashSlot *slot = &fh->slots[index];
+		if (keyfreefp) {
+			keyfreefp(slot->key);
+		}
+		if (valfreefp) {
+			valfreefp(slot->val);
+		}
+		slot->key = key;
+		slot->val = val;
+		return false;
+	}
+	const uint index_new = flathash_insert_ex(fh, key, hash);
+	fh->slots[index_new].val = val;
+	return true;
+}
+
+/**
+ * Replaces the key of an item in the \a fh.
+ *
+ * \returns The previous key or NULL if not found, the caller may free if it's needed.
+ */
+void *BLI_flathash_replace_key(FlatHash *fh, void *key)
+{
+	uint hash;
+	const int index = flathash_find(fh, key, &hash);
+	if (index != -1) {
+		void *key_prev = fh->slots[index].key;
+		fh->slots[index].key = key;
+		return key_prev;
+	}
+	return NULL;
+}
+
+/**
+ * Lookup the value of \a key in \a fh.
+ *
+ * \returns the value for \a key or NULL.
+ */
+void *BLI_flathash_lookup(FlatHash *fh, const void *key)
+{
+	return BLI_flathash_lookup_default(fh, key, NULL);
+}
+
+/**
+ * A version of #BLI_flathash_lookup which accepts a fallback argument.
+ */
+void *BLI_flathash_lookup_default(FlatHash *fh, const void *key, void *val_default)
+{
+	uint hash;
+	const int index = flathash_find(fh, key, &hash);
+	return (index != -1) ? fh->slots[index].val : val_default;
+}
+
+/**
+ * Lookup a pointer to the value of \a key in \a fh.
+ *
+ * \returns the pointer to value for \a key or NULL.
+ *
+ * \note The pointer is only valid until the next insertion.
+ */
+void **BLI_flathash_lookup_p(FlatHash *fh, const void *key)
+{
+	uint hash;
+	const int index = flathash_find(fh, key, &hash);
+	return (index != -1) ? &fh->slots[index].val : NULL;
+}
+
+/**
+ * Ensure \a key is exists in \a fh, see #BLI_ghash_ensure_p.
+ *
+ * \returns true when the value didn't need to be added.
+ * (when false, the caller _must_ initialize the value).
+ *
+ * \note The pointer is only valid until the next insertion.
+ */
+bool BLI_flathash_ensure_p(FlatHash *fh, void *key, void ***r_val)
+{
+	uint hash;
+	int index = flathash_find(fh, key, &hash);
+	const bool haskey = (index != -1);
+	if (!haskey) {
+		index = (int)flathash_insert_ex(fh, key, hash);
+	}
+	*r_val = &fh->slots[index].val;
+	return haskey;
+}
+
+/**
+ * A version of #BLI_flathash_ensure_p that allows caller to re-assign the key.
+ * Typically used when the key is to be duplicated.
+ *
+ * \warning Caller _must_ write to \a r_key when returning false.
+ */
+bool BLI_flathash_ensure_p_ex(FlatHash *fh, const void *key, void ***r_key, void ***r_val)
+{
+	uint hash;
+	int index = flathash_find(fh, key, &hash);
+	const bool haskey = (index != -1);
+	if (!haskey) {
+		/* Pass 'key' in case we resize. */
+		index = (int)flathash_insert_ex(fh, (void *)key, hash);
+		fh->slots[index].key = NULL;  /* caller must re-assign */
+	}
+	*r_key = &fh->slots[index].key;
+	*r_val = &fh->slots[index].val;
+	return haskey;
+}
+
+/**
+ * Remove \a key from \a fh, or return false if the key wasn't found.
+ *
+ * \param key: The key to remove.
+ * \param keyfreefp: Optional callback to free the key.
+ * \param valfreefp: Optional callback to free the value.
+ * \return true if \a key was removed from \a fh.
+ */
+bool BLI_flathash_remove(FlatHash *fh, const void *key, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	uint hash;
+	const int index = flathash_find(fh, key, &hash);
+	if (index == -1) {
+		return false;
+	}
+	if (keyfreefp) {
+		keyfreefp(fh->slots[index].key);
+	}
+	if (valfreefp) {
+		valfreefp(fh->slots[index].val);
+	}
+	flathash_remove_ex(fh, (uint)index);
+	return true;
+}
+
+/**
+ * Remove \a key from \a fh, returning the value or NULL if the key wasn't found.
+ *
+ * \param key: The key to remove.
+ * \param keyfreefp: Optional callback to free the key.
+ * \return the value of \a key int \a fh or NULL.
+ */
+void *BLI_flathash_popkey(FlatHash *fh, const void *key, GHashKeyFreeFP keyfreefp)
+{
+	uint hash;
+	const int index = flathash_find(fh, key, &hash);
+	if (index == -1) {
+		return NULL;
+	}
+	void *val = fh->slots[index].val;
+	if (keyfreefp) {
+		keyfreefp(fh->slots[index].key);
+	}
+	flathash_remove_ex(fh, (uint)index);
+	return val;
+}
+
+/**
+ * \return true if the \a key is in \a fh.
+ */
+bool BLI_flathash_haskey(FlatHash *fh, const void *key)
+{
+	uint hash;
+	return (flathash_find(fh, key, &hash) != -1);
+}
+
+/**
+ * Reset \a fh clearing all entries.
+ *
+ * \param keyfreefp: Optional callback to free the key.
+ * \param valfreefp: Optional callback to free the value.
+ * \param nentries_reserve: Optionally reserve the number of members that the hash will hold.
+ */
+void BLI_flathash_clear_ex(
+        FlatHash *fh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp,
+        const uint nentries_reserve)
+{
+	flathash_free_entries(fh, keyfreefp, valfreefp);
+
+	const uint num_groups = flathash_groups_for_entries(nentries_reserve);
+	if (num_groups != fh->group_mask + 1) {
+		MEM_freeN(fh->ctrl);
+		MEM_freeN(fh->slots);
+		flathash_alloc(fh, num_groups);
+	}
+	else {
+		memset(fh->ctrl, FLATHASH_CTRL_EMPTY, (size_t)flathash_capacity(fh));
+		fh->growth_left = FLATHASH_MAX_LOAD(flathash_capacity(fh));
+	}
+	fh->nentries = 0;
+}
+
+/**
+ * Wraps #BLI_flathash_clear_ex with zero entries reserved.
+ */
+void BLI_flathash_clear(FlatHash *fh, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	BLI_flathash_clear_ex(fh, keyfreefp, valfreefp, 0);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name FlatHash Iterator API
+ * \{ */
+
+static void flathash_iterator_next(FlatHashIterator *fhi, uint index)
+{
+	FlatHash *fh = fhi->fh;
+	const uint capacity = flathash_capacity(fh);
+
+	for (; index < capacity; index += FLATHASH_GROUP_SIZE) {
+		const uint group = index & ~(uint)(FLATHASH_GROUP_SIZE - 1);
+		/* Full slots of the group, starting at index. */
+		const uint full = ~flathash_group_match_empty_or_deleted(&fh->ctrl[group]) &
+		                  (0xffffu << (index - group)) & 0xffffu;
+		if (full) {
+			fhi->curr_index = group + bitscan_forward_uint(full);
+			fhi->curr_slot = (void **)&fh->slots[fhi->curr_index];
+			return;
+		}
+		index = group;
+	}
+
+	fhi->curr_index = capacity;
+	fhi->curr_slot = NULL;
+}
+
+/**
+ * Init an already allocated FlatHashIterator.
+ *
+ * \param fhi: The FlatHashIterator to initialize.
+ * \param fh: The FlatHash to iterate over.
+ */
+void BLI_flathashIterator_init(FlatHashIterator *fhi, FlatHash *fh)
+{
+	fhi->fh = fh;
+	flathash_iterator_next(fhi, 0);
+}
+
+/**
+ * Steps the iterator to the next entry.
+ *
+ * \param fhi: The iterator.
+ */
+void BLI_flathashIterator_step(FlatHashIterator *fhi)
+{
+	if (fhi->curr_slot) {
+		flathash_iterator_next(fhi, fhi->curr_index + 1);
+	}
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name FlatHash Specializations
+ * \{ */
+
+FlatHash *BLI_flathash_ptr_new_ex(const char *info, const uint nentries_reserve)
+{
+	return flathash_new(BLI_ghashutil_ptrhash, BLI_ghashutil_ptrcmp, FLATHASH_KEY_PTR, info, nentries_reserve);
+}
+FlatHash *BLI_flathash_ptr_new(const char *info)
+{
+	return BLI_flathash_ptr_new_ex(info, 0);
+}
+
+FlatHash *BLI_flathash_int_new_ex(const char *info, const uint nentries_reserve)
+{
+	return flathash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, FLATHASH_KEY_INT, info, nentries_reserve);
+}
+FlatHash *BLI_flathash_int_new(const char *info)
+{
+	return BLI_flathash_int_new_ex(info, 0);
+}
+
+FlatHash *BLI_flathash_str_new_ex(const char *info, const uint nentries_reserve)
+{
+	return flathash_new(BLI_ghashutil_strhash_p, BLI_ghashutil_strcmp, FLATHASH_KEY_STR, info, nentries_reserve);
+}
+FlatHash *BLI_flathash_str_new(const char *info)
+{
+	return BLI_flathash_str_new_ex(info, 0);
+}
+
+/** \} */
@@ -36,10 +36,20 @@
  *   #BLI_bvhtree_overlap, #BVHOverlapData_Shared, #BVHOverlapData_Thread
  * - Range Query:
  *   #BLI_bvhtree_range_query
+ * - Batched ray-cast and nearest point queries:
+ *   #BLI_bvhtree_ray_cast_batch, #BLI_bvhtree_find_nearest_batch
+ *
+ * Trees with up to 4 children per node are also flattened into a compact layout
+ * used by the ray-cast, nearest and range queries, built on the first of those queries,
+ * see #BVHNodeCompact.
  */
 
 #include <assert.h>
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 #include "MEM_guardedalloc.h"
 
 #include "BLI_utildefines.h"
@@ -47,9 +57,13 @@
 #include "BLI_stack.h"
 #include "BLI_kdopbvh.h"
 #include "BLI_math.h"
+#include "BLI_math_bits.h"
 #include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_heap_simple.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_strict_flags.h"
 
 /* used for iterative_raycast */
@@ -61,6 +75,9 @@
 /* Check tree is valid. */
 // #define USE_VERIFY_TREE
 
+/* Build a flattened 4-wide layout used by the queries, see #BVHNodeCompact. */
+#define USE_COMPACT_NODES
+
 
 #define MAX_TREETYPE 32
 
@@ -92,23 +109,50 @@ typedef struct BVHNode {
 	char main_axis; /* Axis used to split this node */
 } BVHNode;
 
+#ifdef USE_COMPACT_NODES
+#define BVH_COMPACT_WIDTH 4
+
+/**
+ * Flattened node with up to 4 children, the x/y/z bounds of the children are quantized
+ * to 8 bits relative to the bounds of this node so a node fits in a single cache line.
+ *
+ * Quantized bounds are rounded outwards, the exact tests are done on the #BVHNode of the leaves.
+ */
+typedef struct BVHNodeCompact {
+	float origin[3];    /* minimum of this node bounds */
+	float scale[3];     /* size of a quantization step */
+	unsigned char bv_min[3][BVH_COMPACT_WIDTH];  /* per axis, the bounds of each child */
+	unsigned char bv_max[3][BVH_COMPACT_WIDTH];
+	/* > 0: index of a compact node, < 0: ~index of a leaf in BVHTree.nodearray, 0: unused. */
+	int children[BVH_COMPACT_WIDTH];
+} BVHNodeCompact;
+
+BLI_STATIC_ASSERT(sizeof(BVHNodeCompact) == 64, "cache line size")
+#endif
+
 /* keep under 26 bytes for speed purposes */
 struct BVHTree {
 	BVHNode **nodes;
 	BVHNode *nodearray;     /* pre-alloc branch nodes */
 	BVHNode **nodechild;    /* pre-alloc childs for nodes */
 	float   *nodebv;        /* pre-alloc bounding-volumes for nodes */
+#ifdef USE_COMPACT_NODES
+	BVHNodeCompact *compact;  /* flattened branch nodes, NULL when unsupported by the tree */
+#endif
 	float epsilon;          /* epslion is used for inflation of the k-dop	   */
 	int totleaf;            /* leafs */
 	int totbranch;
 	axis_t start_axis, stop_axis;  /* bvhtree_kdop_axes array indices according to axis */
 	axis_t axis;                   /* kdop type (6 => OBB, 7 => AABB, ...) */
 	char tree_type;                /* type of tree (4 => quadtree) */
+#ifdef USE_COMPACT_NODES
+	uint8_t compact_valid;         /* the compact nodes match the tree, see #bvhtree_compact_ensure */
+#endif
 };
 
 /* optimization, ensure we stay small */
-BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 48) ||
-                  (sizeof(void *) == 4 && sizeof(BVHTree) <= 32),
+BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 64) ||
+                  (sizeof(void *) == 4 && sizeof(BVHTree) <= 40),
                   "over sized")
 
 /* avoid duplicating vars in BVHOverlapData_Thread */
@@ -812,6 +856,225 @@ static void non_recursive_bvh_div_nodes(
 /** \} */
 
 
+/* -------------------------------------------------------------------- */
+/** \name Compact Layout
+ *
+ * On the first ray-cast, nearest or range query after balancing or updating the tree,
+ * the branches are flattened into #BVHNodeCompact,
+ * binary and ternary trees are collapsed into 4-wide nodes by pulling up
+ * the children of the largest child nodes.
+ *
+ * Queries walk the compact nodes, only reading the #BVHNode of the leaves.
+ * \{ */
+
+#ifdef USE_COMPACT_NODES
+
+static bool bvhtree_compact_supported(const BVHTree *tree)
+{
+	/* only the x/y/z axes are stored */
+	return (tree->tree_type <= BVH_COMPACT_WIDTH) && (tree->start_axis == 0);
+}
+
+static float bv_half_area(const float bv[6])
+{
+	const float size[3] = {bv[1] - bv[0], bv[3] - bv[2], bv[5] - bv[4]};
+	return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+}
+
+static void compact_node_quantize(BVHNodeCompact *cnode, const float bv[6], BVHNode **children, int children_len)
+{
+	for (int axis = 0; axis < 3; axis++) {
+		const float origin = bv[2 * axis];
+		const float end = bv[2 * axis + 1];
+		/* grow the step until the last one reaches the end, in case of rounding */
+		const float step_ulp = max_ff(2.0f * (nextafterf(fabsf(end), FLT_MAX) - fabsf(end)) / 255.0f, FLT_MIN);
+		float scale = (end - origin) / 255.0f;
+		while (origin + 255.0f * scale < end) {
+			scale = max_ff(scale + step_ulp, nextafterf(scale, FLT_MAX));
+		}
+
+		cnode->origin[axis] = origin;
+		cnode->scale[axis] = scale;
+
+		for (int i = 0; i < children_len; i++) {
+			const float *child_bv = &children[i]->bv[2 * axis];
+			int q_min = 0, q_max = 255;
+
+			if (scale > 0.0f) {
+				q_min = (int)floorf(clamp_f((child_bv[0] - origin) / scale, 0.0f, 255.0f));
+				q_max = (int)ceilf(clamp_f((child_bv[1] - origin) / scale, 0.0f, 255.0f));
+			}
+			/* round outwards, the child must be inside its quantized bounds */
+			while (q_min > 0 && origin + (float)q_min * scale > child_bv[0]) {
+				q_min--;
+			}
+			while (q_max < 255 && origin + (float)q_max * scale < child_bv[1]) {
+				q_max++;
+			}
+
+			cnode->bv_min[axis][i] = (unsigned char)q_min;
+			cnode->bv_max[axis][i] = (unsigned char)q_max;
+		}
+	}
+}
+
+static int compact_node_build(BVHTree *tree, const BVHNode *node, int *r_compact_len)
+{
+	const int cnode_index = (*r_compact_len)++;
+	BVHNodeCompact *cnode = &tree->compact[cnode_index];
+	BVHNode *children[BVH_COMPACT_WIDTH];
+	int children_len = 0;
+
+	for (int i = 0; i < node->totnode; i++) {
+		children[children_len++] = node->children[i];
+	}
+
+	/* collapse: replace the largest branch by its children while they fit */
+	while (true) {
+		int best = -1;
+		float best_area = -1.0f;
+		for (int i = 0; i < children_len; i++) {
+			if (children[i]->totnode != 0 &&
+			    children_len + children[i]->totnode - 1 <= BVH_COMPACT_WIDTH)
+			{
+				const float area = bv_half_area(children[i]->bv);
+				if (area > best_area) {
+					best = i;
+					best_area = area;
+				}
+			}
+		}
+		if (best == -1) {
+			break;
+		}
+
+		const BVHNode *child = children[best];
+		children[best] = child->children[0];
+		for (int i = 1; i < child->totnode; i++) {
+			children[children_len++] = child->children[i];
+		}
+	}
+
+	compact_node_quantize(cnode, node->bv, children, children_len);
+
+	for (int i = 0; i < BVH_COMPACT_WIDTH; i++) {
+		if (i >= children_len) {
+			cnode->children[i] = 0;
+		}
+		else if (children[i]->totnode == 0) {
+			cnode->children[i] = ~(int)(children[i] - tree->nodearray);
+		}
+		else {
+			cnode->children[i] = compact_node_build(tree, children[i], r_compact_len);
+		}
+	}
+
+	return cnode_index;
+}
+
+/**
+ * Build (or rebuild after the bounds changed) the compact layout of a balanced tree.
+ */
+static void bvhtree_compact_build(BVHTree *tree)
+{
+	const BVHNode *root = tree->nodes[tree->totleaf];
+	int compact_len = 0;
+
+	if (!bvhtree_compact_supported(tree) || root->totnode == 0) {
+		return;
+	}
+
+	/* collapsing only removes branches */
+	if (tree->compact == NULL) {
+		tree->compact = MEM_mallocN_aligned(sizeof(*tree->compact) * (size_t)tree->totbranch, 64, __func__);
+	}
+
+	compact_node_build(tree, root, &compact_len);
+	BLI_assert(compact_len <= tree->totbranch);
+}
+
+static ThreadMutex bvhtree_compact_mutex = BLI_MUTEX_INITIALIZER;
+
+/**
+ * Build the compact layout when it's out of date, trees which are only used for overlap
+ * queries (cloth, collision, refit every step) never build it.
+ *
+ * Queries may run from multiple threads at once, so the build is done under a lock.
+ *
+ * \return the compact nodes, NULL when the tree isn't supported.
+ */
+static const BVHNodeCompact *bvhtree_compact_ensure(BVHTree *tree)
+{
+	if (UNLIKELY(*(volatile uint8_t *)&tree->compact_valid == 0)) {
+		BLI_mutex_lock(&bvhtree_compact_mutex);
+		if (tree->compact_valid == 0) {
+			bvhtree_compact_build(tree);
+			atomic_fetch_and_or_uint8(&tree->compact_valid, 1);
+		}
+		BLI_mutex_unlock(&bvhtree_compact_mutex);
+	}
+	return tree->compact;
+}
+
+BLI_INLINE uint compact_node_children_mask(const BVHNodeCompact *cnode)
+{
+	return ((cnode->children[0] != 0) ? 1u : 0u) |
+	       ((cnode->children[1] != 0) ? 2u : 0u) |
+	       ((cnode->children[2] != 0) ? 4u : 0u) |
+	       ((cnode->children[3] != 0) ? 8u : 0u);
+}
+
+/**
+ * Dequantized bounds of the children, per axis.
+ */
+BLI_INLINE void compact_node_bounds(
+        const BVHNodeCompact *cnode, float r_min[3][BVH_COMPACT_WIDTH], float r_max[3][BVH_COMPACT_WIDTH])
+{
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+	for (int axis = 0; axis < 3; axis++) {
+		const __m128 origin = _mm_set1_ps(cnode->origin[axis]);
+		const __m128 scale = _mm_set1_ps(cnode->scale[axis]);
+		int q_min, q_max;
+		memcpy(&q_min, cnode->bv_min[axis], sizeof(q_min));
+		memcpy(&q_max, cnode->bv_max[axis], sizeof(q_max));
+		const __m128i q_min_i = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(q_min), zero), zero);
+		const __m128i q_max_i = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(q_max), zero), zero);
+		_mm_storeu_ps(r_min[axis], _mm_add_ps(origin, _mm_mul_ps(_mm_cvtepi32_ps(q_min_i), scale)));
+		_mm_storeu_ps(r_max[axis], _mm_add_ps(origin, _mm_mul_ps(_mm_cvtepi32_ps(q_max_i), scale)));
+	}
+#else
+	for (int axis = 0; axis < 3; axis++) {
+		for (int i = 0; i < BVH_COMPACT_WIDTH; i++) {
+			r_min[axis][i] = cnode->origin[axis] + (float)cnode->bv_min[axis][i] * cnode->scale[axis];
+			r_max[axis][i] = cnode->origin[axis] + (float)cnode->bv_max[axis][i] * cnode->scale[axis];
+		}
+	}
+#endif
+}
+
+/**
+ * Sort the children in \a mask by increasing \a dist, returns the number of children.
+ */
+BLI_INLINE int compact_node_children_order(uint mask, const float dist[BVH_COMPACT_WIDTH], int r_order[BVH_COMPACT_WIDTH])
+{
+	int order_len = 0;
+	while (mask) {
+		const int i = (int)bitscan_forward_clear_uint(&mask);
+		int j = order_len++;
+		for (; j > 0 && dist[r_order[j - 1]] > dist[i]; j--) {
+			r_order[j] = r_order[j - 1];
+		}
+		r_order[j] = i;
+	}
+	return order_len;
+}
+
+#endif  /* USE_COMPACT_NODES */
+
+/** \} */
+
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree API
  * \{ */
@@ -905,6 +1168,9 @@ void BLI_bvhtree_free(BVHTree *tree)
 		MEM_SAFE_FREE(tree->nodearray);
 		MEM_SAFE_FREE(tree->nodebv);
 		MEM_SAFE_FREE(tree->nodechild);
+#ifdef USE_COMPACT_NODES
+		MEM_SAFE_FREE(tree->compact);
+#endif
 		MEM_freeN(tree);
 	}
 }
@@ -931,6 +1197,10 @@ void BLI_bvhtree_balance(BVHTree *tree)
 	build_skip_links(tree, tree->nodes[tree->totleaf], NULL, NULL);
 #endif
 
+#ifdef USE_COMPACT_NODES
+	tree->compact_valid = 0;
+#endif
+
 #ifdef USE_VERIFY_TREE
 	bvhtree_verify(tree);
 #endif
@@ -1001,6 +1271,10 @@ void BLI_bvhtree_update_tree(BVHTree *tree)
 
 	for (; index >= root; index--)
 		node_join(tree, *index);
+
+#ifdef USE_COMPACT_NODES
+	tree->compact_valid = 0;
+#endif
 }
 /**
  * Number of times #BLI_bvhtree_insert has been called.
@@ -1302,6 +1576,79 @@ static void dfs_find_nearest_dfs(BVHNearestData *data, BVHNode *node)
 	}
 }
 
+#ifdef USE_COMPACT_NODES
+
+/**
+ * Same as #calc_nearest_point_squared for all children of \a cnode.
+ *
+ * \return the mask of children closer than \a dist_sq_max.
+ */
+BLI_INLINE uint compact_nearest_overlap(
+        const float co[3], const BVHNodeCompact *cnode, const float dist_sq_max,
+        float r_dist_sq[BVH_COMPACT_WIDTH])
+{
+	float bv_min[3][BVH_COMPACT_WIDTH], bv_max[3][BVH_COMPACT_WIDTH];
+
+	compact_node_bounds(cnode, bv_min, bv_max);
+
+#ifdef __SSE2__
+	__m128 dist_sq = _mm_setzero_ps();
+	for (int axis = 0; axis < 3; axis++) {
+		const __m128 co_axis = _mm_set1_ps(co[axis]);
+		const __m128 nearest = _mm_min_ps(_mm_max_ps(co_axis, _mm_loadu_ps(bv_min[axis])), _mm_loadu_ps(bv_max[axis]));
+		const __m128 d = _mm_sub_ps(co_axis, nearest);
+		dist_sq = _mm_add_ps(dist_sq, _mm_mul_ps(d, d));
+	}
+	_mm_storeu_ps(r_dist_sq, dist_sq);
+	return (uint)_mm_movemask_ps(_mm_cmplt_ps(dist_sq, _mm_set1_ps(dist_sq_max)));
+#else
+	uint mask = 0;
+	for (int i = 0; i < BVH_COMPACT_WIDTH; i++) {
+		r_dist_sq[i] = 0.0f;
+		for (int axis = 0; axis < 3; axis++) {
+			const float d = co[axis] - min_ff(max_ff(co[axis], bv_min[axis][i]), bv_max[axis][i]);
+			r_dist_sq[i] += d * d;
+		}
+		if (r_dist_sq[i] < dist_sq_max) {
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+#endif
+}
+
+static void dfs_find_nearest_compact(BVHNearestData *data, const BVHNodeCompact *cnode)
+{
+	float dist_sq[BVH_COMPACT_WIDTH];
+	int order[BVH_COMPACT_WIDTH];
+	const uint mask = compact_node_children_mask(cnode) &
+	                  compact_nearest_overlap(data->proj, cnode, data->nearest.dist_sq, dist_sq);
+	const int order_len = compact_node_children_order(mask, dist_sq, order);
+
+	/* closest first */
+	for (int j = 0; j < order_len; j++) {
+		const int i = order[j];
+		const int child = cnode->children[i];
+
+		if (dist_sq[i] >= data->nearest.dist_sq) {
+			break;
+		}
+
+		if (child < 0) {
+			BVHNode *leaf = &data->tree->nodearray[~child];
+			float nearest[3];
+			if (calc_nearest_point_squared(data->proj, leaf, nearest) < data->nearest.dist_sq) {
+				dfs_find_nearest_dfs(data, leaf);
+			}
+		}
+		else {
+			dfs_find_nearest_compact(data, &data->tree->compact[child]);
+		}
+	}
+}
+
+#endif  /* USE_COMPACT_NODES */
+
 static void dfs_find_nearest_begin(BVHNearestData *data, BVHNode *node)
 {
 	float nearest[3], dist_sq;
@@ -1309,6 +1656,12 @@ static void dfs_find_nearest_begin(BVHNearestData *data, BVHNode *node)
 	if (dist_sq >= data->nearest.dist_sq) {
 		return;
 	}
+#ifdef USE_COMPACT_NODES
+	if (data->tree->compact) {
+		dfs_find_nearest_compact(data, data->tree->compact);
+		return;
+	}
+#endif
 	dfs_find_nearest_dfs(data, node);
 }
 
@@ -1390,6 +1743,9 @@ int BLI_bvhtree_find_nearest_ex(
 			heap_find_nearest_begin(&data, root);
 		}
 		else {
+#ifdef USE_COMPACT_NODES
+			bvhtree_compact_ensure(tree);
+#endif
 			dfs_find_nearest_begin(&data, root);
 		}
 	}
@@ -1520,6 +1876,87 @@ static void dfs_raycast(BVHRayCastData *data, BVHNode *node)
 	}
 }
 
+#ifdef USE_COMPACT_NODES
+
+/**
+ * Same as #ray_nearest_hit for all children of \a cnode,
+ * \a idot_axis must be finite (see #ray_idot_axis_finite).
+ *
+ * \return the mask of children hit closer than the current hit.
+ */
+BLI_INLINE uint compact_ray_nearest_hit(
+        const BVHRayCastData *data, const float idot_axis[3], const BVHNodeCompact *cnode,
+        float r_dist[BVH_COMPACT_WIDTH])
+{
+	float bv_min[3][BVH_COMPACT_WIDTH], bv_max[3][BVH_COMPACT_WIDTH];
+
+	compact_node_bounds(cnode, bv_min, bv_max);
+
+#ifdef __SSE2__
+	const __m128 radius = _mm_set1_ps(data->ray.radius);
+	__m128 tnear = _mm_set1_ps(-FLT_MAX);
+	__m128 tfar = _mm_set1_ps(FLT_MAX);
+
+	for (int axis = 0; axis < 3; axis++) {
+		const __m128 origin = _mm_set1_ps(data->ray.origin[axis]);
+		const __m128 idot = _mm_set1_ps(idot_axis[axis]);
+		const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(bv_min[axis]), radius), origin), idot);
+		const __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(bv_max[axis]), radius), origin), idot);
+		tnear = _mm_max_ps(tnear, _mm_min_ps(t1, t2));
+		tfar = _mm_min_ps(tfar, _mm_max_ps(t1, t2));
+	}
+
+	const __m128 hit = _mm_and_ps(
+	        _mm_and_ps(_mm_cmple_ps(tnear, tfar), _mm_cmpge_ps(tfar, _mm_setzero_ps())),
+	        _mm_cmplt_ps(tnear, _mm_set1_ps(data->hit.dist)));
+	_mm_storeu_ps(r_dist, tnear);
+	return (uint)_mm_movemask_ps(hit);
+#else
+	uint mask = 0;
+	for (int i = 0; i < BVH_COMPACT_WIDTH; i++) {
+		float tnear = -FLT_MAX, tfar = FLT_MAX;
+		for (int axis = 0; axis < 3; axis++) {
+			const float t1 = (bv_min[axis][i] - data->ray.radius - data->ray.origin[axis]) * idot_axis[axis];
+			const float t2 = (bv_max[axis][i] + data->ray.radius - data->ray.origin[axis]) * idot_axis[axis];
+			tnear = max_ff(tnear, min_ff(t1, t2));
+			tfar = min_ff(tfar, max_ff(t1, t2));
+		}
+		if (tnear <= tfar && tfar >= 0.0f && tnear < data->hit.dist) {
+			mask |= 1u << i;
+		}
+		r_dist[i] = tnear;
+	}
+	return mask;
+#endif
+}
+
+static void dfs_raycast_compact(BVHRayCastData *data, const float idot_axis[3], const BVHNodeCompact *cnode)
+{
+	float dist[BVH_COMPACT_WIDTH];
+	int order[BVH_COMPACT_WIDTH];
+	const uint mask = compact_node_children_mask(cnode) & compact_ray_nearest_hit(data, idot_axis, cnode, dist);
+	const int order_len = compact_node_children_order(mask, dist, order);
+
+	/* front to back */
+	for (int j = 0; j < order_len; j++) {
+		const int i = order[j];
+		const int child = cnode->children[i];
+
+		if (dist[i] >= data->hit.dist) {
+			break;
+		}
+
+		if (child < 0) {
+			dfs_raycast(data, &data->tree->nodearray[~child]);
+		}
+		else {
+			dfs_raycast_compact(data, idot_axis, &data->tree->compact[child]);
+		}
+	}
+}
+
+#endif  /* USE_COMPACT_NODES */
+
 /**
  * A version of #dfs_raycast with minor changes to reset the index & dist each ray cast.
  */
@@ -1587,6 +2024,17 @@ static void bvhtree_ray_cast_data_precalc(BVHRayCastData *data, int flag)
 #endif
 }
 
+/**
+ * Inverse of the ray direction with infinite values clamped,
+ * avoids 'NaN' in the SIMD slab tests when the origin of an axis aligned ray is on a bound.
+ */
+static void ray_idot_axis_finite(const BVHRayCastData *data, float r_idot_axis[3])
+{
+	for (int i = 0; i < 3; i++) {
+		r_idot_axis[i] = isfinite(data->idot_axis[i]) ? data->idot_axis[i] : copysignf(FLT_MAX, data->idot_axis[i]);
+	}
+}
+
 int BLI_bvhtree_ray_cast_ex(
         BVHTree *tree, const float co[3], const float dir[3], float radius, BVHTreeRayHit *hit,
         BVHTree_RayCastCallback callback, void *userdata,
@@ -1617,7 +2065,17 @@ int BLI_bvhtree_ray_cast_ex(
 	}
 
 	if (root) {
-		dfs_raycast(&data, root);
+#ifdef USE_COMPACT_NODES
+		if (bvhtree_compact_ensure(tree)) {
+			float idot_axis[3];
+			ray_idot_axis_finite(&data, idot_axis);
+			dfs_raycast_compact(&data, idot_axis, tree->compact);
+		}
+		else
+#endif
+		{
+			dfs_raycast(&data, root);
+		}
 //		iterative_raycast(&data, root);
 	}
 
@@ -1707,6 +2165,401 @@ void BLI_bvhtree_ray_cast_all(
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_bvhtree_ray_cast_batch & BLI_bvhtree_find_nearest_batch
+ *
+ * Adjacent queries are traversed together in packets of #BVH_PACKET_SIZE,
+ * testing a node against all queries of the packet at once (with SSE when available).
+ * A node is visited when at least one query of the packet overlaps it,
+ * so this works best for coherent queries (neighbor vertices, rays of a grid... etc).
+ *
+ * Packets are processed in parallel.
+ *
+ * \{ */
+
+#define BVH_PACKET_SIZE 4
+
+typedef struct BVHRayPacket {
+	/* Per axis values of the rays, for the node tests. */
+	float origin[3][BVH_PACKET_SIZE];
+	float idot_axis[3][BVH_PACKET_SIZE];
+	float dist[BVH_PACKET_SIZE];
+	float radius;
+
+	BVHRayCastData data[BVH_PACKET_SIZE];
+} BVHRayPacket;
+
+typedef struct BVHNearestPacket {
+	/* Per axis coordinates of the points, for the node tests. */
+	float co[3][BVH_PACKET_SIZE];
+	float dist_sq[BVH_PACKET_SIZE];
+
+	BVHNearestData data[BVH_PACKET_SIZE];
+} BVHNearestPacket;
+
+typedef struct BVHRayCastBatchData {
+	const BVHTree *tree;
+	BVHNode *root;
+	const float (*co)[3];
+	const float (*dir)[3];
+	float radius;
+	BVHTreeRayHit *hits;
+	int rays_len;
+	BVHTree_RayCastCallback callback;
+	void *userdata;
+	int flag;
+} BVHRayCastBatchData;
+
+typedef struct BVHNearestBatchData {
+	BVHTree *tree;
+	BVHNode *root;
+	const float (*co)[3];
+	BVHTreeNearest *nearest;
+	int co_len;
+	BVHTree_NearestPointCallback callback;
+	void *userdata;
+	int flag;
+} BVHNearestBatchData;
+
+/**
+ * Same as #ray_nearest_hit for all rays of the packet.
+ *
+ * \return the mask of rays hitting the bounding volume closer than their current hit.
+ */
+BLI_INLINE uint ray_packet_nearest_hit(const BVHRayPacket *packet, const float bv[6], float r_dist[BVH_PACKET_SIZE])
+{
+#ifdef __SSE2__
+	const __m128 radius = _mm_set1_ps(packet->radius);
+	__m128 tnear = _mm_set1_ps(-FLT_MAX);
+	__m128 tfar = _mm_set1_ps(FLT_MAX);
+
+	for (int i = 0; i < 3; i++) {
+		const __m128 origin = _mm_loadu_ps(packet->origin[i]);
+		const __m128 idot_axis = _mm_loadu_ps(packet->idot_axis[i]);
+		const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_set1_ps(bv[2 * i]), radius), origin), idot_axis);
+		const __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_set1_ps(bv[2 * i + 1]), radius), origin), idot_axis);
+		tnear = _mm_max_ps(tnear, _mm_min_ps(t1, t2));
+		tfar = _mm_min_ps(tfar, _mm_max_ps(t1, t2));
+	}
+
+	const __m128 hit = _mm_and_ps(
+	        _mm_and_ps(_mm_cmple_ps(tnear, tfar), _mm_cmpge_ps(tfar, _mm_setzero_ps())),
+	        _mm_cmplt_ps(tnear, _mm_loadu_ps(packet->dist)));
+	_mm_storeu_ps(r_dist, tnear);
+	return (uint)_mm_movemask_ps(hit);
+#else
+	uint mask = 0;
+	for (int j = 0; j < BVH_PACKET_SIZE; j++) {
+		float tnear = -FLT_MAX, tfar = FLT_MAX;
+		for (int i = 0; i < 3; i++) {
+			const float t1 = (bv[2 * i] - packet->radius - packet->origin[i][j]) * packet->idot_axis[i][j];
+			const float t2 = (bv[2 * i + 1] + packet->radius - packet->origin[i][j]) * packet->idot_axis[i][j];
+			tnear = max_ff(tnear, min_ff(t1, t2));
+			tfar = min_ff(tfar, max_ff(t1, t2));
+		}
+		if (tnear <= tfar && tfar >= 0.0f && tnear < packet->dist[j]) {
+			mask |= 1u << j;
+		}
+		r_dist[j] = tnear;
+	}
+	return mask;
+#endif
+}
+
+static void dfs_raycast_packet(BVHRayPacket *packet, BVHNode *node, uint mask)
+{
+	float dist[BVH_PACKET_SIZE];
+
+	mask &= ray_packet_nearest_hit(packet, node->bv, dist);
+	if (mask == 0) {
+		return;
+	}
+
+	if (node->totnode == 0) {
+		do {
+			const uint i = bitscan_forward_clear_uint(&mask);
+			BVHRayCastData *data = &packet->data[i];
+			if (data->callback) {
+				data->callback(data->userdata, node->index, &data->ray, &data->hit);
+			}
+			else {
+				data->hit.index = node->index;
+				data->hit.dist  = dist[i];
+				madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist[i]);
+			}
+			packet->dist[i] = data->hit.dist;
+		} while (mask);
+	}
+	else {
+		/* pick loop direction based on the first ray of the packet still hitting */
+		const BVHRayCastData *data = &packet->data[bitscan_forward_uint(mask)];
+		if (data->ray_dot_axis[node->main_axis] > 0.0f) {
+			for (int i = 0; i != node->totnode; i++) {
+				dfs_raycast_packet(packet, node->children[i], mask);
+			}
+		}
+		else {
+			for (int i = node->totnode - 1; i >= 0; i--) {
+				dfs_raycast_packet(packet, node->children[i], mask);
+			}
+		}
+	}
+}
+
+static void bvhtree_ray_cast_batch_task_cb(
+        void *__restrict userdata,
+        const int packet_index,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	const BVHRayCastBatchData *batch = userdata;
+	const int start = packet_index * BVH_PACKET_SIZE;
+	const int len = min_ii(BVH_PACKET_SIZE, batch->rays_len - start);
+	BVHRayPacket packet;
+
+	packet.radius = batch->radius;
+
+	/* Unused lanes of the last packet repeat its last ray. */
+	for (int i = 0; i < BVH_PACKET_SIZE; i++) {
+		const int ray_index = start + min_ii(i, len - 1);
+		BVHRayCastData *data = &packet.data[i];
+
+		BLI_ASSERT_UNIT_V3(batch->dir[ray_index]);
+
+		data->tree = batch->tree;
+		data->callback = batch->callback;
+		data->userdata = batch->userdata;
+
+		copy_v3_v3(data->ray.origin,    batch->co[ray_index]);
+		copy_v3_v3(data->ray.direction, batch->dir[ray_index]);
+		data->ray.radius = batch->radius;
+
+		bvhtree_ray_cast_data_precalc(data, batch->flag);
+
+		memcpy(&data->hit, &batch->hits[ray_index], sizeof(data->hit));
+
+		float idot_axis[3];
+		ray_idot_axis_finite(data, idot_axis);
+		for (int axis = 0; axis < 3; axis++) {
+			packet.origin[axis][i] = data->ray.origin[axis];
+			packet.idot_axis[axis][i] = idot_axis[axis];
+		}
+		packet.dist[i] = data->hit.dist;
+	}
+
+	dfs_raycast_packet(&packet, batch->root, (1u << len) - 1);
+
+	for (int i = 0; i < len; i++) {
+		memcpy(&batch->hits[start + i], &packet.data[i].hit, sizeof(packet.data[i].hit));
+	}
+}
+
+/**
+ * Cast many rays at once, a batched version of #BLI_bvhtree_ray_cast_ex.
+ *
+ * \param co, dir: Origins and (normalized) directions of the rays.
+ * \param hits: Must be initialized like the \a hit argument of #BLI_bvhtree_ray_cast_ex
+ * (typically index -1 and #BVH_RAYCAST_DIST_MAX), the result of every ray is written back.
+ *
+ * \note The \a callback is called from multiple threads.
+ */
+void BLI_bvhtree_ray_cast_batch(
+        BVHTree *tree, const float (*co)[3], const float (*dir)[3], float radius,
+        BVHTreeRayHit *hits, int rays_len,
+        BVHTree_RayCastCallback callback, void *userdata,
+        int flag)
+{
+	BVHNode *root = tree->nodes[tree->totleaf];
+
+	if (root == NULL || rays_len == 0) {
+		return;
+	}
+
+	BVHRayCastBatchData batch = {
+		.tree = tree,
+		.root = root,
+		.co = co,
+		.dir = dir,
+		.radius = radius,
+		.hits = hits,
+		.rays_len = rays_len,
+		.callback = callback,
+		.userdata = userdata,
+		.flag = flag,
+	};
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.use_threading = (rays_len > KDOPBVH_THREAD_LEAF_THRESHOLD);
+	BLI_task_parallel_range(
+	        0, (rays_len + BVH_PACKET_SIZE - 1) / BVH_PACKET_SIZE,
+	        &batch,
+	        bvhtree_ray_cast_batch_task_cb,
+	        &settings);
+}
+
+/**
+ * Same as #calc_nearest_point_squared for all points of the packet.
+ *
+ * \return the mask of points closer to the bounding volume than to their current nearest.
+ */
+BLI_INLINE uint nearest_packet_overlap(const BVHNearestPacket *packet, const float bv[6])
+{
+#ifdef __SSE2__
+	__m128 dist_sq = _mm_setzero_ps();
+
+	for (int i = 0; i < 3; i++) {
+		const __m128 co = _mm_loadu_ps(packet->co[i]);
+		const __m128 nearest = _mm_min_ps(_mm_max_ps(co, _mm_set1_ps(bv[2 * i])), _mm_set1_ps(bv[2 * i + 1]));
+		const __m128 d = _mm_sub_ps(co, nearest);
+		dist_sq = _mm_add_ps(dist_sq, _mm_mul_ps(d, d));
+	}
+
+	return (uint)_mm_movemask_ps(_mm_cmplt_ps(dist_sq, _mm_loadu_ps(packet->dist_sq)));
+#else
+	uint mask = 0;
+	for (int j = 0; j < BVH_PACKET_SIZE; j++) {
+		float dist_sq = 0.0f;
+		for (int i = 0; i < 3; i++) {
+			const float co = packet->co[i][j];
+			const float d = co - min_ff(max_ff(co, bv[2 * i]), bv[2 * i + 1]);
+			dist_sq += d * d;
+		}
+		if (dist_sq < packet->dist_sq[j]) {
+			mask |= 1u << j;
+		}
+	}
+	return mask;
+#endif
+}
+
+static void dfs_find_nearest_packet(BVHNearestPacket *packet, BVHNode *node, uint mask)
+{
+	mask &= nearest_packet_overlap(packet, node->bv);
+	if (mask == 0) {
+		return;
+	}
+
+	if (node->totnode == 0) {
+		do {
+			const uint i = bitscan_forward_clear_uint(&mask);
+			BVHNearestData *data = &packet->data[i];
+			if (data->callback) {
+				data->callback(data->userdata, node->index, data->co, &data->nearest);
+			}
+			else {
+				data->nearest.index = node->index;
+				data->nearest.dist_sq = calc_nearest_point_squared(data->proj, node, data->nearest.co);
+			}
+			packet->dist_sq[i] = data->nearest.dist_sq;
+		} while (mask);
+	}
+	else {
+		/* pick the closest node to dive on, based on the first point of the packet still overlapping */
+		const BVHNearestData *data = &packet->data[bitscan_forward_uint(mask)];
+		if (data->proj[node->main_axis] <= node->children[0]->bv[node->main_axis * 2 + 1]) {
+			for (int i = 0; i != node->totnode; i++) {
+				dfs_find_nearest_packet(packet, node->children[i], mask);
+			}
+		}
+		else {
+			for (int i = node->totnode - 1; i >= 0; i--) {
+				dfs_find_nearest_packet(packet, node->children[i], mask);
+			}
+		}
+	}
+}
+
+static void bvhtree_find_nearest_batch_task_cb(
+        void *__restrict userdata,
+        const int packet_index,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	const BVHNearestBatchData *batch = userdata;
+	const int start = packet_index * BVH_PACKET_SIZE;
+	const int len = min_ii(BVH_PACKET_SIZE, batch->co_len - start);
+
+	if (batch->flag & BVH_NEAREST_OPTIMAL_ORDER) {
+		/* Each point has its own priority queue, no packet traversal. */
+		for (int i = start; i < start + len; i++) {
+			BLI_bvhtree_find_nearest_ex(
+			        batch->tree, batch->co[i], &batch->nearest[i], batch->callback, batch->userdata, batch->flag);
+		}
+		return;
+	}
+
+	BVHNearestPacket packet;
+
+	/* Unused lanes of the last packet repeat its last point. */
+	for (int i = 0; i < BVH_PACKET_SIZE; i++) {
+		const int co_index = start + min_ii(i, len - 1);
+		BVHNearestData *data = &packet.data[i];
+
+		data->tree = batch->tree;
+		data->co = batch->co[co_index];
+		data->callback = batch->callback;
+		data->userdata = batch->userdata;
+
+		for (axis_t axis_iter = data->tree->start_axis; axis_iter != data->tree->stop_axis; axis_iter++) {
+			data->proj[axis_iter] = dot_v3v3(data->co, bvhtree_kdop_axes[axis_iter]);
+		}
+
+		memcpy(&data->nearest, &batch->nearest[co_index], sizeof(data->nearest));
+
+		for (int axis = 0; axis < 3; axis++) {
+			packet.co[axis][i] = data->co[axis];
+		}
+		packet.dist_sq[i] = data->nearest.dist_sq;
+	}
+
+	dfs_find_nearest_packet(&packet, batch->root, (1u << len) - 1);
+
+	for (int i = 0; i < len; i++) {
+		memcpy(&batch->nearest[start + i], &packet.data[i].nearest, sizeof(packet.data[i].nearest));
+	}
+}
+
+/**
+ * Find the nearest node of many points at once, a batched version of #BLI_bvhtree_find_nearest_ex.
+ *
+ * \param nearest: Must be initialized like the \a nearest argument of #BLI_bvhtree_find_nearest_ex
+ * (typically index -1 and FLT_MAX distance), the result of every point is written back.
+ *
+ * \note The \a callback is called from multiple threads.
+ */
+void BLI_bvhtree_find_nearest_batch(
+        BVHTree *tree, const float (*co)[3], BVHTreeNearest *nearest, int co_len,
+        BVHTree_NearestPointCallback callback, void *userdata,
+        int flag)
+{
+	BVHNode *root = tree->nodes[tree->totleaf];
+
+	if (root == NULL || co_len == 0) {
+		return;
+	}
+
+	BVHNearestBatchData batch = {
+		.tree = tree,
+		.root = root,
+		.co = co,
+		.nearest = nearest,
+		.co_len = co_len,
+		.callback = callback,
+		.userdata = userdata,
+		.flag = flag,
+	};
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.use_threading = (co_len > KDOPBVH_THREAD_LEAF_THRESHOLD);
+	BLI_task_parallel_range(
+	        0, (co_len + BVH_PACKET_SIZE - 1) / BVH_PACKET_SIZE,
+	        &batch,
+	        bvhtree_find_nearest_batch_task_cb,
+	        &settings);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree_range_query
  *
@@ -1757,6 +2610,31 @@ static void dfs_range_query(RangeQueryData *data, BVHNode *node)
 	}
 }
 
+#ifdef USE_COMPACT_NODES
+static void dfs_range_query_compact(RangeQueryData *data, const BVHNodeCompact *cnode)
+{
+	float dist_sq[BVH_COMPACT_WIDTH];
+	uint mask = compact_node_children_mask(cnode) &
+	            compact_nearest_overlap(data->center, cnode, data->radius_sq, dist_sq);
+
+	while (mask) {
+		const int child = cnode->children[bitscan_forward_clear_uint(&mask)];
+		if (child < 0) {
+			BVHNode *leaf = &data->tree->nodearray[~child];
+			float nearest[3];
+			const float leaf_dist_sq = calc_nearest_point_squared(data->center, leaf, nearest);
+			if (leaf_dist_sq < data->radius_sq) {
+				data->hits++;
+				data->callback(data->userdata, leaf->index, data->center, leaf_dist_sq);
+			}
+		}
+		else {
+			dfs_range_query_compact(data, &data->tree->compact[child]);
+		}
+	}
+}
+#endif
+
 int BLI_bvhtree_range_query(
         BVHTree *tree, const float co[3], float radius,
         BVHTree_RangeQuery callback, void *userdata)
@@ -1781,6 +2659,11 @@ int BLI_bvhtree_range_query(
 				data.hits++;
 				data.callback(data.userdata, root->index, co, dist_sq);
 			}
+#ifdef USE_COMPACT_NODES
+			else if (bvhtree_compact_ensure(tree)) {
+				dfs_range_query_compact(&data, tree->compact);
+			}
+#endif
 			else
 				dfs_range_query(&data, root);
 		}
@@ -16,12 +16,17 @@
 
 /** \file
  * \ingroup bli
+ *
+ * Balancing stores the nodes in depth first order: the left child of a node
+ * directly follows it in the array, so searches walk mostly forward in memory.
  */
 
 #include "MEM_guardedalloc.h"
 
 #include "BLI_math.h"
 #include "BLI_kdtree.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 #include "BLI_strict_flags.h"
 
@@ -54,6 +59,16 @@ struct KDTree {
 
 #define KD_NODE_UNSET ((uint)-1)
 
+/* Use threads to balance sub-trees with more nodes, and for batched searches of more points.
+ * Setting it low in debug builds so we can catch bugs in BLI_task/KDTree. */
+#ifdef DEBUG
+#  define KD_BALANCE_THREAD_THRESHOLD 64
+#  define KD_SEARCH_THREAD_THRESHOLD 0
+#else
+#  define KD_BALANCE_THREAD_THRESHOLD 10000
+#  define KD_SEARCH_THREAD_THRESHOLD 1024
+#endif
+
 /**
  * Creates or free a kdtree
  */
@@ -106,18 +121,16 @@ void BLI_kdtree_insert(KDTree *tree, int index, const float co[3])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint totnode, uint axis, const uint ofs)
+/**
+ * Partition \a nodes around their median on \a axis, quick-select style.
+ *
+ * \return the median index.
+ */
+static uint kdtree_partition(KDTreeNode *nodes, uint totnode, uint axis)
 {
-	KDTreeNode *node;
 	float co;
 	uint left, right, median, i, j;
 
-	if (totnode <= 0)
-		return KD_NODE_UNSET;
-	else if (totnode == 1)
-		return 0 + ofs;
-
-	/* quicksort style sorting around median */
 	left = 0;
 	right = totnode - 1;
 	median = totnode / 2;
@@ -144,19 +157,103 @@ static uint kdtree_balance(KDTreeNode *nodes, uint totnode, uint axis, const uin
 			left = i + 1;
 	}
 
-	/* set node and sort subnodes */
-	node = &nodes[median];
-	node->d = axis;
-	axis = (axis + 1) % 3;
-	node->left = kdtree_balance(nodes, median, axis, ofs);
-	node->right = kdtree_balance(nodes + median + 1, (totnode - (median + 1)), axis, (median + 1) + ofs);
+	return median;
+}
+
+typedef struct KDTreeBalanceTask {
+	uint ofs;      /* first node of this sub-tree in #KDTreeBalanceData.nodes */
+	uint totnode;
+	uint axis;
+	uint pos;      /* position of this sub-tree in #KDTreeBalanceData.nodes_dst */
+} KDTreeBalanceTask;
+
+typedef struct KDTreeBalanceData {
+	KDTreeNode *nodes;      /* partitioned in place */
+	KDTreeNode *nodes_dst;  /* balanced nodes, in depth first order */
+} KDTreeBalanceData;
+
+static void kdtree_balance_task_cb(TaskPool *__restrict pool, void *taskdata, int threadid);
+
+/**
+ * Once a node is the median of its range its position in the depth first order is known,
+ * so it's copied right away and its sub-trees (which don't overlap) can be balanced in parallel.
+ */
+static void kdtree_balance_recursive(
+        const KDTreeBalanceData *data, KDTreeBalanceTask task,
+        TaskPool *pool, int threadid)
+{
+	while (task.totnode != 0) {
+		KDTreeNode *nodes = &data->nodes[task.ofs];
+		KDTreeNode *node_dst = &data->nodes_dst[task.pos];
+		const uint median = kdtree_partition(nodes, task.totnode, task.axis);
+		const uint left_totnode = median;
+		const uint right_totnode = task.totnode - (median + 1);
+
+		*node_dst = nodes[median];
+		node_dst->d = task.axis;
+		node_dst->left = left_totnode ? task.pos + 1 : KD_NODE_UNSET;
+		node_dst->right = right_totnode ? task.pos + 1 + left_totnode : KD_NODE_UNSET;
+
+		const KDTreeBalanceTask task_left = {
+			.ofs = task.ofs,
+			.totnode = left_totnode,
+			.axis = (task.axis + 1) % 3,
+			.pos = task.pos + 1,
+		};
+
+		if (pool && left_totnode > KD_BALANCE_THREAD_THRESHOLD) {
+			KDTreeBalanceTask *taskdata = MEM_mallocN(sizeof(*taskdata), __func__);
+			*taskdata = task_left;
+			BLI_task_pool_push_from_thread(pool, kdtree_balance_task_cb, taskdata, true, TASK_PRIORITY_HIGH, threadid);
+		}
+		else {
+			kdtree_balance_recursive(data, task_left, pool, threadid);
+		}
+
+		/* continue with the right sub-tree */
+		task.ofs += median + 1;
+		task.totnode = right_totnode;
+		task.axis = task_left.axis;
+		task.pos += 1 + left_totnode;
+	}
+}
 
-	return median + ofs;
+static void kdtree_balance_task_cb(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+	const KDTreeBalanceData *data = BLI_task_pool_userdata(pool);
+	kdtree_balance_recursive(data, *(const KDTreeBalanceTask *)taskdata, pool, threadid);
 }
 
 void BLI_kdtree_balance(KDTree *tree)
 {
-	tree->root = kdtree_balance(tree->nodes, tree->totnode, 0, 0);
+	KDTreeBalanceData data;
+	const KDTreeBalanceTask task = {
+		.ofs = 0,
+		.totnode = tree->totnode,
+		.axis = 0,
+		.pos = 0,
+	};
+
+	/* keep the same capacity, in case more nodes are inserted and the tree balanced again */
+	data.nodes = tree->nodes;
+	data.nodes_dst = MEM_mallocN(MEM_allocN_len(tree->nodes), "KDTreeNode");
+
+	if (tree->totnode > KD_BALANCE_THREAD_THRESHOLD) {
+		TaskScheduler *scheduler = BLI_task_scheduler_get();
+		TaskPool *pool = BLI_task_pool_create(scheduler, &data);
+		KDTreeBalanceTask *taskdata = MEM_mallocN(sizeof(*taskdata), __func__);
+		*taskdata = task;
+		BLI_task_pool_push(pool, kdtree_balance_task_cb, taskdata, true, TASK_PRIORITY_HIGH);
+		BLI_task_pool_work_and_wait(pool);
+		BLI_task_pool_free(pool);
+	}
+	else {
+		kdtree_balance_recursive(&data, task, NULL, 0);
+	}
+
+	MEM_freeN(tree->nodes);
+	tree->nodes = data.nodes_dst;
+	tree->root = tree->totnode ? 0 : KD_NODE_UNSET;
 
 #ifdef DEBUG
 	tree->is_balanced = true;
@@ -409,6 +506,51 @@ static void add_nearest(KDTreeNearest *ptn, uint *found, uint n, int index,
 	copy_v3_v3(ptn[i].co, co);
 }
 
+struct NearestNParams {
+	const KDTreeNode *nodes;
+	const float *co;
+	const float *nor;
+	KDTreeNearest *r_nearest;
+	uint n;
+	uint found;
+};
+
+/**
+ * Visit the side of the split plane containing \a co first,
+ * so the far side is only visited when it's closer than the n'th nearest found so far.
+ */
+static void nearest_n_recursive(struct NearestNParams *p, uint i)
+{
+	const KDTreeNode *node = &p->nodes[i];
+	const float plane_dist = p->co[node->d] - node->co[node->d];
+	uint node_near, node_far;
+	float dist_sq;
+
+	if (plane_dist < 0.0f) {
+		node_near = node->left;
+		node_far = node->right;
+	}
+	else {
+		node_near = node->right;
+		node_far = node->left;
+	}
+
+	if (node_near != KD_NODE_UNSET) {
+		nearest_n_recursive(p, node_near);
+	}
+
+	dist_sq = squared_distance(node->co, p->co, p->nor);
+	if (p->found < p->n || dist_sq < p->r_nearest[p->found - 1].dist) {
+		add_nearest(p->r_nearest, &p->found, p->n, node->index, dist_sq, node->co);
+	}
+
+	if (node_far != KD_NODE_UNSET) {
+		if (p->found < p->n || plane_dist * plane_dist < p->r_nearest[p->found - 1].dist) {
+			nearest_n_recursive(p, node_far);
+		}
+	}
+}
+
 /**
  * Find n nearest returns number of points found, with results in nearest.
  * Normal is optional, but if given will limit results to points in normal direction from co.
@@ -420,12 +562,14 @@ int BLI_kdtree_find_nearest_n__normal(
         KDTreeNearest r_nearest[],
         uint n)
 {
-	const KDTreeNode *nodes = tree->nodes;
-	const KDTreeNode *root;
-	uint *stack, defaultstack[KD_STACK_INIT];
-	float cur_dist;
-	uint totstack, cur = 0;
-	uint i, found = 0;
+	struct NearestNParams p = {
+		.nodes = tree->nodes,
+		.co = co,
+		.nor = nor,
+		.r_nearest = r_nearest,
+		.n = n,
+		.found = 0,
+	};
 
 #ifdef DEBUG
 	BLI_assert(tree->is_balanced == true);
@@ -434,73 +578,12 @@ int BLI_kdtree_find_nearest_n__normal(
 	if (UNLIKELY((tree->root == KD_NODE_UNSET) || n == 0))
 		return 0;
 
-	stack = defaultstack;
-	totstack = KD_STACK_INIT;
-
-	root = &nodes[tree->root];
+	nearest_n_recursive(&p, tree->root);
 
-	cur_dist = squared_distance(root->co, co, nor);
-	add_nearest(r_nearest, &found, n, root->index, cur_dist, root->co);
-
-	if (co[root->d] < root->co[root->d]) {
-		if (root->right != KD_NODE_UNSET)
-			stack[cur++] = root->right;
-		if (root->left != KD_NODE_UNSET)
-			stack[cur++] = root->left;
-	}
-	else {
-		if (root->left != KD_NODE_UNSET)
-			stack[cur++] = root->left;
-		if (root->right != KD_NODE_UNSET)
-			stack[cur++] = root->right;
-	}
-
-	while (cur--) {
-		const KDTreeNode *node = &nodes[stack[cur]];
-
-		cur_dist = node->co[node->d] - co[node->d];
-
-		if (cur_dist < 0.0f) {
-			cur_dist = -cur_dist * cur_dist;
-
-			if (found < n || -cur_dist < r_nearest[found - 1].dist) {
-				cur_dist = squared_distance(node->co, co, nor);
-
-				if (found < n || cur_dist < r_nearest[found - 1].dist)
-					add_nearest(r_nearest, &found, n, node->index, cur_dist, node->co);
-
-				if (node->left != KD_NODE_UNSET)
-					stack[cur++] = node->left;
-			}
-			if (node->right != KD_NODE_UNSET)
-				stack[cur++] = node->right;
-		}
-		else {
-			cur_dist = cur_dist * cur_dist;
-
-			if (found < n || cur_dist < r_nearest[found - 1].dist) {
-				cur_dist = squared_distance(node->co, co, nor);
-				if (found < n || cur_dist < r_nearest[found - 1].dist)
-					add_nearest(r_nearest, &found, n, node->index, cur_dist, node->co);
-
-				if (node->right != KD_NODE_UNSET)
-					stack[cur++] = node->right;
-			}
-			if (node->left != KD_NODE_UNSET)
-				stack[cur++] = node->left;
-		}
-		if (UNLIKELY(cur + 3 > totstack)) {
-			stack = realloc_nodes(stack, &totstack, defaultstack != stack);
-		}
-	}
-
-	for (i = 0; i < found; i++)
+	for (uint i = 0; i < p.found; i++)
 		r_nearest[i].dist = sqrtf(r_nearest[i].dist);
 
-	if (stack != defaultstack)
-		MEM_freeN(stack);
-
-	return (int)found;
+	return (int)p.found;
 }
 
 static int range_compare(const void *a, const void *b)
@@ -668,6 +751,102 @@ finally:
 		MEM_freeN(stack);
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Batched Searches
+ *
+ * Search many points at once, in parallel.
+ * \{ */
+
+typedef struct KDTreeSearchBatchData {
+	const KDTree *tree;
+	const float (*co)[3];
+
+	/* BLI_kdtree_find_nearest_n_batch */
+	KDTreeNearest *r_nearest;
+	uint n;
+	int *r_found;
+
+	/* BLI_kdtree_range_search_batch */
+	float range;
+	KDTreeNearest **r_nearest_range;
+	int *r_nearest_range_len;
+} KDTreeSearchBatchData;
+
+static void kdtree_find_nearest_n_batch_cb(
+        void *__restrict userdata,
+        const int i,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	const KDTreeSearchBatchData *data = userdata;
+	const int found = BLI_kdtree_find_nearest_n(data->tree, data->co[i], &data->r_nearest[(uint)i * data->n], data->n);
+	if (data->r_found) {
+		data->r_found[i] = found;
+	}
+}
+
+static void kdtree_range_search_batch_cb(
+        void *__restrict userdata,
+        const int i,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	const KDTreeSearchBatchData *data = userdata;
+	/* not written by the search when nothing is found */
+	data->r_nearest_range[i] = NULL;
+	data->r_nearest_range_len[i] = BLI_kdtree_range_search(
+	        data->tree, data->co[i], &data->r_nearest_range[i], data->range);
+}
+
+/**
+ * Batched #BLI_kdtree_find_nearest_n.
+ *
+ * \param r_nearest: An array of \a co_len * \a n nearest, the nearest of \a co[i] start at `i * n`.
+ * \param r_found: Optional, the number of nearest found for each coordinate.
+ */
+void BLI_kdtree_find_nearest_n_batch(
+        const KDTree *tree, const float (*co)[3], int co_len,
+        KDTreeNearest *r_nearest, uint n, int *r_found)
+{
+	KDTreeSearchBatchData data = {
+		.tree = tree,
+		.co = co,
+		.r_nearest = r_nearest,
+		.n = n,
+		.r_found = r_found,
+	};
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.use_threading = (co_len > KD_SEARCH_THREAD_THRESHOLD);
+	BLI_task_parallel_range(0, co_len, &data, kdtree_find_nearest_n_batch_cb, &settings);
+}
+
+/**
+ * Batched #BLI_kdtree_range_search.
+ *
+ * \param r_nearest: An array of \a co_len pointers, each set to an array the caller must free
+ * (NULL when nothing is found), as for #BLI_kdtree_range_search.
+ * \param r_nearest_len: The number of points found for each coordinate.
+ */
+void BLI_kdtree_range_search_batch(
+        const KDTree *tree, const float (*co)[3], int co_len, float range,
+        KDTreeNearest **r_nearest, int *r_nearest_len)
+{
+	KDTreeSearchBatchData data = {
+		.tree = tree,
+		.co = co,
+		.range = range,
+		.r_nearest_range = r_nearest,
+		.r_nearest_range_len = r_nearest_len,
+	};
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.use_threading = (co_len > KD_SEARCH_THREAD_THRESHOLD);
+	BLI_task_parallel_range(0, co_len, &data, kdtree_range_search_batch_cb, &settings);
+}
+
+/** \} */
+
 /**
  * Use when we want to loop over nodes ordered by index.
  * Requires indices to be aligned with nodes.
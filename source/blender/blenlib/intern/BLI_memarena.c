@@ -26,7 +26,14 @@
  * needs to quickly allocate lots of little bits of data,
  * which are all freed at the same moment.
  *
- * \note Memory can't be freed during the arenas lifetime.
+ * \note Memory can't be freed during the arenas lifetime,
+ * except by resetting the arena to a previous #MemArenaMark.
+ *
+ * Each thread also has its own arena (#BLI_memarena_thread_get),
+ * for temporary arrays which are freed before the function that allocated them returns.
+ * Buffers released by resetting are kept for reuse (up to #MEMARENA_THREAD_SPARE_MAX),
+ * so code run for every evaluation doesn't go through the allocator each time.
+ * A thread's arena is freed when the thread exits.
  */
 
 #include <stdlib.h>
@@ -36,6 +43,7 @@
 
 #include "BLI_utildefines.h"
 #include "BLI_memarena.h"
+#include "BLI_threads.h"
 #include "BLI_strict_flags.h"
 
 #ifdef WITH_MEM_VALGRIND
@@ -57,8 +65,12 @@
 #  define ASAN_UNPOISON_MEMORY_REGION(addr, size) UNUSED_VARS(addr, size)
 #endif
 
+/* Bytes of released buffers each thread arena keeps for reuse. */
+#define MEMARENA_THREAD_SPARE_MAX (1 << 22)
+
 struct MemBuf {
 	struct MemBuf *next;
+	size_t size;
 	uchar data[0];
 };
 
@@ -70,6 +82,13 @@ struct MemArena {
 	size_t bufsize, cursize;
 	size_t align;
 
+	/* Released buffers kept for reuse, only used when 'spare_max' is set. */
+	struct MemBuf *bufs_spare;
+	size_t spare_size, spare_max;
+
+	/* Next thread arena, see #BLI_memarena_thread_free_all. */
+	struct MemArena *thread_next;
+
 	bool use_calloc;
 };
 
@@ -115,6 +134,7 @@ void BLI_memarena_use_align(struct MemArena *ma, const size_t align)
 void BLI_memarena_free(MemArena *ma)
 {
 	memarena_buf_free_all(ma->bufs);
+	memarena_buf_free_all(ma->bufs_spare);
 
 	VALGRIND_DESTROY_MEMPOOL(ma);
 
@@ -124,6 +144,41 @@ void BLI_memarena_free(MemArena *ma)
 /** Pad num up by \a amt (must be power of two). */
 #define PADUP(num, amt) (((num) + ((amt) - 1)) & ~((amt) - 1))
 
+/**
+ * Take the first spare buffer of at least \a size bytes.
+ */
+static struct MemBuf *memarena_buf_spare_pop(MemArena *ma, const size_t size)
+{
+	for (struct MemBuf **mb_p = &ma->bufs_spare; *mb_p; mb_p = &(*mb_p)->next) {
+		struct MemBuf *mb = *mb_p;
+		if (mb->size >= size) {
+			*mb_p = mb->next;
+			ma->spare_size -= mb->size;
+			if (ma->use_calloc) {
+				memset(mb->data, 0, mb->size);
+			}
+			return mb;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Free a buffer which is no longer used, or keep it as a spare.
+ */
+static void memarena_buf_release(MemArena *ma, struct MemBuf *mb)
+{
+	if (ma->spare_size + mb->size <= ma->spare_max) {
+		mb->next = ma->bufs_spare;
+		ma->bufs_spare = mb;
+		ma->spare_size += mb->size;
+		ASAN_POISON_MEMORY_REGION(mb->data, mb->size);
+	}
+	else {
+		MEM_freeN(mb);
+	}
+}
+
 /** Align alloc'ed memory (needed if `align > 8`). */
 static void memarena_curbuf_align(MemArena *ma)
 {
@@ -149,7 +204,12 @@ void *BLI_memarena_alloc(MemArena *ma, size_t size)
 			ma->cursize = ma->bufsize;
 		}
 
-		struct MemBuf *mb = (ma->use_calloc ? MEM_callocN : MEM_mallocN)(sizeof(*mb) + ma->cursize, ma->name);
+		struct MemBuf *mb = ma->bufs_spare ? memarena_buf_spare_pop(ma, ma->cursize) : NULL;
+		if (mb == NULL) {
+			mb = (ma->use_calloc ? MEM_callocN : MEM_mallocN)(sizeof(*mb) + ma->cursize, ma->name);
+			mb->size = ma->cursize;
+		}
+		ma->cursize = mb->size;
 		ma->curbuf = mb->data;
 		mb->next = ma->bufs;
 		ma->bufs = mb;
@@ -215,3 +275,159 @@ void BLI_memarena_clear(MemArena *ma)
 	VALGRIND_DESTROY_MEMPOOL(ma);
 	VALGRIND_CREATE_MEMPOOL(ma, 0, false);
 }
+
+/* -------------------------------------------------------------------- */
+/** \name Marks
+ *
+ * Allocations made after a mark are released together when resetting to it,
+ * marks must be reset in the reverse order they were taken.
+ * Clearing the arena invalidates all marks.
+ * \{ */
+
+void BLI_memarena_mark(MemArena *ma, MemArenaMark *r_mark)
+{
+	r_mark->buf = ma->bufs;
+	r_mark->curbuf = ma->curbuf;
+	r_mark->cursize = ma->cursize;
+}
+
+void BLI_memarena_reset_to_mark(MemArena *ma, const MemArenaMark *mark)
+{
+	size_t curbuf_used = (size_t)(ma->curbuf - (unsigned char *)mark->curbuf);
+
+	if (ma->bufs != mark->buf) {
+		/* The rest of the marked buffer may have been used before the new buffers were added. */
+		curbuf_used = mark->cursize;
+		while (ma->bufs != mark->buf) {
+			struct MemBuf *mb = ma->bufs;
+			BLI_assert(mb != NULL);
+			ma->bufs = mb->next;
+			memarena_buf_release(ma, mb);
+		}
+	}
+
+	ma->curbuf = mark->curbuf;
+	ma->cursize = mark->cursize;
+
+	if (ma->bufs) {
+		if (ma->use_calloc) {
+			ASAN_UNPOISON_MEMORY_REGION(ma->curbuf, curbuf_used);
+			memset(ma->curbuf, 0, curbuf_used);
+		}
+		ASAN_POISON_MEMORY_REGION(ma->curbuf, ma->cursize);
+	}
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Thread Arenas
+ *
+ * Usage for temporary allocations:
+ *
+ * \code{.c}
+ * MemArenaMark mark;
+ * MemArena *arena = BLI_memarena_thread_begin(&mark);
+ * int *array = BLI_memarena_alloc(arena, sizeof(*array) * len);
+ * ...
+ * BLI_memarena_thread_end(arena, &mark);
+ * \endcode
+ *
+ * Nested begin/end pairs are supported, as long as they don't cross.
+ * \{ */
+
+static ThreadLocal(void *) memarena_thread_tls;
+/* Only used to free the arena of a thread when it exits. */
+static pthread_key_t memarena_thread_key;
+/* All thread arenas, so they can be freed on exit. */
+static MemArena *memarena_thread_list = NULL;
+static ThreadMutex memarena_thread_mutex = BLI_MUTEX_INITIALIZER;
+static pthread_once_t memarena_thread_once = PTHREAD_ONCE_INIT;
+
+static void memarena_thread_list_remove(MemArena *ma)
+{
+	BLI_mutex_lock(&memarena_thread_mutex);
+	for (MemArena **ma_p = &memarena_thread_list; *ma_p; ma_p = &(*ma_p)->thread_next) {
+		if (*ma_p == ma) {
+			*ma_p = ma->thread_next;
+			break;
+		}
+	}
+	BLI_mutex_unlock(&memarena_thread_mutex);
+}
+
+static void memarena_thread_exit(void *data)
+{
+	MemArena *ma = data;
+	BLI_thread_local_set(memarena_thread_tls, NULL);
+	memarena_thread_list_remove(ma);
+	BLI_memarena_free(ma);
+}
+
+static void memarena_thread_local_create(void)
+{
+	BLI_thread_local_create(memarena_thread_tls);
+	pthread_key_create(&memarena_thread_key, memarena_thread_exit);
+}
+
+/**
+ * \return the arena of the calling thread, created on first use.
+ * It's freed when the thread exits.
+ */
+MemArena *BLI_memarena_thread_get(void)
+{
+#ifdef __APPLE__
+	/* The thread local is a key which has to be created first. */
+	pthread_once(&memarena_thread_once, memarena_thread_local_create);
+#endif
+	MemArena *ma = BLI_thread_local_get(memarena_thread_tls);
+	if (UNLIKELY(ma == NULL)) {
+		pthread_once(&memarena_thread_once, memarena_thread_local_create);
+		ma = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, "thread memarena");
+		ma->spare_max = MEMARENA_THREAD_SPARE_MAX;
+		BLI_thread_local_set(memarena_thread_tls, ma);
+		pthread_setspecific(memarena_thread_key, ma);
+
+		BLI_mutex_lock(&memarena_thread_mutex);
+		ma->thread_next = memarena_thread_list;
+		memarena_thread_list = ma;
+		BLI_mutex_unlock(&memarena_thread_mutex);
+	}
+	return ma;
+}
+
+MemArena *BLI_memarena_thread_begin(MemArenaMark *r_mark)
+{
+	MemArena *ma = BLI_memarena_thread_get();
+	BLI_memarena_mark(ma, r_mark);
+	return ma;
+}
+
+void BLI_memarena_thread_end(MemArena *ma, const MemArenaMark *mark)
+{
+	BLI_assert(ma == BLI_thread_local_get(memarena_thread_tls));
+	BLI_memarena_reset_to_mark(ma, mark);
+}
+
+/**
+ * Free the arenas of all threads, only call on exit when no other threads are running.
+ */
+void BLI_memarena_thread_free_all(void)
+{
+	pthread_once(&memarena_thread_once, memarena_thread_local_create);
+
+	BLI_mutex_lock(&memarena_thread_mutex);
+	MemArena *ma = memarena_thread_list;
+	memarena_thread_list = NULL;
+	BLI_mutex_unlock(&memarena_thread_mutex);
+
+	while (ma) {
+		MemArena *ma_next = ma->thread_next;
+		BLI_memarena_free(ma);
+		ma = ma_next;
+	}
+	BLI_thread_local_set(memarena_thread_tls, NULL);
+	pthread_setspecific(memarena_thread_key, NULL);
+}
+
+/** \} */
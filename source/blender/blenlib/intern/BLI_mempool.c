@@ -27,6 +27,8 @@
  * - Freeing chunks.
  * - Iterating over allocated chunks
  *   (optionally when using the #BLI_MEMPOOL_ALLOW_ITER flag).
+ * - Allocating and freeing from multiple threads
+ *   (optionally when using the #BLI_MEMPOOL_CONCURRENT flag).
  */
 
 #include <string.h>
@@ -35,6 +37,7 @@
 #include "atomic_ops.h"
 
 #include "BLI_utildefines.h"
+#include "BLI_threads.h"
 
 #include "BLI_mempool.h" /* own include */
 
@@ -81,6 +84,12 @@
 /* optimize pool size */
 #define USE_CHUNK_POW2
 
+/**
+ * Number of free lists of a #BLI_MEMPOOL_CONCURRENT pool, must be a power of 2.
+ * Threads are spread over them, more threads than this share free lists.
+ */
+#define MEMPOOL_THREAD_SLOTS 64
+
 
 #ifndef NDEBUG
 static bool mempool_debug_memset = false;
@@ -106,6 +115,21 @@ typedef struct BLI_mempool_chunk {
 	struct BLI_mempool_chunk *next;
 } BLI_mempool_chunk;
 
+/**
+ * Free list of a thread, for #BLI_MEMPOOL_CONCURRENT pools.
+ *
+ * Elements are freed into the list of the freeing thread,
+ * so a thread allocating from its own list only contends with threads sharing its slot.
+ */
+typedef struct BLI_mempool_thread {
+	SpinLock lock;
+	BLI_freenode *free;
+	/** Elements allocated minus elements freed by this thread (may be negative). */
+	int totused;
+	/* Avoid false sharing between the free lists of different threads. */
+	char _pad[64];
+} BLI_mempool_thread;
+
 /**
  * The mempool, stores and tracks memory \a chunks and elements within those chunks \a free.
  */
@@ -135,6 +159,12 @@ struct BLI_mempool {
 	/** Number of elements allocated in total. */
 	uint totalloc;
 #endif
+
+	/** Per thread free lists, only for #BLI_MEMPOOL_CONCURRENT
+	 * (\a free and \a totused are then only used while no thread is allocating). */
+	BLI_mempool_thread *threads;
+	/** Protects \a chunks, \a chunk_tail and \a free for concurrent pools. */
+	SpinLock chunk_lock;
 };
 
 #define MEMPOOL_ELEM_SIZE_MIN (sizeof(void *) * 2)
@@ -160,6 +190,42 @@ static uint power_of_2_max_u(uint x)
 }
 #endif
 
+/* Thread index plus one, zero when not assigned yet. */
+static ThreadLocal(void *) mempool_thread_index_tls;
+static uint32_t mempool_thread_index_next = 0;
+
+#ifdef __APPLE__
+static void mempool_thread_local_create(void)
+{
+	BLI_thread_local_create(mempool_thread_index_tls);
+}
+#endif
+
+/**
+ * \return the free list of the calling thread.
+ */
+BLI_INLINE BLI_mempool_thread *mempool_thread_get(BLI_mempool *pool)
+{
+	uint index = POINTER_AS_UINT(BLI_thread_local_get(mempool_thread_index_tls));
+	if (UNLIKELY(index == 0)) {
+		index = atomic_add_and_fetch_uint32(&mempool_thread_index_next, 1);
+		BLI_thread_local_set(mempool_thread_index_tls, POINTER_FROM_UINT(index));
+	}
+	return &pool->threads[(index - 1) & (MEMPOOL_THREAD_SLOTS - 1)];
+}
+
+BLI_INLINE uint mempool_totused(const BLI_mempool *pool)
+{
+	if (pool->threads) {
+		int totused = (int)pool->totused;
+		for (int i = 0; i < MEMPOOL_THREAD_SLOTS; i++) {
+			totused += pool->threads[i].totused;
+		}
+		return (uint)totused;
+	}
+	return pool->totused;
+}
+
 BLI_INLINE BLI_mempool_chunk *mempool_chunk_find(BLI_mempool_chunk *head, uint index)
 {
 	while (index-- && head) {
@@ -184,6 +250,41 @@ static BLI_mempool_chunk *mempool_chunk_alloc(BLI_mempool *pool)
 	return MEM_mallocN(sizeof(BLI_mempool_chunk) + (size_t)pool->csize, "BLI_Mempool Chunk");
 }
 
+/**
+ * Link the elements of a chunk into a free list.
+ *
+ * \return The last element of the list.
+ */
+static BLI_freenode *mempool_chunk_freelist_init(BLI_mempool *pool, BLI_mempool_chunk *mpchunk)
+{
+	const uint esize = pool->esize;
+	BLI_freenode *curnode = CHUNK_DATA(mpchunk);
+	uint j;
+
+	/* loop through the allocated data, building the pointer structures */
+	j = pool->pchunk;
+	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+		while (j--) {
+			curnode->next = NODE_STEP_NEXT(curnode);
+			curnode->freeword = FREEWORD;
+			curnode = curnode->next;
+		}
+	}
+	else {
+		while (j--) {
+			curnode->next = NODE_STEP_NEXT(curnode);
+			curnode = curnode->next;
+		}
+	}
+
+	/* terminate the list (rewind one)
+	 * will be overwritten if 'curnode' gets passed in again as 'last_tail' */
+	curnode = NODE_STEP_PREV(curnode);
+	curnode->next = NULL;
+
+	return curnode;
+}
+
 /**
  * Initialize a chunk and add into \a pool->chunks
  *
@@ -197,9 +298,7 @@ static BLI_freenode *mempool_chunk_add(
         BLI_mempool *pool, BLI_mempool_chunk *mpchunk,
         BLI_freenode *last_tail)
 {
-	const uint esize = pool->esize;
 	BLI_freenode *curnode = CHUNK_DATA(mpchunk);
-	uint j;
 
 	/* append */
 	if (pool->chunk_tail) {
@@ -217,26 +316,7 @@ static BLI_freenode *mempool_chunk_add(
 		pool->free = curnode;
 	}
 
-	/* loop through the allocated data, building the pointer structures */
-	j = pool->pchunk;
-	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
-		while (j--) {
-			curnode->next = NODE_STEP_NEXT(curnode);
-			curnode->freeword = FREEWORD;
-			curnode = curnode->next;
-		}
-	}
-	else {
-		while (j--) {
-			curnode->next = NODE_STEP_NEXT(curnode);
-			curnode = curnode->next;
-		}
-	}
-
-	/* terminate the list (rewind one)
-	 * will be overwritten if 'curnode' gets passed in again as 'last_tail' */
-	curnode = NODE_STEP_PREV(curnode);
-	curnode->next = NULL;
+	curnode = mempool_chunk_freelist_init(pool, mpchunk);
 
 #ifdef USE_TOTALLOC
 	pool->totalloc += pool->pchunk;
@@ -250,6 +330,34 @@ static BLI_freenode *mempool_chunk_add(
 	return curnode;
 }
 
+/**
+ * Add a new chunk to a #BLI_MEMPOOL_CONCURRENT pool.
+ *
+ * \return The free list of the new chunk.
+ */
+static BLI_freenode *mempool_chunk_add_concurrent(BLI_mempool *pool)
+{
+	BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
+	mpchunk->next = NULL;
+	mempool_chunk_freelist_init(pool, mpchunk);
+
+	BLI_spin_lock(&pool->chunk_lock);
+	if (pool->chunk_tail) {
+		pool->chunk_tail->next = mpchunk;
+	}
+	else {
+		pool->chunks = mpchunk;
+	}
+	pool->chunk_tail = mpchunk;
+#ifdef USE_TOTALLOC
+	pool->totalloc += pool->pchunk;
+#endif
+	BLI_spin_unlock(&pool->chunk_lock);
+
+	return CHUNK_DATA(mpchunk);
+}
+
+
 static void mempool_chunk_free(BLI_mempool_chunk *mpchunk)
 {
 	MEM_freeN(mpchunk);
@@ -317,6 +425,19 @@ BLI_mempool *BLI_mempool_create(
 	pool->totalloc = 0;
 #endif
 	pool->totused = 0;
+	pool->threads = NULL;
+
+	if (flag & BLI_MEMPOOL_CONCURRENT) {
+#ifdef __APPLE__
+		static pthread_once_t thread_local_once = PTHREAD_ONCE_INIT;
+		pthread_once(&thread_local_once, mempool_thread_local_create);
+#endif
+		pool->threads = MEM_callocN(sizeof(*pool->threads) * MEMPOOL_THREAD_SLOTS, "BLI_Mempool Threads");
+		for (i = 0; i < MEMPOOL_THREAD_SLOTS; i++) {
+			BLI_spin_init(&pool->threads[i].lock);
+		}
+		BLI_spin_init(&pool->chunk_lock);
+	}
 
 	if (totelem) {
 		/* Allocate the actual chunks. */
@@ -333,10 +454,96 @@ BLI_mempool *BLI_mempool_create(
 	return pool;
 }
 
+/**
+ * Get free elements for a thread which ran out of them: first the elements shared by all threads,
+ * then the elements freed into the list of another thread, then a new chunk.
+ *
+ * \note Must be called without holding the lock of \a thread, since other threads are locked.
+ */
+static BLI_freenode *mempool_thread_freelist_take(BLI_mempool *pool, BLI_mempool_thread *thread)
+{
+	BLI_freenode *free_list = NULL;
+
+	if (pool->free) {
+		BLI_spin_lock(&pool->chunk_lock);
+		free_list = pool->free;
+		pool->free = NULL;
+		BLI_spin_unlock(&pool->chunk_lock);
+		if (free_list) {
+			return free_list;
+		}
+	}
+
+	/* Elements allocated by one thread and freed by another end up in the list of the latter. */
+	for (int i = 0; i < MEMPOOL_THREAD_SLOTS; i++) {
+		BLI_mempool_thread *other = &pool->threads[i];
+		if (other != thread && other->free) {
+			BLI_spin_lock(&other->lock);
+			free_list = other->free;
+			other->free = NULL;
+			BLI_spin_unlock(&other->lock);
+			if (free_list) {
+				return free_list;
+			}
+		}
+	}
+
+	return mempool_chunk_add_concurrent(pool);
+}
+
+static void *mempool_alloc_concurrent(BLI_mempool *pool)
+{
+	BLI_mempool_thread *thread = mempool_thread_get(pool);
+	BLI_freenode *free_pop;
+
+	BLI_spin_lock(&thread->lock);
+
+	if (LIKELY(thread->free)) {
+		free_pop = thread->free;
+		thread->free = free_pop->next;
+	}
+	else {
+		BLI_spin_unlock(&thread->lock);
+		free_pop = mempool_thread_freelist_take(pool, thread);
+		BLI_spin_lock(&thread->lock);
+
+		BLI_freenode *free_rest = free_pop->next;
+		if (free_rest) {
+			/* Another thread sharing this list may have freed meanwhile. */
+			if (thread->free) {
+				BLI_freenode *tail = free_rest;
+				while (tail->next) {
+					tail = tail->next;
+				}
+				tail->next = thread->free;
+			}
+			thread->free = free_rest;
+		}
+	}
+
+	if (pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+		free_pop->freeword = USEDWORD;
+	}
+
+	thread->totused++;
+
+	BLI_spin_unlock(&thread->lock);
+
+#ifdef WITH_MEM_VALGRIND
+	VALGRIND_MEMPOOL_ALLOC(pool, free_pop, pool->esize);
+#endif
+
+	return (void *)free_pop;
+}
+
 void *BLI_mempool_alloc(BLI_mempool *pool)
 {
 	BLI_freenode *free_pop;
 
+	if (pool->threads) {
+		return mempool_alloc_concurrent(pool);
+	}
+
 	if (UNLIKELY(pool->free == NULL)) {
 		/* Need to allocate a new chunk. */
 		BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
@@ -381,12 +588,18 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 	{
 		BLI_mempool_chunk *chunk;
 		bool found = false;
+		if (pool->threads) {
+			BLI_spin_lock(&pool->chunk_lock);
+		}
 		for (chunk = pool->chunks; chunk; chunk = chunk->next) {
 			if (ARRAY_HAS_ITEM((char *)addr, (char *)CHUNK_DATA(chunk), pool->csize)) {
 				found = true;
 				break;
 			}
 		}
+		if (pool->threads) {
+			BLI_spin_unlock(&pool->chunk_lock);
+		}
 		if (!found) {
 			BLI_assert(!"Attempt to free data which is not in pool.\n");
 		}
@@ -406,6 +619,21 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 		newhead->freeword = FREEWORD;
 	}
 
+	if (pool->threads) {
+		/* Chunks are only freed on clear/destroy, they may still be used by other threads. */
+		BLI_mempool_thread *thread = mempool_thread_get(pool);
+		BLI_spin_lock(&thread->lock);
+		newhead->next = thread->free;
+		thread->free = newhead;
+		thread->totused--;
+		BLI_spin_unlock(&thread->lock);
+
+#ifdef WITH_MEM_VALGRIND
+		VALGRIND_MEMPOOL_FREE(pool, addr);
+#endif
+		return;
+	}
+
 	newhead->next = pool->free;
 	pool->free = newhead;
 
@@ -455,16 +683,19 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 	}
 }
 
+/**
+ * \note For #BLI_MEMPOOL_CONCURRENT pools this is only exact while no other thread allocates or frees.
+ */
 int BLI_mempool_len(BLI_mempool *pool)
 {
-	return (int)pool->totused;
+	return (int)mempool_totused(pool);
 }
 
 void *BLI_mempool_findelem(BLI_mempool *pool, uint index)
 {
 	BLI_assert(pool->flag & BLI_MEMPOOL_ALLOW_ITER);
 
-	if (index < pool->totused) {
+	if (index < mempool_totused(pool)) {
 		/* We could have some faster mem chunk stepping code inline. */
 		BLI_mempool_iter iter;
 		void *elem;
@@ -495,7 +726,7 @@ void BLI_mempool_as_table(BLI_mempool *pool, void **data)
 	while ((elem = BLI_mempool_iterstep(&iter))) {
 		*p++ = elem;
 	}
-	BLI_assert((uint)(p - data) == pool->totused);
+	BLI_assert((uint)(p - data) == mempool_totused(pool));
 }
 
 /**
@@ -503,7 +734,7 @@ void BLI_mempool_as_table(BLI_mempool *pool, void **data)
  */
 void **BLI_mempool_as_tableN(BLI_mempool *pool, const char *allocstr)
 {
-	void **data = MEM_mallocN((size_t)pool->totused * sizeof(void *), allocstr);
+	void **data = MEM_mallocN((size_t)mempool_totused(pool) * sizeof(void *), allocstr);
 	BLI_mempool_as_table(pool, data);
 	return data;
 }
@@ -522,7 +753,7 @@ void BLI_mempool_as_array(BLI_mempool *pool, void *data)
 		memcpy(p, elem, (size_t)esize);
 		p = NODE_STEP_NEXT(p);
 	}
-	BLI_assert((uint)(p - (char *)data) == pool->totused * esize);
+	BLI_assert((uint)(p - (char *)data) == mempool_totused(pool) * esize);
 }
 
 /**
@@ -530,7 +761,7 @@ void BLI_mempool_as_array(BLI_mempool *pool, void *data)
  */
 void *BLI_mempool_as_arrayN(BLI_mempool *pool, const char *allocstr)
 {
-	char *data = MEM_mallocN((size_t)(pool->totused * pool->esize), allocstr);
+	char *data = MEM_mallocN((size_t)(mempool_totused(pool) * pool->esize), allocstr);
 	BLI_mempool_as_array(pool, data);
 	return data;
 }
@@ -735,6 +966,12 @@ void BLI_mempool_clear_ex(BLI_mempool *pool, const int totelem_reserve)
 	/* re-initialize */
 	pool->free = NULL;
 	pool->totused = 0;
+	if (pool->threads) {
+		for (int i = 0; i < MEMPOOL_THREAD_SLOTS; i++) {
+			pool->threads[i].free = NULL;
+			pool->threads[i].totused = 0;
+		}
+	}
 #ifdef USE_TOTALLOC
 	pool->totalloc = 0;
 #endif
@@ -764,6 +1001,14 @@ void BLI_mempool_destroy(BLI_mempool *pool)
 {
 	mempool_chunk_free_all(pool->chunks);
 
+	if (pool->threads) {
+		for (int i = 0; i < MEMPOOL_THREAD_SLOTS; i++) {
+			BLI_spin_end(&pool->threads[i].lock);
+		}
+		BLI_spin_end(&pool->chunk_lock);
+		MEM_freeN(pool->threads);
+	}
+
 #ifdef WITH_MEM_VALGRIND
 	VALGRIND_DESTROY_MEMPOOL(pool);
 #endif
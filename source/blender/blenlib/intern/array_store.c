@@ -151,6 +151,11 @@
  * so 4 -> 7, 5 -> 10, 6 -> 15... etc.
  */
 #  define BCHUNK_HASH_TABLE_ACCUMULATE_STEPS 4
+/* Number of elements of the new data to hash at once,
+ * hashes are only calculated once the lookup reaches them (see #BTableHashWindow),
+ * so data skipped over by matching chunks is never hashed.
+ */
+#  define BCHUNK_HASH_WINDOW_LEN 4096
 #else
 /* How many items to hash (multiplied by stride)
  */
@@ -309,6 +314,28 @@ typedef struct BTableRef {
 	const BChunkRef *cref;
 } BTableRef;
 
+#ifdef USE_HASH_TABLE_ACCUMULATE
+/**
+ * Accumulated hashes for a window of the data being added.
+ *
+ * The table lookup only moves forward, so the window is moved when the lookup passes its end.
+ * Elements after the window are hashed too, so the values are the same as when hashing all data at once.
+ */
+typedef struct BTableHashWindow {
+	/** Data to look up, starting at the first element which needs a hash. */
+	const uchar *data;
+	/** Number of elements in \a data. */
+	size_t data_len;
+
+	/** First element (relative to \a data) and number of elements with a valid hash. */
+	size_t window_start;
+	size_t window_len;
+
+	hash_key *hash_array;
+	size_t    hash_array_len;
+} BTableHashWindow;
+#endif
+
 /** \} */
 
 
@@ -915,12 +942,52 @@ static hash_key key_from_chunk_ref(
 	}
 }
 
+static void table_hash_window_init(
+        const BArrayInfo *info, BTableHashWindow *hash_window,
+        const uchar *data, const size_t data_len)
+{
+	hash_window->data = data;
+	hash_window->data_len = data_len / info->chunk_stride;
+	hash_window->window_start = 0;
+	hash_window->window_len = 0;
+
+	/* Read-ahead of the last element in the window, see #hash_accum. */
+	hash_window->hash_array_len = MIN2(
+	        BCHUNK_HASH_WINDOW_LEN + info->accum_read_ahead_len + info->accum_steps,
+	        hash_window->data_len);
+	hash_window->hash_array = MEM_mallocN(sizeof(hash_key) * hash_window->hash_array_len, __func__);
+}
+
+static void table_hash_window_free(BTableHashWindow *hash_window)
+{
+	MEM_freeN(hash_window->hash_array);
+}
+
+static hash_key table_hash_window_key(
+        const BArrayInfo *info, BTableHashWindow *hash_window, const size_t i)
+{
+	BLI_assert(i >= hash_window->window_start);
+	if (UNLIKELY(i - hash_window->window_start >= hash_window->window_len)) {
+		const size_t hash_len = MIN2(hash_window->hash_array_len, hash_window->data_len - i);
+		hash_array_from_data(
+		        info, &hash_window->data[i * info->chunk_stride], hash_len * info->chunk_stride,
+		        hash_window->hash_array);
+		hash_accum(hash_window->hash_array, hash_len, info->accum_steps);
+
+		hash_window->window_start = i;
+		/* Elements near the end of the hashed range are only valid at the end of the data. */
+		hash_window->window_len = (i + hash_len == hash_window->data_len) ?
+		        hash_len : hash_len - (info->accum_read_ahead_len + info->accum_steps);
+	}
+	return hash_window->hash_array[i - hash_window->window_start];
+}
+
 static const BChunkRef *table_lookup(
         const BArrayInfo *info, BTableRef **table, const size_t table_len, const size_t i_table_start,
-        const uchar *data, const size_t data_len, const size_t offset, const hash_key *table_hash_array)
+        const uchar *data, const size_t data_len, const size_t offset, BTableHashWindow *hash_window)
 {
 	size_t size_left = data_len - offset;
-	hash_key key = table_hash_array[((offset - i_table_start) / info->chunk_stride)];
+	hash_key key = table_hash_window_key(info, hash_window, (offset - i_table_start) / info->chunk_stride);
 	size_t key_index = (size_t)(key % (hash_key)table_len);
 	for (const BTableRef *tref = table[key_index]; tref; tref = tref->next) {
 		const BChunkRef *cref = tref->cref;
@@ -973,7 +1040,7 @@ static hash_key key_from_chunk_ref(const BArrayInfo *info, const BChunkRef *cref
 
 static const BChunkRef *table_lookup(
         const BArrayInfo *info, BTableRef **table, const size_t table_len, const uint UNUSED(i_table_start),
-        const uchar *data, const size_t data_len, const size_t offset, const hash_key *UNUSED(table_hash_array))
+        const uchar *data, const size_t data_len, const size_t offset, void *UNUSED(hash_window))
 {
 	const size_t data_hash_len = BCHUNK_HASH_LEN * info->chunk_stride;  /* TODO, cache */
 
@@ -1201,15 +1268,13 @@ static BChunkList *bchunk_list_from_data_merge(
 
 #ifdef USE_HASH_TABLE_ACCUMULATE
 		size_t i_table_start = i_prev;
-		const size_t table_hash_array_len = (data_len - i_prev) / info->chunk_stride;
-		hash_key  *table_hash_array = MEM_mallocN(sizeof(*table_hash_array) * table_hash_array_len, __func__);
-		hash_array_from_data(info, &data[i_prev], data_len - i_prev, table_hash_array);
-
-		hash_accum(table_hash_array, table_hash_array_len, info->accum_steps);
+		BTableHashWindow hash_window_data;
+		BTableHashWindow *hash_window = &hash_window_data;
+		table_hash_window_init(info, hash_window, &data[i_prev], data_len - i_prev);
 #else
 		/* dummy vars */
 		uint i_table_start = 0;
-		hash_key *table_hash_array = NULL;
+		void *hash_window = NULL;
 #endif
 
 		const uint chunk_list_reference_remaining_len =
@@ -1288,7 +1353,7 @@ static BChunkList *bchunk_list_from_data_merge(
 			const BChunkRef *cref_found = table_lookup(
 			        info,
 			        table, table_len, i_table_start,
-			        data, data_len, i, table_hash_array);
+			        data, data_len, i, hash_window);
 			if (cref_found != NULL) {
 				BLI_assert(i < data_len);
 				if (i != i_prev) {
@@ -1336,7 +1401,7 @@ static BChunkList *bchunk_list_from_data_merge(
 		}
 
 #ifdef USE_HASH_TABLE_ACCUMULATE
-		MEM_freeN(table_hash_array);
+		table_hash_window_free(hash_window);
 #endif
 		MEM_freeN(table);
 		MEM_freeN(table_ref_stack);
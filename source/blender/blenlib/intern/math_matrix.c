@@ -525,6 +525,52 @@ void mul_m4_v3(const float mat[4][4], float vec[3])
 	vec[2] = x * mat[0][2] + y * mat[1][2] + mat[2][2] * vec[2] + mat[3][2];
 }
 
+#ifdef __SSE2__
+/* Store the first 3 components, without touching the memory after them. */
+BLI_INLINE void mul_m_v3_store_sse(float r[3], const __m128 v)
+{
+	_mm_storel_pi((__m64 *)r, v);
+	_mm_store_ss(&r[2], _mm_movehl_ps(v, v));
+}
+#endif
+
+/**
+ * Same as #mul_m4_v3 for each vector in an array,
+ * \a arr_stride is the size of the elements in bytes, so vectors can be members of structs (#MVert.co for e.g.).
+ *
+ * \note Results are identical to #mul_m4_v3.
+ */
+void mul_m4_v3_array_stride(const float M[4][4], float *r_arr, const int arr_len, const size_t arr_stride)
+{
+	char *r_iter = (char *)r_arr;
+#ifdef __SSE2__
+	const __m128 m0 = _mm_loadu_ps(M[0]);
+	const __m128 m1 = _mm_loadu_ps(M[1]);
+	const __m128 m2 = _mm_loadu_ps(M[2]);
+	const __m128 m3 = _mm_loadu_ps(M[3]);
+
+	for (int i = 0; i < arr_len; i++, r_iter += arr_stride) {
+		float *r = (float *)r_iter;
+		/* Same order of operations as #mul_m4_v3. */
+		const __m128 v = _mm_add_ps(
+		        _mm_add_ps(
+		                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(r[0]), m0), _mm_mul_ps(_mm_set1_ps(r[1]), m1)),
+		                _mm_mul_ps(m2, _mm_set1_ps(r[2]))),
+		        m3);
+		mul_m_v3_store_sse(r, v);
+	}
+#else
+	for (int i = 0; i < arr_len; i++, r_iter += arr_stride) {
+		mul_m4_v3(M, (float *)r_iter);
+	}
+#endif
+}
+
+void mul_m4_v3_array(const float M[4][4], float (*r_arr)[3], const int arr_len)
+{
+	mul_m4_v3_array_stride(M, (float *)r_arr, arr_len, sizeof(*r_arr));
+}
+
 void mul_v3_m4v3(float r[3], const float mat[4][4], const float vec[3])
 {
 	const float x = vec[0];
@@ -684,6 +730,37 @@ void mul_m3_v3(const float M[3][3], float r[3])
 	mul_v3_m3v3(r, M, (const float[3]){UNPACK3(r)});
 }
 
+/**
+ * Same as #mul_m3_v3 for each vector in an array, see #mul_m4_v3_array_stride.
+ */
+void mul_m3_v3_array_stride(const float M[3][3], float *r_arr, const int arr_len, const size_t arr_stride)
+{
+	char *r_iter = (char *)r_arr;
+#ifdef __SSE2__
+	/* Rows only have 3 components, loading 4 would read past the matrix. */
+	const __m128 m0 = _mm_set_ps(0.0f, M[0][2], M[0][1], M[0][0]);
+	const __m128 m1 = _mm_set_ps(0.0f, M[1][2], M[1][1], M[1][0]);
+	const __m128 m2 = _mm_set_ps(0.0f, M[2][2], M[2][1], M[2][0]);
+
+	for (int i = 0; i < arr_len; i++, r_iter += arr_stride) {
+		float *r = (float *)r_iter;
+		const __m128 v = _mm_add_ps(
+		        _mm_add_ps(_mm_mul_ps(m0, _mm_set1_ps(r[0])), _mm_mul_ps(m1, _mm_set1_ps(r[1]))),
+		        _mm_mul_ps(m2, _mm_set1_ps(r[2])));
+		mul_m_v3_store_sse(r, v);
+	}
+#else
+	for (int i = 0; i < arr_len; i++, r_iter += arr_stride) {
+		mul_m3_v3(M, (float *)r_iter);
+	}
+#endif
+}
+
+void mul_m3_v3_array(const float M[3][3], float (*r_arr)[3], const int arr_len)
+{
+	mul_m3_v3_array_stride(M, (float *)r_arr, arr_len, sizeof(*r_arr));
+}
+
 void mul_m3_v3_db(const double M[3][3], double r[3])
 {
 	mul_v3_m3v3_db(r, M, (const double[3]){UNPACK3(r)});
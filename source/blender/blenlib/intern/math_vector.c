@@ -945,9 +945,40 @@ void minmax_v2v2_v2(float min[2], float max[2], const float vec[2])
 
 void minmax_v3v3_v3_array(float r_min[3], float r_max[3], const float (*vec_arr)[3], int nbr)
 {
-	while (nbr--) {
-		minmax_v3v3_v3(r_min, r_max, *vec_arr++);
+	minmax_v3v3_v3_array_stride(r_min, r_max, (const float *)vec_arr, nbr, sizeof(*vec_arr));
+}
+
+/**
+ * Same as #minmax_v3v3_v3_array, \a arr_stride is the size of the elements in bytes,
+ * so vectors can be members of structs (#MVert.co for e.g.).
+ */
+void minmax_v3v3_v3_array_stride(
+        float r_min[3], float r_max[3], const float *arr, const int arr_len, const size_t arr_stride)
+{
+	const char *arr_iter = (const char *)arr;
+#ifdef __SSE2__
+	__m128 min = _mm_set_ps(0.0f, r_min[2], r_min[1], r_min[0]);
+	__m128 max = _mm_set_ps(0.0f, r_max[2], r_max[1], r_max[0]);
+
+	for (int i = 0; i < arr_len; i++, arr_iter += arr_stride) {
+		const float *v = (const float *)arr_iter;
+		/* Don't read past the vector, the last one may end the array. */
+		const __m128 co = _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)v), _mm_load_ss(&v[2]));
+		/* Comparisons with NaN return the second argument, ignore them as #minmax_v3v3_v3 does. */
+		min = _mm_min_ps(co, min);
+		max = _mm_max_ps(co, max);
 	}
+
+	float min_v4[4], max_v4[4];
+	_mm_storeu_ps(min_v4, min);
+	_mm_storeu_ps(max_v4, max);
+	copy_v3_v3(r_min, min_v4);
+	copy_v3_v3(r_max, max_v4);
+#else
+	for (int i = 0; i < arr_len; i++, arr_iter += arr_stride) {
+		minmax_v3v3_v3(r_min, r_max, (const float *)arr_iter);
+	}
+#endif
 }
 
 /** ensure \a v1 is \a dist from \a v2 */
@@ -1045,6 +1076,44 @@ float normalize_vn(float *array_tar, const int size)
 	return normalize_vn_vn(array_tar, array_tar, size);
 }
 
+/**
+ * Same as #normalize_v3 for each vector in an array (vectors too short to normalize are zeroed).
+ *
+ * \note Results are identical to #normalize_v3.
+ */
+void normalize_v3_array(float (*arr)[3], const int arr_len)
+{
+	int i = 0;
+#ifdef __SSE2__
+	/* Square root and division of 4 vectors at once. */
+	for (; i + 4 <= arr_len; i += 4) {
+		float (*v)[3] = &arr[i];
+		const __m128 x = _mm_set_ps(v[3][0], v[2][0], v[1][0], v[0][0]);
+		const __m128 y = _mm_set_ps(v[3][1], v[2][1], v[1][1], v[0][1]);
+		const __m128 z = _mm_set_ps(v[3][2], v[2][2], v[1][2], v[0][2]);
+		/* Same order of operations as #dot_v3v3. */
+		const __m128 d_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		const __m128 d = _mm_sqrt_ps(d_sq);
+		float fac[4];
+		int valid;
+
+		_mm_storeu_ps(fac, _mm_div_ps(_mm_set1_ps(1.0f), d));
+		valid = _mm_movemask_ps(_mm_cmpgt_ps(d_sq, _mm_set1_ps(1.0e-35f)));
+		for (int j = 0; j < 4; j++) {
+			if (valid & (1 << j)) {
+				mul_v3_fl(v[j], fac[j]);
+			}
+			else {
+				zero_v3(v[j]);
+			}
+		}
+	}
+#endif
+	for (; i < arr_len; i++) {
+		normalize_v3(arr[i]);
+	}
+}
+
 void range_vn_i(int *array_tar, const int size, const int start)
 {
 	int *array_pt = array_tar + (size - 1);
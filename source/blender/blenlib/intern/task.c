@@ -45,18 +45,18 @@
  */
 #define MEMPOOL_SIZE 256
 
-/* Number of tasks which are pushed directly to local thread queue.
+/* Capacity of the per-thread task deques, must be a power of two.
  *
- * This allows thread to fetch next task without locking the whole queue.
+ * Tasks which don't fit into the deque of the pushing thread go to the
+ * scheduler's injection queue instead.
  */
-#define LOCAL_QUEUE_SIZE 1
+#define DEQUE_SIZE 4096
+#define DEQUE_MASK (DEQUE_SIZE - 1)
 
-/* Number of tasks which are allowed to be scheduled in a delayed manner.
- *
- * This allows to use less locks per graph node children schedule. More details
- * could be found at TaskThreadLocalStorage::do_delayed_push.
+/* Number of tasks a waiting thread looks at in its own deque when looking for
+ * a task of the pool it waits for. Other tasks are put back in order.
  */
-#define DELAYED_QUEUE_SIZE 4096
+#define DEQUE_SCAN_SIZE 16
 
 #ifndef NDEBUG
 #  define ASSERT_THREAD_ID(scheduler, thread_id)                              \
@@ -138,31 +138,68 @@ typedef struct TaskThreadLocalStorage {
 	 */
 	TaskMemPool task_mempool;
 
-	/* Local queue keeps thread alive by keeping small amount of tasks ready
-	 * to be picked up without causing global thread locks for synchronization.
+	/* State of the random number generator used to pick a thread to steal
+	 * tasks from.
 	 */
-	int num_local_queue;
-	Task *local_queue[LOCAL_QUEUE_SIZE];
+	uint32_t steal_rng;
 
 	/* Thread can be marked for delayed tasks push. This is helpful when it's
 	 * know that lots of subsequent task pushed will happen from the same thread
 	 * without "interrupting" for task execution.
 	 *
-	 * We try to accumulate as much tasks as possible in a local queue without
-	 * any locks first, and then we push all of them into a scheduler's queue
-	 * from within a single mutex lock.
+	 * Pushes are lock-free either way, but sleeping threads are only woken up
+	 * once all tasks are pushed instead of once per task.
 	 */
 	bool do_delayed_push;
-	int num_delayed_queue;
-	Task *delayed_queue[DELAYED_QUEUE_SIZE];
 } TaskThreadLocalStorage;
 
+/* Slot of the work-stealing deque.
+ *
+ * The pool is stored next to the task, so threads waiting for a specific pool
+ * can check the oldest task of a deque without touching the task itself, which
+ * might be finished and freed concurrently.
+ */
+typedef struct TaskDequeSlot {
+	Task *task;
+	TaskPool *pool;
+} TaskDequeSlot;
+
+/* Per-thread work-stealing deque (Chase-Lev).
+ *
+ * Only the owner thread pushes and pops tasks at the bottom, without any locks.
+ * Other threads steal the oldest task from the top with a single CAS, and only
+ * race with the owner when a single task is left.
+ */
+typedef struct TaskDeque {
+	/* Index of the oldest task, advanced by thieves and the owner. */
+	int64_t top;
+	char pad_top[64 - sizeof(int64_t)];
+	/* Index past the newest task, only written by the owner. */
+	int64_t bottom;
+	char pad_bottom[64 - sizeof(int64_t)];
+
+	TaskDequeSlot slots[DEQUE_SIZE];
+} TaskDeque;
+
 struct TaskPool {
 	TaskScheduler *scheduler;
 
+	/* Number of tasks which are not done yet, and how many of them are still
+	 * waiting in some queue. Both are only modified with atomics.
+	 */
 	volatile size_t num;
+	volatile size_t num_queued;
+	/* Number of tasks in the injection queues, so threads waiting for the pool
+	 * don't need to look through them when there is nothing for the pool.
+	 */
+	volatile size_t num_injected;
+
+	/* Used by the threads which wait for the pool to sleep until tasks are
+	 * done or new tasks are pushed. Only taken when someone is waiting.
+	 */
 	ThreadMutex num_mutex;
 	ThreadCondition num_cond;
+	volatile int num_waiting;
 
 	void *userdata;
 	ThreadMutex user_mutex;
@@ -207,9 +244,24 @@ struct TaskScheduler {
 	int num_threads;
 	bool background_thread_only;
 
-	ListBase queue;
-	ThreadMutex queue_mutex;
-	ThreadCondition queue_cond;
+	/* Queues for tasks which are pushed from threads without a deque or which
+	 * didn't fit into it. Pushing is lock-free, taking tasks out is serialized
+	 * by queue_lock. Worker threads move tasks from here into their own deque.
+	 */
+	Task *injection_queue;
+	Task *injection_queue_high;
+
+	/* Tasks of background pools, when the only worker is the background thread
+	 * which doesn't run any other tasks.
+	 */
+	Task *background_queue;
+
+	SpinLock queue_lock;
+
+	/* Idle worker threads sleep here until new tasks are pushed. */
+	ThreadMutex sleep_mutex;
+	ThreadCondition sleep_cond;
+	volatile int num_sleeping;
 
 	volatile bool do_exit;
 
@@ -221,6 +273,7 @@ typedef struct TaskThread {
 	TaskScheduler *scheduler;
 	int id;
 	TaskThreadLocalStorage tls;
+	TaskDeque deque;
 } TaskThread;
 
 /* Helper */
@@ -236,9 +289,10 @@ BLI_INLINE void task_data_free(Task *task, const int thread_id)
 	}
 }
 
-BLI_INLINE void initialize_task_tls(TaskThreadLocalStorage *tls)
+BLI_INLINE void initialize_task_tls(TaskThreadLocalStorage *tls, const uint32_t seed)
 {
 	memset(tls, 0, sizeof(TaskThreadLocalStorage));
+	tls->steal_rng = seed * 2654435761u + 1;
 }
 
 BLI_INLINE TaskThreadLocalStorage *get_task_tls(TaskPool *pool,
@@ -323,130 +377,478 @@ static void task_free(TaskPool *pool, Task *task, const int thread_id)
 	}
 }
 
-/* Task Scheduler */
+/* Task Deque */
 
-static void task_pool_num_decrease(TaskPool *pool, size_t done)
+static bool task_deque_push(TaskDeque *deque, Task *task)
 {
-	BLI_mutex_lock(&pool->num_mutex);
+	const int64_t bottom = deque->bottom;
+	/* A stale top only makes the deque look fuller than it is. */
+	const int64_t top = *(volatile int64_t *)&deque->top;
+	if (bottom - top >= DEQUE_SIZE) {
+		return false;
+	}
+	TaskDequeSlot *slot = &deque->slots[bottom & DEQUE_MASK];
+	slot->task = task;
+	slot->pool = task->pool;
+	/* Full barrier, the slot is written before thieves can see it. */
+	atomic_add_and_fetch_int64(&deque->bottom, 1);
+	return true;
+}
 
-	BLI_assert(pool->num >= done);
+static Task *task_deque_pop(TaskDeque *deque)
+{
+	/* Full barrier, thieves see the reserved slot before we read top. */
+	const int64_t bottom = atomic_sub_and_fetch_int64(&deque->bottom, 1);
+	const int64_t top = *(volatile int64_t *)&deque->top;
+	if (top > bottom) {
+		/* Deque was empty. */
+		deque->bottom = bottom + 1;
+		return NULL;
+	}
+	Task *task = deque->slots[bottom & DEQUE_MASK].task;
+	if (top == bottom) {
+		/* Last task, race with thieves for it. */
+		if (atomic_cas_int64(&deque->top, top, top + 1) != top) {
+			task = NULL;
+		}
+		deque->bottom = bottom + 1;
+	}
+	return task;
+}
 
-	pool->num -= done;
+/* Steal the oldest task of the deque. When a pool is given, the task is only
+ * stolen if it belongs to that pool.
+ */
+static Task *task_deque_steal(TaskDeque *deque, TaskPool *only_pool)
+{
+	for (;;) {
+		/* Cheap check first, most deques a thread looks at are empty. */
+		if (*(volatile int64_t *)&deque->top >= *(volatile int64_t *)&deque->bottom) {
+			return NULL;
+		}
+		/* Atomic read acts as a barrier between reading top and bottom. */
+		const int64_t top = atomic_fetch_and_add_int64(&deque->top, 0);
+		const int64_t bottom = *(volatile int64_t *)&deque->bottom;
+		if (top >= bottom) {
+			return NULL;
+		}
+		const TaskDequeSlot slot = deque->slots[top & DEQUE_MASK];
+		if (only_pool != NULL && slot.pool != only_pool) {
+			return NULL;
+		}
+		if (atomic_cas_int64(&deque->top, top, top + 1) == top) {
+			return slot.task;
+		}
+		/* Lost the race with another thread, try again. */
+	}
+}
 
-	if (pool->num == 0)
-		BLI_condition_notify_all(&pool->num_cond);
+BLI_INLINE bool task_deque_is_empty(TaskDeque *deque)
+{
+	return *(volatile int64_t *)&deque->top >= *(volatile int64_t *)&deque->bottom;
+}
 
-	BLI_mutex_unlock(&pool->num_mutex);
+/* Injection Queues
+ *
+ * Intrusive stacks of tasks linked by Task.next. Tasks are pushed with a CAS
+ * without any locks. Tasks are only removed with the scheduler's queue_lock
+ * held, so removing from the middle of the stack is safe and there is no ABA
+ * problem: pushing threads only ever modify the head.
+ */
+
+static void task_queue_push(Task **queue, Task *task)
+{
+	for (;;) {
+		Task *head = *(Task * volatile *)queue;
+		task->next = head;
+		if (atomic_cas_ptr((void **)queue, head, task) == head) {
+			return;
+		}
+	}
 }
 
-static void task_pool_num_increase(TaskPool *pool, size_t new)
+/* Unlink task from the queue, prev is the task before it or NULL if it was the
+ * head at the time it was read. Returns the actual previous task.
+ */
+static Task *task_queue_unlink(Task **queue, Task *prev, Task *task)
 {
-	BLI_mutex_lock(&pool->num_mutex);
+	if (prev == NULL) {
+		if (atomic_cas_ptr((void **)queue, task, task->next) == task) {
+			return NULL;
+		}
+		/* New tasks were pushed in the meantime, look for the task among them. */
+		prev = *(Task * volatile *)queue;
+		while (prev->next != task) {
+			prev = prev->next;
+		}
+	}
+	prev->next = task->next;
+	return prev;
+}
 
-	pool->num += new;
-	BLI_condition_notify_all(&pool->num_cond);
+/* Take up to max_tasks tasks from the queue, newest first. When a pool is given
+ * only tasks of that pool are taken. Must be called with queue_lock held.
+ */
+static Task *task_queue_take(Task **queue, TaskPool *only_pool, int max_tasks)
+{
+	Task *first = NULL, *last = NULL;
+	Task *prev = NULL;
+	Task *task = *(Task * volatile *)queue;
+	int num_tasks = 0;
+
+	while (task != NULL && num_tasks < max_tasks) {
+		Task *next = task->next;
+		if (only_pool == NULL || task->pool == only_pool) {
+			prev = task_queue_unlink(queue, prev, task);
+			atomic_sub_and_fetch_z((size_t *)&task->pool->num_injected, 1);
+			task->next = NULL;
+			if (last == NULL) {
+				first = task;
+			}
+			else {
+				last->next = task;
+			}
+			last = task;
+			num_tasks++;
+		}
+		else {
+			prev = task;
+		}
+		task = next;
+	}
 
-	BLI_mutex_unlock(&pool->num_mutex);
+	return first;
 }
 
-static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, Task **task)
+BLI_INLINE bool task_queue_is_empty(Task **queue)
 {
-	bool found_task = false;
-	BLI_mutex_lock(&scheduler->queue_mutex);
+	return *(Task * volatile *)queue == NULL;
+}
 
-	while (!scheduler->queue.first && !scheduler->do_exit)
-		BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+/* Task Scheduler */
 
-	do {
-		Task *current_task;
+static void task_pool_num_increase(TaskPool *pool, size_t new)
+{
+	atomic_add_and_fetch_z((size_t *)&pool->num, new);
+	atomic_add_and_fetch_z((size_t *)&pool->num_queued, new);
+}
 
-		/* Assuming we can only have a void queue in 'exit' case here seems logical
-		 * (we should only be here after our worker thread has been woken up from a
-		 * condition_wait(), which only happens after a new task was added to the queue),
-		 * but it is wrong.
-		 * Waiting on condition may wake up the thread even if condition is not signaled
-		 * (spurious wake-ups), and some race condition may also empty the queue **after**
-		 * condition has been signaled, but **before** awoken thread reaches this point...
-		 * See http://stackoverflow.com/questions/8594591
-		 *
-		 * So we only abort here if do_exit is set.
+/* Wake up threads which sleep in work_and_wait() of the pool, called once
+ * pushed tasks are visible to them.
+ */
+static void task_pool_notify_waiting(TaskPool *pool)
+{
+	if (pool->num_waiting != 0) {
+		BLI_mutex_lock(&pool->num_mutex);
+		BLI_condition_notify_all(&pool->num_cond);
+		BLI_mutex_unlock(&pool->num_mutex);
+	}
+}
+
+static void task_pool_num_decrease(TaskPool *pool, size_t done)
+{
+	for (;;) {
+		const size_t num = pool->num;
+		BLI_assert(num >= done);
+		if (num == done) {
+			/* The waiting thread may free the pool as soon as it sees zero, so
+			 * the last tasks are finished with the mutex held, and the waiting
+			 * thread takes the mutex once before returning.
+			 */
+			BLI_mutex_lock(&pool->num_mutex);
+			if (atomic_sub_and_fetch_z((size_t *)&pool->num, done) == 0) {
+				BLI_condition_notify_all(&pool->num_cond);
+			}
+			BLI_mutex_unlock(&pool->num_mutex);
+			return;
+		}
+		if (atomic_cas_z((size_t *)&pool->num, num, num - done) == num) {
+			return;
+		}
+	}
+}
+
+/* Task was taken out of a queue by some thread. */
+BLI_INLINE void task_pool_num_queued_decrease(TaskPool *pool)
+{
+	atomic_sub_and_fetch_z((size_t *)&pool->num_queued, 1);
+}
+
+static int task_scheduler_current_thread_id(TaskScheduler *scheduler)
+{
+	if (BLI_thread_is_main()) {
+		return 0;
+	}
+	TaskThread *thread = pthread_getspecific(scheduler->tls_id_key);
+	return (thread != NULL) ? thread->id : -1;
+}
+
+/* Deque of the given thread which tasks of the pool can be pushed to, NULL
+ * when tasks have to go through one of the injection queues.
+ */
+static TaskDeque *task_pool_push_deque(TaskPool *pool, int thread_id)
+{
+	TaskScheduler *scheduler = pool->scheduler;
+	if (thread_id == -1) {
+		thread_id = task_scheduler_current_thread_id(scheduler);
+	}
+	if (thread_id == -1 || (thread_id == 0 && pool->use_local_tls)) {
+		return NULL;
+	}
+	if (scheduler->background_thread_only) {
+		/* The background thread only runs tasks of background pools, the other
+		 * ones are only ever run by the threads waiting for them, which look for
+		 * them in the injection queue.
 		 */
-		if (scheduler->do_exit) {
-			BLI_mutex_unlock(&scheduler->queue_mutex);
-			return false;
+		if (thread_id == 0 || !pool->run_in_background) {
+			return NULL;
 		}
+	}
+	return &scheduler->task_threads[thread_id].deque;
+}
 
-		for (current_task = scheduler->queue.first;
-		     current_task != NULL;
-		     current_task = current_task->next)
-		{
-			TaskPool *pool = current_task->pool;
+static Task **task_scheduler_queue(TaskScheduler *scheduler, TaskPool *pool, TaskPriority priority)
+{
+	if (scheduler->background_thread_only && pool->run_in_background) {
+		return &scheduler->background_queue;
+	}
+	return (priority == TASK_PRIORITY_HIGH) ? &scheduler->injection_queue_high :
+	                                          &scheduler->injection_queue;
+}
 
-			if (scheduler->background_thread_only && !pool->run_in_background) {
-				continue;
-			}
+/* Wake up sleeping worker threads after tasks were pushed. */
+static void task_scheduler_wake(TaskScheduler *scheduler, const bool wake_all)
+{
+	/* Pushing a task ends with a full barrier, so a worker which goes to sleep
+	 * concurrently either is counted here already or sees the new task.
+	 */
+	if (scheduler->num_sleeping == 0) {
+		return;
+	}
+	BLI_mutex_lock(&scheduler->sleep_mutex);
+	if (wake_all) {
+		BLI_condition_notify_all(&scheduler->sleep_cond);
+	}
+	else {
+		BLI_condition_notify_one(&scheduler->sleep_cond);
+	}
+	BLI_mutex_unlock(&scheduler->sleep_mutex);
+}
 
-			*task = current_task;
-			found_task = true;
-			BLI_remlink(&scheduler->queue, *task);
-			break;
+/* Push task to one of the injection queues, where any thread can find it. */
+static void task_scheduler_inject(TaskScheduler *scheduler, Task *task, TaskPriority priority)
+{
+	atomic_add_and_fetch_z((size_t *)&task->pool->num_injected, 1);
+	task_queue_push(task_scheduler_queue(scheduler, task->pool, priority), task);
+}
+
+/* Take tasks from an injection queue, see task_queue_take(). */
+static Task *task_scheduler_take(TaskScheduler *scheduler,
+                                 Task **queue,
+                                 TaskPool *only_pool,
+                                 int max_tasks)
+{
+	if (task_queue_is_empty(queue)) {
+		return NULL;
+	}
+	BLI_spin_lock(&scheduler->queue_lock);
+	Task *task = task_queue_take(queue, only_pool, max_tasks);
+	BLI_spin_unlock(&scheduler->queue_lock);
+	return task;
+}
+
+static void task_scheduler_push(TaskScheduler *scheduler,
+                                Task *task,
+                                TaskPriority priority,
+                                const int thread_id)
+{
+	TaskPool *pool = task->pool;
+
+	task_pool_num_increase(pool, 1);
+
+	/* Push to the deque of the current thread, this is cheapest push ever and
+	 * the task is likely to be picked up next by this thread.
+	 */
+	TaskDeque *deque = task_pool_push_deque(pool, thread_id);
+	if (deque == NULL || !task_deque_push(deque, task)) {
+		task_scheduler_inject(scheduler, task, priority);
+	}
+
+	task_pool_notify_waiting(pool);
+
+	/* Only threads waiting for the pool can run the task in single threaded
+	 * case, so there is no worker to wake up.
+	 */
+	if (!scheduler->background_thread_only || pool->run_in_background) {
+		bool do_delayed_push = false;
+		if (thread_id != -1 && deque != NULL) {
+			do_delayed_push = get_task_tls(pool, thread_id)->do_delayed_push;
+		}
+		if (!do_delayed_push) {
+			task_scheduler_wake(scheduler, false);
 		}
-		if (!found_task)
-			BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
-	} while (!found_task);
+	}
+}
 
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+/* Move tasks of an injection queue into the deque of the thread, as many as
+ * there is room for. Oldest tasks end up at the bottom so they are run first by
+ * the thread, and newest ones are stolen first.
+ */
+static void task_scheduler_take_queue(TaskScheduler *scheduler, Task **queue, TaskDeque *deque)
+{
+	const int max_tasks = DEQUE_SIZE - (int)(deque->bottom - *(volatile int64_t *)&deque->top);
+	Task *task = task_scheduler_take(scheduler, queue, NULL, max_tasks);
+	int num_moved = 0;
+	while (task != NULL) {
+		Task *next = task->next;
+		/* Only this thread pushes to the deque, so there is room. */
+		const bool pushed = task_deque_push(deque, task);
+		BLI_assert(pushed);
+		UNUSED_VARS_NDEBUG(pushed);
+		num_moved++;
+		task = next;
+	}
+	/* Let other threads steal from us. */
+	if (num_moved > 1) {
+		task_scheduler_wake(scheduler, false);
+	}
+}
 
-	return true;
+/* Steal a task from a random other thread, only tasks of the given pool are
+ * stolen when it's not NULL.
+ */
+static Task *task_scheduler_steal(TaskScheduler *scheduler,
+                                  TaskThreadLocalStorage *tls,
+                                  TaskPool *only_pool,
+                                  const int thread_id)
+{
+	const int num_deques = scheduler->num_threads + 1;
+	/* Xorshift, good enough to spread thieves over the deques. */
+	uint32_t rng = tls->steal_rng;
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	tls->steal_rng = rng;
+
+	const int start = (int)(rng % (uint32_t)num_deques);
+	for (int i = 0; i < num_deques; i++) {
+		const int victim = (start + i) % num_deques;
+		if (victim == thread_id) {
+			continue;
+		}
+		Task *task = task_deque_steal(&scheduler->task_threads[victim].deque, only_pool);
+		if (task != NULL) {
+			return task;
+		}
+	}
+	return NULL;
 }
 
-BLI_INLINE void handle_local_queue(TaskThreadLocalStorage *tls,
-                                   const int thread_id)
+/* Find any task to run for a worker thread. */
+static Task *task_scheduler_find_task(TaskScheduler *scheduler, TaskThread *thread)
 {
-	BLI_assert(!tls->do_delayed_push);
-	while (tls->num_local_queue > 0) {
-		/* We pop task from queue before handling it so handler of the task can
-		 * push next job to the local queue.
-		 */
-		tls->num_local_queue--;
-		Task *local_task = tls->local_queue[tls->num_local_queue];
-		/* TODO(sergey): Double-check work_and_wait() doesn't handle other's
-		 * pool tasks.
-		 */
-		TaskPool *local_pool = local_task->pool;
-		local_task->run(local_pool, local_task->taskdata, thread_id);
-		task_free(local_pool, local_task, thread_id);
+	TaskDeque *deque = &thread->deque;
+
+	/* Newest task of our own deque first, keeps caches warm. */
+	Task *task = task_deque_pop(deque);
+	if (task != NULL) {
+		return task;
+	}
+
+	if (scheduler->background_thread_only) {
+		task_scheduler_take_queue(scheduler, &scheduler->background_queue, deque);
+		return task_deque_pop(deque);
+	}
+
+	/* Tasks pushed from outside of the scheduler, high priority ones are moved
+	 * last so they are popped first.
+	 */
+	if (!task_queue_is_empty(&scheduler->injection_queue) ||
+	    !task_queue_is_empty(&scheduler->injection_queue_high))
+	{
+		task_scheduler_take_queue(scheduler, &scheduler->injection_queue, deque);
+		task_scheduler_take_queue(scheduler, &scheduler->injection_queue_high, deque);
+		task = task_deque_pop(deque);
+		if (task != NULL) {
+			return task;
+		}
 	}
-	BLI_assert(!tls->do_delayed_push);
+
+	/* Oldest task of some other thread. */
+	return task_scheduler_steal(scheduler, &thread->tls, NULL, thread->id);
 }
 
-static void *task_scheduler_thread_run(void *thread_p)
+static bool task_scheduler_has_work(TaskScheduler *scheduler, TaskThread *thread)
 {
-	TaskThread *thread = (TaskThread *) thread_p;
-	TaskThreadLocalStorage *tls = &thread->tls;
-	TaskScheduler *scheduler = thread->scheduler;
-	int thread_id = thread->id;
-	Task *task;
+	if (!task_deque_is_empty(&thread->deque)) {
+		return true;
+	}
+	if (scheduler->background_thread_only) {
+		return !task_queue_is_empty(&scheduler->background_queue);
+	}
+	if (!task_queue_is_empty(&scheduler->injection_queue) ||
+	    !task_queue_is_empty(&scheduler->injection_queue_high))
+	{
+		return true;
+	}
+	for (int i = 0; i < scheduler->num_threads + 1; i++) {
+		if (!task_deque_is_empty(&scheduler->task_threads[i].deque)) {
+			return true;
+		}
+	}
+	return false;
+}
 
-	pthread_setspecific(scheduler->tls_id_key, thread);
+static void task_scheduler_sleep(TaskScheduler *scheduler, TaskThread *thread)
+{
+	BLI_mutex_lock(&scheduler->sleep_mutex);
+	/* Full barrier, pairs with the one at the end of pushing a task. */
+	atomic_add_and_fetch_int32((int32_t *)&scheduler->num_sleeping, 1);
+	if (!scheduler->do_exit && !task_scheduler_has_work(scheduler, thread)) {
+		BLI_condition_wait(&scheduler->sleep_cond, &scheduler->sleep_mutex);
+	}
+	atomic_sub_and_fetch_int32((int32_t *)&scheduler->num_sleeping, 1);
+	BLI_mutex_unlock(&scheduler->sleep_mutex);
+}
+
+/* Run a task which was taken out of a queue, tasks of canceled pools are only
+ * freed.
+ */
+static void task_run(Task *task, TaskThreadLocalStorage *tls, const int thread_id)
+{
+	TaskPool *pool = task->pool;
 
-	/* keep popping off tasks */
-	while (task_scheduler_thread_wait_pop(scheduler, &task)) {
-		TaskPool *pool = task->pool;
+	task_pool_num_queued_decrease(pool);
 
-		/* run task */
+	if (!pool->do_cancel) {
 		BLI_assert(!tls->do_delayed_push);
 		task->run(pool, task->taskdata, thread_id);
 		BLI_assert(!tls->do_delayed_push);
+	}
+	UNUSED_VARS_NDEBUG(tls);
+
+	task_free(pool, task, thread_id);
 
-		/* delete task */
-		task_free(pool, task, thread_id);
+	/* Notify pool task was done. */
+	task_pool_num_decrease(pool, 1);
+}
+
+static void *task_scheduler_thread_run(void *thread_p)
+{
+	TaskThread *thread = (TaskThread *) thread_p;
+	TaskScheduler *scheduler = thread->scheduler;
 
-		/* Handle all tasks from local queue. */
-		handle_local_queue(tls, thread_id);
+	pthread_setspecific(scheduler->tls_id_key, thread);
 
-		/* notify pool task was done */
-		task_pool_num_decrease(pool, 1);
+	/* Keep running tasks until the scheduler is freed. */
+	while (!scheduler->do_exit) {
+		Task *task = task_scheduler_find_task(scheduler, thread);
+		if (task != NULL) {
+			task_run(task, &thread->tls, thread->id);
+		}
+		else {
+			task_scheduler_sleep(scheduler, thread);
+		}
 	}
 
 	return NULL;
@@ -460,9 +862,9 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 	 * threads, so we keep track of the number of users. */
 	scheduler->do_exit = false;
 
-	BLI_listbase_clear(&scheduler->queue);
-	BLI_mutex_init(&scheduler->queue_mutex);
-	BLI_condition_init(&scheduler->queue_cond);
+	BLI_spin_init(&scheduler->queue_lock);
+	BLI_mutex_init(&scheduler->sleep_mutex);
+	BLI_condition_init(&scheduler->sleep_cond);
 
 	if (num_threads == 0) {
 		/* automatic number of threads will be main thread + num cores */
@@ -478,11 +880,11 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 		num_threads = 1;
 	}
 
-	scheduler->task_threads = MEM_mallocN(sizeof(TaskThread) * (num_threads + 1),
+	scheduler->task_threads = MEM_callocN(sizeof(TaskThread) * (num_threads + 1),
 	                                      "TaskScheduler task threads");
 
 	/* Initialize TLS for main thread. */
-	initialize_task_tls(&scheduler->task_threads[0].tls);
+	initialize_task_tls(&scheduler->task_threads[0].tls, 0);
 
 	pthread_key_create(&scheduler->tls_id_key, NULL);
 
@@ -497,7 +899,7 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 			TaskThread *thread = &scheduler->task_threads[i + 1];
 			thread->scheduler = scheduler;
 			thread->id = i + 1;
-			initialize_task_tls(&thread->tls);
+			initialize_task_tls(&thread->tls, i + 1);
 
 			if (pthread_create(&scheduler->threads[i], NULL, task_scheduler_thread_run, thread) != 0) {
 				fprintf(stderr, "TaskScheduler failed to launch thread %d/%d\n", i, num_threads);
@@ -508,15 +910,23 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 	return scheduler;
 }
 
-void BLI_task_scheduler_free(TaskScheduler *scheduler)
+static void task_list_free(Task *task)
 {
-	Task *task;
+	while (task != NULL) {
+		Task *next = task->next;
+		task_data_free(task, 0);
+		MEM_freeN(task);
+		task = next;
+	}
+}
 
+void BLI_task_scheduler_free(TaskScheduler *scheduler)
+{
 	/* stop all waiting threads */
-	BLI_mutex_lock(&scheduler->queue_mutex);
+	BLI_mutex_lock(&scheduler->sleep_mutex);
 	scheduler->do_exit = true;
-	BLI_condition_notify_all(&scheduler->queue_cond);
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+	BLI_condition_notify_all(&scheduler->sleep_cond);
+	BLI_mutex_unlock(&scheduler->sleep_mutex);
 
 	pthread_key_delete(scheduler->tls_id_key);
 
@@ -532,9 +942,16 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 		MEM_freeN(scheduler->threads);
 	}
 
-	/* Delete task thread data */
+	/* Delete task thread data and leftover tasks. */
 	if (scheduler->task_threads) {
 		for (int i = 0; i < scheduler->num_threads + 1; ++i) {
+			TaskDeque *deque = &scheduler->task_threads[i].deque;
+			for (int64_t j = deque->top; j < deque->bottom; j++) {
+				Task *task = deque->slots[j & DEQUE_MASK].task;
+				task_data_free(task, 0);
+				MEM_freeN(task);
+			}
+
 			TaskThreadLocalStorage *tls = &scheduler->task_threads[i].tls;
 			free_task_tls(tls);
 		}
@@ -542,15 +959,14 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 		MEM_freeN(scheduler->task_threads);
 	}
 
-	/* delete leftover tasks */
-	for (task = scheduler->queue.first; task; task = task->next) {
-		task_data_free(task, 0);
-	}
-	BLI_freelistN(&scheduler->queue);
+	task_list_free(scheduler->injection_queue);
+	task_list_free(scheduler->injection_queue_high);
+	task_list_free(scheduler->background_queue);
 
 	/* delete mutex/condition */
-	BLI_mutex_end(&scheduler->queue_mutex);
-	BLI_condition_end(&scheduler->queue_cond);
+	BLI_spin_end(&scheduler->queue_lock);
+	BLI_mutex_end(&scheduler->sleep_mutex);
+	BLI_condition_end(&scheduler->sleep_cond);
 
 	MEM_freeN(scheduler);
 }
@@ -560,68 +976,6 @@ int BLI_task_scheduler_num_threads(TaskScheduler *scheduler)
 	return scheduler->num_threads + 1;
 }
 
-static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriority priority)
-{
-	task_pool_num_increase(task->pool, 1);
-
-	/* add task to queue */
-	BLI_mutex_lock(&scheduler->queue_mutex);
-
-	if (priority == TASK_PRIORITY_HIGH)
-		BLI_addhead(&scheduler->queue, task);
-	else
-		BLI_addtail(&scheduler->queue, task);
-
-	BLI_condition_notify_one(&scheduler->queue_cond);
-	BLI_mutex_unlock(&scheduler->queue_mutex);
-}
-
-static void task_scheduler_push_all(TaskScheduler *scheduler,
-                                    TaskPool *pool,
-                                    Task **tasks,
-                                    int num_tasks)
-{
-	if (num_tasks == 0) {
-		return;
-	}
-
-	task_pool_num_increase(pool, num_tasks);
-
-	BLI_mutex_lock(&scheduler->queue_mutex);
-
-	for (int i = 0; i < num_tasks; i++) {
-		BLI_addhead(&scheduler->queue, tasks[i]);
-	}
-
-	BLI_condition_notify_all(&scheduler->queue_cond);
-	BLI_mutex_unlock(&scheduler->queue_mutex);
-}
-
-static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
-{
-	Task *task, *nexttask;
-	size_t done = 0;
-
-	BLI_mutex_lock(&scheduler->queue_mutex);
-
-	/* free all tasks from this pool from the queue */
-	for (task = scheduler->queue.first; task; task = nexttask) {
-		nexttask = task->next;
-
-		if (task->pool == pool) {
-			task_data_free(task, pool->thread_id);
-			BLI_freelinkN(&scheduler->queue, task);
-
-			done++;
-		}
-	}
-
-	BLI_mutex_unlock(&scheduler->queue_mutex);
-
-	/* notify done */
-	task_pool_num_decrease(pool, done);
-}
-
 /* Task Pool */
 
 static TaskPool *task_pool_create_ex(TaskScheduler *scheduler,
@@ -646,6 +1000,9 @@ static TaskPool *task_pool_create_ex(TaskScheduler *scheduler,
 
 	pool->scheduler = scheduler;
 	pool->num = 0;
+	pool->num_queued = 0;
+	pool->num_injected = 0;
+	pool->num_waiting = 0;
 	pool->do_cancel = false;
 	pool->do_work = false;
 	pool->is_suspended = is_suspended;
@@ -677,7 +1034,7 @@ static TaskPool *task_pool_create_ex(TaskScheduler *scheduler,
 #ifndef NDEBUG
 			pool->creator_thread_id = pthread_self();
 #endif
-			initialize_task_tls(&pool->local_tls);
+			initialize_task_tls(&pool->local_tls, (uint32_t)(intptr_t)pool);
 		}
 		else {
 			pool->thread_id = thread->id;
@@ -766,11 +1123,6 @@ void BLI_task_pool_free(TaskPool *pool)
 	BLI_threaded_malloc_end();
 }
 
-BLI_INLINE bool task_can_use_local_queues(TaskPool *pool, int thread_id)
-{
-	return (thread_id != -1 && (thread_id != pool->thread_id || pool->do_work));
-}
-
 static void task_pool_push(
         TaskPool *pool, TaskRunFunction run, void *taskdata,
         bool free_taskdata, TaskFreeFunction freedata, TaskPriority priority,
@@ -794,32 +1146,10 @@ static void task_pool_push(
 		atomic_fetch_and_add_z(&pool->num_suspended, 1);
 		return;
 	}
-	/* Populate to any local queue first, this is cheapest push ever. */
-	if (task_can_use_local_queues(pool, thread_id)) {
+	if (thread_id != -1) {
 		ASSERT_THREAD_ID(pool->scheduler, thread_id);
-		TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
-		/* Try to push to a local execution queue.
-		 * These tasks will be picked up next.
-		 */
-		if (tls->num_local_queue < LOCAL_QUEUE_SIZE) {
-			tls->local_queue[tls->num_local_queue] = task;
-			tls->num_local_queue++;
-			return;
-		}
-		/* If we are in the delayed tasks push mode, we push tasks to a
-		 * temporary local queue first without any locks, and then move them
-		 * to global execution queue with a single lock.
-		 */
-		if (tls->do_delayed_push && tls->num_delayed_queue < DELAYED_QUEUE_SIZE) {
-			tls->delayed_queue[tls->num_delayed_queue] = task;
-			tls->num_delayed_queue++;
-			return;
-		}
 	}
-	/* Do push to a global execution pool, slowest possible method,
-	 * causes quite reasonable amount of threading overhead.
-	 */
-	task_scheduler_push(pool->scheduler, task, priority);
+	task_scheduler_push(pool->scheduler, task, priority, thread_id);
 }
 
 void BLI_task_pool_push_ex(
@@ -841,83 +1171,160 @@ void BLI_task_pool_push_from_thread(TaskPool *pool, TaskRunFunction run,
 	task_pool_push(pool, run, taskdata, free_taskdata, NULL, priority, thread_id);
 }
 
-void BLI_task_pool_work_and_wait(TaskPool *pool)
+/* Move tasks pushed to a suspended pool to the scheduler. */
+static void task_pool_push_suspended(TaskPool *pool)
 {
-	TaskThreadLocalStorage *tls = get_task_tls(pool, pool->thread_id);
 	TaskScheduler *scheduler = pool->scheduler;
+	TaskDeque *deque = task_pool_push_deque(pool, pool->thread_id);
 
-	if (atomic_fetch_and_and_uint8((uint8_t *)&pool->is_suspended, 0)) {
-		if (pool->num_suspended) {
-			task_pool_num_increase(pool, pool->num_suspended);
-			BLI_mutex_lock(&scheduler->queue_mutex);
-
-			BLI_movelisttolist(&scheduler->queue, &pool->suspended_queue);
-
-			BLI_condition_notify_all(&scheduler->queue_cond);
-			BLI_mutex_unlock(&scheduler->queue_mutex);
+	task_pool_num_increase(pool, pool->num_suspended);
 
-			pool->num_suspended = 0;
+	Task *task = pool->suspended_queue.first;
+	while (task != NULL) {
+		Task *next = task->next;
+		if (deque == NULL || !task_deque_push(deque, task)) {
+			task_scheduler_inject(scheduler, task, TASK_PRIORITY_LOW);
 		}
+		task = next;
 	}
 
-	pool->do_work = true;
-
-	ASSERT_THREAD_ID(pool->scheduler, pool->thread_id);
-
-	handle_local_queue(tls, pool->thread_id);
-
-	BLI_mutex_lock(&pool->num_mutex);
-
-	while (pool->num != 0) {
-		Task *task, *work_task = NULL;
-		bool found_task = false;
-
-		BLI_mutex_unlock(&pool->num_mutex);
+	BLI_listbase_clear(&pool->suspended_queue);
+	pool->num_suspended = 0;
 
-		BLI_mutex_lock(&scheduler->queue_mutex);
+	if (!scheduler->background_thread_only) {
+		task_scheduler_wake(scheduler, true);
+	}
+}
 
-		/* find task from this pool. if we get a task from another pool,
-		 * we can get into deadlock */
+/* Find a task of the pool for a thread which waits for it. Tasks of other pools
+ * are never run here, since they could need locks which are held by the waiting
+ * thread.
+ */
+static Task *task_pool_find_task(TaskPool *pool, TaskDeque *deque, TaskThreadLocalStorage *tls)
+{
+	TaskScheduler *scheduler = pool->scheduler;
 
-		for (task = scheduler->queue.first; task; task = task->next) {
+	/* Newest tasks of our own deque, those are most likely pushed by the tasks
+	 * of this pool.
+	 */
+	if (deque != NULL) {
+		Task *skipped[DEQUE_SCAN_SIZE];
+		int num_skipped = 0;
+		Task *found = NULL;
+		while (num_skipped < DEQUE_SCAN_SIZE) {
+			Task *task = task_deque_pop(deque);
+			if (task == NULL) {
+				break;
+			}
 			if (task->pool == pool) {
-				work_task = task;
-				found_task = true;
-				BLI_remlink(&scheduler->queue, task);
+				found = task;
 				break;
 			}
+			skipped[num_skipped++] = task;
+		}
+		/* Restore the deque as it was, these were just pushed so there is room. */
+		if (num_skipped != 0) {
+			while (num_skipped--) {
+				if (!task_deque_push(deque, skipped[num_skipped])) {
+					task_scheduler_inject(scheduler, skipped[num_skipped], TASK_PRIORITY_LOW);
+				}
+			}
+			/* Workers might have missed them while they were out of the deque. */
+			task_scheduler_wake(scheduler, false);
+		}
+		if (found != NULL) {
+			return found;
 		}
+	}
 
-		BLI_mutex_unlock(&scheduler->queue_mutex);
+	/* Tasks of this pool which were pushed to the injection queues. */
+	if (pool->num_injected != 0) {
+		Task **queues[3] = {&scheduler->injection_queue_high,
+		                    &scheduler->injection_queue,
+		                    &scheduler->background_queue};
+		for (int i = 0; i < 3; i++) {
+			Task *task = task_scheduler_take(scheduler, queues[i], pool, 1);
+			if (task != NULL) {
+				return task;
+			}
+		}
+	}
 
-		/* if found task, do it, otherwise wait until other tasks are done */
-		if (found_task) {
-			/* run task */
-			BLI_assert(!tls->do_delayed_push);
-			work_task->run(pool, work_task->taskdata, pool->thread_id);
-			BLI_assert(!tls->do_delayed_push);
+	/* Oldest tasks of other threads, when they belong to this pool. */
+	return task_scheduler_steal(scheduler, tls, pool, (deque != NULL) ? pool->thread_id : -1);
+}
 
-			/* delete task */
-			task_free(pool, task, pool->thread_id);
+/* Tasks of the pool are queued but none of them could be found, which happens
+ * when they are buried under tasks of other pools in some deque. Move one of
+ * those tasks to the injection queue so the ones below get reachable.
+ */
+static void task_pool_unbury_task(TaskPool *pool, TaskDeque *deque)
+{
+	TaskScheduler *scheduler = pool->scheduler;
+	for (int i = 0; i < scheduler->num_threads + 1; i++) {
+		TaskDeque *victim = &scheduler->task_threads[i].deque;
+		Task *task = (victim == deque) ? task_deque_pop(deque) : task_deque_steal(victim, NULL);
+		if (task == NULL) {
+			continue;
+		}
+		task_scheduler_inject(scheduler, task, TASK_PRIORITY_LOW);
+		task_scheduler_wake(scheduler, false);
+		return;
+	}
+}
 
-			/* Handle all tasks from local queue. */
-			handle_local_queue(tls, pool->thread_id);
+/* Run tasks of the pool until all of them are done.
+ *
+ * Waiting threads only sleep once all tasks of the pool were taken by other
+ * threads, so they never miss tasks which are briefly out of a deque while
+ * some thread looks through it.
+ */
+static void task_pool_work_and_wait_ex(TaskPool *pool)
+{
+	TaskThreadLocalStorage *tls = get_task_tls(pool, pool->thread_id);
+	TaskDeque *deque = task_pool_push_deque(pool, pool->thread_id);
 
-			/* notify pool task was done */
-			task_pool_num_decrease(pool, 1);
+	while (pool->num != 0) {
+		Task *task = task_pool_find_task(pool, deque, tls);
+		if (task != NULL) {
+			task_run(task, tls, pool->thread_id);
+			continue;
 		}
 
-		BLI_mutex_lock(&pool->num_mutex);
-		if (pool->num == 0)
-			break;
+		if (pool->num_queued != 0) {
+			task_pool_unbury_task(pool, deque);
+			continue;
+		}
 
-		if (!found_task)
+		/* Sleep until tasks are done or new ones are pushed. */
+		BLI_mutex_lock(&pool->num_mutex);
+		/* Full barrier, pairs with the one at the end of pushing a task. */
+		atomic_add_and_fetch_int32((int32_t *)&pool->num_waiting, 1);
+		if (pool->num != 0 && pool->num_queued == 0) {
 			BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
+		}
+		atomic_sub_and_fetch_int32((int32_t *)&pool->num_waiting, 1);
+		BLI_mutex_unlock(&pool->num_mutex);
 	}
 
+	/* The thread which finished the last task might still hold the mutex. */
+	BLI_mutex_lock(&pool->num_mutex);
 	BLI_mutex_unlock(&pool->num_mutex);
+}
+
+void BLI_task_pool_work_and_wait(TaskPool *pool)
+{
+	if (atomic_fetch_and_and_uint8((uint8_t *)&pool->is_suspended, 0)) {
+		if (pool->num_suspended) {
+			task_pool_push_suspended(pool);
+		}
+	}
 
-	BLI_assert(tls->num_local_queue == 0);
+	pool->do_work = true;
+
+	ASSERT_THREAD_ID(pool->scheduler, pool->thread_id);
+
+	task_pool_work_and_wait_ex(pool);
 }
 
 void BLI_task_pool_work_wait_and_reset(TaskPool *pool)
@@ -932,13 +1339,19 @@ void BLI_task_pool_cancel(TaskPool *pool)
 {
 	pool->do_cancel = true;
 
-	task_scheduler_clear(pool->scheduler, pool);
+	/* Tasks of a pool which was never started are not known to the scheduler. */
+	if (pool->num_suspended) {
+		for (Task *task = pool->suspended_queue.first; task != NULL; task = task->next) {
+			task_data_free(task, pool->thread_id);
+		}
+		BLI_freelistN(&pool->suspended_queue);
+		pool->num_suspended = 0;
+	}
 
-	/* wait until all entries are cleared */
-	BLI_mutex_lock(&pool->num_mutex);
-	while (pool->num)
-		BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
-	BLI_mutex_unlock(&pool->num_mutex);
+	/* Queued tasks are freed without running them by whichever thread takes
+	 * them, including this one, wait until all of them are gone.
+	 */
+	task_pool_work_and_wait_ex(pool);
 
 	pool->do_cancel = false;
 }
@@ -960,7 +1373,7 @@ ThreadMutex *BLI_task_pool_user_mutex(TaskPool *pool)
 
 void BLI_task_pool_delayed_push_begin(TaskPool *pool, int thread_id)
 {
-	if (task_can_use_local_queues(pool, thread_id)) {
+	if (task_pool_push_deque(pool, thread_id) != NULL) {
 		ASSERT_THREAD_ID(pool->scheduler, thread_id);
 		TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
 		tls->do_delayed_push = true;
@@ -969,16 +1382,12 @@ void BLI_task_pool_delayed_push_begin(TaskPool *pool, int thread_id)
 
 void BLI_task_pool_delayed_push_end(TaskPool *pool, int thread_id)
 {
-	if (task_can_use_local_queues(pool, thread_id)) {
+	if (task_pool_push_deque(pool, thread_id) != NULL) {
 		ASSERT_THREAD_ID(pool->scheduler, thread_id);
 		TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
 		BLI_assert(tls->do_delayed_push);
-		task_scheduler_push_all(pool->scheduler,
-		                        pool,
-		                        tls->delayed_queue,
-		                        tls->num_delayed_queue);
 		tls->do_delayed_push = false;
-		tls->num_delayed_queue = 0;
+		task_scheduler_wake(pool->scheduler, true);
 	}
 }
 
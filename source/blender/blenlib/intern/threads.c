@@ -29,6 +29,7 @@
 
 #include "BLI_listbase.h"
 #include "BLI_gsqueue.h"
+#include "BLI_memarena.h"
 #include "BLI_system.h"
 #include "BLI_task.h"
 #include "BLI_threads.h"
@@ -160,6 +161,7 @@ void BLI_threadapi_exit(void)
 	if (task_scheduler) {
 		BLI_task_scheduler_free(task_scheduler);
 	}
+	BLI_memarena_thread_free_all();
 	BLI_spin_end(&_malloc_lock);
 }
 
@@ -32,6 +32,7 @@
 #include "BLI_string.h"
 #include "BLI_alloca.h"
 #include "BLI_edgehash.h"
+#include "BLI_memarena.h"
 
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
@@ -143,6 +144,10 @@ typedef struct EdgeDrawAttr {
 typedef struct MeshRenderData {
 	int types;
 
+	/* Allocates this struct and the small per-layer arrays, reset when freed. */
+	MemArena *arena;
+	MemArenaMark arena_mark;
+
 	int vert_len;
 	int edge_len;
 	int tri_len;
@@ -554,7 +559,11 @@ static MeshRenderData *mesh_render_data_create_ex(
         Mesh *me, const int types, const uchar cd_vused[CD_NUMTYPES], const ushort cd_lused[CD_NUMTYPES],
         const ToolSettings *ts)
 {
-	MeshRenderData *rdata = MEM_callocN(sizeof(*rdata), __func__);
+	MemArenaMark arena_mark;
+	MemArena *arena = BLI_memarena_thread_begin(&arena_mark);
+	MeshRenderData *rdata = BLI_memarena_calloc(arena, sizeof(*rdata));
+	rdata->arena = arena;
+	rdata->arena_mark = arena_mark;
 	rdata->types = types;
 	rdata->toolsettings = ts;
 	rdata->mat_len = mesh_render_mat_len_get(me);
@@ -863,22 +872,22 @@ static MeshRenderData *mesh_render_data_create_ex(
 		rdata->cd.layers.tangent_len = count_bits_i(cd_lused[CD_TANGENT]);
 		rdata->cd.layers.vcol_len = min_ii(cd_layers_src.vcol_len, count_bits_i(cd_lused[CD_MLOOPCOL]));
 
-		rdata->cd.layers.uv = MEM_mallocN(sizeof(*rdata->cd.layers.uv) * rdata->cd.layers.uv_len, __func__);
-		rdata->cd.layers.vcol = MEM_mallocN(sizeof(*rdata->cd.layers.vcol) * rdata->cd.layers.vcol_len, __func__);
-		rdata->cd.layers.tangent = MEM_mallocN(sizeof(*rdata->cd.layers.tangent) * rdata->cd.layers.tangent_len, __func__);
+		rdata->cd.layers.uv = BLI_memarena_alloc(rdata->arena, sizeof(*rdata->cd.layers.uv) * rdata->cd.layers.uv_len);
+		rdata->cd.layers.vcol = BLI_memarena_alloc(rdata->arena, sizeof(*rdata->cd.layers.vcol) * rdata->cd.layers.vcol_len);
+		rdata->cd.layers.tangent = BLI_memarena_alloc(rdata->arena, sizeof(*rdata->cd.layers.tangent) * rdata->cd.layers.tangent_len);
 
-		rdata->cd.uuid.uv = MEM_mallocN(sizeof(*rdata->cd.uuid.uv) * rdata->cd.layers.uv_len, __func__);
-		rdata->cd.uuid.vcol = MEM_mallocN(sizeof(*rdata->cd.uuid.vcol) * rdata->cd.layers.vcol_len, __func__);
-		rdata->cd.uuid.tangent = MEM_mallocN(sizeof(*rdata->cd.uuid.tangent) * rdata->cd.layers.tangent_len, __func__);
+		rdata->cd.uuid.uv = BLI_memarena_alloc(rdata->arena, sizeof(*rdata->cd.uuid.uv) * rdata->cd.layers.uv_len);
+		rdata->cd.uuid.vcol = BLI_memarena_alloc(rdata->arena, sizeof(*rdata->cd.uuid.vcol) * rdata->cd.layers.vcol_len);
+		rdata->cd.uuid.tangent = BLI_memarena_alloc(rdata->arena, sizeof(*rdata->cd.uuid.tangent) * rdata->cd.layers.tangent_len);
 
-		rdata->cd.offset.uv = MEM_mallocN(sizeof(*rdata->cd.offset.uv) * rdata->cd.layers.uv_len, __func__);
-		rdata->cd.offset.vcol = MEM_mallocN(sizeof(*rdata->cd.offset.vcol) * rdata->cd.layers.vcol_len, __func__);
+		rdata->cd.offset.uv = BLI_memarena_alloc(rdata->arena, sizeof(*rdata->cd.offset.uv) * rdata->cd.layers.uv_len);
+		rdata->cd.offset.vcol = BLI_memarena_alloc(rdata->arena, sizeof(*rdata->cd.offset.vcol) * rdata->cd.layers.vcol_len);
 
 		/* Allocate max */
-		rdata->cd.layers.auto_vcol = MEM_callocN(
-		        sizeof(*rdata->cd.layers.auto_vcol) * rdata->cd.layers.vcol_len, __func__);
-		rdata->cd.uuid.auto_mix = MEM_mallocN(
-		        sizeof(*rdata->cd.uuid.auto_mix) * (rdata->cd.layers.vcol_len + rdata->cd.layers.uv_len), __func__);
+		rdata->cd.layers.auto_vcol = BLI_memarena_calloc(
+		        rdata->arena, sizeof(*rdata->cd.layers.auto_vcol) * rdata->cd.layers.vcol_len);
+		rdata->cd.uuid.auto_mix = BLI_memarena_alloc(
+		        rdata->arena, sizeof(*rdata->cd.uuid.auto_mix) * (rdata->cd.layers.vcol_len + rdata->cd.layers.uv_len));
 
 		/* XXX FIXME XXX */
 		/* We use a hash to identify each data layer based on its name.
@@ -1087,16 +1096,6 @@ static void mesh_render_data_free(MeshRenderData *rdata)
 	if (rdata->is_orco_allocated) {
 		MEM_SAFE_FREE(rdata->orco);
 	}
-	MEM_SAFE_FREE(rdata->cd.offset.uv);
-	MEM_SAFE_FREE(rdata->cd.offset.vcol);
-	MEM_SAFE_FREE(rdata->cd.uuid.auto_mix);
-	MEM_SAFE_FREE(rdata->cd.uuid.uv);
-	MEM_SAFE_FREE(rdata->cd.uuid.vcol);
-	MEM_SAFE_FREE(rdata->cd.uuid.tangent);
-	MEM_SAFE_FREE(rdata->cd.layers.uv);
-	MEM_SAFE_FREE(rdata->cd.layers.vcol);
-	MEM_SAFE_FREE(rdata->cd.layers.tangent);
-	MEM_SAFE_FREE(rdata->cd.layers.auto_vcol);
 	MEM_SAFE_FREE(rdata->loose_verts);
 	MEM_SAFE_FREE(rdata->loose_edges);
 	MEM_SAFE_FREE(rdata->edges_adjacent_polys);
@@ -1115,7 +1114,9 @@ static void mesh_render_data_free(MeshRenderData *rdata)
 
 	CustomData_free(&rdata->cd.output.ldata, rdata->loop_len);
 
-	MEM_freeN(rdata);
+	/* Frees 'rdata' too. */
+	const MemArenaMark arena_mark = rdata->arena_mark;
+	BLI_memarena_thread_end(rdata->arena, &arena_mark);
 }
 
 /** \} */
@@ -65,7 +65,7 @@
 #  define USE_ARRAY_STORE_THREAD
 #endif
 
-#ifdef USE_ARRAY_STORE_THREAD
+#ifdef USE_ARRAY_STORE
 #  include "BLI_task.h"
 #endif
 
@@ -86,6 +86,22 @@ typedef struct BArrayCustomData {
 	BArrayState *states[0];
 } BArrayCustomData;
 
+/**
+ * A state to add to an array-store.
+ *
+ * These are collected for all layers first, so the states of each array-store
+ * (there is one for every stride) can be added in parallel.
+ */
+typedef struct UMArrayStateAdd {
+	struct UMArrayStateAdd *next;
+	BArrayStore *bs;
+	/* Freed once the state has been added. */
+	void *data;
+	size_t data_len;
+	const BArrayState *state_reference;
+	BArrayState **r_state;
+} UMArrayStateAdd;
+
 #endif
 
 typedef struct UndoMesh {
@@ -133,11 +149,71 @@ static struct {
 
 } um_arraystore = {{NULL}};
 
+/**
+ * Queue adding a state for \a data, which is freed once it has been added.
+ */
+static void um_arraystore_state_add_queue(
+        UMArrayStateAdd **state_add_queue,
+        BArrayStore *bs, void *data, const size_t data_len,
+        const BArrayState *state_reference, BArrayState **r_state)
+{
+	UMArrayStateAdd *state_add = MEM_mallocN(sizeof(*state_add), __func__);
+	state_add->bs = bs;
+	state_add->data = data;
+	state_add->data_len = data_len;
+	state_add->state_reference = state_reference;
+	state_add->r_state = r_state;
+
+	state_add->next = *state_add_queue;
+	*state_add_queue = state_add;
+}
+
+static void um_arraystore_state_add_cb(
+        void *__restrict userdata,
+        const int stride_index,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	UMArrayStateAdd *state_add_queue = userdata;
+	BArrayStore *bs = um_arraystore.bs_stride.stride_table[stride_index];
+	if (bs == NULL) {
+		return;
+	}
+
+	/* States of a single array-store are added by one thread. */
+	for (UMArrayStateAdd *state_add = state_add_queue; state_add; state_add = state_add->next) {
+		if (state_add->bs == bs) {
+			*state_add->r_state = BLI_array_store_state_add(
+			        bs, state_add->data, state_add->data_len, state_add->state_reference);
+			MEM_freeN(state_add->data);
+		}
+	}
+}
+
+static void um_arraystore_state_add_queue_run(UMArrayStateAdd *state_add_queue)
+{
+	if (state_add_queue == NULL) {
+		return;
+	}
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.min_iter_per_thread = 1;
+	BLI_task_parallel_range(
+	        0, um_arraystore.bs_stride.stride_table_len, state_add_queue,
+	        um_arraystore_state_add_cb, &settings);
+
+	for (UMArrayStateAdd *state_add = state_add_queue, *state_add_next; state_add; state_add = state_add_next) {
+		state_add_next = state_add->next;
+		MEM_freeN(state_add);
+	}
+}
+
 static void um_arraystore_cd_compact(
         struct CustomData *cdata, const size_t data_len,
         bool create,
         const BArrayCustomData *bcd_reference,
-        BArrayCustomData **r_bcd_first)
+        BArrayCustomData **r_bcd_first,
+        UMArrayStateAdd **state_add_queue)
 {
 	if (data_len == 0) {
 		if (create) {
@@ -205,8 +281,10 @@ static void um_arraystore_cd_compact(
 					BArrayState *state_reference =
 					        (bcd_reference_current && i < bcd_reference_current->states_len) ?
 					         bcd_reference_current->states[i] : NULL;
-					bcd->states[i] = BLI_array_store_state_add(
-					        bs, layer->data, (size_t)data_len * stride, state_reference);
+					um_arraystore_state_add_queue(
+					        state_add_queue, bs, layer->data, (size_t)data_len * stride,
+					        state_reference, &bcd->states[i]);
+					layer->data = NULL;
 				}
 				else {
 					bcd->states[i] = NULL;
@@ -284,11 +362,20 @@ static void um_arraystore_compact_ex(
         bool create)
 {
 	Mesh *me = &um->me;
-
-	um_arraystore_cd_compact(&me->vdata, me->totvert, create, um_ref ? um_ref->store.vdata : NULL, &um->store.vdata);
-	um_arraystore_cd_compact(&me->edata, me->totedge, create, um_ref ? um_ref->store.edata : NULL, &um->store.edata);
-	um_arraystore_cd_compact(&me->ldata, me->totloop, create, um_ref ? um_ref->store.ldata : NULL, &um->store.ldata);
-	um_arraystore_cd_compact(&me->pdata, me->totpoly, create, um_ref ? um_ref->store.pdata : NULL, &um->store.pdata);
+	UMArrayStateAdd *state_add_queue = NULL;
+
+	um_arraystore_cd_compact(
+	        &me->vdata, me->totvert, create, um_ref ? um_ref->store.vdata : NULL, &um->store.vdata,
+	        &state_add_queue);
+	um_arraystore_cd_compact(
+	        &me->edata, me->totedge, create, um_ref ? um_ref->store.edata : NULL, &um->store.edata,
+	        &state_add_queue);
+	um_arraystore_cd_compact(
+	        &me->ldata, me->totloop, create, um_ref ? um_ref->store.ldata : NULL, &um->store.ldata,
+	        &state_add_queue);
+	um_arraystore_cd_compact(
+	        &me->pdata, me->totpoly, create, um_ref ? um_ref->store.pdata : NULL, &um->store.pdata,
+	        &state_add_queue);
 
 	if (me->key && me->key->totkey) {
 		const size_t stride = me->key->elemsize;
@@ -302,9 +389,15 @@ static void um_arraystore_compact_ex(
 				BArrayState *state_reference =
 				        (um_ref && um_ref->me.key && (i < um_ref->me.key->totkey)) ?
 				         um_ref->store.keyblocks[i] : NULL;
-				um->store.keyblocks[i] = BLI_array_store_state_add(
-				        bs, keyblock->data, (size_t)keyblock->totelem * stride,
-				        state_reference);
+				if (keyblock->data) {
+					um_arraystore_state_add_queue(
+					        &state_add_queue, bs, keyblock->data, (size_t)keyblock->totelem * stride,
+					        state_reference, &um->store.keyblocks[i]);
+					keyblock->data = NULL;
+				}
+				else {
+					um->store.keyblocks[i] = BLI_array_store_state_add(bs, NULL, 0, state_reference);
+				}
 			}
 
 			if (keyblock->data) {
@@ -320,16 +413,20 @@ static void um_arraystore_compact_ex(
 			BArrayState *state_reference = um_ref ? um_ref->store.mselect : NULL;
 			const size_t stride = sizeof(*me->mselect);
 			BArrayStore *bs = BLI_array_store_at_size_ensure(&um_arraystore.bs_stride, stride, ARRAY_CHUNK_SIZE);
-			um->store.mselect = BLI_array_store_state_add(
-			        bs, me->mselect, (size_t)me->totselect * stride, state_reference);
+			um_arraystore_state_add_queue(
+			        &state_add_queue, bs, me->mselect, (size_t)me->totselect * stride,
+			        state_reference, &um->store.mselect);
+		}
+		else {
+			MEM_freeN(me->mselect);
 		}
 
 		/* keep me->totselect for validation */
-		MEM_freeN(me->mselect);
 		me->mselect = NULL;
 	}
 
 	if (create) {
+		um_arraystore_state_add_queue_run(state_add_queue);
 		um_arraystore.users += 1;
 	}
 
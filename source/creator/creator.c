@@ -268,18 +268,26 @@ int main(
 	 */
 	{
 		int i;
+		bool use_slab_allocator = false;
 		for (i = 0; i < argc; i++) {
 			if (STREQ(argv[i], "--debug") || STREQ(argv[i], "-d") ||
 			    STREQ(argv[i], "--debug-memory") || STREQ(argv[i], "--debug-all"))
 			{
 				printf("Switching to fully guarded memory allocator.\n");
 				MEM_use_guarded_allocator();
+				use_slab_allocator = false;
 				break;
 			}
+			else if (STREQ(argv[i], "--enable-slab-alloc")) {
+				use_slab_allocator = true;
+			}
 			else if (STREQ(argv[i], "--")) {
 				break;
 			}
 		}
+		if (use_slab_allocator) {
+			MEM_use_slab_allocator();
+		}
 	}
 
 #ifdef BUILD_DATE
@@ -583,6 +583,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 	BLI_argsPrintArgDoc(ba, "--factory-startup");
 	BLI_argsPrintArgDoc(ba, "--enable-static-override");
 	BLI_argsPrintArgDoc(ba, "--enable-event-simulate");
+	BLI_argsPrintArgDoc(ba, "--enable-slab-alloc");
 	printf("\n");
 	BLI_argsPrintArgDoc(ba, "--env-system-datafiles");
 	BLI_argsPrintArgDoc(ba, "--env-system-scripts");
@@ -1044,6 +1045,15 @@ static int arg_handle_enable_event_simulate(int UNUSED(argc), const char **UNUSE
 	return 0;
 }
 
+static const char arg_handle_enable_slab_alloc_doc[] =
+"\n\tUse per-thread caches for small memory allocations (ignored with memory debugging)."
+;
+static int arg_handle_enable_slab_alloc(int UNUSED(argc), const char **UNUSED(argv), void *UNUSED(data))
+{
+	/* Handled in 'main' before any allocation happened. */
+	return 0;
+}
+
 static const char arg_handle_env_system_set_doc_datafiles[] =
 "\n\tSet the "STRINGIFY_ARG (BLENDER_SYSTEM_DATAFILES)" environment variable.";
 static const char arg_handle_env_system_set_doc_scripts[] =
@@ -1986,6 +1996,7 @@ void main_args_setup(bContext *C, bArgs *ba)
 	BLI_argsAdd(ba, 1, NULL, "--factory-startup", CB(arg_handle_factory_startup_set), NULL);
 	BLI_argsAdd(ba, 1, NULL, "--enable-static-override", CB(arg_handle_enable_static_override), NULL);
 	BLI_argsAdd(ba, 1, NULL, "--enable-event-simulate", CB(arg_handle_enable_event_simulate), NULL);
+	BLI_argsAdd(ba, 1, NULL, "--enable-slab-alloc", CB(arg_handle_enable_slab_alloc), NULL);
 
 	/* TODO, add user env vars? */
 	BLI_argsAdd(ba, 1, NULL, "--env-system-datafiles", CB_EX(arg_handle_env_system_set, datafiles), NULL);
@@ -0,0 +1,172 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_array_store.h"
+
+#include "MEM_guardedalloc.h"
+#include "BLI_sys_types.h"
+#include "BLI_utildefines.h"
+#include "BLI_listbase.h"
+#include "BLI_rand.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* print memory savings */
+// #define DEBUG_PRINT
+
+
+/* -------------------------------------------------------------------- */
+/* Helper functions */
+
+#ifdef DEBUG_PRINT
+static void print_mem_saved(const char *id, const BArrayStore *bs)
+{
+	const double size_real   = BLI_array_store_calc_size_compacted_get(bs);
+	const double size_expand = BLI_array_store_calc_size_expanded_get(bs);
+	const double percent = size_expand ? ((size_real / size_expand) * 100.0) : -1.0;
+	printf("%s: %.8f%%\n", id, percent);
+}
+#endif
+
+typedef struct TestBuffer {
+	struct TestBuffer *next, *prev;
+	const void *data;
+	size_t data_len;
+
+	/* for reference */
+	BArrayState *state;
+} TestBuffer;
+
+static TestBuffer *testbuffer_list_add(ListBase *lb, const void *data, size_t data_len)
+{
+	TestBuffer *tb = (TestBuffer *)MEM_mallocN(sizeof(*tb), __func__);
+	tb->data = data;
+	tb->data_len = data_len;
+	tb->state = NULL;
+	BLI_addtail(lb, tb);
+	return tb;
+}
+
+static bool testbuffer_item_validate(TestBuffer *tb)
+{
+	size_t data_state_len;
+	bool ok = true;
+	void *data_state = BLI_array_store_state_data_get_alloc(tb->state, &data_state_len);
+	if (tb->data_len != data_state_len) {
+		ok = false;
+	}
+	else if (memcmp(data_state, tb->data, data_state_len) != 0) {
+		ok = false;
+	}
+	MEM_freeN(data_state);
+	return ok;
+}
+
+static bool testbuffer_list_validate(const ListBase *lb)
+{
+	for (TestBuffer *tb = (TestBuffer *)lb->first; tb; tb = tb->next) {
+		if (!testbuffer_item_validate(tb)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void testbuffer_list_store_populate(
+        BArrayStore *bs, ListBase *lb)
+{
+	for (TestBuffer *tb = (TestBuffer *)lb->first, *tb_prev = NULL; tb; tb_prev = tb, tb = tb->next) {
+		tb->state = BLI_array_store_state_add(bs, tb->data, tb->data_len, (tb_prev ? tb_prev->state : NULL));
+	}
+}
+
+static void testbuffer_list_free(ListBase *lb)
+{
+	for (TestBuffer *tb = (TestBuffer *)lb->first, *tb_next; tb; tb = tb_next) {
+		tb_next = tb->next;
+		MEM_freeN((void *)tb->data);
+		MEM_freeN(tb);
+	}
+	BLI_listbase_clear(lb);
+}
+
+static unsigned int rand_range_i(RNG *rng, unsigned int min_i, unsigned int max_i, unsigned int step)
+{
+	if (min_i == max_i) {
+		return min_i;
+	}
+	BLI_assert(min_i <= max_i);
+	BLI_assert(((min_i % step) == 0) && ((max_i % step) == 0));
+	unsigned int range = (max_i - min_i);
+	unsigned int value = BLI_rng_get_uint(rng) % range;
+	value = (value / step) * step;
+	return min_i + value;
+}
+
+
+/* -------------------------------------------------------------------- */
+/* Large Array Tests */
+
+/**
+ * Large arrays with elements removed and added at scattered positions for each state,
+ * as mesh undo does when deleting or duplicating a selection.
+ */
+static void large_data_edit_helper(
+        const int items_len, const int items_total,
+        const int stride, const int chunk_count,
+        const int random_seed, const int edits)
+{
+	ListBase lb;
+	BLI_listbase_clear(&lb);
+
+	{
+		RNG *rng = BLI_rng_new(random_seed);
+		size_t data_len = (size_t)items_len * stride;
+		char *data = (char *)MEM_mallocN(data_len, __func__);
+		BLI_rng_get_char_n(rng, data, data_len);
+		testbuffer_list_add(&lb, (const void *)data, data_len);
+
+		for (int i = 1; i < items_total; i++) {
+			const TestBuffer *tb_last = (const TestBuffer *)lb.last;
+			data_len = tb_last->data_len;
+			data = (char *)MEM_mallocN(data_len + (size_t)edits * stride, __func__);
+			memcpy(data, tb_last->data, data_len);
+
+			for (int j = 0; j < edits; j++) {
+				const unsigned int offset = rand_range_i(rng, 0, data_len - stride, stride);
+				if (BLI_rng_get_uint(rng) % 2) {
+					memmove(&data[offset + stride], &data[offset], data_len - offset);
+					BLI_rng_get_char_n(rng, &data[offset], stride);
+					data_len += stride;
+				}
+				else {
+					memmove(&data[offset], &data[offset + stride], data_len - (offset + stride));
+					data_len -= stride;
+				}
+			}
+			testbuffer_list_add(&lb, (const void *)data, data_len);
+		}
+		BLI_rng_free(rng);
+	}
+
+	BArrayStore *bs = BLI_array_store_create(stride, chunk_count);
+
+	TIMEIT_START(array_store_state_add);
+	testbuffer_list_store_populate(bs, &lb);
+	TIMEIT_END(array_store_state_add);
+
+	EXPECT_TRUE(testbuffer_list_validate(&lb));
+	EXPECT_TRUE(BLI_array_store_is_valid(bs));
+#ifdef DEBUG_PRINT
+	print_mem_saved("large data", bs);
+#endif
+
+	BLI_array_store_destroy(bs);
+	testbuffer_list_free(&lb);
+}
+
+TEST(array_store, LargeData_Stride12_Chunk256_Edit16) { large_data_edit_helper(1000000, 8, 12, 256, 4321, 16); }
+TEST(array_store, LargeData_Stride4_Chunk256_Edit256) { large_data_edit_helper(1000000, 8,  4, 256, 1234, 256); }
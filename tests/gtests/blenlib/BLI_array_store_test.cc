@@ -722,6 +722,69 @@ TEST(array_store, TestChunk_Rand64_Stride8_Chunk32)  { random_chunk_mutate_helpe
 TEST(array_store, TestChunk_Rand31_Stride11_Chunk21) { random_chunk_mutate_helper(31, 100, 11, 21, 7117); }
 
 
+/* -------------------------------------------------------------------- */
+/* Large Array Tests */
+
+/**
+ * Large arrays with elements removed and added at scattered positions for each state,
+ * as mesh undo does when deleting or duplicating a selection.
+ */
+static void large_data_edit_helper(
+        const int items_len, const int items_total,
+        const int stride, const int chunk_count,
+        const int random_seed, const int edits)
+{
+	ListBase lb;
+	BLI_listbase_clear(&lb);
+
+	{
+		RNG *rng = BLI_rng_new(random_seed);
+		size_t data_len = (size_t)items_len * stride;
+		char *data = (char *)MEM_mallocN(data_len, __func__);
+		BLI_rng_get_char_n(rng, data, data_len);
+		testbuffer_list_add(&lb, (const void *)data, data_len);
+
+		for (int i = 1; i < items_total; i++) {
+			const TestBuffer *tb_last = (const TestBuffer *)lb.last;
+			data_len = tb_last->data_len;
+			data = (char *)MEM_mallocN(data_len + (size_t)edits * stride, __func__);
+			memcpy(data, tb_last->data, data_len);
+
+			for (int j = 0; j < edits; j++) {
+				const unsigned int offset = rand_range_i(rng, 0, data_len - stride, stride);
+				if (BLI_rng_get_uint(rng) % 2) {
+					memmove(&data[offset + stride], &data[offset], data_len - offset);
+					BLI_rng_get_char_n(rng, &data[offset], stride);
+					data_len += stride;
+				}
+				else {
+					memmove(&data[offset], &data[offset + stride], data_len - (offset + stride));
+					data_len -= stride;
+				}
+			}
+			testbuffer_list_add(&lb, (const void *)data, data_len);
+		}
+		BLI_rng_free(rng);
+	}
+
+	BArrayStore *bs = BLI_array_store_create(stride, chunk_count);
+
+	testbuffer_list_store_populate(bs, &lb);
+
+	EXPECT_TRUE(testbuffer_list_validate(&lb));
+	EXPECT_TRUE(BLI_array_store_is_valid(bs));
+#ifdef DEBUG_PRINT
+	print_mem_saved("large data", bs);
+#endif
+
+	BLI_array_store_destroy(bs);
+	testbuffer_list_free(&lb);
+}
+
+TEST(array_store, LargeData_Stride12_Chunk256_Edit16) { large_data_edit_helper(20000, 8, 12, 256, 4321, 16); }
+TEST(array_store, LargeData_Stride4_Chunk256_Edit256) { large_data_edit_helper(20000, 8,  4, 256, 1234, 256); }
+
+
 #if 0
 /* -------------------------------------------------------------------- */
 
@@ -0,0 +1,227 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_flathash.h"
+#include "BLI_ghash.h"
+#include "BLI_string.h"
+}
+
+#define TESTCASE_SIZE 10000
+
+/* Unique, well spread keys (multiplying by an odd number is a bijection). */
+static void init_keys(unsigned int keys[TESTCASE_SIZE], const unsigned int seed)
+{
+	for (unsigned int i = 0; i < TESTCASE_SIZE; i++) {
+		keys[i] = (i + seed * TESTCASE_SIZE) * 2654435761u;
+	}
+}
+
+static void *key_from_int(const unsigned int k)
+{
+	return POINTER_FROM_UINT(k);
+}
+
+/* Here we simply insert and then lookup all keys, ensuring we do get back the expected stored 'data'. */
+TEST(flathash, InsertLookup)
+{
+	FlatHash *fh = BLI_flathash_int_new(__func__);
+	unsigned int keys[TESTCASE_SIZE];
+
+	init_keys(keys, 0);
+
+	for (int i = 0; i < TESTCASE_SIZE; i++) {
+		BLI_flathash_insert(fh, key_from_int(keys[i]), key_from_int(keys[i]));
+	}
+
+	EXPECT_EQ(BLI_flathash_len(fh), TESTCASE_SIZE);
+
+	for (int i = 0; i < TESTCASE_SIZE; i++) {
+		void *v = BLI_flathash_lookup(fh, key_from_int(keys[i]));
+		EXPECT_EQ(POINTER_AS_UINT(v), keys[i]);
+	}
+
+	EXPECT_FALSE(BLI_flathash_haskey(fh, key_from_int(keys[0] + 1)));
+	EXPECT_EQ(BLI_flathash_lookup_default(fh, key_from_int(keys[0] + 1), key_from_int(7)), key_from_int(7));
+
+	BLI_flathash_free(fh, NULL, NULL);
+}
+
+/* Remove half the keys, then check lookups still find the others (through deleted slots). */
+TEST(flathash, InsertRemove)
+{
+	FlatHash *fh = BLI_flathash_ptr_new(__func__);
+	unsigned int keys[TESTCASE_SIZE];
+
+	init_keys(keys, 1);
+
+	for (int i = 0; i < TESTCASE_SIZE; i++) {
+		BLI_flathash_insert(fh, key_from_int(keys[i]), key_from_int(keys[i]));
+	}
+
+	for (int i = 0; i < TESTCASE_SIZE; i += 2) {
+		void *v = BLI_flathash_popkey(fh, key_from_int(keys[i]), NULL);
+		EXPECT_EQ(POINTER_AS_UINT(v), keys[i]);
+	}
+
+	EXPECT_EQ(BLI_flathash_len(fh), TESTCASE_SIZE / 2);
+
+	for (int i = 0; i < TESTCASE_SIZE; i++) {
+		EXPECT_EQ(BLI_flathash_haskey(fh, key_from_int(keys[i])), (i % 2) == 1);
+	}
+
+	for (int i = 1; i < TESTCASE_SIZE; i += 2) {
+		EXPECT_TRUE(BLI_flathash_remove(fh, key_from_int(keys[i]), NULL, NULL));
+	}
+	EXPECT_FALSE(BLI_flathash_remove(fh, key_from_int(keys[1]), NULL, NULL));
+
+	EXPECT_EQ(BLI_flathash_len(fh), 0);
+
+	BLI_flathash_free(fh, NULL, NULL);
+}
+
+/* Insert and remove in a sliding window, so the table has to reuse deleted slots instead of growing forever. */
+TEST(flathash, Churn)
+{
+	FlatHash *fh = BLI_flathash_int_new(__func__);
+	const unsigned int window = 1000;
+
+	for (unsigned int i = 0; i < TESTCASE_SIZE * 10; i++) {
+		BLI_flathash_insert(fh, key_from_int(i), key_from_int(i));
+		if (i >= window) {
+			EXPECT_TRUE(BLI_flathash_remove(fh, key_from_int(i - window), NULL, NULL));
+		}
+	}
+
+	EXPECT_EQ(BLI_flathash_len(fh), window);
+	for (unsigned int i = TESTCASE_SIZE * 10 - window; i < TESTCASE_SIZE * 10; i++) {
+		EXPECT_EQ(POINTER_AS_UINT(BLI_flathash_lookup(fh, key_from_int(i))), i);
+	}
+
+	BLI_flathash_free(fh, NULL, NULL);
+}
+
+TEST(flathash, EnsureReinsert)
+{
+	FlatHash *fh = BLI_flathash_int_new(__func__);
+	void **val_p;
+
+	for (unsigned int i = 0; i < TESTCASE_SIZE; i++) {
+		if (!BLI_flathash_ensure_p(fh, key_from_int(i % 100), &val_p)) {
+			*val_p = key_from_int(0);
+		}
+		*val_p = key_from_int(POINTER_AS_UINT(*val_p) + 1);
+	}
+
+	EXPECT_EQ(BLI_flathash_len(fh), 100);
+	for (unsigned int i = 0; i < 100; i++) {
+		EXPECT_EQ(POINTER_AS_UINT(BLI_flathash_lookup(fh, key_from_int(i))), TESTCASE_SIZE / 100);
+	}
+
+	EXPECT_FALSE(BLI_flathash_reinsert(fh, key_from_int(5), key_from_int(42), NULL, NULL));
+	EXPECT_TRUE(BLI_flathash_reinsert(fh, key_from_int(500), key_from_int(43), NULL, NULL));
+	EXPECT_EQ(POINTER_AS_UINT(BLI_flathash_lookup(fh, key_from_int(5))), 42);
+	EXPECT_EQ(POINTER_AS_UINT(BLI_flathash_lookup(fh, key_from_int(500))), 43);
+
+	val_p = BLI_flathash_lookup_p(fh, key_from_int(6));
+	*val_p = key_from_int(44);
+	EXPECT_EQ(POINTER_AS_UINT(BLI_flathash_lookup(fh, key_from_int(6))), 44);
+	EXPECT_EQ(BLI_flathash_lookup_p(fh, key_from_int(1000)), (void **)NULL);
+
+	BLI_flathash_free(fh, NULL, NULL);
+}
+
+TEST(flathash, Iterator)
+{
+	FlatHash *fh = BLI_flathash_int_new(__func__);
+	FlatHashIterator fhi;
+	unsigned int keys[TESTCASE_SIZE];
+	unsigned int sum_expected = 0, sum = 0, count = 0;
+
+	init_keys(keys, 2);
+
+	FLATHASH_ITER (fhi, fh) {
+		count++;
+	}
+	EXPECT_EQ(count, 0);
+
+	for (int i = 0; i < TESTCASE_SIZE; i++) {
+		BLI_flathash_insert(fh, key_from_int(keys[i]), key_from_int(keys[i] + 1));
+		sum_expected += keys[i];
+	}
+
+	FLATHASH_ITER (fhi, fh) {
+		unsigned int k = POINTER_AS_UINT(BLI_flathashIterator_getKey(&fhi));
+		EXPECT_EQ(POINTER_AS_UINT(BLI_flathashIterator_getValue(&fhi)), k + 1);
+		sum += k;
+		count++;
+	}
+
+	EXPECT_EQ(count, TESTCASE_SIZE);
+	EXPECT_EQ(sum, sum_expected);
+
+	BLI_flathash_free(fh, NULL, NULL);
+}
+
+TEST(flathash, StringKeys)
+{
+	FlatHash *fh = BLI_flathash_str_new(__func__);
+	char buf[32];
+
+	for (int i = 0; i < TESTCASE_SIZE; i++) {
+		void **key_p, **val_p;
+		BLI_snprintf(buf, sizeof(buf), "key_%d", i);
+		EXPECT_FALSE(BLI_flathash_ensure_p_ex(fh, buf, &key_p, &val_p));
+		*key_p = BLI_strdup(buf);
+		*val_p = POINTER_FROM_INT(i);
+	}
+
+	EXPECT_EQ(BLI_flathash_len(fh), TESTCASE_SIZE);
+
+	for (int i = 0; i < TESTCASE_SIZE; i++) {
+		BLI_snprintf(buf, sizeof(buf), "key_%d", i);
+		EXPECT_EQ(POINTER_AS_INT(BLI_flathash_lookup(fh, buf)), i);
+	}
+	EXPECT_FALSE(BLI_flathash_haskey(fh, "key_"));
+
+	EXPECT_TRUE(BLI_flathash_remove(fh, "key_10", MEM_freeN, NULL));
+	EXPECT_FALSE(BLI_flathash_haskey(fh, "key_10"));
+
+	BLI_flathash_clear(fh, MEM_freeN, NULL);
+	EXPECT_EQ(BLI_flathash_len(fh), 0);
+	EXPECT_FALSE(BLI_flathash_haskey(fh, "key_1"));
+
+	BLI_flathash_free(fh, MEM_freeN, NULL);
+}
+
+/* Generic callbacks, comparing the result with GHash. */
+TEST(flathash, MatchGHash)
+{
+	FlatHash *fh = BLI_flathash_new(BLI_ghashutil_inthash_p_simple, BLI_ghashutil_intcmp, __func__);
+	GHash *gh = BLI_ghash_new(BLI_ghashutil_inthash_p_simple, BLI_ghashutil_intcmp, __func__);
+
+	unsigned int state = 1;
+	for (int i = 0; i < TESTCASE_SIZE * 4; i++) {
+		state = state * 1664525u + 1013904223u;
+		void *key = key_from_int((state >> 8) % 4096);
+		if ((state >> 30) & 1) {
+			BLI_flathash_reinsert(fh, key, key, NULL, NULL);
+			BLI_ghash_reinsert(gh, key, key, NULL, NULL);
+		}
+		else {
+			EXPECT_EQ(BLI_flathash_remove(fh, key, NULL, NULL), BLI_ghash_remove(gh, key, NULL, NULL));
+		}
+	}
+
+	EXPECT_EQ(BLI_flathash_len(fh), BLI_ghash_len(gh));
+	for (unsigned int k = 0; k < 4096; k++) {
+		EXPECT_EQ(BLI_flathash_haskey(fh, key_from_int(k)), BLI_ghash_haskey(gh, key_from_int(k)));
+	}
+
+	BLI_flathash_free(fh, NULL, NULL);
+	BLI_ghash_free(gh, NULL, NULL);
+}
@@ -8,6 +8,7 @@
 extern "C" {
 #include "MEM_guardedalloc.h"
 #include "BLI_utildefines.h"
+#include "BLI_flathash.h"
 #include "BLI_ghash.h"
 #include "BLI_rand.h"
 #include "BLI_string.h"
@@ -534,3 +535,307 @@ TEST(ghash, MultiRandIntMurmur2a200000)
 
 	multi_small_ghash_tests(ghash, "MultiSmall RandIntGHash - Murmur2a - 200000", 200000);
 }
+
+
+/* FlatHash: same tests as above, to compare the open-addressing hash with GHash. */
+
+static void str_flathash_tests(FlatHash *fh, const char *id)
+{
+	printf("\n========== STARTING %s ==========\n", id);
+
+	char *data = BLI_strdup(words10k);
+	char *data_p = BLI_strdup(data);
+	char *data_w = BLI_strdup(data);
+	char *data_bis = BLI_strdup(data);
+
+	{
+		char *p, *w, *c_p, *c_w;
+
+		TIMEIT_START(string_insert);
+
+#ifdef GHASH_RESERVE
+		BLI_flathash_reserve(fh, strlen(data) / 32);  /* rough estimation... */
+#endif
+
+		BLI_flathash_insert(fh, data, POINTER_FROM_INT(data[0]));
+
+		for (p = c_p = data_p, w = c_w = data_w; *c_w; c_w++, c_p++) {
+			if (*c_p == '.') {
+				*c_p = *c_w = '\0';
+				if (!BLI_flathash_haskey(fh, p)) {
+					BLI_flathash_insert(fh, p, POINTER_FROM_INT(p[0]));
+				}
+				if (!BLI_flathash_haskey(fh, w)) {
+					BLI_flathash_insert(fh, w, POINTER_FROM_INT(w[0]));
+				}
+				p = c_p + 1;
+				w = c_w + 1;
+			}
+			else if (*c_w == ' ') {
+				*c_w = '\0';
+				if (!BLI_flathash_haskey(fh, w)) {
+					BLI_flathash_insert(fh, w, POINTER_FROM_INT(w[0]));
+				}
+				w = c_w + 1;
+			}
+		}
+
+		TIMEIT_END(string_insert);
+	}
+
+	{
+		char *p, *w, *c;
+		void *v;
+
+		TIMEIT_START(string_lookup);
+
+		v = BLI_flathash_lookup(fh, data_bis);
+		EXPECT_EQ(POINTER_AS_INT(v), data_bis[0]);
+
+		for (p = w = c = data_bis; *c; c++) {
+			if (*c == '.') {
+				*c = '\0';
+				v = BLI_flathash_lookup(fh, w);
+				EXPECT_EQ(POINTER_AS_INT(v), w[0]);
+				v = BLI_flathash_lookup(fh, p);
+				EXPECT_EQ(POINTER_AS_INT(v), p[0]);
+				p = w = c + 1;
+			}
+			else if (*c == ' ') {
+				*c = '\0';
+				v = BLI_flathash_lookup(fh, w);
+				EXPECT_EQ(POINTER_AS_INT(v), w[0]);
+				w = c + 1;
+			}
+		}
+
+		TIMEIT_END(string_lookup);
+	}
+
+	BLI_flathash_free(fh, NULL, NULL);
+	MEM_freeN(data);
+	MEM_freeN(data_p);
+	MEM_freeN(data_w);
+	MEM_freeN(data_bis);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(ghash, TextFlatHash)
+{
+	FlatHash *fh = BLI_flathash_str_new(__func__);
+
+	str_flathash_tests(fh, "StrGHash - FlatHash");
+}
+
+static void int_flathash_tests(FlatHash *fh, const char *id, const unsigned int nbr)
+{
+	printf("\n========== STARTING %s ==========\n", id);
+
+	{
+		unsigned int i = nbr;
+
+		TIMEIT_START(int_insert);
+
+#ifdef GHASH_RESERVE
+		BLI_flathash_reserve(fh, nbr);
+#endif
+
+		while (i--) {
+			BLI_flathash_insert(fh, POINTER_FROM_UINT(i), POINTER_FROM_UINT(i));
+		}
+
+		TIMEIT_END(int_insert);
+	}
+
+	{
+		unsigned int i = nbr;
+
+		TIMEIT_START(int_lookup);
+
+		while (i--) {
+			void *v = BLI_flathash_lookup(fh, POINTER_FROM_UINT(i));
+			EXPECT_EQ(POINTER_AS_UINT(v), i);
+		}
+
+		TIMEIT_END(int_lookup);
+	}
+
+	{
+		unsigned int i = nbr;
+
+		TIMEIT_START(int_remove);
+
+		while (i--) {
+			void *v = BLI_flathash_popkey(fh, POINTER_FROM_UINT(i), NULL);
+			EXPECT_EQ(POINTER_AS_UINT(v), i);
+		}
+
+		TIMEIT_END(int_remove);
+	}
+	EXPECT_EQ(BLI_flathash_len(fh), 0);
+
+	BLI_flathash_free(fh, NULL, NULL);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(ghash, IntFlatHash12000)
+{
+	FlatHash *fh = BLI_flathash_int_new(__func__);
+
+	int_flathash_tests(fh, "IntGHash - FlatHash - 12000", 12000);
+}
+
+#ifdef GHASH_RUN_BIG
+TEST(ghash, IntFlatHash100000000)
+{
+	FlatHash *fh = BLI_flathash_int_new(__func__);
+
+	int_flathash_tests(fh, "IntGHash - FlatHash - 100000000", 100000000);
+}
+#endif
+
+static void randint_flathash_tests(FlatHash *fh, const char *id, const unsigned int nbr)
+{
+	printf("\n========== STARTING %s ==========\n", id);
+
+	unsigned int *data = (unsigned int *)MEM_mallocN(sizeof(*data) * (size_t)nbr, __func__);
+	unsigned int *dt;
+	unsigned int i;
+
+	{
+		RNG *rng = BLI_rng_new(0);
+		for (i = nbr, dt = data; i--; dt++) {
+			*dt = BLI_rng_get_uint(rng);
+		}
+		BLI_rng_free(rng);
+	}
+
+	{
+		TIMEIT_START(int_insert);
+
+#ifdef GHASH_RESERVE
+		BLI_flathash_reserve(fh, nbr);
+#endif
+
+		/* Random keys may repeat. */
+		for (i = nbr, dt = data; i--; dt++) {
+			BLI_flathash_reinsert(fh, POINTER_FROM_UINT(*dt), POINTER_FROM_UINT(*dt), NULL, NULL);
+		}
+
+		TIMEIT_END(int_insert);
+	}
+
+	{
+		TIMEIT_START(int_lookup);
+
+		for (i = nbr, dt = data; i--; dt++) {
+			void *v = BLI_flathash_lookup(fh, POINTER_FROM_UINT(*dt));
+			EXPECT_EQ(POINTER_AS_UINT(v), *dt);
+		}
+
+		TIMEIT_END(int_lookup);
+	}
+
+	BLI_flathash_free(fh, NULL, NULL);
+	MEM_freeN(data);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(ghash, IntRandFlatHash12000)
+{
+	FlatHash *fh = BLI_flathash_int_new(__func__);
+
+	randint_flathash_tests(fh, "RandIntGHash - FlatHash - 12000", 12000);
+}
+
+#ifdef GHASH_RUN_BIG
+TEST(ghash, IntRandFlatHash50000000)
+{
+	FlatHash *fh = BLI_flathash_int_new(__func__);
+
+	randint_flathash_tests(fh, "RandIntGHash - FlatHash - 50000000", 50000000);
+}
+#endif
+
+TEST(ghash, IntRandFlatHashCallbacks12000)
+{
+	FlatHash *fh = BLI_flathash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+
+	randint_flathash_tests(fh, "RandIntGHash - FlatHash (callbacks) - 12000", 12000);
+}
+
+static void multi_small_flathash_tests_one(FlatHash *fh, RNG *rng, const unsigned int nbr)
+{
+	unsigned int *data = (unsigned int *)MEM_mallocN(sizeof(*data) * (size_t)nbr, __func__);
+	unsigned int *dt;
+	unsigned int i;
+
+	for (i = nbr, dt = data; i--; dt++) {
+		*dt = BLI_rng_get_uint(rng);
+	}
+
+#ifdef GHASH_RESERVE
+	BLI_flathash_reserve(fh, nbr);
+#endif
+
+	for (i = nbr, dt = data; i--; dt++) {
+		BLI_flathash_reinsert(fh, POINTER_FROM_UINT(*dt), POINTER_FROM_UINT(*dt), NULL, NULL);
+	}
+
+	for (i = nbr, dt = data; i--; dt++) {
+		void *v = BLI_flathash_lookup(fh, POINTER_FROM_UINT(*dt));
+		EXPECT_EQ(POINTER_AS_UINT(v), *dt);
+	}
+
+	BLI_flathash_clear(fh, NULL, NULL);
+	MEM_freeN(data);
+}
+
+static void multi_small_flathash_tests(FlatHash *fh, const char *id, const unsigned int nbr)
+{
+	printf("\n========== STARTING %s ==========\n", id);
+
+	RNG *rng = BLI_rng_new(0);
+
+	TIMEIT_START(multi_small_flathash);
+
+	unsigned int i = nbr;
+	while (i--) {
+		const int nbr = 1 + (BLI_rng_get_int(rng) % TESTCASE_SIZE_SMALL) * (!(i % 100) ? 100 : (!(i % 10) ? 10 : 1));
+		multi_small_flathash_tests_one(fh, rng, nbr);
+	}
+
+	TIMEIT_END(multi_small_flathash);
+
+	TIMEIT_START(multi_small2_flathash);
+
+	unsigned int i = nbr;
+	while (i--) {
+		const int nbr = 1 + (BLI_rng_get_int(rng) % TESTCASE_SIZE_SMALL) / 2 * (!(i % 100) ? 100 : (!(i % 10) ? 10 : 1));
+		multi_small_flathash_tests_one(fh, rng, nbr);
+	}
+
+	TIMEIT_END(multi_small2_flathash);
+
+	BLI_flathash_free(fh, NULL, NULL);
+	BLI_rng_free(rng);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(ghash, MultiRandIntFlatHash2000)
+{
+	FlatHash *fh = BLI_flathash_int_new(__func__);
+
+	multi_small_flathash_tests(fh, "MultiSmall RandIntGHash - FlatHash - 2000", 2000);
+}
+
+TEST(ghash, MultiRandIntFlatHash200000)
+{
+	FlatHash *fh = BLI_flathash_int_new(__func__);
+
+	multi_small_flathash_tests(fh, "MultiSmall RandIntGHash - FlatHash - 200000", 200000);
+}
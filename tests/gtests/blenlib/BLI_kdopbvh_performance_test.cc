@@ -0,0 +1,107 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_compiler_attrs.h"
+#include "BLI_kdopbvh.h"
+#include "BLI_rand.h"
+#include "BLI_math_vector.h"
+#include "MEM_guardedalloc.h"
+#include "PIL_time_utildefines.h"
+}
+
+#include "stubs/bf_intern_eigen_stubs.h"
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+static void rng_v3_round(
+        float *coords, int coords_len,
+        struct RNG *rng, int round, float scale)
+{
+	for (int i = 0; i < coords_len; i++) {
+		float f = BLI_rng_get_float(rng) * 2.0f - 1.0f;
+		coords[i] = ((float)((int)(f * round)) / (float)round) * scale;
+	}
+}
+
+static BVHTree *points_tree_new(float (*points)[3], int points_len, struct RNG *rng, int round)
+{
+	BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+	for (int i = 0; i < points_len; i++) {
+		rng_v3_round(points[i], 3, rng, round, 1.0f);
+		BLI_bvhtree_insert(tree, i, points[i], 1);
+	}
+	BLI_bvhtree_balance(tree);
+	return tree;
+}
+
+/* -------------------------------------------------------------------- */
+/* Tests */
+
+TEST(kdopbvh, BatchBenchmark)
+{
+	const int points_len = 100000;
+	struct RNG *rng = BLI_rng_new(42);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	float (*dir)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest) * points_len, __func__);
+	BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hits) * points_len, __func__);
+	BVHTree *tree = points_tree_new(points, points_len, rng, 1000000);
+
+	/* Coherent queries: close points, parallel rays. */
+	float (*co)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	for (int i = 0; i < points_len; i++) {
+		const int x = i % 316, y = i / 316;
+		co[i][0] = (float)x / 158.0f - 1.0f;
+		co[i][1] = (float)y / 158.0f - 1.0f;
+		co[i][2] = -2.0f;
+		copy_v3_fl3(dir[i], 0.0f, 0.0f, 1.0f);
+	}
+
+	{
+		TIMEIT_START(find_nearest_single);
+		for (int i = 0; i < points_len; i++) {
+			nearest[i].index = -1;
+			nearest[i].dist_sq = FLT_MAX;
+			BLI_bvhtree_find_nearest_ex(tree, co[i], &nearest[i], NULL, NULL, 0);
+		}
+		TIMEIT_END(find_nearest_single);
+	}
+	{
+		TIMEIT_START(find_nearest_batch);
+		for (int i = 0; i < points_len; i++) {
+			nearest[i].index = -1;
+			nearest[i].dist_sq = FLT_MAX;
+		}
+		BLI_bvhtree_find_nearest_batch(tree, co, nearest, points_len, NULL, NULL, 0);
+		TIMEIT_END(find_nearest_batch);
+	}
+	{
+		TIMEIT_START(ray_cast_single);
+		for (int i = 0; i < points_len; i++) {
+			hits[i].index = -1;
+			hits[i].dist = BVH_RAYCAST_DIST_MAX;
+			BLI_bvhtree_ray_cast_ex(tree, co[i], dir[i], 0.001f, &hits[i], NULL, NULL, BVH_RAYCAST_DEFAULT);
+		}
+		TIMEIT_END(ray_cast_single);
+	}
+	{
+		TIMEIT_START(ray_cast_batch);
+		for (int i = 0; i < points_len; i++) {
+			hits[i].index = -1;
+			hits[i].dist = BVH_RAYCAST_DIST_MAX;
+		}
+		BLI_bvhtree_ray_cast_batch(tree, co, dir, 0.001f, hits, points_len, NULL, NULL, BVH_RAYCAST_DEFAULT);
+		TIMEIT_END(ray_cast_batch);
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(co);
+	MEM_freeN(dir);
+	MEM_freeN(nearest);
+	MEM_freeN(hits);
+}
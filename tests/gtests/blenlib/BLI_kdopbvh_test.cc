@@ -115,3 +115,185 @@ TEST(kdopbvh, FindNearest_500)		{ find_nearest_points_test(500, 1.0, 1000, 12);
 TEST(kdopbvh, OptimalFindNearest_1)		{ find_nearest_points_test(1, 1.0, 1000, 1234, true); }
 TEST(kdopbvh, OptimalFindNearest_2)		{ find_nearest_points_test(2, 1.0, 1000, 123, true); }
 TEST(kdopbvh, OptimalFindNearest_500)		{ find_nearest_points_test(500, 1.0, 1000, 12, true); }
+
+/* -------------------------------------------------------------------- */
+/* Batched Queries */
+
+static BVHTree *points_tree_new(float (*points)[3], int points_len, struct RNG *rng, int round)
+{
+	BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
+	for (int i = 0; i < points_len; i++) {
+		rng_v3_round(points[i], 3, rng, round, 1.0f);
+		BLI_bvhtree_insert(tree, i, points[i], 1);
+	}
+	BLI_bvhtree_balance(tree);
+	return tree;
+}
+
+/**
+ * Check #BLI_bvhtree_find_nearest_batch finds the same as #BLI_bvhtree_find_nearest_ex
+ * for points which are not in the tree.
+ */
+static void find_nearest_batch_test(int points_len, int co_len, int random_seed, bool optimal = false)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	float (*co)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * co_len, __func__);
+	BVHTreeNearest *nearest = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest) * co_len, __func__);
+	BVHTree *tree = points_tree_new(points, points_len, rng, 1000);
+	const int flags = optimal ? BVH_NEAREST_OPTIMAL_ORDER : 0;
+
+	for (int i = 0; i < co_len; i++) {
+		rng_v3_round(co[i], 3, rng, 100000, 1.5f);
+		nearest[i].index = -1;
+		nearest[i].dist_sq = FLT_MAX;
+	}
+
+	BLI_bvhtree_find_nearest_batch(tree, co, nearest, co_len, NULL, NULL, flags);
+
+	for (int i = 0; i < co_len; i++) {
+		BVHTreeNearest nearest_single;
+		nearest_single.index = -1;
+		nearest_single.dist_sq = FLT_MAX;
+		BLI_bvhtree_find_nearest_ex(tree, co[i], &nearest_single, NULL, NULL, flags);
+
+		EXPECT_GE(nearest[i].index, 0);
+		EXPECT_FLOAT_EQ(nearest[i].dist_sq, nearest_single.dist_sq);
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(co);
+	MEM_freeN(nearest);
+}
+
+TEST(kdopbvh, FindNearestBatch_1)		{ find_nearest_batch_test(1, 3, 1234); }
+TEST(kdopbvh, FindNearestBatch_500)		{ find_nearest_batch_test(500, 1001, 12); }
+TEST(kdopbvh, OptimalFindNearestBatch_500)		{ find_nearest_batch_test(500, 1001, 12, true); }
+
+/**
+ * Check #BLI_bvhtree_ray_cast_batch hits the same as #BLI_bvhtree_ray_cast_ex,
+ * casting rays from random points towards the points of the tree.
+ */
+static void ray_cast_batch_test(int points_len, int rays_len, int random_seed)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	float (*co)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+	float (*dir)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * rays_len, __func__);
+	BVHTreeRayHit *hits = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hits) * rays_len, __func__);
+	BVHTree *tree = points_tree_new(points, points_len, rng, 1000);
+	const float radius = 0.01f;
+
+	for (int i = 0; i < rays_len; i++) {
+		rng_v3_round(co[i], 3, rng, 100000, 2.0f);
+		sub_v3_v3v3(dir[i], points[i % points_len], co[i]);
+		normalize_v3(dir[i]);
+		hits[i].index = -1;
+		hits[i].dist = BVH_RAYCAST_DIST_MAX;
+	}
+
+	BLI_bvhtree_ray_cast_batch(tree, co, dir, radius, hits, rays_len, NULL, NULL, BVH_RAYCAST_DEFAULT);
+
+	for (int i = 0; i < rays_len; i++) {
+		BVHTreeRayHit hit_single;
+		hit_single.index = -1;
+		hit_single.dist = BVH_RAYCAST_DIST_MAX;
+		BLI_bvhtree_ray_cast_ex(tree, co[i], dir[i], radius, &hit_single, NULL, NULL, BVH_RAYCAST_DEFAULT);
+
+		/* Every ray is aimed at a point. */
+		EXPECT_GE(hits[i].index, 0);
+		EXPECT_NEAR(hits[i].dist, hit_single.dist, 1e-5f);
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+	MEM_freeN(co);
+	MEM_freeN(dir);
+	MEM_freeN(hits);
+}
+
+TEST(kdopbvh, RayCastBatch_1)		{ ray_cast_batch_test(1, 3, 1234); }
+TEST(kdopbvh, RayCastBatch_500)		{ ray_cast_batch_test(500, 1001, 12); }
+
+/* -------------------------------------------------------------------- */
+/* Compact Layout */
+
+static void range_query_count_cb(void *userdata, int UNUSED(index), const float UNUSED(co[3]), float UNUSED(dist_sq))
+{
+	(*(int *)userdata)++;
+}
+
+/**
+ * Trees with up to 4 children per node are queried through their compact layout,
+ * check they give the same results as an octree (which isn't).
+ */
+static void compact_layout_test(int points_len, char tree_type, int random_seed)
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, tree_type, 6);
+	BVHTree *tree_ref = BLI_bvhtree_new(points_len, 0.0, 8, 6);
+
+	for (int i = 0; i < points_len; i++) {
+		rng_v3_round(points[i], 3, rng, 1000, 1.0f);
+		BLI_bvhtree_insert(tree, i, points[i], 1);
+		BLI_bvhtree_insert(tree_ref, i, points[i], 1);
+	}
+	BLI_bvhtree_balance(tree);
+	BLI_bvhtree_balance(tree_ref);
+
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			/* move the points, the compact layout must follow */
+			for (int i = 0; i < points_len; i++) {
+				points[i][2] += 0.5f * points[i][0];
+				BLI_bvhtree_update_node(tree, i, points[i], NULL, 1);
+				BLI_bvhtree_update_node(tree_ref, i, points[i], NULL, 1);
+			}
+			BLI_bvhtree_update_tree(tree);
+			BLI_bvhtree_update_tree(tree_ref);
+		}
+
+		for (int i = 0; i < 200; i++) {
+			float co[3], dir[3];
+			rng_v3_round(co, 3, rng, 100000, 1.5f);
+
+			BVHTreeNearest nearest = {-1}, nearest_ref = {-1};
+			nearest.dist_sq = nearest_ref.dist_sq = FLT_MAX;
+			BLI_bvhtree_find_nearest(tree, co, &nearest, NULL, NULL);
+			BLI_bvhtree_find_nearest(tree_ref, co, &nearest_ref, NULL, NULL);
+			EXPECT_GE(nearest.index, 0);
+			EXPECT_FLOAT_EQ(nearest.dist_sq, nearest_ref.dist_sq);
+
+			sub_v3_v3v3(dir, points[i % points_len], co);
+			normalize_v3(dir);
+			for (int j = 0; j < 2; j++) {
+				const float radius = j ? 0.01f : 0.0f;
+				BVHTreeRayHit hit = {-1}, hit_ref = {-1};
+				hit.dist = hit_ref.dist = BVH_RAYCAST_DIST_MAX;
+				BLI_bvhtree_ray_cast(tree, co, dir, radius, &hit, NULL, NULL);
+				BLI_bvhtree_ray_cast(tree_ref, co, dir, radius, &hit_ref, NULL, NULL);
+				EXPECT_EQ(hit.index == -1, hit_ref.index == -1);
+				EXPECT_FLOAT_EQ(hit.dist, hit_ref.dist);
+			}
+
+			int hits = 0, hits_ref = 0;
+			EXPECT_EQ(BLI_bvhtree_range_query(tree, co, 0.2f, range_query_count_cb, &hits),
+			          BLI_bvhtree_range_query(tree_ref, co, 0.2f, range_query_count_cb, &hits_ref));
+			EXPECT_EQ(hits, hits_ref);
+		}
+	}
+
+	BLI_bvhtree_free(tree);
+	BLI_bvhtree_free(tree_ref);
+	BLI_rng_free(rng);
+	MEM_freeN(points);
+}
+
+TEST(kdopbvh, CompactLayout_Binary_1)		{ compact_layout_test(1, 2, 1234); }
+TEST(kdopbvh, CompactLayout_Binary_500)		{ compact_layout_test(500, 2, 12); }
+TEST(kdopbvh, CompactLayout_Ternary_500)		{ compact_layout_test(500, 3, 12); }
+TEST(kdopbvh, CompactLayout_Quad_500)		{ compact_layout_test(500, 4, 12); }
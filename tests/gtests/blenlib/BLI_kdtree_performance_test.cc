@@ -0,0 +1,55 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_kdtree.h"
+#include "BLI_rand.h"
+#include "BLI_math_vector.h"
+#include "BLI_utildefines.h"
+#include "MEM_guardedalloc.h"
+#include "PIL_time_utildefines.h"
+}
+
+static float (*random_points_new(int points_len, int random_seed))[3]
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	for (int i = 0; i < points_len; i++) {
+		BLI_rng_get_float_unit_v3(rng, points[i]);
+		mul_v3_fl(points[i], BLI_rng_get_float(rng));
+	}
+	BLI_rng_free(rng);
+	return points;
+}
+
+TEST(kdtree, Benchmark)
+{
+	const int points_len = 200000;
+	const unsigned int n = 8;
+	float (*points)[3] = random_points_new(points_len, 6);
+	KDTreeNearest *nearest = (KDTreeNearest *)MEM_mallocN(sizeof(*nearest) * points_len * n, __func__);
+	KDTree *tree = BLI_kdtree_new(points_len);
+
+	for (int i = 0; i < points_len; i++) {
+		BLI_kdtree_insert(tree, i, points[i]);
+	}
+
+	TIMEIT_START(kdtree_balance);
+	BLI_kdtree_balance(tree);
+	TIMEIT_END(kdtree_balance);
+
+	TIMEIT_START(kdtree_find_nearest_n);
+	for (int i = 0; i < points_len; i++) {
+		BLI_kdtree_find_nearest_n(tree, points[i], &nearest[i * n], n);
+	}
+	TIMEIT_END(kdtree_find_nearest_n);
+
+	TIMEIT_START(kdtree_find_nearest_n_batch);
+	BLI_kdtree_find_nearest_n_batch(tree, points, points_len, nearest, n, NULL);
+	TIMEIT_END(kdtree_find_nearest_n_batch);
+
+	BLI_kdtree_free(tree);
+	MEM_freeN(points);
+	MEM_freeN(nearest);
+}
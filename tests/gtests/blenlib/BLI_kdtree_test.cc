@@ -0,0 +1,183 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_kdtree.h"
+#include "BLI_rand.h"
+#include "BLI_math_vector.h"
+#include "BLI_utildefines.h"
+#include "MEM_guardedalloc.h"
+}
+
+/* -------------------------------------------------------------------- */
+/* Helper Functions */
+
+static float (*random_points_new(int points_len, int random_seed))[3]
+{
+	struct RNG *rng = BLI_rng_new(random_seed);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(float[3]) * points_len, __func__);
+	for (int i = 0; i < points_len; i++) {
+		BLI_rng_get_float_unit_v3(rng, points[i]);
+		mul_v3_fl(points[i], BLI_rng_get_float(rng));
+	}
+	BLI_rng_free(rng);
+	return points;
+}
+
+static KDTree *kdtree_from_points(const float (*points)[3], int points_len)
+{
+	KDTree *tree = BLI_kdtree_new((unsigned int)points_len);
+	for (int i = 0; i < points_len; i++) {
+		BLI_kdtree_insert(tree, i, points[i]);
+	}
+	BLI_kdtree_balance(tree);
+	return tree;
+}
+
+static int brute_force_nearest(const float (*points)[3], int points_len, const float co[3])
+{
+	int index = -1;
+	float dist_sq_min = FLT_MAX;
+	for (int i = 0; i < points_len; i++) {
+		const float dist_sq = len_squared_v3v3(points[i], co);
+		if (dist_sq < dist_sq_min) {
+			dist_sq_min = dist_sq;
+			index = i;
+		}
+	}
+	return index;
+}
+
+/* -------------------------------------------------------------------- */
+/* Tests */
+
+TEST(kdtree, Empty)
+{
+	KDTree *tree = BLI_kdtree_new(0);
+	BLI_kdtree_balance(tree);
+	const float co[3] = {0.0f, 0.0f, 0.0f};
+	EXPECT_EQ(BLI_kdtree_find_nearest(tree, co, NULL), -1);
+	BLI_kdtree_free(tree);
+}
+
+/* Large enough for the sub-trees to be balanced in parallel. */
+static void find_nearest_test(int points_len, int random_seed)
+{
+	float (*points)[3] = random_points_new(points_len, random_seed);
+	float (*co)[3] = random_points_new(100, random_seed + 1);
+	KDTree *tree = kdtree_from_points(points, points_len);
+
+	for (int i = 0; i < points_len; i += 97) {
+		KDTreeNearest nearest;
+		EXPECT_EQ(BLI_kdtree_find_nearest(tree, points[i], &nearest), i);
+		EXPECT_EQ(nearest.dist, 0.0f);
+	}
+	for (int i = 0; i < 100; i++) {
+		EXPECT_EQ(BLI_kdtree_find_nearest(tree, co[i], NULL), brute_force_nearest(points, points_len, co[i]));
+	}
+
+	BLI_kdtree_free(tree);
+	MEM_freeN(points);
+	MEM_freeN(co);
+}
+
+TEST(kdtree, FindNearest_1)		{ find_nearest_test(1, 1234); }
+TEST(kdtree, FindNearest_1000)		{ find_nearest_test(1000, 123); }
+TEST(kdtree, FindNearest_100000)		{ find_nearest_test(100000, 12); }
+
+TEST(kdtree, Rebalance)
+{
+	float (*points)[3] = random_points_new(2000, 1);
+	KDTree *tree = BLI_kdtree_new(2000);
+
+	for (int i = 0; i < 1000; i++) {
+		BLI_kdtree_insert(tree, i, points[i]);
+	}
+	BLI_kdtree_balance(tree);
+	for (int i = 1000; i < 2000; i++) {
+		BLI_kdtree_insert(tree, i, points[i]);
+	}
+	BLI_kdtree_balance(tree);
+
+	for (int i = 0; i < 2000; i++) {
+		EXPECT_EQ(BLI_kdtree_find_nearest(tree, points[i], NULL), i);
+	}
+
+	BLI_kdtree_free(tree);
+	MEM_freeN(points);
+}
+
+TEST(kdtree, FindNearestNBatch)
+{
+	const int points_len = 10000, co_len = 2000;
+	const unsigned int n = 8;
+	float (*points)[3] = random_points_new(points_len, 2);
+	float (*co)[3] = random_points_new(co_len, 3);
+	KDTree *tree = kdtree_from_points(points, points_len);
+	KDTreeNearest *nearest = (KDTreeNearest *)MEM_mallocN(sizeof(*nearest) * co_len * n, __func__);
+	int *found = (int *)MEM_mallocN(sizeof(*found) * co_len, __func__);
+
+	BLI_kdtree_find_nearest_n_batch(tree, co, co_len, nearest, n, found);
+
+	for (int i = 0; i < co_len; i++) {
+		KDTreeNearest nearest_single[n];
+		EXPECT_EQ(found[i], BLI_kdtree_find_nearest_n(tree, co[i], nearest_single, n));
+		for (int j = 0; j < found[i]; j++) {
+			EXPECT_EQ(nearest[i * n + j].index, nearest_single[j].index);
+			EXPECT_EQ(nearest[i * n + j].dist, nearest_single[j].dist);
+		}
+	}
+
+	BLI_kdtree_free(tree);
+	MEM_freeN(points);
+	MEM_freeN(co);
+	MEM_freeN(nearest);
+	MEM_freeN(found);
+}
+
+TEST(kdtree, RangeSearchBatch)
+{
+	const int points_len = 10000, co_len = 2000;
+	float (*points)[3] = random_points_new(points_len, 4);
+	float (*co)[3] = random_points_new(co_len, 5);
+	KDTree *tree = kdtree_from_points(points, points_len);
+	KDTreeNearest **nearest = (KDTreeNearest **)MEM_mallocN(sizeof(*nearest) * co_len, __func__);
+	int *nearest_len = (int *)MEM_mallocN(sizeof(*nearest_len) * co_len, __func__);
+
+	BLI_kdtree_range_search_batch(tree, co, co_len, 0.1f, nearest, nearest_len);
+
+	for (int i = 0; i < co_len; i++) {
+		KDTreeNearest *nearest_single;
+		EXPECT_EQ(nearest_len[i], BLI_kdtree_range_search(tree, co[i], &nearest_single, 0.1f));
+		for (int j = 0; j < nearest_len[i]; j++) {
+			EXPECT_EQ(nearest[i][j].dist, nearest_single[j].dist);
+		}
+		MEM_SAFE_FREE(nearest[i]);
+		MEM_SAFE_FREE(nearest_single);
+	}
+
+	BLI_kdtree_free(tree);
+	MEM_freeN(points);
+	MEM_freeN(co);
+	MEM_freeN(nearest);
+	MEM_freeN(nearest_len);
+}
+
+TEST(kdtree, RangeSearchBatchEmpty)
+{
+	const float co[2][3] = {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}};
+	KDTreeNearest *nearest[2] = {(KDTreeNearest *)co, (KDTreeNearest *)co};
+	int nearest_len[2];
+	KDTree *tree = BLI_kdtree_new(0);
+	BLI_kdtree_balance(tree);
+
+	BLI_kdtree_range_search_batch(tree, co, 2, 0.1f, nearest, nearest_len);
+
+	for (int i = 0; i < 2; i++) {
+		EXPECT_EQ(nearest_len[i], 0);
+		EXPECT_EQ(nearest[i], (KDTreeNearest *)NULL);
+	}
+
+	BLI_kdtree_free(tree);
+}
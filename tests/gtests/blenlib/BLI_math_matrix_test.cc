@@ -0,0 +1,108 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_utildefines.h"
+}
+
+/* Vectors in a struct, as #MVert.co. */
+struct VertTest {
+	float co[3];
+	int flag;
+};
+
+static float (*random_vectors_new(int vecs_len, int random_seed))[3]
+{
+	RNG *rng = BLI_rng_new(random_seed);
+	float (*vecs)[3] = (float (*)[3])MEM_mallocN(sizeof(*vecs) * vecs_len, __func__);
+	for (int i = 0; i < vecs_len; i++) {
+		BLI_rng_get_float_unit_v3(rng, vecs[i]);
+		mul_v3_fl(vecs[i], 100.0f * BLI_rng_get_float(rng));
+	}
+	BLI_rng_free(rng);
+	return vecs;
+}
+
+static void random_matrix(float mat[4][4], int random_seed)
+{
+	RNG *rng = BLI_rng_new(random_seed);
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			mat[i][j] = BLI_rng_get_float(rng) * 2.0f - 1.0f;
+		}
+	}
+	BLI_rng_free(rng);
+}
+
+TEST(math_matrix, MulM4V3Array)
+{
+	const int vecs_len = 1001;
+	float (*vecs)[3] = random_vectors_new(vecs_len, 1);
+	float (*vecs_array)[3] = (float (*)[3])MEM_dupallocN(vecs);
+	float mat[4][4];
+	random_matrix(mat, 2);
+
+	mul_m4_v3_array(mat, vecs_array, vecs_len);
+	for (int i = 0; i < vecs_len; i++) {
+		mul_m4_v3(mat, vecs[i]);
+		for (int j = 0; j < 3; j++) {
+			EXPECT_FLOAT_EQ(vecs_array[i][j], vecs[i][j]);
+		}
+	}
+
+	MEM_freeN(vecs);
+	MEM_freeN(vecs_array);
+}
+
+TEST(math_matrix, MulM4V3ArrayStride)
+{
+	const int verts_len = 1001;
+	float (*vecs)[3] = random_vectors_new(verts_len, 3);
+	VertTest *verts = (VertTest *)MEM_mallocN(sizeof(*verts) * verts_len, __func__);
+	float mat[4][4];
+	random_matrix(mat, 4);
+
+	for (int i = 0; i < verts_len; i++) {
+		copy_v3_v3(verts[i].co, vecs[i]);
+		verts[i].flag = i;
+	}
+
+	mul_m4_v3_array_stride(mat, verts[0].co, verts_len, sizeof(*verts));
+	for (int i = 0; i < verts_len; i++) {
+		mul_m4_v3(mat, vecs[i]);
+		for (int j = 0; j < 3; j++) {
+			EXPECT_FLOAT_EQ(verts[i].co[j], vecs[i][j]);
+		}
+		/* Other members are untouched. */
+		EXPECT_EQ(verts[i].flag, i);
+	}
+
+	MEM_freeN(vecs);
+	MEM_freeN(verts);
+}
+
+TEST(math_matrix, MulM3V3Array)
+{
+	const int vecs_len = 1001;
+	float (*vecs)[3] = random_vectors_new(vecs_len, 5);
+	float (*vecs_array)[3] = (float (*)[3])MEM_dupallocN(vecs);
+	float mat4[4][4], mat[3][3];
+	random_matrix(mat4, 6);
+	copy_m3_m4(mat, mat4);
+
+	mul_m3_v3_array(mat, vecs_array, vecs_len);
+	for (int i = 0; i < vecs_len; i++) {
+		mul_m3_v3(mat, vecs[i]);
+		for (int j = 0; j < 3; j++) {
+			EXPECT_FLOAT_EQ(vecs_array[i][j], vecs[i][j]);
+		}
+	}
+
+	MEM_freeN(vecs);
+	MEM_freeN(vecs_array);
+}
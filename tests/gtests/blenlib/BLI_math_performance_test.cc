@@ -0,0 +1,110 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_utildefines.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Vectors in a struct, as #MVert.co. */
+struct VertTest {
+	float co[3];
+	int flag;
+};
+
+static float (*random_vectors_new(int vecs_len, int random_seed))[3]
+{
+	RNG *rng = BLI_rng_new(random_seed);
+	float (*vecs)[3] = (float (*)[3])MEM_mallocN(sizeof(*vecs) * vecs_len, __func__);
+	for (int i = 0; i < vecs_len; i++) {
+		BLI_rng_get_float_unit_v3(rng, vecs[i]);
+		mul_v3_fl(vecs[i], 100.0f * BLI_rng_get_float(rng));
+	}
+	BLI_rng_free(rng);
+	return vecs;
+}
+
+static void random_matrix(float mat[4][4], int random_seed)
+{
+	RNG *rng = BLI_rng_new(random_seed);
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			mat[i][j] = BLI_rng_get_float(rng) * 2.0f - 1.0f;
+		}
+	}
+	BLI_rng_free(rng);
+}
+
+TEST(math_matrix, MulM4V3ArrayBenchmark)
+{
+	const int verts_len = 1000000;
+	float (*vecs)[3] = random_vectors_new(verts_len, 7);
+	VertTest *verts = (VertTest *)MEM_mallocN(sizeof(*verts) * verts_len, __func__);
+	float mat[4][4];
+	random_matrix(mat, 8);
+
+	for (int i = 0; i < verts_len; i++) {
+		copy_v3_v3(verts[i].co, vecs[i]);
+	}
+
+	TIMEIT_START(mul_m4_v3);
+	for (int iter = 0; iter < 10; iter++) {
+		for (int i = 0; i < verts_len; i++) {
+			mul_m4_v3(mat, verts[i].co);
+		}
+	}
+	TIMEIT_END(mul_m4_v3);
+
+	TIMEIT_START(mul_m4_v3_array_stride);
+	for (int iter = 0; iter < 10; iter++) {
+		mul_m4_v3_array_stride(mat, verts[0].co, verts_len, sizeof(*verts));
+	}
+	TIMEIT_END(mul_m4_v3_array_stride);
+
+	MEM_freeN(vecs);
+	MEM_freeN(verts);
+}
+
+TEST(math_vector, ArrayBenchmark)
+{
+	const int vecs_len = 1000000;
+	float (*vecs)[3] = random_vectors_new(vecs_len, 3);
+	float (*vecs_copy)[3] = (float (*)[3])MEM_mallocN(sizeof(*vecs) * vecs_len, __func__);
+	float min[3], max[3];
+
+	memcpy(vecs_copy, vecs, sizeof(*vecs) * vecs_len);
+	TIMEIT_START(normalize_v3);
+	for (int i = 0; i < vecs_len; i++) {
+		normalize_v3(vecs_copy[i]);
+	}
+	TIMEIT_END(normalize_v3);
+
+	memcpy(vecs_copy, vecs, sizeof(*vecs) * vecs_len);
+	TIMEIT_START(normalize_v3_array);
+	normalize_v3_array(vecs_copy, vecs_len);
+	TIMEIT_END(normalize_v3_array);
+
+	INIT_MINMAX(min, max);
+	TIMEIT_START(minmax_v3v3_v3);
+	for (int iter = 0; iter < 10; iter++) {
+		for (int i = 0; i < vecs_len; i++) {
+			minmax_v3v3_v3(min, max, vecs[i]);
+		}
+	}
+	TIMEIT_END(minmax_v3v3_v3);
+
+	INIT_MINMAX(min, max);
+	TIMEIT_START(minmax_v3v3_v3_array);
+	for (int iter = 0; iter < 10; iter++) {
+		minmax_v3v3_v3_array(min, max, (const float (*)[3])vecs, vecs_len);
+	}
+	TIMEIT_END(minmax_v3v3_v3_array);
+
+	MEM_freeN(vecs);
+	MEM_freeN(vecs_copy);
+}
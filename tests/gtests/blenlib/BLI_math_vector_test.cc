@@ -0,0 +1,83 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_utildefines.h"
+}
+
+/* Vectors in a struct, as #MVert.co. */
+struct VertTest {
+	float co[3];
+	int flag;
+};
+
+static float (*random_vectors_new(int vecs_len, int random_seed))[3]
+{
+	RNG *rng = BLI_rng_new(random_seed);
+	float (*vecs)[3] = (float (*)[3])MEM_mallocN(sizeof(*vecs) * vecs_len, __func__);
+	for (int i = 0; i < vecs_len; i++) {
+		BLI_rng_get_float_unit_v3(rng, vecs[i]);
+		mul_v3_fl(vecs[i], 100.0f * BLI_rng_get_float(rng));
+	}
+	BLI_rng_free(rng);
+	return vecs;
+}
+
+TEST(math_vector, NormalizeV3Array)
+{
+	const int vecs_len = 1003;
+	float (*vecs)[3] = random_vectors_new(vecs_len, 1);
+	/* Vectors which are too short to normalize. */
+	zero_v3(vecs[0]);
+	copy_v3_fl(vecs[5], 1e-20f);
+	zero_v3(vecs[vecs_len - 1]);
+	float (*vecs_array)[3] = (float (*)[3])MEM_dupallocN(vecs);
+
+	normalize_v3_array(vecs_array, vecs_len);
+	for (int i = 0; i < vecs_len; i++) {
+		normalize_v3(vecs[i]);
+		for (int j = 0; j < 3; j++) {
+			EXPECT_FLOAT_EQ(vecs_array[i][j], vecs[i][j]);
+		}
+	}
+	EXPECT_TRUE(is_zero_v3(vecs_array[5]));
+
+	MEM_freeN(vecs);
+	MEM_freeN(vecs_array);
+}
+
+TEST(math_vector, MinmaxV3V3V3ArrayStride)
+{
+	const int verts_len = 1001;
+	float (*vecs)[3] = random_vectors_new(verts_len, 2);
+	VertTest *verts = (VertTest *)MEM_mallocN(sizeof(*verts) * verts_len, __func__);
+	for (int i = 0; i < verts_len; i++) {
+		copy_v3_v3(verts[i].co, vecs[i]);
+		verts[i].flag = i;
+	}
+	/* Ignored, as with #minmax_v3v3_v3. */
+	verts[10].co[1] = NAN;
+
+	float min[3], max[3], min_array[3], max_array[3];
+	INIT_MINMAX(min, max);
+	INIT_MINMAX(min_array, max_array);
+	for (int i = 0; i < verts_len; i++) {
+		minmax_v3v3_v3(min, max, verts[i].co);
+	}
+	minmax_v3v3_v3_array_stride(min_array, max_array, verts[0].co, verts_len, sizeof(*verts));
+	EXPECT_V3_NEAR(min_array, min, 0.0f);
+	EXPECT_V3_NEAR(max_array, max, 0.0f);
+
+	/* Existing bounds are extended, not replaced. */
+	minmax_v3v3_v3_array(min_array, max_array, (const float (*)[3])vecs, 1);
+	EXPECT_V3_NEAR(min_array, min, 0.0f);
+	EXPECT_V3_NEAR(max_array, max, 0.0f);
+
+	MEM_freeN(vecs);
+	MEM_freeN(verts);
+}
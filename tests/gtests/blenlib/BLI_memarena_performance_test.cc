@@ -0,0 +1,68 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_memarena.h"
+#include "BLI_utildefines.h"
+#include "PIL_time_utildefines.h"
+};
+
+/**
+ * Allocate like polygon tessellation: small arrays for each of many polygons.
+ * Reset to \a mark after each polygon, or clear the arena when it's NULL.
+ */
+static void memarena_alloc_ngons(MemArena *arena, const MemArenaMark *mark, const int ngons_len)
+{
+	for (int i = 0; i < ngons_len; i++) {
+		const int verts_len = 5 + i % 20;
+		float(*projverts)[2] = (float(*)[2])BLI_memarena_alloc(arena, sizeof(*projverts) * verts_len);
+		uint(*tris)[3] = (uint(*)[3])BLI_memarena_alloc(arena, sizeof(*tris) * (verts_len - 2));
+		projverts[0][0] = 0.0f;
+		tris[0][0] = 0;
+		if (mark) {
+			BLI_memarena_reset_to_mark(arena, mark);
+		}
+		else {
+			BLI_memarena_clear(arena);
+		}
+	}
+}
+
+TEST(memarena, ThreadBenchmark)
+{
+	const int iter_len = 1000, ngons_len = 1000;
+	unsigned int blocks_max;
+
+	/* Arena created for each evaluation, as tessellation used to do. */
+	blocks_max = 0;
+	TIMEIT_START(memarena_new_free);
+	for (int i = 0; i < iter_len; i++) {
+		const unsigned int blocks_len = MEM_get_memory_blocks_in_use();
+		MemArena *arena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, __func__);
+		memarena_alloc_ngons(arena, NULL, ngons_len);
+		blocks_max = MAX2(blocks_max, MEM_get_memory_blocks_in_use() - blocks_len);
+		BLI_memarena_free(arena);
+	}
+	TIMEIT_END(memarena_new_free);
+	printf("guardedalloc blocks per evaluation: %u\n", blocks_max);
+
+	blocks_max = 0;
+	TIMEIT_START(memarena_thread);
+	for (int i = 0; i < iter_len; i++) {
+		const unsigned int blocks_len = MEM_get_memory_blocks_in_use();
+		MemArenaMark mark;
+		MemArena *arena = BLI_memarena_thread_begin(&mark);
+		memarena_alloc_ngons(arena, &mark, ngons_len);
+		/* The first evaluation creates the buffers. */
+		if (i != 0) {
+			blocks_max = MAX2(blocks_max, MEM_get_memory_blocks_in_use() - blocks_len);
+		}
+		BLI_memarena_thread_end(arena, &mark);
+	}
+	TIMEIT_END(memarena_thread);
+	printf("guardedalloc blocks per evaluation: %u\n", blocks_max);
+	EXPECT_EQ(blocks_max, 0);
+}
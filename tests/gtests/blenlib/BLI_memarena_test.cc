@@ -0,0 +1,198 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <thread>
+#include <vector>
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_memarena.h"
+#include "BLI_task.h"
+#include "BLI_utildefines.h"
+};
+
+TEST(memarena, MarkReset)
+{
+	MemArena *arena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, __func__);
+	MemArenaMark mark;
+
+	int *first = (int *)BLI_memarena_alloc(arena, sizeof(int));
+	*first = 42;
+
+	BLI_memarena_mark(arena, &mark);
+	void *after_mark = BLI_memarena_alloc(arena, 64);
+	/* Enough to need new buffers, including one larger than the buffer size. */
+	for (int i = 0; i < 100; i++) {
+		memset(BLI_memarena_alloc(arena, 1024), 0xff, 1024);
+	}
+	memset(BLI_memarena_alloc(arena, BLI_MEMARENA_STD_BUFSIZE * 4), 0xff, BLI_MEMARENA_STD_BUFSIZE * 4);
+	BLI_memarena_reset_to_mark(arena, &mark);
+
+	EXPECT_EQ(BLI_memarena_alloc(arena, 64), after_mark);
+	EXPECT_EQ(*first, 42);
+
+	BLI_memarena_free(arena);
+}
+
+TEST(memarena, MarkResetNested)
+{
+	MemArena *arena = BLI_memarena_new(256, __func__);
+	MemArenaMark mark_outer, mark_inner;
+
+	/* Marks of an empty arena free all buffers, so the first buffer would be allocated again. */
+	BLI_memarena_alloc(arena, 8);
+	BLI_memarena_mark(arena, &mark_outer);
+	char *outer = (char *)BLI_memarena_alloc(arena, 100);
+	memset(outer, 1, 100);
+
+	BLI_memarena_mark(arena, &mark_inner);
+	for (int i = 0; i < 10; i++) {
+		memset(BLI_memarena_alloc(arena, 100), 2, 100);
+	}
+	BLI_memarena_reset_to_mark(arena, &mark_inner);
+
+	for (int i = 0; i < 100; i++) {
+		EXPECT_EQ(outer[i], 1);
+	}
+
+	BLI_memarena_reset_to_mark(arena, &mark_outer);
+	EXPECT_EQ(BLI_memarena_alloc(arena, 100), (void *)outer);
+
+	BLI_memarena_free(arena);
+}
+
+TEST(memarena, MarkResetCalloc)
+{
+	MemArena *arena = BLI_memarena_new(256, __func__);
+	BLI_memarena_use_calloc(arena);
+	MemArenaMark mark;
+
+	BLI_memarena_alloc(arena, 8);
+	BLI_memarena_mark(arena, &mark);
+	for (int i = 0; i < 10; i++) {
+		memset(BLI_memarena_alloc(arena, 64), 0xff, 64);
+	}
+	BLI_memarena_reset_to_mark(arena, &mark);
+
+	for (int i = 0; i < 10; i++) {
+		const char *data = (const char *)BLI_memarena_alloc(arena, 64);
+		for (int j = 0; j < 64; j++) {
+			EXPECT_EQ(data[j], 0);
+		}
+	}
+
+	BLI_memarena_free(arena);
+}
+
+/**
+ * Allocate like polygon tessellation: small arrays for each of many polygons.
+ * Reset to \a mark after each polygon, or clear the arena when it's NULL.
+ */
+static void memarena_alloc_ngons(MemArena *arena, const MemArenaMark *mark, const int ngons_len)
+{
+	for (int i = 0; i < ngons_len; i++) {
+		const int verts_len = 5 + i % 20;
+		float(*projverts)[2] = (float(*)[2])BLI_memarena_alloc(arena, sizeof(*projverts) * verts_len);
+		uint(*tris)[3] = (uint(*)[3])BLI_memarena_alloc(arena, sizeof(*tris) * (verts_len - 2));
+		projverts[0][0] = 0.0f;
+		tris[0][0] = 0;
+		if (mark) {
+			BLI_memarena_reset_to_mark(arena, mark);
+		}
+		else {
+			BLI_memarena_clear(arena);
+		}
+	}
+}
+
+TEST(memarena, ThreadScopes)
+{
+	MemArenaMark mark_outer, mark_inner;
+	MemArena *arena = BLI_memarena_thread_begin(&mark_outer);
+	EXPECT_EQ(arena, BLI_memarena_thread_get());
+
+	int *outer = (int *)BLI_memarena_alloc(arena, sizeof(int) * 1000);
+	for (int i = 0; i < 1000; i++) {
+		outer[i] = i;
+	}
+
+	EXPECT_EQ(BLI_memarena_thread_begin(&mark_inner), arena);
+	memset(BLI_memarena_alloc(arena, BLI_MEMARENA_STD_BUFSIZE * 2), 0xff, BLI_MEMARENA_STD_BUFSIZE * 2);
+	BLI_memarena_thread_end(arena, &mark_inner);
+
+	for (int i = 0; i < 1000; i++) {
+		EXPECT_EQ(outer[i], i);
+	}
+	BLI_memarena_thread_end(arena, &mark_outer);
+
+	/* Once the buffers exist, scopes don't allocate from guardedalloc. */
+	const unsigned int blocks_len = MEM_get_memory_blocks_in_use();
+	arena = BLI_memarena_thread_begin(&mark_outer);
+	memset(BLI_memarena_alloc(arena, BLI_MEMARENA_STD_BUFSIZE * 2), 0, BLI_MEMARENA_STD_BUFSIZE * 2);
+	memarena_alloc_ngons(arena, &mark_outer, 1000);
+	EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_len);
+	BLI_memarena_thread_end(arena, &mark_outer);
+}
+
+static void memarena_thread_func(
+        void *__restrict userdata,
+        const int iter,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	int *result = (int *)userdata;
+	MemArenaMark mark;
+	MemArena *arena = BLI_memarena_thread_begin(&mark);
+	const int len = 100 + iter;
+	int *data = (int *)BLI_memarena_alloc(arena, sizeof(int) * len);
+	for (int i = 0; i < len; i++) {
+		data[i] = iter;
+	}
+	int sum = 0;
+	for (int i = 0; i < len; i++) {
+		sum += data[i];
+	}
+	result[iter] = sum;
+	BLI_memarena_thread_end(arena, &mark);
+}
+
+TEST(memarena, ThreadArenas)
+{
+	const int iter_len = 10000;
+	int *result = (int *)MEM_mallocN(sizeof(int) * iter_len, __func__);
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.min_iter_per_thread = 1;
+	BLI_task_parallel_range(0, iter_len, result, memarena_thread_func, &settings);
+
+	for (int i = 0; i < iter_len; i++) {
+		EXPECT_EQ(result[i], i * (100 + i));
+	}
+
+	MEM_freeN(result);
+}
+
+/* Arenas of threads which exit are freed. */
+TEST(memarena, ThreadExit)
+{
+	const unsigned int blocks_len = MEM_get_memory_blocks_in_use();
+
+	for (int round = 0; round < 4; round++) {
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 8; t++) {
+			threads.push_back(std::thread([]() {
+				MemArenaMark mark;
+				MemArena *arena = BLI_memarena_thread_begin(&mark);
+				memset(BLI_memarena_alloc(arena, BLI_MEMARENA_STD_BUFSIZE * 2), 0, BLI_MEMARENA_STD_BUFSIZE * 2);
+				memarena_alloc_ngons(arena, &mark, 100);
+				BLI_memarena_thread_end(arena, &mark);
+			}));
+		}
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+		EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_len);
+	}
+}
@@ -0,0 +1,131 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+#include "PIL_time_utildefines.h"
+};
+
+#define NUM_TASKS 64
+#define NUM_ELEMS_PER_TASK 1000
+
+typedef struct MempoolTaskData {
+	BLI_mempool *mempool;
+	/* Only set for pools without BLI_MEMPOOL_CONCURRENT, which then need a lock. */
+	SpinLock *lock;
+	int **elems;
+} MempoolTaskData;
+
+static int *mempool_task_alloc(MempoolTaskData *data)
+{
+	if (data->lock) {
+		BLI_spin_lock(data->lock);
+	}
+	int *elem = (int *)BLI_mempool_alloc(data->mempool);
+	if (data->lock) {
+		BLI_spin_unlock(data->lock);
+	}
+	return elem;
+}
+
+static void mempool_task_free(MempoolTaskData *data, int *elem)
+{
+	if (data->lock) {
+		BLI_spin_lock(data->lock);
+	}
+	BLI_mempool_free(data->mempool, elem);
+	if (data->lock) {
+		BLI_spin_unlock(data->lock);
+	}
+}
+
+static void mempool_alloc_func(TaskPool *__restrict pool, void *taskdata, int /*threadid*/)
+{
+	MempoolTaskData *data = (MempoolTaskData *)BLI_task_pool_userdata(pool);
+	const int task = POINTER_AS_INT(taskdata);
+	int **elems = &data->elems[task * NUM_ELEMS_PER_TASK];
+
+	for (int i = 0; i < NUM_ELEMS_PER_TASK; i++) {
+		elems[i] = mempool_task_alloc(data);
+		*elems[i] = task * NUM_ELEMS_PER_TASK + i;
+	}
+
+	/* Free some and allocate them again, reusing freed elements. */
+	for (int i = 0; i < NUM_ELEMS_PER_TASK; i += 2) {
+		mempool_task_free(data, elems[i]);
+	}
+	for (int i = 0; i < NUM_ELEMS_PER_TASK; i += 2) {
+		elems[i] = mempool_task_alloc(data);
+		*elems[i] = task * NUM_ELEMS_PER_TASK + i;
+	}
+}
+
+static void mempool_free_func(TaskPool *__restrict pool, void *taskdata, int /*threadid*/)
+{
+	MempoolTaskData *data = (MempoolTaskData *)BLI_task_pool_userdata(pool);
+	/* Free the elements of another task, so elements are freed by other threads than the allocating one. */
+	const int task = NUM_TASKS - 1 - POINTER_AS_INT(taskdata);
+	int **elems = &data->elems[task * NUM_ELEMS_PER_TASK];
+
+	for (int i = 0; i < NUM_ELEMS_PER_TASK; i++) {
+		mempool_task_free(data, elems[i]);
+	}
+}
+
+static void mempool_run_tasks(TaskScheduler *scheduler, MempoolTaskData *data, TaskRunFunction run)
+{
+	TaskPool *pool = BLI_task_pool_create(scheduler, data);
+	for (int task = 0; task < NUM_TASKS; task++) {
+		BLI_task_pool_push(pool, run, POINTER_FROM_INT(task), false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+}
+
+TEST(mempool, ConcurrentBenchmark)
+{
+	TaskScheduler *scheduler = BLI_task_scheduler_create(0);
+	printf("Running with %d threads\n", BLI_task_scheduler_num_threads(scheduler));
+
+	SpinLock lock;
+	BLI_spin_init(&lock);
+
+	MempoolTaskData data;
+	data.elems = (int **)MEM_mallocN(sizeof(int *) * NUM_TASKS * NUM_ELEMS_PER_TASK, __func__);
+
+	{
+		data.mempool = BLI_mempool_create(sizeof(int), 0, 512, BLI_MEMPOOL_NOP);
+		data.lock = &lock;
+		TIMEIT_START(mempool_locked);
+		for (int i = 0; i < 20; i++) {
+			mempool_run_tasks(scheduler, &data, mempool_alloc_func);
+			mempool_run_tasks(scheduler, &data, mempool_free_func);
+		}
+		TIMEIT_END(mempool_locked);
+		EXPECT_EQ(BLI_mempool_len(data.mempool), 0);
+		BLI_mempool_destroy(data.mempool);
+	}
+
+	{
+		data.mempool = BLI_mempool_create(sizeof(int), 0, 512, BLI_MEMPOOL_CONCURRENT);
+		data.lock = NULL;
+		TIMEIT_START(mempool_concurrent);
+		for (int i = 0; i < 20; i++) {
+			mempool_run_tasks(scheduler, &data, mempool_alloc_func);
+			mempool_run_tasks(scheduler, &data, mempool_free_func);
+		}
+		TIMEIT_END(mempool_concurrent);
+		EXPECT_EQ(BLI_mempool_len(data.mempool), 0);
+		BLI_mempool_destroy(data.mempool);
+	}
+
+	BLI_spin_end(&lock);
+	MEM_freeN(data.elems);
+	BLI_task_scheduler_free(scheduler);
+}
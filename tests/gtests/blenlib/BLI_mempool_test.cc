@@ -0,0 +1,127 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+#include "atomic_ops.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_utildefines.h"
+};
+
+/* Fixed number of threads, so concurrency is tested on any machine. */
+#define NUM_THREADS 8
+#define NUM_TASKS 64
+#define NUM_ELEMS_PER_TASK 1000
+
+typedef struct MempoolTaskData {
+	BLI_mempool *mempool;
+	int **elems;
+} MempoolTaskData;
+
+static void mempool_alloc_func(TaskPool *__restrict pool, void *taskdata, int /*threadid*/)
+{
+	MempoolTaskData *data = (MempoolTaskData *)BLI_task_pool_userdata(pool);
+	const int task = POINTER_AS_INT(taskdata);
+	int **elems = &data->elems[task * NUM_ELEMS_PER_TASK];
+
+	for (int i = 0; i < NUM_ELEMS_PER_TASK; i++) {
+		elems[i] = (int *)BLI_mempool_alloc(data->mempool);
+		*elems[i] = task * NUM_ELEMS_PER_TASK + i;
+	}
+
+	/* Free some and allocate them again, reusing freed elements. */
+	for (int i = 0; i < NUM_ELEMS_PER_TASK; i += 2) {
+		BLI_mempool_free(data->mempool, elems[i]);
+	}
+	for (int i = 0; i < NUM_ELEMS_PER_TASK; i += 2) {
+		elems[i] = (int *)BLI_mempool_alloc(data->mempool);
+		*elems[i] = task * NUM_ELEMS_PER_TASK + i;
+	}
+}
+
+static void mempool_free_func(TaskPool *__restrict pool, void *taskdata, int /*threadid*/)
+{
+	MempoolTaskData *data = (MempoolTaskData *)BLI_task_pool_userdata(pool);
+	/* Free the elements of another task, so elements are freed by other threads than the allocating one. */
+	const int task = NUM_TASKS - 1 - POINTER_AS_INT(taskdata);
+	int **elems = &data->elems[task * NUM_ELEMS_PER_TASK];
+
+	for (int i = 0; i < NUM_ELEMS_PER_TASK; i++) {
+		BLI_mempool_free(data->mempool, elems[i]);
+	}
+}
+
+static void mempool_run_tasks(TaskScheduler *scheduler, MempoolTaskData *data, TaskRunFunction run)
+{
+	TaskPool *pool = BLI_task_pool_create(scheduler, data);
+	for (int task = 0; task < NUM_TASKS; task++) {
+		BLI_task_pool_push(pool, run, POINTER_FROM_INT(task), false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+}
+
+static void mempool_iter_count_func(void *userdata, MempoolIterData *item)
+{
+	int *elem = (int *)item;
+	EXPECT_LT(*elem, NUM_TASKS * NUM_ELEMS_PER_TASK);
+	atomic_add_and_fetch_uint32((uint32_t *)userdata, 1);
+}
+
+TEST(mempool, ConcurrentAllocFree)
+{
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	MempoolTaskData data;
+	data.mempool = BLI_mempool_create(sizeof(int), 0, 512, BLI_MEMPOOL_ALLOW_ITER | BLI_MEMPOOL_CONCURRENT);
+	data.elems = (int **)MEM_mallocN(sizeof(int *) * NUM_TASKS * NUM_ELEMS_PER_TASK, __func__);
+
+	mempool_run_tasks(scheduler, &data, mempool_alloc_func);
+	EXPECT_EQ(BLI_mempool_len(data.mempool), NUM_TASKS * NUM_ELEMS_PER_TASK);
+
+	/* Every element was allocated once. */
+	for (int i = 0; i < NUM_TASKS * NUM_ELEMS_PER_TASK; i++) {
+		EXPECT_EQ(*data.elems[i], i);
+	}
+
+	/* Iteration sees all elements. */
+	{
+		BLI_mempool_iter iter;
+		int64_t sum = 0;
+		int count = 0;
+		BLI_mempool_iternew(data.mempool, &iter);
+		for (int *elem = (int *)BLI_mempool_iterstep(&iter); elem; elem = (int *)BLI_mempool_iterstep(&iter)) {
+			sum += *elem;
+			count++;
+		}
+		EXPECT_EQ(count, NUM_TASKS * NUM_ELEMS_PER_TASK);
+		EXPECT_EQ(sum, (int64_t)NUM_TASKS * NUM_ELEMS_PER_TASK * (NUM_TASKS * NUM_ELEMS_PER_TASK - 1) / 2);
+	}
+
+	{
+		uint32_t count = 0;
+		BLI_task_parallel_mempool(data.mempool, &count, mempool_iter_count_func, true);
+		EXPECT_EQ(count, NUM_TASKS * NUM_ELEMS_PER_TASK);
+	}
+
+	mempool_run_tasks(scheduler, &data, mempool_free_func);
+	EXPECT_EQ(BLI_mempool_len(data.mempool), 0);
+
+	/* Elements freed by other threads can be allocated again. */
+	mempool_run_tasks(scheduler, &data, mempool_alloc_func);
+	EXPECT_EQ(BLI_mempool_len(data.mempool), NUM_TASKS * NUM_ELEMS_PER_TASK);
+	for (int i = 0; i < NUM_TASKS * NUM_ELEMS_PER_TASK; i++) {
+		EXPECT_EQ(*data.elems[i], i);
+	}
+
+	BLI_mempool_clear(data.mempool);
+	EXPECT_EQ(BLI_mempool_len(data.mempool), 0);
+	mempool_run_tasks(scheduler, &data, mempool_alloc_func);
+	EXPECT_EQ(BLI_mempool_len(data.mempool), NUM_TASKS * NUM_ELEMS_PER_TASK);
+
+	BLI_mempool_destroy(data.mempool);
+	MEM_freeN(data.elems);
+	BLI_task_scheduler_free(scheduler);
+}
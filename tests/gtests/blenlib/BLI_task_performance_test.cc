@@ -0,0 +1,94 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "atomic_ops.h"
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "BLI_task.h"
+#include "BLI_utildefines.h"
+#include "PIL_time_utildefines.h"
+};
+
+static void task_pool_count_func(TaskPool *__restrict pool, void * /*taskdata*/, int /*threadid*/)
+{
+	uint32_t *count = (uint32_t *)BLI_task_pool_userdata(pool);
+	atomic_add_and_fetch_uint32(count, 1);
+}
+
+/* Contention Benchmarks
+ *
+ * Lots of tasks which do almost no work, so the time is spent in the
+ * scheduler itself.
+ */
+
+static void task_spawn_func(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+	const int depth = POINTER_AS_INT(taskdata);
+	task_pool_count_func(pool, NULL, threadid);
+	if (depth > 0) {
+		/* Tasks pushed from worker threads, as done by depsgraph evaluation. */
+		BLI_task_pool_push_from_thread(pool, task_spawn_func, POINTER_FROM_INT(depth - 1),
+		                               false, TASK_PRIORITY_HIGH, threadid);
+		BLI_task_pool_push_from_thread(pool, task_spawn_func, POINTER_FROM_INT(depth - 1),
+		                               false, TASK_PRIORITY_HIGH, threadid);
+	}
+}
+
+static void task_parallel_range_func(void *__restrict userdata,
+                                     const int iter,
+                                     const ParallelRangeTLS *__restrict /*tls*/)
+{
+	uint32_t *count = (uint32_t *)userdata;
+	atomic_add_and_fetch_uint32(count, (uint32_t)(iter >= 0));
+}
+
+TEST(task, ContentionBenchmark)
+{
+	const int num_tasks = 1000000;
+	TaskScheduler *scheduler = BLI_task_scheduler_create(0);
+	printf("Running with %d threads\n", BLI_task_scheduler_num_threads(scheduler));
+
+	{
+		uint32_t count = 0;
+		TaskPool *pool = BLI_task_pool_create(scheduler, &count);
+		TIMEIT_START(push_from_main);
+		for (int i = 0; i < num_tasks; i++) {
+			BLI_task_pool_push(pool, task_pool_count_func, NULL, false, TASK_PRIORITY_HIGH);
+		}
+		BLI_task_pool_work_and_wait(pool);
+		TIMEIT_END(push_from_main);
+		EXPECT_EQ(count, num_tasks);
+		BLI_task_pool_free(pool);
+	}
+
+	{
+		uint32_t count = 0;
+		TaskPool *pool = BLI_task_pool_create(scheduler, &count);
+		TIMEIT_START(push_from_workers);
+		for (int i = 0; i < 16; i++) {
+			BLI_task_pool_push(pool, task_spawn_func, POINTER_FROM_INT(15), false, TASK_PRIORITY_HIGH);
+		}
+		BLI_task_pool_work_and_wait(pool);
+		TIMEIT_END(push_from_workers);
+		EXPECT_EQ(count, 16 * ((1 << 16) - 1));
+		BLI_task_pool_free(pool);
+	}
+
+	{
+		uint32_t count = 0;
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+		TIMEIT_START(parallel_range_small_chunks);
+		for (int i = 0; i < 1000; i++) {
+			BLI_task_parallel_range(0, 1000, &count, task_parallel_range_func, &settings);
+		}
+		TIMEIT_END(parallel_range_small_chunks);
+		EXPECT_EQ(count, 1000 * 1000);
+	}
+
+	BLI_task_scheduler_free(scheduler);
+}
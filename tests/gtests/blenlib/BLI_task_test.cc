@@ -5,10 +5,14 @@
 
 #include "atomic_ops.h"
 
+#include "MEM_guardedalloc.h"
+
 extern "C" {
 #include "BLI_mempool.h"
 #include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
+#include "PIL_time.h"
 };
 
 #define NUM_ITEMS 10000
@@ -74,3 +78,184 @@ TEST(task, MempoolIter)
 
 	BLI_mempool_destroy(mempool);
 }
+
+/* Task Pool */
+
+/* Fixed number of threads, so stealing is tested on any machine. */
+#define NUM_THREADS 8
+
+static void task_pool_count_func(TaskPool *__restrict pool, void * /*taskdata*/, int /*threadid*/)
+{
+	uint32_t *count = (uint32_t *)BLI_task_pool_userdata(pool);
+	atomic_add_and_fetch_uint32(count, 1);
+}
+
+TEST(task, PoolManyTasks)
+{
+	const int num_tasks = 100000;
+	uint32_t count = 0;
+
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	TaskPool *pool = BLI_task_pool_create(scheduler, &count);
+	for (int i = 0; i < num_tasks; i++) {
+		BLI_task_pool_push(pool, task_pool_count_func, POINTER_FROM_INT(i), false,
+		                   (i % 2) ? TASK_PRIORITY_HIGH : TASK_PRIORITY_LOW);
+	}
+	BLI_task_pool_work_and_wait(pool);
+	EXPECT_EQ(count, num_tasks);
+
+	/* Pool can be reused after waiting. */
+	for (int i = 0; i < num_tasks; i++) {
+		BLI_task_pool_push(pool, task_pool_count_func, NULL, false, TASK_PRIORITY_LOW);
+	}
+	BLI_task_pool_work_and_wait(pool);
+	EXPECT_EQ(count, 2 * num_tasks);
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+}
+
+typedef struct NestedPoolData {
+	TaskScheduler *scheduler;
+	uint32_t count;
+} NestedPoolData;
+
+static void task_nested_pool_func(TaskPool *__restrict pool, void *taskdata, int threadid)
+{
+	NestedPoolData *data = (NestedPoolData *)BLI_task_pool_userdata(pool);
+	const int depth = POINTER_AS_INT(taskdata);
+
+	atomic_add_and_fetch_uint32(&data->count, 1);
+	if (depth == 0) {
+		return;
+	}
+
+	/* Every task waits for a pool of its own, like nested parallel ranges do. */
+	TaskPool *sub_pool = BLI_task_pool_create(data->scheduler, data);
+	for (int i = 0; i < 8; i++) {
+		BLI_task_pool_push_from_thread(sub_pool, task_nested_pool_func,
+		                               POINTER_FROM_INT(depth - 1), false, TASK_PRIORITY_HIGH, threadid);
+	}
+	BLI_task_pool_work_and_wait(sub_pool);
+	BLI_task_pool_free(sub_pool);
+}
+
+TEST(task, PoolNested)
+{
+	NestedPoolData data;
+	data.scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	data.count = 0;
+
+	TaskPool *pool = BLI_task_pool_create(data.scheduler, &data);
+	for (int i = 0; i < 8; i++) {
+		BLI_task_pool_push(pool, task_nested_pool_func, POINTER_FROM_INT(3), false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_work_and_wait(pool);
+
+	/* 8 + 8^2 + 8^3 + 8^4 tasks. */
+	EXPECT_EQ(data.count, 4680);
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(data.scheduler);
+}
+
+TEST(task, PoolSingleThreaded)
+{
+	const int num_tasks = 10000;
+	uint32_t count = 0;
+
+	/* Only the background thread exists, which never runs tasks of regular pools. */
+	TaskScheduler *scheduler = BLI_task_scheduler_create(1);
+	TaskPool *pool = BLI_task_pool_create(scheduler, &count);
+	for (int i = 0; i < num_tasks; i++) {
+		BLI_task_pool_push(pool, task_pool_count_func, NULL, false, TASK_PRIORITY_LOW);
+	}
+	BLI_task_pool_work_and_wait(pool);
+	EXPECT_EQ(count, num_tasks);
+	BLI_task_pool_free(pool);
+
+	uint32_t background_count = 0;
+	TaskPool *background_pool = BLI_task_pool_create_background(scheduler, &background_count);
+	for (int i = 0; i < num_tasks; i++) {
+		BLI_task_pool_push(background_pool, task_pool_count_func, NULL, false, TASK_PRIORITY_LOW);
+	}
+	BLI_task_pool_work_and_wait(background_pool);
+	EXPECT_EQ(background_count, num_tasks);
+	BLI_task_pool_free(background_pool);
+
+	BLI_task_scheduler_free(scheduler);
+}
+
+TEST(task, PoolSuspended)
+{
+	const int num_tasks = 10000;
+	uint32_t count = 0;
+
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	TaskPool *pool = BLI_task_pool_create_suspended(scheduler, &count);
+	for (int i = 0; i < num_tasks; i++) {
+		BLI_task_pool_push(pool, task_pool_count_func, NULL, false, TASK_PRIORITY_LOW);
+	}
+	/* Nothing runs before the pool is waited for. */
+	PIL_sleep_ms(10);
+	EXPECT_EQ(count, 0);
+
+	BLI_task_pool_work_wait_and_reset(pool);
+	EXPECT_EQ(count, num_tasks);
+
+	/* Pool is suspended again after reset. */
+	for (int i = 0; i < num_tasks; i++) {
+		BLI_task_pool_push(pool, task_pool_count_func, NULL, false, TASK_PRIORITY_LOW);
+	}
+	PIL_sleep_ms(10);
+	EXPECT_EQ(count, num_tasks);
+	BLI_task_pool_work_and_wait(pool);
+	EXPECT_EQ(count, 2 * num_tasks);
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+}
+
+static void task_free_func(TaskPool *__restrict pool, void *taskdata, int /*threadid*/)
+{
+	uint32_t *num_freed = (uint32_t *)BLI_task_pool_userdata(pool);
+	atomic_add_and_fetch_uint32(num_freed, 1);
+	MEM_freeN(taskdata);
+}
+
+static void task_cancel_func(TaskPool *__restrict pool, void * /*taskdata*/, int /*threadid*/)
+{
+	while (!BLI_task_pool_canceled(pool)) {
+		PIL_sleep_ms(1);
+	}
+}
+
+TEST(task, PoolCancel)
+{
+	const int num_tasks = 10000;
+	uint32_t num_freed = 0;
+
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	TaskPool *pool = BLI_task_pool_create(scheduler, &num_freed);
+	for (int i = 0; i < num_tasks; i++) {
+		BLI_task_pool_push_ex(pool, task_cancel_func, MEM_mallocN(16, __func__), true,
+		                      task_free_func, TASK_PRIORITY_LOW);
+	}
+	PIL_sleep_ms(10);
+	BLI_task_pool_cancel(pool);
+	/* Task data is freed for tasks which ran as well as for discarded ones. */
+	EXPECT_EQ(num_freed, num_tasks);
+	BLI_task_pool_free(pool);
+
+	/* Suspended pools which never started still free their tasks. */
+	num_freed = 0;
+	pool = BLI_task_pool_create_suspended(scheduler, &num_freed);
+	for (int i = 0; i < num_tasks; i++) {
+		BLI_task_pool_push_ex(pool, task_cancel_func, MEM_mallocN(16, __func__), true,
+		                      task_free_func, TASK_PRIORITY_LOW);
+	}
+	BLI_task_pool_free(pool);
+	EXPECT_EQ(num_freed, num_tasks);
+
+	BLI_task_scheduler_free(scheduler);
+}
@@ -0,0 +1,72 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "BLI_utildefines.h"
+}
+
+#include "MEM_guardedalloc.h"
+
+#define NUM_THREADS 8
+#define NUM_BLOCKS 10000
+
+/* The default (lock-free) allocator, to compare with. */
+static void *(*const lockfree_mallocN)(size_t len, const char *str) = MEM_mallocN;
+static void (*const lockfree_freeN)(void *vmemh) = MEM_freeN;
+
+namespace {
+
+/* Sizes of small blocks, mostly below the largest slab size class. */
+size_t block_size(const int i)
+{
+	return (size_t)((i * 7919) % 600);
+}
+
+void alloc_free_blocks(void *(*mallocN)(size_t, const char *), void (*freeN)(void *), const int rounds)
+{
+	std::vector<void *> blocks(NUM_BLOCKS);
+	for (int r = 0; r < rounds; r++) {
+		for (int i = 0; i < NUM_BLOCKS; i++) {
+			blocks[i] = mallocN(block_size(i), __func__);
+		}
+		/* Free in a different order than allocated. */
+		for (int i = 0; i < NUM_BLOCKS; i += 2) {
+			freeN(blocks[i]);
+		}
+		for (int i = 1; i < NUM_BLOCKS; i += 2) {
+			freeN(blocks[i]);
+		}
+	}
+}
+
+double alloc_free_threaded(void *(*mallocN)(size_t, const char *), void (*freeN)(void *), const int rounds)
+{
+	std::vector<std::thread> threads;
+	const auto time_start = std::chrono::steady_clock::now();
+	for (int t = 0; t < NUM_THREADS; t++) {
+		threads.push_back(std::thread(alloc_free_blocks, mallocN, freeN, rounds));
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+}
+
+}  // namespace
+
+TEST(guardedalloc, SlabBenchmark)
+{
+	const int rounds = 50;
+
+	const double time_lockfree = alloc_free_threaded(lockfree_mallocN, lockfree_freeN, rounds);
+	printf("lock-free allocator: %f seconds\n", time_lockfree);
+
+	MEM_use_slab_allocator();
+	const double time_slab = alloc_free_threaded(MEM_mallocN, MEM_freeN, rounds);
+	printf("slab allocator: %f seconds\n", time_slab);
+}
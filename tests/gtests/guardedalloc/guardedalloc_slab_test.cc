@@ -0,0 +1,165 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "BLI_utildefines.h"
+}
+
+#include "MEM_guardedalloc.h"
+
+#define NUM_THREADS 8
+#define NUM_BLOCKS 10000
+
+/* The default (lock-free) allocator, for blocks allocated before switching. */
+static void *(*const lockfree_mallocN)(size_t len, const char *str) = MEM_mallocN;
+
+namespace {
+
+/* Sizes of small blocks, mostly below the largest slab size class. */
+size_t block_size(const int i)
+{
+	return (size_t)((i * 7919) % 600);
+}
+
+void alloc_free_blocks(void *(*mallocN)(size_t, const char *), void (*freeN)(void *), const int rounds)
+{
+	std::vector<void *> blocks(NUM_BLOCKS);
+	for (int r = 0; r < rounds; r++) {
+		for (int i = 0; i < NUM_BLOCKS; i++) {
+			blocks[i] = mallocN(block_size(i), __func__);
+		}
+		/* Free in a different order than allocated. */
+		for (int i = 0; i < NUM_BLOCKS; i += 2) {
+			freeN(blocks[i]);
+		}
+		for (int i = 1; i < NUM_BLOCKS; i += 2) {
+			freeN(blocks[i]);
+		}
+	}
+}
+
+}  // namespace
+
+TEST(guardedalloc, SlabAllocFree)
+{
+	MEM_use_slab_allocator();
+
+	const size_t mem_in_use = MEM_get_memory_in_use();
+	const unsigned int blocks_in_use = MEM_get_memory_blocks_in_use();
+	std::vector<void *> blocks(NUM_BLOCKS);
+	size_t len_total = 0;
+
+	for (int i = 0; i < NUM_BLOCKS; i++) {
+		const size_t len = block_size(i);
+		blocks[i] = MEM_mallocN(len, __func__);
+		EXPECT_GE(MEM_allocN_len(blocks[i]), len);
+		EXPECT_EQ((size_t)blocks[i] % sizeof(void *), 0);
+		memset(blocks[i], i & 0xff, len);
+		len_total += MEM_allocN_len(blocks[i]);
+	}
+
+	EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use + len_total);
+	EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_in_use + NUM_BLOCKS);
+	EXPECT_GE(MEM_get_peak_memory(), mem_in_use + len_total);
+
+	for (int i = 0; i < NUM_BLOCKS; i++) {
+		const unsigned char *data = (const unsigned char *)blocks[i];
+		for (size_t j = 0; j < block_size(i); j++) {
+			EXPECT_EQ(data[j], i & 0xff);
+		}
+		MEM_freeN(blocks[i]);
+	}
+
+	EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use);
+	EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_in_use);
+}
+
+TEST(guardedalloc, SlabRealloc)
+{
+	MEM_use_slab_allocator();
+
+	const size_t mem_in_use = MEM_get_memory_in_use();
+	int *data = (int *)MEM_callocN(sizeof(int) * 4, __func__);
+	for (int i = 0; i < 4; i++) {
+		EXPECT_EQ(data[i], 0);
+		data[i] = i;
+	}
+
+	/* Grow within a size class, to another class and to a block which isn't a slab block. */
+	for (int len = 5; len < 1000; len += 7) {
+		data = (int *)MEM_recallocN(data, sizeof(int) * len);
+		EXPECT_EQ(MEM_allocN_len(data), sizeof(int) * len);
+		for (int i = 0; i < 4; i++) {
+			EXPECT_EQ(data[i], i);
+		}
+		EXPECT_EQ(data[len - 1], 0);
+	}
+	for (int len = 1000; len > 4; len -= 7) {
+		data = (int *)MEM_reallocN(data, sizeof(int) * len);
+		EXPECT_EQ(MEM_allocN_len(data), sizeof(int) * len);
+		for (int i = 0; i < 4; i++) {
+			EXPECT_EQ(data[i], i);
+		}
+	}
+
+	int *data_dup = (int *)MEM_dupallocN(data);
+	EXPECT_EQ(MEM_allocN_len(data_dup), MEM_allocN_len(data));
+	for (int i = 0; i < 4; i++) {
+		EXPECT_EQ(data_dup[i], i);
+	}
+
+	MEM_freeN(data);
+	MEM_freeN(data_dup);
+	EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use);
+}
+
+TEST(guardedalloc, SlabLockfreeBlocks)
+{
+	/* Blocks allocated before switching to the slab allocator. */
+	void *block_small = lockfree_mallocN(16, __func__);
+	void *block_aligned = MEM_mallocN_aligned(16, 16, __func__);
+
+	MEM_use_slab_allocator();
+
+	const unsigned int blocks_in_use = MEM_get_memory_blocks_in_use();
+	block_small = MEM_reallocN(block_small, 32);
+	block_aligned = MEM_reallocN(block_aligned, 32);
+	EXPECT_EQ((size_t)block_aligned % 16, 0);
+	MEM_freeN(block_small);
+	MEM_freeN(block_aligned);
+	EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_in_use - 2);
+}
+
+/* Blocks allocated by one thread and freed by others. */
+TEST(guardedalloc, SlabThreadedFree)
+{
+	MEM_use_slab_allocator();
+
+	const size_t mem_in_use = MEM_get_memory_in_use();
+	const unsigned int blocks_in_use = MEM_get_memory_blocks_in_use();
+	std::vector<void *> blocks(NUM_BLOCKS * NUM_THREADS);
+	for (size_t i = 0; i < blocks.size(); i++) {
+		blocks[i] = MEM_mallocN(block_size((int)i), __func__);
+	}
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < NUM_THREADS; t++) {
+		threads.push_back(std::thread([&blocks, t]() {
+			for (int i = 0; i < NUM_BLOCKS; i++) {
+				MEM_freeN(blocks[t * NUM_BLOCKS + i]);
+			}
+			/* Reuse the freed blocks. */
+			alloc_free_blocks(MEM_mallocN, MEM_freeN, 2);
+		}));
+	}
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	EXPECT_EQ(MEM_get_memory_in_use(), mem_in_use);
+	EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_in_use);
+}